@@ -0,0 +1,71 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Common settings of all ACACIA projects: compiler options and codec libraries.
+#
+# -------------------------------------------------------------------------------------------------
+
+
+# To allow constant class members and nullptr
+QMAKE_CXXFLAGS += -std=c++11
+
+# To enable AVX instructions
+QMAKE_CXXFLAGS += -mavx -mavx2
+
+# To make GCC unroll loops in the feature extraction functions
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+
+
+# JPEG library path
+# In Linux a system library can be used.
+# If libjpeg is used, then comment USE_LIBJPEG_TURBO in encoder.cpp and decoder.cpp
+# A custom path to JPEG library can be specified below:
+
+# - for Windows
+#INCLUDEPATH += "c:/SomeUserPath/Applications/Codecs/libjpeg-turbo-1.5.0-gcc64/include"
+#QMAKE_LIBDIR += "c:/SomeUserPath/Applications/Codecs/libjpeg-turbo-1.5.0-gcc64/lib"
+
+# - for custom Linux installation
+#INCLUDEPATH += "/opt/libjpeg-turbo/include"
+#QMAKE_LIBDIR += "/opt/libjpeg-turbo/lib64"
+
+ACACIA_LIBS += -ljpeg
+
+# Enable static linking for libjpeg. Disabled by default as it may cause conflicts with libjpeg integrated into Qt.
+#QMAKE_LFLAGS += -static
+
+
+
+# WebP library path:
+
+# - for Windows
+#INCLUDEPATH += "c:/SomeUserPath/Applications/Codecs/libwebp-0.5.0-windows-x64-no-wic/include"
+#QMAKE_LIBDIR += "c:/SomeUserPath/Applications/Codecs/libwebp-0.5.0-windows-x64-no-wic/lib"
+
+# - for Linux and OSX
+#INCLUDEPATH += "/.../libwebp-0.5.0-mac-10.9/include"
+#QMAKE_LIBDIR += "/.../libwebp-0.5.0-mac-10.9/lib/"
+
+ACACIA_LIBS += -lwebp
+
+
+
+# Optional input formats of the console tool: "qmake CONFIG+=acacia_png CONFIG+=acacia_tiff"
+# JPEG, WebP, BMP and PNM are always supported.
+acacia_png {
+    DEFINES += USE_LIBPNG
+    ACACIA_LIBS += -lpng
+}
+acacia_tiff {
+    DEFINES += USE_LIBTIFF
+    ACACIA_LIBS += -ltiff
+}
+
+# Batch file I/O through io_uring (Linux 5.6 or later, no liburing needed): "qmake CONFIG+=acacia_io_uring"
+# Without it, or if the kernel refuses io_uring at runtime, a thread pool does blocking I/O.
+acacia_io_uring {
+    DEFINES += USE_IO_URING
+}
+
+# Profiler and worker threads
+unix: ACACIA_LIBS += -lpthread
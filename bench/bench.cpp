@@ -0,0 +1,1270 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math.h"
+
+#include "featureextractor.h"
+#include "featurekernels.h"
+#include "optimizer.h"
+#include "encoder.h"
+#include "sequenceanalyzer.h"
+#include "taskscheduler.h"
+#include "yuvimage.h"
+
+// Every benchmark is a function performing a fixed amount of work.
+// The amount of work is described by the number of operations and pixels processed in one call,
+// which allows to report both ns/op and MP/s.
+struct Benchmark
+{
+    std::string name;
+    double opsPerCall;
+    double pixelsPerCall;
+    std::function<void()> run;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    double nsPerOp;
+    double megapixelsPerSecond;
+    unsigned long long int iterations;
+};
+
+// results of benchmarked functions are accumulated here, so that the compiler cannot remove the calls
+static volatile unsigned long long int benchmarkSink = 0;
+
+static unsigned long long int nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------------------------------------------
+// Synthetic input data
+// ------------------------------------------------------------------------------------------------
+
+// simple deterministic generator, so that all runs see exactly the same data
+static unsigned int nextRandom(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// generates a photo-like xRGB image: smooth gradients, a few sharp edges and some sensor noise
+static std::vector<unsigned int> makeSyntheticImage(int width, int height)
+{
+    std::vector<unsigned int> image((size_t) width * height);
+    unsigned int state = 2463534242u;
+
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const double fx = (double) x / width;
+            const double fy = (double) y / height;
+            const int edge = ((x / 97) + (y / 61)) % 3 == 0 ? 40 : 0;
+            const int noise = (int) (nextRandom(&state) % 17) - 8;
+
+            int r = (int) (128 + 90 * sin(6.0 * fx + 2.0 * fy)) + edge + noise;
+            int g = (int) (128 + 80 * cos(4.0 * fy - 3.0 * fx)) + noise;
+            int b = (int) (110 + 70 * sin(9.0 * fx * fy)) - edge + noise;
+
+            r = std::min(255, std::max(0, r));
+            g = std::min(255, std::max(0, g));
+            b = std::min(255, std::max(0, b));
+
+            image[(size_t) y * width + x] = 0xff000000u | (r << 16) | (g << 8) | b;
+        }
+    }
+
+    return image;
+}
+
+// the synthetic image as a full range I420 frame (Y plane, then U and V), chroma averaged over 2x2 pixels
+static std::vector<unsigned char> makeSyntheticI420(int width, int height)
+{
+    const std::vector<unsigned int> image = makeSyntheticImage(width, height);
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    std::vector<unsigned char> frame((size_t) width * height + 2 * (size_t) chromaWidth * chromaHeight);
+    unsigned char *u = frame.data() + (size_t) width * height;
+    unsigned char *v = u + (size_t) chromaWidth * chromaHeight;
+
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const unsigned int pixel = image[(size_t) y * width + x];
+            const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+            frame[(size_t) y * width + x] = (unsigned char) ((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+        }
+    }
+    for (int cy = 0;  cy < chromaHeight;  cy++)
+    {
+        for (int cx = 0;  cx < chromaWidth;  cx++)
+        {
+            int sumU = 0, sumV = 0;
+            for (int i = 0;  i < 4;  i++)
+            {
+                const int x = std::min(width - 1, 2 * cx + (i & 1));
+                const int y = std::min(height - 1, 2 * cy + (i >> 1));
+                const unsigned int pixel = image[(size_t) y * width + x];
+                const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+                sumU += (-11058 * r - 21710 * g + 32768 * b + 8388608) >> 16;
+                sumV += (32768 * r - 27439 * g - 5329 * b + 8388608) >> 16;
+            }
+            u[(size_t) cy * chromaWidth + cx] = (unsigned char) ((sumU + 2) / 4);
+            v[(size_t) cy * chromaWidth + cx] = (unsigned char) ((sumV + 2) / 4);
+        }
+    }
+
+    return frame;
+}
+
+// dimensions with 4:3 aspect ratio for the given number of megapixels
+static void syntheticImageSize(double megapixels, int *width, int *height)
+{
+    *width  = (int) (sqrt(megapixels * 1000000.0 * 4 / 3) + 0.5);
+    *height = (int) (megapixels * 1000000.0 / *width + 0.5);
+}
+
+static std::string megapixelsLabel(double megapixels)
+{
+    char label [32];
+    snprintf(label, sizeof(label), "%gMP", megapixels);
+    return label;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Benchmark definitions
+// ------------------------------------------------------------------------------------------------
+
+// the kernels process fragments which are already converted to YUV and loaded into registers,
+// so here we prepare a set of such fragments in memory
+static const int numKernelFragments = 1024;
+
+static void addKernelBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    // static arrays guarantee 32-byte alignment, which std::vector does not in C++11
+    static int32x8 fragmentsY [numKernelFragments * 8];
+    static int32x8 fragmentsU [numKernelFragments * 8];
+    static int32x8 fragmentsV [numKernelFragments * 8];
+
+    unsigned int state = 88172645u;
+    for (int i = 0;  i < numKernelFragments * 8;  i++)
+    {
+        int y [8], u [8], v [8];
+        for (int k = 0;  k < 8;  k++) {
+            y[k] = nextRandom(&state) & 0xff;
+            u[k] = 96 + (nextRandom(&state) & 0x3f);
+            v[k] = 96 + (nextRandom(&state) & 0x3f);
+        }
+        fragmentsY[i] = _mm256_setr_epi32(y[0], y[1], y[2], y[3], y[4], y[5], y[6], y[7]);
+        fragmentsU[i] = _mm256_setr_epi32(u[0], u[1], u[2], u[3], u[4], u[5], u[6], u[7]);
+        fragmentsV[i] = _mm256_setr_epi32(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+    }
+
+    const int32x8 *Y = fragmentsY;
+    const int32x8 *U = fragmentsU;
+    const int32x8 *V = fragmentsV;
+
+    const double ops = numKernelFragments;
+    const double pixels = numKernelFragments * 64;
+
+    benchmarks.push_back({"kernel/G1x1", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) { unsigned int a, s;  G1x1(Y + f * 8, &a, &s);  sum += a + s; }
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/G2x2", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) { unsigned int a, s;  G2x2(Y + f * 8, &a, &s);  sum += a + s; }
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/G4x4", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) { unsigned int a, s;  G4x4(Y + f * 8, &a, &s);  sum += a + s; }
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/D2x2", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) sum += D2x2(Y + f * 8);
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/D4x4", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) sum += D4x4(Y + f * 8);
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/absCheckboardConvolution", ops, pixels, [Y]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) sum += absCheckboardConvolution(Y + f * 8);
+        benchmarkSink += sum;
+    }});
+
+    benchmarks.push_back({"kernel/G2x2_UV", ops, pixels, [U, V]() {
+        unsigned long long int sum = 0;
+        for (int f = 0;  f < numKernelFragments;  f++) sum += G2x2_UV(U + f * 8, V + f * 8);
+        benchmarkSink += sum;
+    }});
+}
+
+static void addFeatureBenchmarks(std::vector<Benchmark> &benchmarks, double maxMegapixels)
+{
+    const double sizes [] = {0.1, 0.5, 1, 5, 10, 25, 50, 100};
+
+    for (double megapixels : sizes)
+    {
+        if (megapixels > maxMegapixels) continue;
+
+        int w, h;
+        syntheticImageSize(megapixels, &w, &h);
+
+        // images are generated lazily, because the largest ones take a few hundred megabytes
+        std::shared_ptr<std::vector<unsigned int>> image = std::make_shared<std::vector<unsigned int>>();
+
+        benchmarks.push_back({"features/calculateFeatures/" + megapixelsLabel(megapixels), 1, (double) w * h, [image, w, h]() {
+            if (image->empty()) *image = makeSyntheticImage(w, h);
+            double features [12];
+            FeatureExtractor::calculateFeatures(image->data(), w, h, features);
+            benchmarkSink += (unsigned long long int) (features[0] * 1000);
+        }});
+
+        // the same content as an I420 frame, analyzed without colour conversion
+        std::shared_ptr<std::vector<unsigned char>> frame = std::make_shared<std::vector<unsigned char>>();
+
+        benchmarks.push_back({"features/calculateYuvFeatures/" + megapixelsLabel(megapixels), 1, (double) w * h, [frame, w, h]() {
+            if (frame->empty()) *frame = makeSyntheticI420(w, h);
+            const int chromaWidth = (w + 1) / 2;
+            const unsigned char *y = frame->data();
+            const unsigned char *u = y + (size_t) w * h;
+            const unsigned char *v = u + (size_t) chromaWidth * ((h + 1) / 2);
+            const YuvImage image = {y, u, v, w, chromaWidth, 1, w, h, true, false};
+            double features [12];
+            FeatureExtractor::calculateYuvFeatures(image, features, nullptr);
+            benchmarkSink += (unsigned long long int) (features[0] * 1000);
+        }});
+
+        // the same image as the next frame of a sequence: only the fragment hashes are calculated
+        std::shared_ptr<SequenceAnalyzer> sequence = std::make_shared<SequenceAnalyzer>();
+
+        benchmarks.push_back({"features/SequenceAnalyzer/unchanged/" + megapixelsLabel(megapixels), 1, (double) w * h, [image, sequence, w, h]() {
+            if (image->empty()) *image = makeSyntheticImage(w, h);
+            double features [12];
+            sequence->analyzeFrame(image->data(), w, h, w, features);
+            benchmarkSink += (unsigned long long int) (features[0] * 1000);
+        }});
+    }
+}
+
+static void addOptimizerBenchmarks(std::vector<Benchmark> &benchmarks, const double *referenceInputVector)
+{
+    std::shared_ptr<std::vector<double>> input = std::make_shared<std::vector<double>>(referenceInputVector, referenceInputVector + 12);
+
+    for (int format = 0;  format < 6;  format++)
+    {
+        // reference inference keeps the original benchmark names, so old baselines remain comparable
+        const bool isjpeg = (format % 2 == 0);
+        const InferenceMode mode = (format < 2) ? InferenceReference : (format < 4) ? InferenceFast : InferenceQuantized;
+        const std::string prefix = std::string("optimizer/") + (isjpeg ? "jpeg/" : "webp/") +
+                                   (mode == InferenceFast ? "fast/" : mode == InferenceQuantized ? "quantized/" : "");
+
+        benchmarks.push_back({prefix + "estimateFileSize", 1, 0, [input, isjpeg, mode]() {
+            benchmarkSink += (unsigned long long int) Optimizer::estimateFileSize(isjpeg, input->data(), mode);
+        }});
+
+        benchmarks.push_back({prefix + "estimateYMSSIM", 1, 0, [input, isjpeg, mode]() {
+            benchmarkSink += (unsigned long long int) (Optimizer::estimateYMSSIM(isjpeg, input->data(), mode) * 1000);
+        }});
+
+        benchmarks.push_back({prefix + "estimateYPSNR", 1, 0, [input, isjpeg, mode]() {
+            benchmarkSink += (unsigned long long int) Optimizer::estimateYPSNR(isjpeg, input->data(), mode);
+        }});
+
+        // targets are in the middle of the respective ranges, so that the search is not trivial
+        const char objectives [] = {'s', 'm', 'p'};
+        const double targets [] = {100000, 0.95, 35};
+        for (int i = 0;  i < 3;  i++)
+        {
+            const char objective = objectives[i];
+            const double target = targets[i];
+            benchmarks.push_back({prefix + "findQualityFactor/" + objective, 1, 0, [input, isjpeg, objective, target, mode]() {
+                benchmarkSink += Optimizer::findQualityFactor(isjpeg, objective, target, input->data(), mode);
+            }});
+        }
+    }
+}
+
+static void addEncoderBenchmarks(std::vector<Benchmark> &benchmarks, std::shared_ptr<std::vector<unsigned int>> image, int w, int h, double megapixels)
+{
+    const int qualityFactors [] = {30, 50, 75, 90};
+
+    for (int format = 0;  format < 2;  format++)
+    {
+        const bool isjpeg = (format == 0);
+        for (int qualityFactor : qualityFactors)
+        {
+            const std::string name = std::string("encoder/") + (isjpeg ? "jpeg" : "webp") + "/q" + std::to_string(qualityFactor) + "/" + megapixelsLabel(megapixels);
+            benchmarks.push_back({name, 1, (double) w * h, [image, w, h, isjpeg, qualityFactor]() {
+                const unsigned char *data = (const unsigned char *) image->data();
+                unsigned long long int size = 0;
+                unsigned char *buffer = isjpeg ? Encoder::compressToJpeg(data, w, h, qualityFactor, &size) :
+                                                 Encoder::compressToWebp(data, w, h, qualityFactor, &size);
+                benchmarkSink += size;
+                Encoder::freeBuffer(buffer);
+            }});
+        }
+    }
+
+    // analysis followed by JPEG encoding, with the colour conversion done by libjpeg or shared with the analysis
+    std::shared_ptr<YuvBuffer> conversion = std::make_shared<YuvBuffer>();
+    for (int shared = 0;  shared < 2;  shared++)
+    {
+        const std::string name = std::string("pipeline/jpeg/") + (shared ? "shared" : "separate") + "/q75/" + megapixelsLabel(megapixels);
+        benchmarks.push_back({name, 1, (double) w * h, [image, conversion, w, h, shared]() {
+            double features [12];
+            unsigned long long int size = 0;
+            unsigned char *buffer;
+            if (shared) {
+                FeatureExtractor::calculateFeatures(image->data(), w, h, w, features, conversion.get(), nullptr);
+                buffer = Encoder::compressYuvToJpeg(conversion->image(), 75, &size);
+            } else {
+                FeatureExtractor::calculateFeatures(image->data(), w, h, features);
+                buffer = Encoder::compressToJpeg((const unsigned char *) image->data(), w, h, 75, &size);
+            }
+            benchmarkSink += size;
+            Encoder::freeBuffer(buffer);
+        }});
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Validation of fast and quantized inference
+// ------------------------------------------------------------------------------------------------
+
+static double prediction(bool isjpeg, char objective, const double *input, InferenceMode mode = InferenceReference)
+{
+    return (objective == 's') ? Optimizer::estimateFileSize(isjpeg, input, mode) :
+           (objective == 'm') ? Optimizer::estimateYMSSIM(isjpeg, input, mode) : Optimizer::estimateYPSNR(isjpeg, input, mode);
+}
+
+// Compares predictions of the fast or quantized models with the double precision reference for random
+// input vectors around the features of the synthetic image and for all quality factors, and the quality
+// factors chosen by the search. Returns false if the error exceeds the tolerance of the mode, which is
+// below the prediction error of the models themselves, or if the chosen quality factors deviate.
+static bool validateInference(const double *referenceInputVector, int numVectors, InferenceMode mode)
+{
+    // the size model predicts a logarithm, float rounding of the hidden layer gives a relative error
+    // of up to about 1e-4 for typical inputs and several times more at the edges of the input range;
+    // in the quantized models the rounding of weights and of inputs to 1/2048 gives about half of the limits
+    const bool quantized = (mode == InferenceQuantized);
+    const double maxSizeError = quantized ? 0.01 : 1e-3;       // relative
+    const double maxMSSIMError = quantized ? 1e-3 : 1e-5;
+    const double maxPSNRError = quantized ? 0.15 : 1e-3;       // dB
+
+    // Where the reference predictions grow with the quality factor, the target has one answer and the search
+    // must find it within 2 steps, apart from 1 search in 1000 on plateaus. Random vectors often give curves
+    // that are not monotonic, where distant quality factors are almost equally close to the target. There
+    // a different choice must not be further from the target, by the reference, than a choice 2 steps away
+    // or than the errors of the mode at both quality factors explain; otherwise the search itself is wrong.
+    const int maxQualityDeviation = 2;
+    const double maxDeviationShare = 0.001;
+
+    unsigned int state = 88172645u;
+    bool ok = true;
+
+    printf("%s inference:\n", quantized ? "quantized" : "fast");
+    printf("%-8s %16s %16s %16s %14s %12s %16s %14s\n", "format", "size rel. error", "MSSIM error", "PSNR error", "QF mismatches", "max QF diff",
+           "QF deviations", "worse choices");
+    for (int format = 0;  format < 2;  format++)
+    {
+        const bool isjpeg = (format == 0);
+        const int minQF = isjpeg ? 5 : 0;
+        double sizeError = 0, mssimError = 0, psnrError = 0;
+        unsigned long long int numSearches = 0, numMismatches = 0, numWorseChoices = 0;
+        unsigned long long int numMonotonicSearches = 0, numDeviations = 0;
+        int maxQualityDifference = 0;
+
+        for (int v = 0;  v < numVectors;  v++)
+        {
+            // content features are logarithms, +-1.5 covers everything from flat to very noisy images
+            double input [12];
+            for (int i = 0;  i < 10;  i++) input[i] = std::max(0.0, referenceInputVector[i] + (nextRandom(&state) % 3001) / 1000.0 - 1.5);
+            input[10] = log(0.1) + (nextRandom(&state) % 1001) / 1000.0 * (log(100.0) - log(0.1));
+
+            for (int qualityFactor = 0;  qualityFactor <= 100;  qualityFactor++)
+            {
+                input[11] = qualityFactor;
+                const double referenceSize = Optimizer::estimateFileSize(isjpeg, input);
+                // sizes are rounded to whole bytes, so a difference of one byte is only rounding
+                const double sizeDifference = std::max(0.0, fabs(Optimizer::estimateFileSize(isjpeg, input, mode) - referenceSize) - 1.0);
+                sizeError  = std::max(sizeError, sizeDifference / std::max(1.0, referenceSize));
+                mssimError = std::max(mssimError, fabs(Optimizer::estimateYMSSIM(isjpeg, input, mode) - Optimizer::estimateYMSSIM(isjpeg, input)));
+                psnrError  = std::max(psnrError, fabs(Optimizer::estimateYPSNR(isjpeg, input, mode) - Optimizer::estimateYPSNR(isjpeg, input)));
+            }
+
+            // the search compares predictions of neighbouring quality factors, so targets are taken
+            // from the predictions themselves, which is the worst case for rounding differences
+            const char objectives [] = {'s', 'm', 'p'};
+            for (char objective : objectives)
+            {
+                double predicted [101];
+                bool monotonic = true;
+                for (int qualityFactor = minQF;  qualityFactor <= 100;  qualityFactor++)
+                {
+                    input[11] = qualityFactor;
+                    predicted[qualityFactor] = prediction(isjpeg, objective, input);
+                    if (qualityFactor > minQF && predicted[qualityFactor] < predicted[qualityFactor - 1]) monotonic = false;
+                }
+
+                input[11] = 5 + nextRandom(&state) % 96;
+                const double target = (objective == 's') ? predicted[(int) input[11]] * 1.01 :
+                                      (objective == 'm') ? predicted[(int) input[11]] : predicted[(int) input[11]] + 0.01;
+                const int reference = Optimizer::findQualityFactor(isjpeg, objective, target, input);
+                const int approximate = Optimizer::findQualityFactor(isjpeg, objective, target, input, mode);
+                const int difference = abs(approximate - reference);
+                numSearches++;
+                if (monotonic) numMonotonicSearches++;
+                if (difference == 0) continue;
+                numMismatches++;
+                maxQualityDifference = std::max(maxQualityDifference, difference);
+                if (monotonic && difference > maxQualityDeviation) numDeviations++;
+
+                double tolerance = 0;
+                for (int neighbour = std::max(minQF, reference - maxQualityDeviation);  neighbour <= std::min(100, reference + maxQualityDeviation);  neighbour++)
+                {
+                    tolerance = std::max(tolerance, fabs(predicted[neighbour] - target));
+                }
+                double modeError = 0;
+                const int choices [] = {reference, approximate};
+                for (int choice : choices)
+                {
+                    input[11] = choice;
+                    modeError += fabs(prediction(isjpeg, objective, input, mode) - predicted[choice]);
+                }
+                tolerance = std::max(tolerance, fabs(predicted[reference] - target) + modeError);
+                if (fabs(predicted[approximate] - target) > tolerance * (1 + 1e-9)) numWorseChoices++;
+            }
+        }
+
+        const bool formatOk = sizeError <= maxSizeError && mssimError <= maxMSSIMError && psnrError <= maxPSNRError && numWorseChoices == 0 &&
+                              numDeviations <= maxDeviationShare * numMonotonicSearches;
+        ok = ok && formatOk;
+        printf("%-8s %16.3g %16.3g %16.3g %7llu/%-6llu %12d %8llu/%-7llu %14llu%s\n", isjpeg ? "jpeg" : "webp", sizeError, mssimError, psnrError,
+               numMismatches, numSearches, maxQualityDifference, numDeviations, numMonotonicSearches, numWorseChoices, formatOk ? "" : "  FAILED");
+    }
+
+    return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Validation of the SIMD features and the encoders
+// ------------------------------------------------------------------------------------------------
+
+// Full range Y, U and V of every pixel, the input of the feature kernels
+struct ReferencePlanes
+{
+    int width;
+    int height;
+    std::vector<int> y;
+    std::vector<int> u;
+    std::vector<int> v;
+
+    ReferencePlanes(int w, int h) : width(w), height(h), y((size_t) w * h), u((size_t) w * h), v((size_t) w * h) {}
+};
+
+static ReferencePlanes xrgbPlanes(const unsigned int *image, int width, int height, int stride)
+{
+    ReferencePlanes planes(width, height);
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const unsigned int pixel = image[(size_t) y * stride + x];
+            const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+            const size_t i = (size_t) y * width + x;
+            planes.y[i] = (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+            planes.u[i] = (-11058 * r - 21710 * g + 32768 * b + 8388608) >> 16;
+            planes.v[i] = (32768 * r - 27439 * g - 5329 * b + 8388608) >> 16;
+        }
+    }
+    return planes;
+}
+
+static ReferencePlanes grayPlanes(const unsigned char *image, int width, int height, int stride)
+{
+    ReferencePlanes planes(width, height);
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const size_t i = (size_t) y * width + x;
+            planes.y[i] = image[(size_t) y * stride + x];
+            planes.u[i] = planes.v[i] = 128;
+        }
+    }
+    return planes;
+}
+
+// chroma repeated for the 2x2 pixels it covers, the video range scaled like in featureextractor.cpp
+static ReferencePlanes yuvPlanes(const YuvImage &image)
+{
+    ReferencePlanes planes(image.width, image.height);
+    for (int y = 0;  y < image.height;  y++)
+    {
+        for (int x = 0;  x < image.width;  x++)
+        {
+            const size_t i = (size_t) y * image.width + x;
+            const size_t c = (size_t) (y / 2) * image.uvStride + (size_t) (x / 2) * image.uvStep;
+            int luma = image.y[(size_t) y * image.yStride + x], u = image.u[c], v = image.v[c];
+            if (!image.fullRange) {
+                luma = std::min(255, std::max(0, ((luma - 16) * 19077 + 8192) >> 14));
+                u = std::min(255, std::max(0, (((u - 128) * 18651 + 8192) >> 14) + 128));
+                v = std::min(255, std::max(0, (((v - 128) * 18651 + 8192) >> 14) + 128));
+            }
+            planes.y[i] = luma;
+            planes.u[i] = u;
+            planes.v[i] = v;
+        }
+    }
+    return planes;
+}
+
+// sums of the 2x2 blocks of an n x n grid
+static void referenceBlockSums(const int *grid, int n, int *sums)
+{
+    for (int r = 0;  r < n;  r += 2)
+        for (int c = 0;  c < n;  c += 2)
+            sums[(r / 2) * (n / 2) + c / 2] = grid[r * n + c] + grid[r * n + c + 1] + grid[(r + 1) * n + c] + grid[(r + 1) * n + c + 1];
+}
+
+// differences of the columns 0-1, 2-3, ... in every row and of the rows 0-1, 2-3, ... in every column
+static void referenceGradient(const int *grid, int n, unsigned long long int *absSum, unsigned long long int *sqrSum)
+{
+    for (int i = 0;  i < n;  i++)
+    {
+        for (int j = 0;  j < n;  j += 2)
+        {
+            const long long int horizontal = grid[i * n + j] - grid[i * n + j + 1];
+            const long long int vertical = grid[j * n + i] - grid[(j + 1) * n + i];
+            *absSum += llabs(horizontal) + llabs(vertical);
+            if (sqrSum) *sqrSum += horizontal * horizontal + vertical * vertical;
+        }
+    }
+}
+
+// second order differences of the 2x2 blocks
+static unsigned long long int referenceDiagonal(const int *grid, int n)
+{
+    unsigned long long int sum = 0;
+    for (int r = 0;  r < n;  r += 2)
+        for (int c = 0;  c < n;  c += 2)
+            sum += llabs((long long int) grid[r * n + c] - grid[r * n + c + 1] - grid[(r + 1) * n + c] + grid[(r + 1) * n + c + 1]);
+    return sum;
+}
+
+// The kernels of featurekernels.h in plain integer arithmetic, one 8x8 fragment at a time,
+// without any of the lane tricks of the SIMD version
+static void referenceFeatures(const ReferencePlanes &planes, double *features)
+{
+    const int fragmentSize = 8;
+    FeatureSums sums;
+    sums.clear();
+    sums.numFragments = (planes.width / fragmentSize) * (planes.height / fragmentSize);
+
+    for (int frow = 0;  frow < planes.height / fragmentSize;  frow++)
+    {
+        for (int fcol = 0;  fcol < planes.width / fragmentSize;  fcol++)
+        {
+            int Y [64], U [64], V [64];
+            long long int checkerboard = 0;
+            for (int r = 0;  r < fragmentSize;  r++)
+            {
+                for (int c = 0;  c < fragmentSize;  c++)
+                {
+                    const size_t i = (size_t) (frow * fragmentSize + r) * planes.width + fcol * fragmentSize + c;
+                    Y[r * 8 + c] = planes.y[i];
+                    U[r * 8 + c] = planes.u[i];
+                    V[r * 8 + c] = planes.v[i];
+                    checkerboard += ((r + c) & 1) ? -planes.y[i] : planes.y[i];
+                }
+            }
+
+            int Y2 [16], Y4 [4], U2 [16], V2 [16];
+            referenceBlockSums(Y, 8, Y2);
+            referenceBlockSums(Y2, 4, Y4);
+            referenceBlockSums(U, 8, U2);
+            referenceBlockSums(V, 8, V2);
+
+            referenceGradient(Y, 8, &sums.absSumG1x1, &sums.sqrSumG1x1);
+            referenceGradient(Y2, 4, &sums.absSumG2x2, &sums.sqrSumG2x2);
+            referenceGradient(Y4, 2, &sums.absSumG4x4, &sums.sqrSumG4x4);
+            sums.absSumD2x2 += referenceDiagonal(Y, 8);
+            sums.absSumD4x4 += referenceDiagonal(Y2, 4);
+            sums.absSumCheckboard += llabs(checkerboard);
+            referenceGradient(U2, 4, &sums.absSumG2UV, nullptr);
+            referenceGradient(V2, 4, &sums.absSumG2UV, nullptr);
+        }
+    }
+
+    FeatureExtractor::finishFeatures(sums, features);
+}
+
+// random content with a smooth part, noise of random amplitude and clipping; the x byte and the
+// padding of the rows are random as well, none of them may change the result
+static std::vector<unsigned int> makeRandomImage(int width, int height, int stride, unsigned int *state)
+{
+    std::vector<unsigned int> image((size_t) stride * height);
+    const int amplitude = 1 << (nextRandom(state) % 9);
+    int offset [3], slopeX [3], slopeY [3];
+    for (int channel = 0;  channel < 3;  channel++)
+    {
+        offset[channel] = (int) (nextRandom(state) % 256);
+        slopeX[channel] = (int) (nextRandom(state) % 65) - 32;
+        slopeY[channel] = (int) (nextRandom(state) % 65) - 32;
+    }
+
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < stride;  x++)
+        {
+            unsigned int pixel = nextRandom(state);
+            if (x < width)
+            {
+                pixel &= 0xff000000u;
+                for (int channel = 0;  channel < 3;  channel++)
+                {
+                    const int value = offset[channel] + (x * slopeX[channel] + y * slopeY[channel]) / 16 + (int) (nextRandom(state) % amplitude) - amplitude / 2;
+                    pixel |= (unsigned int) std::min(255, std::max(0, value)) << (8 * channel);
+                }
+            }
+            image[(size_t) y * stride + x] = pixel;
+        }
+    }
+
+    return image;
+}
+
+// A copy of a YUV frame as I420 (layout 0), NV12 (1) or NV21 (2) with rows longer than needed
+struct YuvFrame
+{
+    std::vector<unsigned char> data;
+    YuvImage image;
+};
+
+static void copyYuvFrame(const YuvImage &source, int layout, unsigned int *state, YuvFrame *frame)
+{
+    const int chromaWidth = (source.width + 1) / 2;
+    const int chromaHeight = (source.height + 1) / 2;
+    const int uvStep = (layout == 0) ? 1 : 2;
+    const int yStride = source.width + (int) (nextRandom(state) % 7);
+    const int uvStride = chromaWidth * uvStep + (int) (nextRandom(state) % 7);
+
+    frame->data.resize((size_t) yStride * source.height + (size_t) uvStride * chromaHeight * (3 - uvStep));
+    for (unsigned char &value : frame->data) value = (unsigned char) nextRandom(state);
+
+    unsigned char *y = frame->data.data();
+    unsigned char *chroma = y + (size_t) yStride * source.height;
+    unsigned char *u = (layout == 2) ? chroma + 1 : chroma;
+    unsigned char *v = (layout == 0) ? chroma + (size_t) uvStride * chromaHeight : (layout == 1) ? chroma + 1 : chroma;
+
+    for (int row = 0;  row < source.height;  row++) memcpy(y + (size_t) row * yStride, source.y + (size_t) row * source.yStride, source.width);
+    for (int row = 0;  row < chromaHeight;  row++)
+    {
+        for (int x = 0;  x < chromaWidth;  x++)
+        {
+            u[(size_t) row * uvStride + x * uvStep] = source.u[(size_t) row * source.uvStride + (size_t) x * source.uvStep];
+            v[(size_t) row * uvStride + x * uvStep] = source.v[(size_t) row * source.uvStride + (size_t) x * source.uvStep];
+        }
+    }
+
+    frame->image = {y, u, v, yStride, uvStride, uvStep, source.width, source.height, source.fullRange, false};
+}
+
+// A padded I420 copy (see yuvimage.h) whose edges repeat the last row and column, which is what
+// the JPEG encoder does for frames that are not padded
+static void padYuvFrame(const YuvImage &source, YuvFrame *frame)
+{
+    const int lumaWidth = (source.width + 15) / 16 * 16;
+    const int lumaHeight = (source.height + 15) / 16 * 16;
+    const int chromaWidth = lumaWidth / 2;
+    const int chromaHeight = lumaHeight / 2;
+    const int chromaSamples = (source.width + 1) / 2;
+    const int chromaRows = (source.height + 1) / 2;
+
+    frame->data.resize((size_t) lumaWidth * lumaHeight + 2 * (size_t) chromaWidth * chromaHeight);
+    unsigned char *y = frame->data.data();
+    unsigned char *u = y + (size_t) lumaWidth * lumaHeight;
+    unsigned char *v = u + (size_t) chromaWidth * chromaHeight;
+
+    for (int row = 0;  row < lumaHeight;  row++)
+    {
+        const unsigned char *line = source.y + (size_t) std::min(row, source.height - 1) * source.yStride;
+        for (int x = 0;  x < lumaWidth;  x++) y[(size_t) row * lumaWidth + x] = line[std::min(x, source.width - 1)];
+    }
+    for (int row = 0;  row < chromaHeight;  row++)
+    {
+        const size_t line = (size_t) std::min(row, chromaRows - 1) * source.uvStride;
+        for (int x = 0;  x < chromaWidth;  x++)
+        {
+            const size_t sample = line + (size_t) std::min(x, chromaSamples - 1) * source.uvStep;
+            u[(size_t) row * chromaWidth + x] = source.u[sample];
+            v[(size_t) row * chromaWidth + x] = source.v[sample];
+        }
+    }
+
+    frame->image = {y, u, v, lumaWidth, chromaWidth, 1, source.width, source.height, source.fullRange, true};
+}
+
+static bool appendToVector(void *context, const unsigned char *data, unsigned long long int size)
+{
+    std::vector<unsigned char> *output = (std::vector<unsigned char> *) context;
+    output->insert(output->end(), data, data + size);
+    return true;
+}
+
+// output of an allocating encoder, released here; the size is read after the encoder has set it
+static std::vector<unsigned char> takeBuffer(unsigned char *buffer, const unsigned long long int *size)
+{
+    std::vector<unsigned char> output;
+    if (buffer) output.assign(buffer, buffer + *size);
+    Encoder::freeBuffer(buffer);
+    return output;
+}
+
+// sink encoders write through the callback, or into a buffer of exactly the expected size
+static std::vector<unsigned char> encodeToSink(const std::function<EncoderResult(EncoderSink *)> &encode, unsigned long long int capacity = 0)
+{
+    std::vector<unsigned char> output(capacity);
+    EncoderSink sink = {output.data(), capacity, capacity > 0 ? nullptr : appendToVector, &output, 0};
+    if (encode(&sink) != EncoderOk || sink.size != output.size()) output.clear();
+    return output;
+}
+
+struct EquivalenceCheck
+{
+    std::string name;
+    int numMismatches;
+    int numCases;
+};
+
+static void expectEqual(std::vector<EquivalenceCheck> &checks, const char *name, bool equal)
+{
+    for (EquivalenceCheck &check : checks)
+    {
+        if (check.name == name) {
+            check.numCases++;
+            if (!equal) check.numMismatches++;
+            return;
+        }
+    }
+    checks.push_back({name, equal ? 0 : 1, 1});
+}
+
+static bool sameFeatures(const double *features, const double *reference)
+{
+    return memcmp(features, reference, 10 * sizeof(double)) == 0;
+}
+
+static bool sameOutput(const std::vector<unsigned char> &output, const std::vector<unsigned char> &reference)
+{
+    return !reference.empty() && output == reference;
+}
+
+// A random image with its scalar reference features, shared by the checks of the paths
+struct EquivalenceCase
+{
+    std::vector<unsigned int> image;
+    int width;
+    int height;
+    int stride;                  // in pixels
+    int quality;
+    double reference [12];
+    TaskScheduler *scheduler;    // set for images large enough to be split into tasks
+};
+
+// the image without the padding of its rows, as the allocating encoders take it
+static std::vector<unsigned int> packImage(const EquivalenceCase &test)
+{
+    std::vector<unsigned int> packed((size_t) test.width * test.height);
+    for (int y = 0;  y < test.height;  y++) memcpy(&packed[(size_t) y * test.width], &test.image[(size_t) y * test.stride], test.width * sizeof(unsigned int));
+    return packed;
+}
+
+// grayscale with odd strides and its expansion to xRGB with R = G = B
+static void checkGrayPath(const EquivalenceCase &test, unsigned int *state, std::vector<EquivalenceCheck> &checks)
+{
+    const int width = test.width, height = test.height;
+    const int grayStride = width + (int) (nextRandom(state) % 7);
+    std::vector<unsigned char> gray((size_t) grayStride * height);
+    std::vector<unsigned int> expanded((size_t) width * height);
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < grayStride;  x++)
+        {
+            const unsigned char value = (unsigned char) (x < width ? test.image[(size_t) y * test.stride + x] >> 8 : nextRandom(state));
+            gray[(size_t) y * grayStride + x] = value;
+            if (x < width) expanded[(size_t) y * width + x] = (nextRandom(state) & 0xff000000u) | (value << 16) | (value << 8) | value;
+        }
+    }
+
+    double reference [12], features [12];
+    referenceFeatures(grayPlanes(gray.data(), width, height, grayStride), reference);
+    FeatureExtractor::calculateGrayFeatures(gray.data(), width, height, grayStride, features, test.scheduler);
+    expectEqual(checks, "gray features", sameFeatures(features, reference));
+    FeatureExtractor::calculateFeatures(expanded.data(), width, height, width, features, test.scheduler);
+    expectEqual(checks, "gray features vs expanded xRGB", sameFeatures(features, reference));
+
+    std::vector<unsigned char> packedGray((size_t) width * height);
+    for (int y = 0;  y < height;  y++) memcpy(&packedGray[(size_t) y * width], &gray[(size_t) y * grayStride], width);
+    unsigned long long int size;
+    expectEqual(checks, "WebP of gray vs expanded xRGB", sameOutput(takeBuffer(Encoder::compressGrayToWebp(packedGray.data(), width, height, test.quality, &size), &size),
+                                                                     takeBuffer(Encoder::compressToWebp((const unsigned char *) expanded.data(), width, height, test.quality, &size), &size)));
+}
+
+// the sink encoders read the padded rows in place
+static void checkSinkEncoders(const EquivalenceCase &test, std::vector<EquivalenceCheck> &checks)
+{
+    const std::vector<unsigned int> packed = packImage(test);
+    const unsigned char *bytes = (const unsigned char *) test.image.data();
+    unsigned long long int size;
+
+    const std::vector<unsigned char> jpeg = takeBuffer(Encoder::compressToJpeg((const unsigned char *) packed.data(), test.width, test.height, test.quality, &size), &size);
+    expectEqual(checks, "JPEG sink vs allocating", sameOutput(encodeToSink([&](EncoderSink *sink) {
+        return Encoder::compressToJpeg(bytes, test.width, test.height, test.stride * 4, test.quality, sink); }), jpeg));
+
+    const std::vector<unsigned char> webp = takeBuffer(Encoder::compressToWebp((const unsigned char *) packed.data(), test.width, test.height, test.quality, &size), &size);
+    expectEqual(checks, "WebP sink vs allocating", sameOutput(encodeToSink([&](EncoderSink *sink) {
+        return Encoder::compressToWebp(bytes, test.width, test.height, test.stride * 4, test.quality, sink); }, webp.size()), webp));
+}
+
+// the conversion written by the analysis gives the JPEG of the xRGB image
+static void checkConversionBuffer(const EquivalenceCase &test, YuvBuffer *conversion, std::vector<EquivalenceCheck> &checks)
+{
+    double features [12];
+    const bool converted = FeatureExtractor::calculateFeatures(test.image.data(), test.width, test.height, test.stride, features, conversion, test.scheduler);
+    expectEqual(checks, "xRGB features with YuvBuffer conversion", converted && sameFeatures(features, test.reference));
+
+    const std::vector<unsigned int> packed = packImage(test);
+    unsigned long long int size;
+    const std::vector<unsigned char> jpeg = takeBuffer(Encoder::compressToJpeg((const unsigned char *) packed.data(), test.width, test.height, test.quality, &size), &size);
+    expectEqual(checks, "JPEG of YuvBuffer vs xRGB", sameOutput(encodeToSink([&](EncoderSink *sink) {
+        return Encoder::compressYuvToJpeg(conversion->image(), test.quality, sink); }), jpeg));
+    expectEqual(checks, "JPEG of YuvBuffer, allocating", sameOutput(takeBuffer(Encoder::compressYuvToJpeg(conversion->image(), test.quality, &size), &size), jpeg));
+}
+
+// Random I420, NV12 and NV21 frames of both ranges with samples outside of the video range. The features
+// are those of the upsampled planes; every layout gives the JPEG of a padded frame read in place (libjpeg's
+// own padding of xRGB images can't be compared, its chroma comes from pixels beyond the edge) and the WebP
+// of the I420 frame, which is read in place in the video range
+static void checkYuvPaths(const EquivalenceCase &test, unsigned int *state, std::vector<EquivalenceCheck> &checks)
+{
+    const int width = test.width, height = test.height;
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    double reference [12], features [12];
+
+    for (int range = 0;  range < 2;  range++)
+    {
+        std::vector<unsigned char> planes((size_t) width * height + 2 * (size_t) chromaWidth * chromaHeight);
+        const std::vector<unsigned int> lumaSource = makeRandomImage(width, height, width, state);
+        const std::vector<unsigned int> chromaSource = makeRandomImage(chromaWidth, chromaHeight, chromaWidth, state);
+        for (size_t i = 0;  i < lumaSource.size();  i++) planes[i] = (unsigned char) lumaSource[i];
+        for (size_t i = 0;  i < chromaSource.size();  i++)
+        {
+            planes[lumaSource.size() + i] = (unsigned char) (chromaSource[i] >> 8);
+            planes[lumaSource.size() + chromaSource.size() + i] = (unsigned char) (chromaSource[i] >> 16);
+        }
+        const YuvImage source = {planes.data(), planes.data() + lumaSource.size(), planes.data() + lumaSource.size() + chromaSource.size(),
+                                 width, chromaWidth, 1, width, height, range == 0, false};
+        referenceFeatures(yuvPlanes(source), reference);
+
+        YuvFrame padded;
+        padYuvFrame(source, &padded);
+        const std::vector<unsigned char> jpeg = encodeToSink([&](EncoderSink *sink) { return Encoder::compressYuvToJpeg(padded.image, test.quality, sink); });
+        std::vector<unsigned char> webp;
+
+        for (int layout = 0;  layout < 3;  layout++)
+        {
+            YuvFrame frame;
+            copyYuvFrame(source, layout, state, &frame);
+            FeatureExtractor::calculateYuvFeatures(frame.image, features, test.scheduler);
+            expectEqual(checks, "YUV features", sameFeatures(features, reference));
+            expectEqual(checks, "JPEG of copied vs padded YUV", sameOutput(encodeToSink([&](EncoderSink *sink) {
+                return Encoder::compressYuvToJpeg(frame.image, test.quality, sink); }), jpeg));
+
+            const std::vector<unsigned char> frameWebp = encodeToSink([&](EncoderSink *sink) { return Encoder::compressYuvToWebp(frame.image, test.quality, sink); });
+            if (layout == 0) webp = frameWebp;
+            else expectEqual(checks, "WebP of NV12 and NV21 vs I420", sameOutput(frameWebp, webp));
+        }
+    }
+
+    // chroma constant over 2x2 pixels (a gray offset added to R, G and B doesn't change U and V):
+    // a full range I420 frame of the same colours has the features of the xRGB image
+    std::vector<unsigned int> blocks((size_t) width * height);
+    std::vector<unsigned char> blockFrame((size_t) width * height + 2 * (size_t) chromaWidth * chromaHeight);
+    unsigned char *blockU = blockFrame.data() + (size_t) width * height;
+    unsigned char *blockV = blockU + (size_t) chromaWidth * chromaHeight;
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const unsigned int colour = test.image[(size_t) (y & ~1) * test.stride + (x & ~1)];
+            const int r = (colour >> 16) & 0xff, g = (colour >> 8) & 0xff, b = colour & 0xff;
+            const int lowest = std::min(r, std::min(g, b)), highest = std::max(r, std::max(g, b));
+            const int offset = (int) (nextRandom(state) % (256 - highest + lowest)) - lowest;
+            blocks[(size_t) y * width + x] = ((r + offset) << 16) | ((g + offset) << 8) | (b + offset);
+        }
+    }
+    const ReferencePlanes blockPlanes = xrgbPlanes(blocks.data(), width, height, width);
+    for (int y = 0;  y < height;  y++)
+    {
+        for (int x = 0;  x < width;  x++)
+        {
+            const size_t i = (size_t) y * width + x;
+            blockFrame[i] = (unsigned char) blockPlanes.y[i];
+            blockU[(size_t) (y / 2) * chromaWidth + x / 2] = (unsigned char) blockPlanes.u[i];
+            blockV[(size_t) (y / 2) * chromaWidth + x / 2] = (unsigned char) blockPlanes.v[i];
+        }
+    }
+    const YuvImage blockImage = {blockFrame.data(), blockU, blockV, width, chromaWidth, 1, width, height, true, false};
+    FeatureExtractor::calculateFeatures(blocks.data(), width, height, width, reference, test.scheduler);
+    FeatureExtractor::calculateYuvFeatures(blockImage, features, test.scheduler);
+    expectEqual(checks, "YUV features vs xRGB, 2x2 chroma", sameFeatures(features, reference));
+}
+
+// a sequence continues with some fragments changed, the previous image may have had another size
+static void checkSequence(const EquivalenceCase &test, SequenceAnalyzer *sequence, unsigned int *state, std::vector<EquivalenceCheck> &checks)
+{
+    double features [12];
+    std::vector<unsigned int> image = test.image;
+    sequence->analyzeFrame(image.data(), test.width, test.height, test.stride, features);
+    expectEqual(checks, "SequenceAnalyzer, first frame", sameFeatures(features, test.reference));
+
+    const int numChanges = (int) (nextRandom(state) % 8);
+    for (int i = 0;  i < numChanges;  i++) image[(size_t) (nextRandom(state) % test.height) * test.stride + nextRandom(state) % test.width] ^= 1u << (nextRandom(state) % 24);
+    double reference [12];
+    referenceFeatures(xrgbPlanes(image.data(), test.width, test.height, test.stride), reference);
+    sequence->analyzeFrame(image.data(), test.width, test.height, test.stride, features);
+    expectEqual(checks, "SequenceAnalyzer, changed fragments", sameFeatures(features, reference));
+}
+
+// Compares the SIMD feature paths with the scalar reference and the encoders that promise the same file
+// with each other, bit for bit, on random images of random sizes (mostly not multiples of 8 or 16) with
+// padded rows. The last image is large enough to be split into tasks. Returns false on any difference.
+static bool validateEquivalence(int numImages)
+{
+    unsigned int state = 362436069u;
+    std::vector<EquivalenceCheck> checks;
+    TaskScheduler scheduler(4);
+    YuvBuffer conversion;
+    SequenceAnalyzer sequence;
+
+    for (int n = 0;  n < numImages;  n++)
+    {
+        const bool large = (n == numImages - 1);
+        EquivalenceCase test;
+        test.width  = large ? 2048 + (int) (nextRandom(&state) % 64) : 8 + (int) (nextRandom(&state) % 400);
+        test.height = large ? 2048 + (int) (nextRandom(&state) % 64) : 8 + (int) (nextRandom(&state) % 300);
+        test.stride = test.width + (int) (nextRandom(&state) % 4);
+        test.quality = 5 + (int) (nextRandom(&state) % 96);
+        test.scheduler = large ? &scheduler : nullptr;
+        test.image = makeRandomImage(test.width, test.height, test.stride, &state);
+        referenceFeatures(xrgbPlanes(test.image.data(), test.width, test.height, test.stride), test.reference);
+
+        double features [12];
+        FeatureExtractor::calculateFeatures(test.image.data(), test.width, test.height, test.stride, features, test.scheduler);
+        expectEqual(checks, "xRGB features", sameFeatures(features, test.reference));
+
+        checkGrayPath(test, &state, checks);
+        checkSinkEncoders(test, checks);
+        checkConversionBuffer(test, &conversion, checks);
+        checkYuvPaths(test, &state, checks);
+        checkSequence(test, &sequence, &state, checks);
+    }
+
+    bool ok = true;
+    printf("SIMD features and encoders on %d random images:\n", numImages);
+    printf("%-40s %14s\n", "check", "mismatches");
+    for (const EquivalenceCheck &check : checks)
+    {
+        ok = ok && check.numMismatches == 0;
+        printf("%-40s %7d/%-6d%s\n", check.name.c_str(), check.numMismatches, check.numCases, check.numMismatches == 0 ? "" : "  FAILED");
+    }
+
+    return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Measurement
+// ------------------------------------------------------------------------------------------------
+
+static BenchmarkResult measure(const Benchmark &benchmark, double minTimeMs, int numSamples)
+{
+    // warm up (this also lazily creates input data) and find how many calls fit in one sample
+    benchmark.run();
+
+    const double sampleTimeNs = minTimeMs * 1000000.0 / numSamples;
+    unsigned long long int callsPerSample = 1;
+    while (true)
+    {
+        const unsigned long long int start = nowNs();
+        for (unsigned long long int i = 0;  i < callsPerSample;  i++) benchmark.run();
+        const unsigned long long int elapsed = nowNs() - start;
+        if (elapsed >= sampleTimeNs || callsPerSample >= (1ull << 40)) break;
+        // grow towards the target with some margin, but never more than 10x at once
+        const double factor = elapsed > 0 ? std::min(10.0, 1.2 * sampleTimeNs / elapsed) : 10.0;
+        callsPerSample = std::max(callsPerSample + 1, (unsigned long long int) (callsPerSample * factor));
+    }
+
+    // median of several samples is robust against occasional interruptions
+    std::vector<double> samples;
+    for (int s = 0;  s < numSamples;  s++)
+    {
+        const unsigned long long int start = nowNs();
+        for (unsigned long long int i = 0;  i < callsPerSample;  i++) benchmark.run();
+        samples.push_back((double) (nowNs() - start) / callsPerSample);
+    }
+    std::sort(samples.begin(), samples.end());
+    const double nsPerCall = samples[samples.size() / 2];
+
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.nsPerOp = nsPerCall / benchmark.opsPerCall;
+    result.megapixelsPerSecond = benchmark.pixelsPerCall > 0 ? benchmark.pixelsPerCall / nsPerCall * 1000.0 : 0;
+    result.iterations = callsPerSample * numSamples;
+    return result;
+}
+
+// ------------------------------------------------------------------------------------------------
+// JSON report and comparison with a baseline
+// ------------------------------------------------------------------------------------------------
+
+// the report has one benchmark per line, which keeps it readable in diffs and trivial to parse back
+static bool writeJsonReport(const char *path, const std::vector<BenchmarkResult> &results)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    fprintf(f, "{\n  \"version\": 1,\n  \"benchmarks\": [\n");
+    for (size_t i = 0;  i < results.size();  i++)
+    {
+        const BenchmarkResult &r = results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"mp_per_s\": %.3f, \"iterations\": %llu}%s\n",
+                r.name.c_str(), r.nsPerOp, r.megapixelsPerSecond, r.iterations, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    return fclose(f) == 0;
+}
+
+static bool readJsonReport(const char *path, std::vector<BenchmarkResult> &results)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line [1024];
+    while (fgets(line, sizeof(line), f))
+    {
+        const char *namePos = strstr(line, "\"name\": \"");
+        const char *nsPos = strstr(line, "\"ns_per_op\": ");
+        if (!namePos || !nsPos) continue;
+
+        namePos += strlen("\"name\": \"");
+        const char *nameEnd = strchr(namePos, '"');
+        if (!nameEnd) continue;
+
+        BenchmarkResult r;
+        r.name.assign(namePos, nameEnd);
+        r.nsPerOp = atof(nsPos + strlen("\"ns_per_op\": "));
+        r.megapixelsPerSecond = 0;
+        r.iterations = 0;
+        results.push_back(r);
+    }
+
+    fclose(f);
+    return true;
+}
+
+// returns the number of regressions, i.e. benchmarks that became slower than allowed by the threshold
+static int compareWithBaseline(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline, double thresholdPercent)
+{
+    int numRegressions = 0;
+
+    printf("\n%-48s %14s %14s %9s\n", "comparison with baseline", "baseline ns", "current ns", "change");
+    for (const BenchmarkResult &r : results)
+    {
+        for (const BenchmarkResult &b : baseline)
+        {
+            if (b.name != r.name || b.nsPerOp <= 0) continue;
+            const double change = (r.nsPerOp / b.nsPerOp - 1.0) * 100.0;
+            const bool regression = change > thresholdPercent;
+            if (regression) numRegressions++;
+            printf("%-48s %14.1f %14.1f %+8.1f%%%s\n", r.name.c_str(), b.nsPerOp, r.nsPerOp, change, regression ? "  REGRESSION" : "");
+        }
+    }
+
+    return numRegressions;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    const char *filter = nullptr;
+    const char *jsonPath = nullptr;
+    const char *baselinePath = nullptr;
+    double minTimeMs = 500;
+    int numSamples = 5;
+    double maxMegapixels = 100;
+    double thresholdPercent = 10;
+    bool listOnly = false;
+    int validateVectors = 0;
+
+    for (int i = 1;  i < argc;  i++)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = (i + 1 < argc);
+
+        if (argument == "-h" || argument == "--help") {
+            printf("ACACIA microbenchmarks.\n"
+                   "Usage: bench [options]\n"
+                   "Options:\n"
+                   "  -filter <text>       run only benchmarks whose name contains the text;\n"
+                   "  -list                list benchmark names and exit;\n"
+                   "  -min-time <ms>       minimal measurement time per benchmark (default 500);\n"
+                   "  -samples <n>         number of samples, median is reported (default 5);\n"
+                   "  -max-mp <value>      largest synthetic image in megapixels (default 100);\n"
+                   "  -json <path>         write JSON report;\n"
+                   "  -baseline <path>     compare with a JSON report, exit code is 1 on regressions;\n"
+                   "  -threshold <pct>     allowed slowdown compared to baseline (default 10);\n"
+                   "  -validate [n]        compare fast and quantized with reference inference on n random inputs (default 10000),\n"
+                   "                       and the SIMD features and encoders with their equivalents on random images,\n"
+                   "                       instead of benchmarking, exit code is 1 if they differ too much.\n");
+            return 0;
+        } else if (argument == "-filter" && hasValue) {
+            filter = argv[++i];
+        } else if (argument == "-list") {
+            listOnly = true;
+        } else if (argument == "-min-time" && hasValue) {
+            minTimeMs = atof(argv[++i]);
+        } else if (argument == "-samples" && hasValue) {
+            numSamples = std::max(1, atoi(argv[++i]));
+        } else if (argument == "-max-mp" && hasValue) {
+            maxMegapixels = atof(argv[++i]);
+        } else if (argument == "-json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (argument == "-baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (argument == "-threshold" && hasValue) {
+            thresholdPercent = atof(argv[++i]);
+        } else if (argument == "-validate") {
+            validateVectors = (hasValue && argv[i + 1][0] != '-') ? std::max(1, atoi(argv[++i])) : 10000;
+        } else {
+            fprintf(stderr, "[bench] error: unknown or incomplete option \"%s\"\n", argument.c_str());
+            return -1;
+        }
+    }
+
+    // the optimizer and encoder benchmarks use a realistic 1 MP image and its features
+    const double encoderMegapixels = 1;
+    int encoderWidth, encoderHeight;
+    syntheticImageSize(encoderMegapixels, &encoderWidth, &encoderHeight);
+    std::shared_ptr<std::vector<unsigned int>> encoderImage = std::make_shared<std::vector<unsigned int>>(makeSyntheticImage(encoderWidth, encoderHeight));
+
+    double referenceInputVector [12];
+    FeatureExtractor::calculateFeatures(encoderImage->data(), encoderWidth, encoderHeight, referenceInputVector);
+    referenceInputVector[10] = log(encoderWidth * encoderHeight / 1000000.0);
+    referenceInputVector[11] = 75;
+
+    if (validateVectors > 0) {
+        const bool fastOk = validateInference(referenceInputVector, validateVectors, InferenceFast);
+        printf("\n");
+        const bool quantizedOk = validateInference(referenceInputVector, validateVectors, InferenceQuantized);
+        printf("\n");
+        const bool equivalenceOk = validateEquivalence(40);
+        return (fastOk && quantizedOk && equivalenceOk) ? 0 : 1;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    addKernelBenchmarks(benchmarks);
+    addFeatureBenchmarks(benchmarks, maxMegapixels);
+    addOptimizerBenchmarks(benchmarks, referenceInputVector);
+    addEncoderBenchmarks(benchmarks, encoderImage, encoderWidth, encoderHeight, encoderMegapixels);
+
+    std::vector<BenchmarkResult> results;
+
+    if (!listOnly) printf("%-48s %14s %10s %12s\n", "benchmark", "ns/op", "MP/s", "iterations");
+    for (const Benchmark &benchmark : benchmarks)
+    {
+        if (filter && benchmark.name.find(filter) == std::string::npos) continue;
+        if (listOnly) {
+            printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+
+        const BenchmarkResult result = measure(benchmark, minTimeMs, numSamples);
+        results.push_back(result);
+
+        if (result.megapixelsPerSecond > 0) printf("%-48s %14.1f %10.1f %12llu\n", result.name.c_str(), result.nsPerOp, result.megapixelsPerSecond, result.iterations);
+        else                                printf("%-48s %14.1f %10s %12llu\n", result.name.c_str(), result.nsPerOp, "-", result.iterations);
+        fflush(stdout);
+    }
+
+    if (listOnly) return 0;
+
+    if (jsonPath && !writeJsonReport(jsonPath, results)) {
+        fprintf(stderr, "[bench] error: can't write JSON report to \"%s\"\n", jsonPath);
+        return -1;
+    }
+
+    if (baselinePath)
+    {
+        std::vector<BenchmarkResult> baseline;
+        if (!readJsonReport(baselinePath, baseline)) {
+            fprintf(stderr, "[bench] error: can't read baseline \"%s\"\n", baselinePath);
+            return -1;
+        }
+        const int numRegressions = compareWithBaseline(results, baseline, thresholdPercent);
+        if (numRegressions > 0) {
+            printf("\n%d benchmark(s) regressed by more than %g%%\n", numRegressions, thresholdPercent);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Microbenchmarks for the hot paths of ACACIA: feature extraction kernels, full feature extraction,
+# MLP estimators and the JPEG/WebP encoders.
+#
+# This target does not depend on Qt. It's built together with the rest of the project (see acacia.pro);
+# build the whole tree in release mode, otherwise the library is not optimized and the numbers are meaningless:
+#   qmake CONFIG+=release acacia.pro
+#   make
+#   bench/bench -json current.json -baseline baseline.json
+#
+# -------------------------------------------------------------------------------------------------
+
+
+CONFIG  += console
+CONFIG  -= qt app_bundle
+
+TARGET   = bench
+
+TEMPLATE = app
+
+include(../libacacia/libacacia.pri)
+
+SOURCES += \
+    bench.cpp
+
+# Benchmarks should always be built in release mode
+CONFIG  -= debug
+CONFIG  += release
+
+# Build-time accuracy check: the fast and quantized models are compared with the double precision reference
+# and the build fails if they deviate more than allowed. Skip it with CONFIG+=acacia_no_validate,
+# e.g. when cross-compiling or on a CPU without AVX2.
+!acacia_no_validate {
+    acacia_shared: unix: QMAKE_POST_LINK += LD_LIBRARY_PATH=$$OUT_PWD/../libacacia
+    QMAKE_POST_LINK += $$OUT_PWD/$$TARGET -validate 1000
+}
@@ -0,0 +1,19 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Console version of ACACIA. It doesn't depend on Qt, which keeps start-up time and memory
+# footprint small when it's called for every image of a batch.
+#
+# -------------------------------------------------------------------------------------------------
+
+
+CONFIG  += console
+CONFIG  -= qt app_bundle
+
+TARGET   = acacia
+
+TEMPLATE = app
+
+include(../libacacia/libacacia.pri)
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,1093 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "featureextractor.h"
+#include "optimizer.h"
+#include "modelset.h"
+#include "calibration.h"
+#include "encoder.h"
+#include "imagereader.h"
+#include "yuvimage.h"
+#include "memorybudget.h"
+#include "deadlineplanner.h"
+#include "taskscheduler.h"
+#include "asyncio.h"
+#include "archive.h"
+#include "profiler.h"
+#include "version.h"
+
+// the console version doesn't depend on Qt, so it starts quickly and can be called for every image of a batch
+
+static const char *msgPref = "[acacia] ";
+
+// strict number parsing: the whole argument must be a number
+static bool parseInt(const char *text, int *value)
+{
+    char *end = nullptr;
+    const long result = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || result < -2147483647L || result > 2147483647L) return false;
+    *value = (int) result;
+    return true;
+}
+
+static bool parseDouble(const char *text, double *value)
+{
+    char *end = nullptr;
+    *value = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool writeStatistics(const char *statsFileName)
+{
+    FILE *existing = fopen(statsFileName, "r");
+    if (existing) {
+        fclose(existing);
+        if (!Profiler::mergeReport(statsFileName)) {
+            fprintf(stderr, "%swarning: can't parse existing statistics file, it will be overwritten\n", msgPref);
+        }
+    }
+    if (!Profiler::writeReport(statsFileName)) {
+        fprintf(stderr, "%serror: can't write statistics file\n", msgPref);
+        return false;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Decoded input: grayscale sources are kept as 8-bit luminance, which takes a quarter of the memory
+// and needs neither colour conversion nor the chroma kernels; the features are the same as for xRGB
+// ------------------------------------------------------------------------------------------------
+
+struct InputImage
+{
+    unsigned int *xrgb;
+    unsigned char *gray;
+    int width;
+    int height;
+
+    // set by the caller for JPEG output: the analysis of xRGB images writes the YCbCr planes of libjpeg here,
+    // so the encoder doesn't convert the pixels again
+    YuvBuffer *conversion;
+};
+
+static bool decodeInput(const unsigned char *data, unsigned long long int size, InputImage *image)
+{
+    image->xrgb = nullptr;
+    image->gray = nullptr;
+    image->conversion = nullptr;
+    if (!data) return false;
+    if (ImageReader::isGrayscale(data, size)) image->gray = ImageReader::decodeGray(data, size, &image->width, &image->height);
+    else image->xrgb = ImageReader::decode(data, size, &image->width, &image->height);
+    return image->xrgb || image->gray;
+}
+
+static void freeInput(InputImage *image)
+{
+    delete [] image->xrgb;
+    delete [] image->gray;
+    image->xrgb = nullptr;
+    image->gray = nullptr;
+}
+
+// 10 content features and the image size of the MLP input vector; analysisRowStep > 1 samples rows of fragments (-deadline)
+static void calculateInputFeatures(const InputImage &image, double *inputVector, TaskScheduler *scheduler, int analysisRowStep)
+{
+    if (analysisRowStep > 1 && image.gray) FeatureExtractor::sampleGrayFeatures(image.gray, image.width, image.height, image.width, analysisRowStep, inputVector);
+    else if (analysisRowStep > 1) FeatureExtractor::sampleFeatures(image.xrgb, image.width, image.height, image.width, analysisRowStep, inputVector);
+    else if (image.gray) FeatureExtractor::calculateGrayFeatures(image.gray, image.width, image.height, image.width, inputVector, scheduler);
+    else if (image.conversion) FeatureExtractor::calculateFeatures(image.xrgb, image.width, image.height, image.width, inputVector, image.conversion, scheduler);
+    else FeatureExtractor::calculateFeatures(image.xrgb, image.width, image.height, image.width, inputVector, scheduler);
+    inputVector[10] = log(image.width * (double) image.height / 1000000.0);
+}
+
+// release the result with Encoder::freeBuffer()
+static unsigned char *compressInput(const InputImage &image, bool isjpeg, int qualityFactor, unsigned long long int *size,
+                                    const EncoderOptions &options = EncoderOptions())
+{
+    if (image.gray) {
+        return isjpeg ? Encoder::compressGrayToJpeg(image.gray, image.width, image.height, qualityFactor, size, options) :
+                        Encoder::compressGrayToWebp(image.gray, image.width, image.height, qualityFactor, size, options);
+    }
+    // the conversion is empty if it couldn't be allocated
+    if (isjpeg && image.conversion && image.conversion->image().width > 0) {
+        return Encoder::compressYuvToJpeg(image.conversion->image(), qualityFactor, size, options);
+    }
+    const unsigned char *bgrxImageData = (const unsigned char *) image.xrgb;
+    return isjpeg ? Encoder::compressToJpeg(bgrxImageData, image.width, image.height, qualityFactor, size, options) :
+                    Encoder::compressToWebp(bgrxImageData, image.width, image.height, qualityFactor, size, options);
+}
+
+// the actual size corrects later predictions if a calibration is set (-calibration)
+static void recordFileSize(bool isjpeg, double *inputVector, int qualityFactor, unsigned long long int size)
+{
+    inputVector[11] = qualityFactor;
+    Optimizer::recordResult(isjpeg, 's', inputVector, (double) size);
+}
+
+// Recompression guard (-recompress turns it off): re-encoding a JPEG to JPEG can't make it better if it already fits
+// a size target, or if the quality factor chosen for a quality target is not lower than the one it was saved with
+// (estimated from its quantization table). Its coefficients are then only transcoded with optimized Huffman tables,
+// or the file is copied if that's not smaller. The size is checked before decoding, the quality factor after inference.
+static bool isGuardedInput(bool isjpeg, bool recompress, const unsigned char *data, unsigned long long int size, JpegHeader *header)
+{
+    return isjpeg && !recompress && data && ImageReader::readJpegHeader(data, size, header);
+}
+
+// release the result with Encoder::freeBuffer()
+static unsigned char *passThroughJpeg(const unsigned char *data, unsigned long long int size, unsigned long long int *outSize)
+{
+    unsigned char *optimized = Encoder::optimizeJpeg(data, size, false, outSize);
+    if (optimized && *outSize < size) return optimized;
+    Encoder::freeBuffer(optimized);
+
+    // freeBuffer() releases with free()
+    unsigned char *copy = (unsigned char *) malloc(size);
+    if (copy) memcpy(copy, data, size);
+    *outSize = copy ? size : 0;
+    return copy;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Batch mode
+// ------------------------------------------------------------------------------------------------
+
+struct BatchSettings
+{
+    bool isjpeg;
+    char targetObjective;
+    double targetValue;
+    const char *outDirectory;
+    bool recompress;
+    bool silent;
+};
+
+static unsigned long long int fileSize(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fclose(f);
+    return size > 0 ? (unsigned long long int) size : 0;
+}
+
+// output name is the input file name with the extension of the target format
+static std::string outputPath(const BatchSettings &settings, const std::string &input)
+{
+    const size_t slash = input.find_last_of("/\\");
+    std::string name = (slash == std::string::npos) ? input : input.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) name.resize(dot);
+    return std::string(settings.outDirectory) + "/" + name + (settings.isjpeg ? ".jpg" : ".webp");
+}
+
+// result of one image, reported when its file is written
+struct BatchOutput
+{
+    std::string input;
+    std::string output;
+    int qualityFactor;
+    bool passedThrough;    // the input JPEG is not re-encoded, qualityFactor is its own
+    unsigned long long int size;
+    bool silent;
+    std::atomic<int> *numFailed;
+};
+
+static void outputWritten(void *context, bool ok)
+{
+    BatchOutput *result = (BatchOutput *) context;
+    if (!ok) {
+        fprintf(stderr, "%serror: can't write output file \"%s\"\n", msgPref, result->output.c_str());
+        (*result->numFailed)++;
+    } else if (!result->silent && result->passedThrough) {
+        printf("%s%s -> %s: not re-encoded, quality factor %d, %llu bytes\n", msgPref, result->input.c_str(), result->output.c_str(), result->qualityFactor, result->size);
+    } else if (!result->silent) {
+        printf("%s%s -> %s: quality factor %d, %llu bytes\n", msgPref, result->input.c_str(), result->output.c_str(), result->qualityFactor, result->size);
+    }
+    delete result;
+}
+
+// the worker continues with the next image while the file is written
+static void queueBatchOutput(const BatchSettings &settings, const std::string &input, AsyncIO *io, unsigned char *encodedImage,
+                             unsigned long long int size, int qualityFactor, bool passedThrough, std::atomic<int> *numFailed)
+{
+    BatchOutput *result = new BatchOutput();
+    result->input = input;
+    result->output = outputPath(settings, input);
+    result->qualityFactor = qualityFactor;
+    result->passedThrough = passedThrough;
+    result->size = size;
+    result->silent = settings.silent;
+    result->numFailed = numFailed;
+    io->write(result->output.c_str(), encodedImage, size, outputWritten, result);
+}
+
+// result of one image of a batch; data is allocated with malloc(), release it with Encoder::freeBuffer()
+struct CompressedImage
+{
+    unsigned char *data;
+    unsigned long long int size;
+    int qualityFactor;
+    bool passedThrough;    // the input JPEG is not re-encoded, qualityFactor is its own
+    double predicted [3];  // file size, Y-MSSIM and Y-PSNR predicted for the chosen quality factor
+    unsigned long long int stageTimeNs [NumProfilerStages];
+};
+
+// Decodes, analyzes and encodes one encoded input of a batch; the decode stage is measured from sample, started by the
+// caller before the input was read. releaseInput is called as soon as the input isn't needed any more, in any case.
+static bool compressBatchData(const BatchSettings &settings, const std::string &input, const unsigned char *encodedInput,
+                              unsigned long long int encodedSize, const std::function<void()> &releaseInput, ProfilerSample &sample,
+                              TaskScheduler *scheduler, CompressedImage *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // a JPEG input within the size target is not even decoded
+    JpegHeader inputHeader;
+    const bool guarded = isGuardedInput(settings.isjpeg, settings.recompress, encodedInput, encodedSize, &inputHeader);
+    if (guarded && settings.targetObjective == 's' && encodedSize <= settings.targetValue)
+    {
+        Profiler::start(&sample);
+        result->data = passThroughJpeg(encodedInput, encodedSize, &result->size);
+        result->qualityFactor = inputHeader.quality;
+        result->passedThrough = true;
+        releaseInput();
+        result->stageTimeNs[StageEncode] = Profiler::stop(StageEncode, sample);
+        if (!result->data) {
+            fprintf(stderr, "%serror: can't copy \"%s\"\n", msgPref, input.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // a guarded input is kept until the quality factor is known
+    InputImage image;
+    const bool decoded = decodeInput(encodedInput, encodedSize, &image);
+    if (!guarded || !decoded) releaseInput();
+    YuvBuffer conversion;
+    if (settings.isjpeg) image.conversion = &conversion;
+    if (!decoded) {
+        fprintf(stderr, "%serror: can't open input image \"%s\"\n", msgPref, input.c_str());
+        return false;
+    }
+    result->stageTimeNs[StageDecode] = Profiler::stop(StageDecode, sample);
+
+    Profiler::start(&sample);
+    double inputVector [12];
+    calculateInputFeatures(image, inputVector, scheduler, 1);
+    result->stageTimeNs[StageFeatures] = Profiler::stop(StageFeatures, sample);
+
+    Profiler::start(&sample);
+    const int qualityFactor = Optimizer::findQualityFactor(settings.isjpeg, settings.targetObjective, settings.targetValue, inputVector);
+    inputVector[11] = qualityFactor;
+    result->predicted[0] = Optimizer::estimateFileSize(settings.isjpeg, inputVector);
+    result->predicted[1] = Optimizer::estimateYMSSIM(settings.isjpeg, inputVector);
+    result->predicted[2] = Optimizer::estimateYPSNR(settings.isjpeg, inputVector);
+    result->stageTimeNs[StageInference] = Profiler::stop(StageInference, sample);
+
+    const bool passThrough = guarded && settings.targetObjective != 's' && qualityFactor >= inputHeader.quality;
+
+    Profiler::start(&sample);
+    result->data = passThrough ? passThroughJpeg(encodedInput, encodedSize, &result->size) :
+                                 compressInput(image, settings.isjpeg, qualityFactor, &result->size);
+    result->stageTimeNs[StageEncode] = Profiler::stop(StageEncode, sample);
+    result->qualityFactor = passThrough ? inputHeader.quality : qualityFactor;
+    result->passedThrough = passThrough;
+
+    if (result->data && !passThrough) recordFileSize(settings.isjpeg, inputVector, qualityFactor, result->size);
+
+    if (guarded) releaseInput();
+    freeInput(&image);
+
+    if (!result->data) {
+        fprintf(stderr, "%serror: can't compress \"%s\"\n", msgPref, input.c_str());
+        return false;
+    }
+    return true;
+}
+
+// memory is reserved and the file is read by the caller; the job releases both and only queues the write
+static bool compressBatchImage(const BatchSettings &settings, const std::string &input, AsyncIO *io, AsyncRequest *read,
+                               MemoryBudget *budget, unsigned long long int reserved, TaskScheduler *scheduler, std::atomic<int> *numFailed)
+{
+    ProfilerSample sample;
+    Profiler::start(&sample);
+    unsigned long long int encodedSize = 0;
+    const unsigned char *encodedInput = io->waitRead(read, &encodedSize);
+
+    CompressedImage result;
+    const bool ok = compressBatchData(settings, input, encodedInput, encodedSize, [&]() { io->release(read); }, sample, scheduler, &result);
+    budget->release(reserved);
+    if (!ok) return false;
+
+    queueBatchOutput(settings, input, io, result.data, result.size, result.qualityFactor, result.passedThrough, numFailed);
+    return true;
+}
+
+// Images admitted by runBatch whose tasks are not spawned yet
+struct BatchAdmission
+{
+    std::mutex mutex;
+    std::condition_variable spawned;
+    int pending;
+};
+
+// An admitted image. Its task is spawned when the read has completed and the request is stored, whichever comes
+// later (the read may complete before startRead() returns), so a worker only takes images that are in memory.
+struct BatchJob
+{
+    const BatchSettings *settings;
+    std::string input;
+    AsyncIO *io;
+    AsyncRequest *read;
+    MemoryBudget *budget;
+    unsigned long long int reserved;
+    TaskScheduler *scheduler;
+    TaskGroup *batch;
+    BatchAdmission *admission;
+    std::atomic<int> *numFailed;
+    std::atomic<int> unready;
+};
+
+static void spawnBatchJob(BatchJob *job)
+{
+    if (--job->unready > 0) return;
+
+    BatchAdmission *admission = job->admission;
+    job->scheduler->spawn(job->batch, [job] {
+        if (!compressBatchImage(*job->settings, job->input, job->io, job->read, job->budget, job->reserved, job->scheduler, job->numFailed)) (*job->numFailed)++;
+        delete job;
+    });
+
+    std::lock_guard<std::mutex> lock(admission->mutex);
+    if (--admission->pending == 0) admission->spawned.notify_all();
+}
+
+static void batchReadDone(void *context, bool)
+{
+    spawnBatchJob((BatchJob *) context);
+}
+
+static bool readBatchList(const char *path, std::vector<std::string> *inputs)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line [4096];
+    while (fgets(line, sizeof(line), f))
+    {
+        size_t length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (length > 0) inputs->push_back(line);
+    }
+    fclose(f);
+    return true;
+}
+
+// Every image is a task of the work-stealing scheduler, features of large images are split into band tasks
+// which idle workers steal, so a few large images at the end of a batch don't leave the other cores idle.
+// Images are admitted in the order of the list by this thread, so workers never block on the memory budget;
+// the admitted files are read ahead and the task of an image is spawned by the completion of its read, and
+// outputs are written by the I/O layer, so workers don't wait for the disk either. Tasks spawned from outside
+// the pool are taken in this order.
+static int runBatch(const BatchSettings &settings, const char *listFileName, int numThreads, TaskPlacement placement,
+                    unsigned long long int budgetBytes, int ioDepth)
+{
+    std::vector<std::string> inputs;
+    if (!readBatchList(listFileName, &inputs)) {
+        fprintf(stderr, "%serror: can't read batch list \"%s\"\n", msgPref, listFileName);
+        return -1;
+    }
+
+    // images with the same name in different directories would overwrite each other
+    std::set<std::string> outputs;
+    for (size_t i = 0;  i < inputs.size();  i++) {
+        if (!outputs.insert(outputPath(settings, inputs[i])).second) {
+            fprintf(stderr, "%serror: output name of \"%s\" is used by another image of the batch\n", msgPref, inputs[i].c_str());
+            return -1;
+        }
+    }
+
+    MemoryBudget budget (budgetBytes);
+    std::atomic<int> numFailed (0);
+    AsyncIO io (ioDepth);
+
+    TaskScheduler scheduler (numThreads, placement);
+    TaskGroup batch;
+    BatchAdmission admission;
+    admission.pending = (int) inputs.size();
+    for (size_t i = 0;  i < inputs.size();  i++)
+    {
+        // the header is enough to estimate memory, an image of unknown size is processed alone
+        int w = 0;
+        int h = 0;
+        const unsigned long long int estimate = ImageReader::readDimensions(inputs[i].c_str(), &w, &h) ?
+                    MemoryBudget::estimatePeakMemory(w, h, fileSize(inputs[i].c_str()), settings.isjpeg) : budget.budget();
+
+        BatchJob *job = new BatchJob();
+        job->settings = &settings;
+        job->input = inputs[i];
+        job->io = &io;
+        job->budget = &budget;
+        job->reserved = budget.acquire(estimate);
+        job->scheduler = &scheduler;
+        job->batch = &batch;
+        job->admission = &admission;
+        job->numFailed = &numFailed;
+        job->unready = 2;
+        job->read = io.startRead(inputs[i].c_str(), batchReadDone, job);
+        spawnBatchJob(job);
+    }
+
+    // the group is complete when the last task is spawned
+    {
+        std::unique_lock<std::mutex> lock(admission.mutex);
+        admission.spawned.wait(lock, [&] { return admission.pending == 0; });
+    }
+    scheduler.wait(&batch);
+    io.flush();
+
+    if (!settings.silent) printf("%s%d of %d images compressed\n", msgPref, (int) inputs.size() - numFailed.load(), (int) inputs.size());
+    return numFailed.load() == 0 ? 0 : -1;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Archive mode
+// ------------------------------------------------------------------------------------------------
+
+// one line of the manifest, written when all images are done
+struct ManifestEntry
+{
+    std::string input;
+    std::string output;
+    bool ok;
+    CompressedImage result;
+};
+
+// the entry name with the extension of the target format; a name used by an earlier entry gets a number
+static std::string archiveOutputName(const BatchSettings &settings, const std::string &input, std::set<std::string> *used)
+{
+    std::string base = input;
+    const size_t slash = base.find_last_of('/');
+    const size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash + 1)) base.resize(dot);
+
+    const char *extension = settings.isjpeg ? ".jpg" : ".webp";
+    std::string name = base + extension;
+    for (int n = 2;  !used->insert(name).second;  n++) name = base + "-" + std::to_string(n) + extension;
+    return name;
+}
+
+// names are quoted if they contain separators
+static std::string csvField(const std::string &text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (char c : text) quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+    return quoted + "\"";
+}
+
+static std::string manifestCsv(const std::deque<ManifestEntry> &manifest)
+{
+    std::string csv = "input,output,status,quality_factor,predicted_size,predicted_ymssim,predicted_ypsnr,size,"
+                      "decode_ms,features_ms,inference_ms,encode_ms\n";
+    for (const ManifestEntry &entry : manifest)
+    {
+        const CompressedImage &r = entry.result;
+        char line [512];
+        snprintf(line, sizeof(line), ",%s,%d,%.0f,%.6f,%.4f,%llu,%.3f,%.3f,%.3f,%.3f\n",
+                 !entry.ok ? "failed" : (r.passedThrough ? "passed_through" : "ok"), r.qualityFactor,
+                 r.predicted[0], r.predicted[1], r.predicted[2], r.size, r.stageTimeNs[StageDecode] / 1000000.0,
+                 r.stageTimeNs[StageFeatures] / 1000000.0, r.stageTimeNs[StageInference] / 1000000.0, r.stageTimeNs[StageEncode] / 1000000.0);
+        csv += csvField(entry.input) + "," + csvField(entry.ok ? entry.output : std::string()) + line;
+    }
+    return csv;
+}
+
+// Images are read from a tar or length-prefixed stream by this thread, admitted by the memory budget and compressed
+// as tasks like in batch mode; the outputs go to an archive of the same format in the order they are finished,
+// followed by manifest.csv with the quality factor, predictions, size and stage times of every image in input order.
+// Nothing is opened per image, so corpora of millions of small files are read and written sequentially.
+static int runArchive(const BatchSettings &settings, const char *inArchiveName, const char *outArchiveName, int numThreads,
+                      TaskPlacement placement, unsigned long long int budgetBytes)
+{
+    ArchiveReader reader;
+    if (!reader.open(inArchiveName)) {
+        fprintf(stderr, "%serror: can't open input archive \"%s\"\n", msgPref, inArchiveName);
+        return -1;
+    }
+    ArchiveWriter writer;
+    if (!writer.open(outArchiveName, reader.format())) {
+        fprintf(stderr, "%serror: can't open output archive \"%s\"\n", msgPref, outArchiveName);
+        return -1;
+    }
+
+    MemoryBudget budget (budgetBytes);
+    std::atomic<int> numFailed (0);
+
+    // elements of a deque stay in place while it grows, so every task fills its own entry
+    std::deque<ManifestEntry> manifest;
+    std::set<std::string> usedNames;
+    usedNames.insert("manifest.csv");
+
+    TaskScheduler scheduler (numThreads, placement);
+    TaskGroup batch;
+    while (true)
+    {
+        std::string name;
+        unsigned long long int size = 0;
+        unsigned char *data = reader.next(&name, &size);
+        if (!data) break;
+
+        // the header is enough to estimate memory, an image of unknown size is processed alone
+        int w = 0;
+        int h = 0;
+        const unsigned long long int estimate = ImageReader::readDimensions(data, size, &w, &h) ?
+                    MemoryBudget::estimatePeakMemory(w, h, size, settings.isjpeg) : budget.budget();
+        const unsigned long long int reserved = budget.acquire(estimate);
+
+        manifest.push_back(ManifestEntry());
+        ManifestEntry *entry = &manifest.back();
+        entry->input = name;
+        entry->output = archiveOutputName(settings, name, &usedNames);
+
+        scheduler.spawn(&batch, [&, data, size, reserved, entry] {
+            ProfilerSample sample;
+            Profiler::start(&sample);
+            entry->ok = compressBatchData(settings, entry->input, data, size, [data]() { delete [] data; }, sample, &scheduler, &entry->result);
+            budget.release(reserved);
+            if (entry->ok) writer.add(entry->output, entry->result.data, entry->result.size);
+            else numFailed++;
+        });
+    }
+    scheduler.wait(&batch);
+
+    bool ok = true;
+    if (reader.failed()) {
+        fprintf(stderr, "%serror: input archive \"%s\" is corrupted or can't be read\n", msgPref, inArchiveName);
+        ok = false;
+    }
+
+    const std::string csv = manifestCsv(manifest);
+    unsigned char *manifestData = (unsigned char *) malloc(csv.size());
+    if (manifestData) {
+        memcpy(manifestData, csv.data(), csv.size());
+        writer.add("manifest.csv", manifestData, csv.size());
+    }
+    if (!writer.finish() || !manifestData) {
+        fprintf(stderr, "%serror: can't write output archive \"%s\"\n", msgPref, outArchiveName);
+        ok = false;
+    }
+
+    // the standard output may be the archive
+    if (!settings.silent && strcmp(outArchiveName, "-") != 0) {
+        printf("%s%d of %d images compressed\n", msgPref, (int) manifest.size() - numFailed.load(), (int) manifest.size());
+    }
+    return (ok && numFailed.load() == 0) ? 0 : -1;
+}
+
+static void printUsage()
+{
+    printf("ACACIA image compression tool, version %s.\n"
+           "Command line usage: acacia -jpeg|-webp -size|-mssim|-psnr <target_value> -i <input_image> -o <output_image> [-silent]\n"
+           "Use acacia-gui for the graphical interface.\n"
+           "Options:\n"
+           "  -h, --help        this information;\n"
+           "  -jpeg             compress to JPEG format;\n"
+           "  -webp             compress to WebP format;\n"
+           "  -size <value>     target file size in bytes;\n"
+           "  -mssim <value>    target Y-MSSIM (mean SSIM for luminance channel);\n"
+           "  -psnr <value>     target Y-PSNR;\n"
+           "  -i <path>         path to input image (JPEG, WebP, PNG, TIFF, BMP, PPM or PGM);\n"
+           "  -o <path>         path to compressed image;\n"
+           "  -batch <path>     compress all images listed in a text file (one path per line) in parallel,\n"
+           "                    -o is then the output directory;\n"
+           "  -archive <path>   compress all images of a tar or length-prefixed archive (\"-\" is the standard input)\n"
+           "                    in parallel; -o is then the output archive of the same format (\"-\" is the standard\n"
+           "                    output), which ends with manifest.csv: quality factors, predictions, sizes and times;\n"
+           "  -threads <n>      number of worker threads in batch mode (the number of CPU cores by default);\n"
+           "  -affinity none|cores|numa  placement of the worker threads: by the operating system, pinned to cores,\n"
+           "                    or pinned and grouped by NUMA nodes (idle workers steal from their own node first);\n"
+           "  -memory <MB>      memory budget of batch mode (half of the physical memory by default); images are\n"
+           "                    admitted by their estimated peak memory, an image exceeding the budget runs alone;\n"
+           "  -io-depth <n>     reads and writes in flight per device in batch mode (8 by default);\n"
+           "  -stats <path>     write stage timing statistics (JSON, or CSV if the name ends with .csv);\n"
+           "                    statistics from an existing file are merged, so it accumulates over many runs;\n"
+           "  -models <path>    use regression models from a binary model file instead of the built-in ones;\n"
+           "  -export-models <path>  write the built-in models to a model file and exit;\n"
+           "  -calibration <path>  correct the predictions by the actual file sizes of earlier images; the\n"
+           "                    correction is read from the file if it exists and saved to it after compression;\n"
+           "  -recompress       re-encode JPEG inputs to JPEG even if they already fit a size target or have a quality\n"
+           "                    not higher than the target; otherwise they are only optimized losslessly;\n"
+           "  -deadline <ms>    finish within the given time from the start of the program: sampled analysis,\n"
+           "                    fast inference and lower encoder effort are chosen by a cost model if needed;\n"
+           "  -perf             count hardware events (cycles, instructions, cache, TLB and branch misses) per stage;\n"
+           "  -silent           do not print anything to stdout and disable quality comparison.\n", ACACIA_VERSION);
+}
+
+int main(int argc, char *argv[])
+{
+    // -deadline counts from here
+    const unsigned long long int startTimeNs = Profiler::nowNs();
+
+    // list of input parameters
+    bool        isjpeg         = true;
+    int         targetFileSize = -1;
+    double      targetYMSSIM   = -1;
+    double      targetYPSNR    = -1;
+    const char *inFileName     = nullptr;
+    const char *outFileName    = nullptr;
+    const char *statsFileName  = nullptr;
+    const char *modelsFileName = nullptr;
+    const char *calibrationFileName = nullptr;
+    const char *batchFileName  = nullptr;
+    const char *archiveName    = nullptr;
+    int         numThreads     = 0;
+    int         memoryBudgetMB = 0;
+    int         ioDepth        = 8;
+    double      deadlineMs     = 0;
+    TaskPlacement placement    = PlacementNone;
+    bool        recompress     = false;
+    bool        perf           = false;
+    bool        silent         = false;
+
+    // argument presence flags
+    bool formatOk      = 0;
+    int  sizeOk        = 0;
+    int  mssimOk       = 0;
+    int  psnrOk        = 0;
+
+    if (argc == 1) {
+        printUsage();
+        return 0;
+    }
+
+    // loop over the app's arguments
+    for (int i = 1;  i < argc;  i++)
+    {
+        const char *currentArgument = argv[i];
+
+        if (strcmp(currentArgument, "-h") == 0 || strcmp(currentArgument, "--help") == 0) {
+            printUsage();
+            return 0;
+        } else if (strcmp(currentArgument, "-jpeg") == 0) {
+            isjpeg = true;
+            formatOk = true;
+        } else if (strcmp(currentArgument, "-webp") == 0) {
+            isjpeg = false;
+            formatOk = true;
+        } else if (strcmp(currentArgument, "-size") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing target file size\n", msgPref);
+                return -1;
+            }
+            if (!parseInt(argv[i], &targetFileSize) || targetFileSize < 0) {
+                fprintf(stderr, "%serror: invalid target file size\n", msgPref);
+                return -1;
+            }
+            sizeOk = 1;    // true
+        } else if (strcmp(currentArgument, "-mssim") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing target Y-MSSIM value\n", msgPref);
+                return -1;
+            }
+            if (!parseDouble(argv[i], &targetYMSSIM) || targetYMSSIM > 1.0 || targetYMSSIM < -1.0) {
+                fprintf(stderr, "%serror: invalid target Y-MSSIM value\n", msgPref);
+                return -1;
+            }
+            mssimOk = 1;    // true
+        } else if (strcmp(currentArgument, "-psnr") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing target Y-PSNR value\n", msgPref);
+                return -1;
+            }
+            if (!parseDouble(argv[i], &targetYPSNR) || targetYPSNR < 0) {
+                fprintf(stderr, "%serror: invalid target Y-PSNR value\n", msgPref);
+                return -1;
+            }
+            psnrOk = 1;   // true
+        } else if (strcmp(currentArgument, "-i") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing input image\n", msgPref);
+                return -1;
+            }
+            inFileName = argv[i];
+        } else if (strcmp(currentArgument, "-o") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing output image\n", msgPref);
+                return -1;
+            }
+            outFileName = argv[i];
+        } else if (strcmp(currentArgument, "-batch") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing batch list\n", msgPref);
+                return -1;
+            }
+            batchFileName = argv[i];
+        } else if (strcmp(currentArgument, "-archive") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing input archive\n", msgPref);
+                return -1;
+            }
+            archiveName = argv[i];
+        } else if (strcmp(currentArgument, "-threads") == 0) {
+            i++;
+            if (i == argc || !parseInt(argv[i], &numThreads) || numThreads < 1) {
+                fprintf(stderr, "%serror: invalid number of threads\n", msgPref);
+                return -1;
+            }
+        } else if (strcmp(currentArgument, "-affinity") == 0) {
+            i++;
+            if (i < argc && strcmp(argv[i], "none") == 0) placement = PlacementNone;
+            else if (i < argc && strcmp(argv[i], "cores") == 0) placement = PlacementPinned;
+            else if (i < argc && strcmp(argv[i], "numa") == 0) placement = PlacementNuma;
+            else {
+                fprintf(stderr, "%serror: thread affinity must be none, cores or numa\n", msgPref);
+                return -1;
+            }
+        } else if (strcmp(currentArgument, "-memory") == 0) {
+            i++;
+            if (i == argc || !parseInt(argv[i], &memoryBudgetMB) || memoryBudgetMB < 1) {
+                fprintf(stderr, "%serror: invalid memory budget\n", msgPref);
+                return -1;
+            }
+        } else if (strcmp(currentArgument, "-io-depth") == 0) {
+            i++;
+            if (i == argc || !parseInt(argv[i], &ioDepth) || ioDepth < 1) {
+                fprintf(stderr, "%serror: invalid I/O queue depth\n", msgPref);
+                return -1;
+            }
+        } else if (strcmp(currentArgument, "-stats") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing statistics file\n", msgPref);
+                return -1;
+            }
+            statsFileName = argv[i];
+        } else if (strcmp(currentArgument, "-models") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing model file\n", msgPref);
+                return -1;
+            }
+            modelsFileName = argv[i];
+        } else if (strcmp(currentArgument, "-export-models") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing model file\n", msgPref);
+                return -1;
+            }
+            return ModelSet::builtIn().save(argv[i]) ? 0 : -1;
+        } else if (strcmp(currentArgument, "-calibration") == 0) {
+            i++;
+            if (i == argc) {
+                fprintf(stderr, "%serror: missing calibration file\n", msgPref);
+                return -1;
+            }
+            calibrationFileName = argv[i];
+        } else if (strcmp(currentArgument, "-deadline") == 0) {
+            i++;
+            if (i == argc || !parseDouble(argv[i], &deadlineMs) || deadlineMs <= 0) {
+                fprintf(stderr, "%serror: invalid deadline\n", msgPref);
+                return -1;
+            }
+        } else if (strcmp(currentArgument, "-recompress") == 0) {
+            recompress = true;
+        } else if (strcmp(currentArgument, "-perf") == 0) {
+            perf = true;
+        } else if (strcmp(currentArgument, "-silent") == 0) {
+            silent = true;
+        } else {
+            fprintf(stderr, "%serror: unknown option \"%s\"\n", msgPref, currentArgument);
+            return -1;
+        }
+    }
+
+    // now checking if all necessary parameters were supplied as arguments
+    if (!formatOk) {
+        fprintf(stderr, "%serror: missing target image format\n", msgPref);
+        return -1;
+    }
+    if (!sizeOk && !mssimOk && !psnrOk) {
+        fprintf(stderr, "%serror: missing target restriction\n", msgPref);
+        return -1;
+    }
+    if ((sizeOk + mssimOk + psnrOk) > 1) {
+        fprintf(stderr, "%serror: only one target restriction can be used\n", msgPref);
+        return -1;
+    }
+    if (!inFileName && !batchFileName && !archiveName) {
+        fprintf(stderr, "%serror: missing input image\n", msgPref);
+        return -1;
+    }
+    if ((inFileName != nullptr) + (batchFileName != nullptr) + (archiveName != nullptr) > 1) {
+        fprintf(stderr, "%serror: only one of -i, -batch and -archive can be used\n", msgPref);
+        return -1;
+    }
+    if (!outFileName) {
+        fprintf(stderr, "%serror: missing output image\n", msgPref);
+        return -1;
+    }
+    if (deadlineMs > 0 && !inFileName) {
+        fprintf(stderr, "%serror: -deadline can be used only for single images\n", msgPref);
+        return -1;
+    }
+
+    if (modelsFileName) {
+        std::shared_ptr<const ModelSet> models = ModelSet::load(modelsFileName);
+        if (!models) return -1;    // the reason is already printed
+        Optimizer::setModelSet(models);
+    }
+
+    // a missing calibration file is created, an invalid one is an error
+    std::shared_ptr<Calibration> calibration;
+    if (calibrationFileName) {
+        calibration = std::make_shared<Calibration>();
+        FILE *existing = fopen(calibrationFileName, "r");
+        if (existing) {
+            fclose(existing);
+            if (!calibration->load(calibrationFileName)) return -1;    // the reason is already printed
+        }
+        Optimizer::setCalibration(calibration);
+    }
+
+    // hardware counters are optional, timing works without them
+    if (perf && !PerfCounters::enable()) {
+        fprintf(stderr, "%swarning: hardware performance counters are not available (check /proc/sys/kernel/perf_event_paranoid)\n", msgPref);
+        perf = false;
+    }
+
+    if (batchFileName || archiveName) {
+        const char targetObjective = sizeOk ? 's'            : (mssimOk ? 'm'          : 'p');
+        const double targetValue   = sizeOk ? targetFileSize : (mssimOk ? targetYMSSIM : targetYPSNR);
+        const BatchSettings settings = {isjpeg, targetObjective, targetValue, outFileName, recompress, silent};
+
+        if (numThreads == 0) numThreads = std::thread::hardware_concurrency() > 0 ? (int) std::thread::hardware_concurrency() : 1;
+        const unsigned long long int budgetBytes = memoryBudgetMB > 0 ? (unsigned long long int) memoryBudgetMB << 20 : MemoryBudget::defaultBudget();
+
+        const int status = archiveName ? runArchive(settings, archiveName, outFileName, numThreads, placement, budgetBytes) :
+                                         runBatch(settings, batchFileName, numThreads, placement, budgetBytes, ioDepth);
+        if (calibration && !calibration->save(calibrationFileName)) return -1;
+        if (statsFileName && !writeStatistics(statsFileName)) return -1;
+        return status;
+    }
+
+    // duration and hardware events of every stage
+    ProfilerSample sample;
+    unsigned long long int stageTimeNs [NumProfilerStages] = {};
+    unsigned long long int stageEvents [NumProfilerStages][NumPerfCounters] = {};
+
+    // arguments are checked, time to open input image
+    // the reader produces xRGB or gray pixels directly, so there is no separate colour conversion stage
+    Profiler::start(&sample);
+    unsigned long long int inputFileSize = 0;
+    unsigned char *inputFileData = ImageReader::readFileData(inFileName, &inputFileSize);
+
+    // a JPEG input within the size target is copied without decoding
+    JpegHeader inputHeader;
+    const bool guarded = isGuardedInput(isjpeg, recompress, inputFileData, inputFileSize, &inputHeader);
+    if (guarded && sizeOk && inputFileSize <= (unsigned long long int) targetFileSize)
+    {
+        unsigned long long int passedSize = 0;
+        unsigned char *passedImage = passThroughJpeg(inputFileData, inputFileSize, &passedSize);
+        delete [] inputFileData;
+        Profiler::stop(StageDecode, sample);
+
+        Profiler::start(&sample);
+        FILE *passedFile = passedImage ? fopen(outFileName, "wb") : nullptr;
+        const bool written = passedFile && fwrite(passedImage, 1, passedSize, passedFile) == passedSize;
+        if (passedFile && fclose(passedFile) != 0) passedFile = nullptr;
+        Encoder::freeBuffer(passedImage);
+        if (!written || !passedFile) {
+            fprintf(stderr, "%serror: can't write output file\n", msgPref);
+            return -1;
+        }
+        Profiler::stop(StageWrite, sample);
+        if (!silent) {
+            printf("%sinput JPEG already fits the target size, not re-encoded\n", msgPref);
+            printf("%scompressed size: %llu bytes\n", msgPref, passedSize);
+            printf("%squality factor of the input: %d\n", msgPref, inputHeader.quality);
+        }
+
+        // the copy is accumulated in the statistics like any other image
+        if (statsFileName && !writeStatistics(statsFileName)) return -1;
+        return 0;
+    }
+
+    // a guarded input is kept until the quality factor is known
+    InputImage image;
+    const bool decoded = decodeInput(inputFileData, inputFileSize, &image);
+    if (!guarded) {
+        delete [] inputFileData;
+        inputFileData = nullptr;
+    }
+    if (!decoded) {
+        delete [] inputFileData;
+        fprintf(stderr, "%serror: can't open input image\n", msgPref);
+        return -1;
+    }
+    stageTimeNs[StageDecode] = Profiler::stop(StageDecode, sample, stageEvents[StageDecode]);
+
+    // the rest of the deadline is planned now that the image size is known; without a deadline the plan
+    // is the full analysis, reference inference and the default encoder effort
+    DeadlinePlan plan;
+    plan.analysisRowStep = 1;
+    plan.inference = InferenceReference;
+    plan.sizeFactor = 1.0;
+    const double remainingNs = deadlineMs * 1000000.0 - (double) (Profiler::nowNs() - startTimeNs);
+    if (deadlineMs > 0) {
+        plan = DeadlinePlanner::plan(isjpeg, image.width, image.height, remainingNs);
+        if (!plan.withinBudget) fprintf(stderr, "%swarning: the deadline can't be met, the fastest settings are used\n", msgPref);
+    }
+
+    // sampled analysis doesn't convert all pixels, the encoder converts them then
+    YuvBuffer conversion;
+    if (isjpeg && plan.analysisRowStep == 1) image.conversion = &conversion;
+
+    // open file for saving compressed image
+    FILE *encodedImage = fopen(outFileName, "wb");
+    if (!encodedImage) {
+        fprintf(stderr, "%serror: can't open output file for writing\n", msgPref);
+        freeInput(&image);
+        delete [] inputFileData;
+        return -1;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    // we don't perform error checks beyond this point to simplify program
+    // --------------------------------------------------------------------------------------------
+
+    // now image is located in memory, so we measure time from this point
+    // there are 3 main stages to compress image: feature extraction, choosing optimal quality factor and actual compression
+
+    // stage 1 - feature extraction
+    Profiler::start(&sample);
+
+    // prepare MLP input vector, which consists of 10 content features, image size and quality factor (in this order); 12 elements in total
+    const int inputVectorSize = 12;
+    double inputVector [inputVectorSize];
+
+    // actual function that calculated 10 image features from uncompressed data, and the 11-th input (image size)
+    calculateInputFeatures(image, inputVector, nullptr, plan.analysisRowStep);
+
+    // stage 2 - search for optimal parameters (quality factor)
+    stageTimeNs[StageFeatures] = Profiler::stop(StageFeatures, sample, stageEvents[StageFeatures]);
+    Profiler::start(&sample);
+
+    // we need to chose optimal QF - last 12-th input, which gives us the closest prediction to the target value
+    // firstly, we perform multiplexing of the objective type and target value
+    const char targetObjective = sizeOk ? 's'            : (mssimOk ? 'm'          : 'p');
+    const double targetValue   = sizeOk ? targetFileSize / plan.sizeFactor : (mssimOk ? targetYMSSIM : targetYPSNR);
+
+    // secondly, we call a universal function that performs search using a repective regression model
+    const int qualityFactor = Optimizer::findQualityFactor(isjpeg, targetObjective, targetValue, inputVector, plan.inference);
+
+    // a JPEG input whose quality is not above the target is not re-encoded
+    const bool passThrough = guarded && !sizeOk && qualityFactor >= inputHeader.quality;
+
+    // stage 3 - compression
+    stageTimeNs[StageInference] = Profiler::stop(StageInference, sample, stageEvents[StageInference]);
+    Profiler::start(&sample);
+
+    // call respective function depending on a target image format
+    unsigned long long int compressedBufferSize = 0;
+    const unsigned char *compressedImageBuffer = passThrough ? passThroughJpeg(inputFileData, inputFileSize, &compressedBufferSize) :
+                                                               compressInput(image, isjpeg, qualityFactor, &compressedBufferSize, plan.encoder);
+    delete [] inputFileData;
+
+    // the calibration corrects the models for the default encoder effort only
+    if (!passThrough && plan.sizeFactor == 1.0) recordFileSize(isjpeg, inputVector, qualityFactor, compressedBufferSize);
+
+    // save compressed image to file
+    stageTimeNs[StageEncode] = Profiler::stop(StageEncode, sample, stageEvents[StageEncode]);
+    Profiler::start(&sample);
+
+    fwrite(compressedImageBuffer, 1, compressedBufferSize, encodedImage);
+    fclose(encodedImage);
+    Encoder::freeBuffer((unsigned char *) compressedImageBuffer);
+    freeInput(&image);
+
+    // compression finished
+    stageTimeNs[StageWrite] = Profiler::stop(StageWrite, sample, stageEvents[StageWrite]);
+
+    // print some information, times are measured with a nanosecond clock and printed in milliseconds
+    if (!silent) {
+        printf("%simage reading time: %.3f ms\n",          msgPref, stageTimeNs[StageDecode] / 1000000.0);
+        printf("%sfeature extraction time: %.3f ms\n",     msgPref, stageTimeNs[StageFeatures] / 1000000.0);
+        printf("%sparameter optimization time: %.3f ms\n", msgPref, stageTimeNs[StageInference] / 1000000.0);
+        printf("%sactual compression time: %.3f ms\n",     msgPref, stageTimeNs[StageEncode] / 1000000.0);
+        printf("%sfile writing time: %.3f ms\n",           msgPref, stageTimeNs[StageWrite] / 1000000.0);
+        printf("%scompressed size: %llu bytes\n",          msgPref, compressedBufferSize);
+        if (passThrough) printf("%sinput JPEG has quality factor %d, not re-encoded (chosen %d)\n", msgPref, inputHeader.quality, qualityFactor);
+        else printf("%squality factor used: %d\n",         msgPref, qualityFactor);
+
+        // choices of the deadline mode and the estimate they were based on
+        if (deadlineMs > 0) {
+            printf("%sdeadline: %.3f ms, %.3f ms left after reading, estimated %.3f ms\n", msgPref, deadlineMs, remainingNs / 1000000.0, plan.estimatedNs / 1000000.0);
+            if (plan.analysisRowStep == 1) printf("%sdeadline analysis: full\n", msgPref);
+            else printf("%sdeadline analysis: 1 of %d rows of fragments\n", msgPref, plan.analysisRowStep);
+            printf("%sdeadline inference: %s\n", msgPref, plan.inference == InferenceReference ? "reference" : "fast");
+            if (isjpeg) printf("%sdeadline encoder: Huffman optimization %s\n", msgPref, plan.encoder.optimizeHuffman ? "on" : "off");
+            else printf("%sdeadline encoder: WebP method %d\n", msgPref, plan.encoder.webpMethod);
+            printf("%stotal time: %.3f ms\n", msgPref, (Profiler::nowNs() - startTimeNs) / 1000000.0);
+        }
+
+        // one line per stage; instructions per cycle show whether a stage is compute or memory bound
+        if (perf) {
+            for (int s = 0;  s < NumProfilerStages;  s++)
+            {
+                const unsigned long long int *events = stageEvents[s];
+                printf("%s%s events:", msgPref, Profiler::stageName(s));
+                for (int c = 0;  c < NumPerfCounters;  c++) {
+                    if (PerfCounters::isAvailable(c)) printf(" %s=%llu", PerfCounters::counterName(c), events[c]);
+                }
+                if (events[PerfCycles] > 0) printf(" ipc=%.2f", (double) events[PerfInstructions] / events[PerfCycles]);
+                printf("\n");
+            }
+        }
+    }
+
+    // statistics and the calibration are accumulated in the files over many runs
+    if (calibration && !calibration->save(calibrationFileName)) return -1;
+    if (statsFileName && !writeStatistics(statsFileName)) return -1;
+
+    return 0;
+}
@@ -0,0 +1,427 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QImage>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "math.h"
+
+#include "featureextractor.h"
+#include "optimizer.h"
+#include "metrics.h"
+#include "groundtruth.h"
+
+static unsigned long long int nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------------------------------------------
+// Results collected for every image
+// ------------------------------------------------------------------------------------------------
+
+struct Prediction
+{
+    double fileSize;
+    double yPSNR;
+    double yMSSIM;
+
+    // quality factors chosen by the optimizer when the actually measured values are used as targets
+    int qualityFactorForSize;
+    int qualityFactorForPSNR;
+    int qualityFactorForMSSIM;
+
+    // the same searches with quantized inference, to measure its deviation from the reference models
+    int quantizedQualityFactorForSize;
+    int quantizedQualityFactorForPSNR;
+    int quantizedQualityFactorForMSSIM;
+};
+
+struct ImageRecord
+{
+    std::string name;
+    bool ok;
+    int width;
+    int height;
+
+    // samples and predictions for JPEG (index 0) and WebP (index 1)
+    std::vector<GroundTruthSample> samples [2];
+    std::vector<Prediction> predictions [2];
+};
+
+// time spent in each stage summed over all images processed by one worker, in nanoseconds
+struct StageTimes
+{
+    unsigned long long int decode;
+    unsigned long long int conversion;
+    unsigned long long int features;
+    unsigned long long int inference;
+    unsigned long long int search;
+    unsigned long long int encode;
+    unsigned long long int measure;
+
+    unsigned long long int numPredictions;
+    unsigned long long int numSearches;
+    unsigned long long int numEncodes;
+    double megapixels;
+    double encodedMegapixels;
+};
+
+struct Settings
+{
+    bool formats [2];
+    int qfStep;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+static void processImage(const QString &path, const Settings &settings, ImageRecord *record, StageTimes *times)
+{
+    record->ok = false;
+
+    // decoding
+
+    unsigned long long int startTime = nowNs();
+    QImage inputImage(path);
+    if (inputImage.isNull()) return;
+    times->decode += nowNs() - startTime;
+
+    // conversion to 24 bpp like in the main application
+
+    startTime = nowNs();
+    if (inputImage.format() != QImage::Format_RGB32) inputImage = inputImage.convertToFormat(QImage::Format_RGB32);
+    times->conversion += nowNs() - startTime;
+
+    const int w = inputImage.width();
+    const int h = inputImage.height();
+    const unsigned int *inputImageData = (const unsigned int *) inputImage.constBits();
+
+    record->width = w;
+    record->height = h;
+    times->megapixels += w * h / 1000000.0;
+
+    // feature extraction
+
+    startTime = nowNs();
+    const int inputVectorSize = 12;
+    double inputVector [inputVectorSize];
+    FeatureExtractor::calculateFeatures(inputImageData, w, h, inputVector);
+    inputVector[10] = log(w * h / 1000000.0);
+    times->features += nowNs() - startTime;
+
+    // luminance of the original image is shared by all measurements
+
+    startTime = nowNs();
+    std::vector<unsigned char> referenceLuma ((size_t) w * h);
+    Metrics::extractLuma(inputImageData, w, h, referenceLuma.data());
+    times->measure += nowNs() - startTime;
+
+    for (int format = 0;  format < 2;  format++)
+    {
+        if (!settings.formats[format]) continue;
+        const bool isjpeg = (format == 0);
+
+        // the same QF range as used by the optimizer, always including 100
+        const int minQF = isjpeg ? 5 : 0;
+        std::vector<int> qualityFactors;
+        for (int qualityFactor = minQF;  qualityFactor < 100;  qualityFactor += settings.qfStep) qualityFactors.push_back(qualityFactor);
+        qualityFactors.push_back(100);
+
+        for (int qualityFactor : qualityFactors)
+        {
+            GroundTruthSample sample;
+            if (!GroundTruth::measure(isjpeg, inputImageData, referenceLuma.data(), w, h, qualityFactor, &sample)) return;
+            times->encode += sample.encodeTimeNs;
+            times->measure += sample.measureTimeNs;
+            times->numEncodes++;
+            times->encodedMegapixels += w * h / 1000000.0;
+
+            startTime = nowNs();
+            Prediction prediction;
+            inputVector[11] = qualityFactor;
+            prediction.fileSize = Optimizer::estimateFileSize(isjpeg, inputVector);
+            prediction.yPSNR = Optimizer::estimateYPSNR(isjpeg, inputVector);
+            prediction.yMSSIM = Optimizer::estimateYMSSIM(isjpeg, inputVector);
+            times->inference += nowNs() - startTime;
+            times->numPredictions += 3;
+
+            startTime = nowNs();
+            prediction.qualityFactorForSize = Optimizer::findQualityFactor(isjpeg, 's', sample.fileSize, inputVector);
+            prediction.qualityFactorForPSNR = Optimizer::findQualityFactor(isjpeg, 'p', sample.yPSNR, inputVector);
+            prediction.qualityFactorForMSSIM = Optimizer::findQualityFactor(isjpeg, 'm', sample.yMSSIM, inputVector);
+            times->search += nowNs() - startTime;
+            times->numSearches += 3;
+
+            prediction.quantizedQualityFactorForSize = Optimizer::findQualityFactor(isjpeg, 's', sample.fileSize, inputVector, InferenceQuantized);
+            prediction.quantizedQualityFactorForPSNR = Optimizer::findQualityFactor(isjpeg, 'p', sample.yPSNR, inputVector, InferenceQuantized);
+            prediction.quantizedQualityFactorForMSSIM = Optimizer::findQualityFactor(isjpeg, 'm', sample.yMSSIM, inputVector, InferenceQuantized);
+
+            record->samples[format].push_back(sample);
+            record->predictions[format].push_back(prediction);
+        }
+    }
+
+    record->ok = true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Report
+// ------------------------------------------------------------------------------------------------
+
+static double percentile(const std::vector<double> &sortedValues, double p)
+{
+    if (sortedValues.empty()) return 0;
+    const size_t index = std::min(sortedValues.size() - 1, (size_t) (p * (sortedValues.size() - 1) + 0.5));
+    return sortedValues[index];
+}
+
+// prints signed mean error (bias) and the distribution of absolute errors
+static void printDistribution(const char *format, const char *name, const std::vector<double> &errors)
+{
+    if (errors.empty()) return;
+
+    double sum = 0;
+    std::vector<double> absErrors;
+    for (double e : errors) {
+        sum += e;
+        absErrors.push_back(fabs(e));
+    }
+    std::sort(absErrors.begin(), absErrors.end());
+
+    printf("%-6s %-22s %8zu %10.4f %10.4f %10.4f %10.4f %10.4f\n", format, name, errors.size(), sum / errors.size(),
+           percentile(absErrors, 0.5), percentile(absErrors, 0.9), percentile(absErrors, 0.99), absErrors.back());
+}
+
+static void printStage(const char *name, unsigned long long int timeNs, double megapixels, int numThreads, double wallTimeS)
+{
+    // per-core throughput is calculated from the time actually spent in the stage,
+    // the share of wall time shows which stage dominates the whole run
+    const double timeS = timeNs / 1000000000.0;
+    printf("%-12s %12.1f %12.1f %9.1f%%\n", name, timeS * 1000.0, timeS > 0 ? megapixels / timeS : 0, 100.0 * timeS / (wallTimeS * numThreads));
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    // QCoreApplication is needed for image format plugins
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+
+    QString directory;
+    QString csvPath;
+    Settings settings;
+    settings.formats[0] = true;
+    settings.formats[1] = true;
+    settings.qfStep = 5;
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    int limit = -1;
+
+    for (int i = 1;  i < arguments.size();  i++)
+    {
+        const QString argument = arguments.at(i);
+        const bool hasValue = (i + 1 < arguments.size());
+
+        if (argument == "-h" || argument == "--help") {
+            printf("ACACIA prediction accuracy and throughput evaluation.\n"
+                   "Usage: evaluate -dir <path> [options]\n"
+                   "Options:\n"
+                   "  -dir <path>          directory with test images;\n"
+                   "  -jpeg, -webp         evaluate only one format (both by default);\n"
+                   "  -qf-step <n>         step of the quality factor sweep (default 5);\n"
+                   "  -threads <n>         number of worker threads (default: all cores);\n"
+                   "  -limit <n>           process only the first n images;\n"
+                   "  -csv <path>          write all samples with predictions to a CSV file.\n");
+            return 0;
+        } else if (argument == "-dir" && hasValue) {
+            directory = arguments.at(++i);
+        } else if (argument == "-jpeg") {
+            settings.formats[0] = true;
+            settings.formats[1] = false;
+        } else if (argument == "-webp") {
+            settings.formats[0] = false;
+            settings.formats[1] = true;
+        } else if (argument == "-qf-step" && hasValue) {
+            settings.qfStep = std::max(1, arguments.at(++i).toInt());
+        } else if (argument == "-threads" && hasValue) {
+            numThreads = std::max(1, arguments.at(++i).toInt());
+        } else if (argument == "-limit" && hasValue) {
+            limit = arguments.at(++i).toInt();
+        } else if (argument == "-csv" && hasValue) {
+            csvPath = arguments.at(++i);
+        } else {
+            fprintf(stderr, "[evaluate] error: unknown or incomplete option \"%s\"\n", argument.toLocal8Bit().constData());
+            return -1;
+        }
+    }
+
+    if (directory.isEmpty()) {
+        fprintf(stderr, "[evaluate] error: missing image directory\n");
+        return -1;
+    }
+
+    QDir dir(directory);
+    QStringList nameFilters;
+    nameFilters << "*.jpg" << "*.jpeg" << "*.bmp" << "*.png" << "*.tif" << "*.tiff" << "*.ppm";
+    QStringList files = dir.entryList(nameFilters, QDir::Files, QDir::Name);
+    if (limit >= 0 && files.size() > limit) files = files.mid(0, limit);
+    if (files.isEmpty()) {
+        fprintf(stderr, "[evaluate] error: no images found in \"%s\"\n", directory.toLocal8Bit().constData());
+        return -1;
+    }
+
+    // parallel processing: every worker takes the next unprocessed image
+    std::vector<ImageRecord> records (files.size());
+    std::vector<StageTimes> times (numThreads);
+    std::atomic<int> nextImage(0);
+
+    const unsigned long long int startTime = nowNs();
+
+    std::vector<std::thread> workers;
+    for (int t = 0;  t < numThreads;  t++)
+    {
+        times[t] = StageTimes();
+        workers.push_back(std::thread([&, t]() {
+            while (true) {
+                const int index = nextImage++;
+                if (index >= files.size()) break;
+                records[index].name = files.at(index).toStdString();
+                processImage(dir.filePath(files.at(index)), settings, &records[index], &times[t]);
+            }
+        }));
+    }
+    for (std::thread &worker : workers) worker.join();
+
+    const double wallTimeS = (nowNs() - startTime) / 1000000000.0;
+
+    // error distributions
+
+    std::vector<double> sizeErrors [2], psnrErrors [2], mssimErrors [2], qfSizeErrors [2], qfPSNRErrors [2], qfMSSIMErrors [2];
+    std::vector<double> quantizedQFDeviations [2][3];
+    int numFailed = 0;
+
+    FILE *csv = csvPath.isEmpty() ? nullptr : fopen(csvPath.toLocal8Bit().constData(), "w");
+    if (!csvPath.isEmpty() && !csv) {
+        fprintf(stderr, "[evaluate] error: can't open CSV file for writing\n");
+        return -1;
+    }
+    if (csv) fprintf(csv, "image,width,height,format,qf,size,predicted_size,ypsnr,predicted_ypsnr,ymssim,predicted_ymssim,qf_for_size,qf_for_ypsnr,qf_for_ymssim,encode_ms\n");
+
+    for (const ImageRecord &record : records)
+    {
+        if (!record.ok) {
+            numFailed++;
+            fprintf(stderr, "[evaluate] warning: can't process \"%s\"\n", record.name.c_str());
+            continue;
+        }
+
+        for (int format = 0;  format < 2;  format++)
+        {
+            for (size_t i = 0;  i < record.samples[format].size();  i++)
+            {
+                const GroundTruthSample &s = record.samples[format][i];
+                const Prediction &p = record.predictions[format][i];
+
+                sizeErrors[format].push_back(100.0 * (p.fileSize - s.fileSize) / s.fileSize);
+                psnrErrors[format].push_back(p.yPSNR - s.yPSNR);
+                mssimErrors[format].push_back(p.yMSSIM - s.yMSSIM);
+                qfSizeErrors[format].push_back(p.qualityFactorForSize - s.qualityFactor);
+                qfPSNRErrors[format].push_back(p.qualityFactorForPSNR - s.qualityFactor);
+                qfMSSIMErrors[format].push_back(p.qualityFactorForMSSIM - s.qualityFactor);
+                quantizedQFDeviations[format][0].push_back(p.quantizedQualityFactorForSize - p.qualityFactorForSize);
+                quantizedQFDeviations[format][1].push_back(p.quantizedQualityFactorForPSNR - p.qualityFactorForPSNR);
+                quantizedQFDeviations[format][2].push_back(p.quantizedQualityFactorForMSSIM - p.qualityFactorForMSSIM);
+
+                if (csv) fprintf(csv, "\"%s\",%d,%d,%s,%d,%.0f,%.0f,%.4f,%.4f,%.6f,%.6f,%d,%d,%d,%.3f\n",
+                                 record.name.c_str(), record.width, record.height, format == 0 ? "jpeg" : "webp", s.qualityFactor,
+                                 s.fileSize, p.fileSize, s.yPSNR, p.yPSNR, s.yMSSIM, p.yMSSIM,
+                                 p.qualityFactorForSize, p.qualityFactorForPSNR, p.qualityFactorForMSSIM, s.encodeTimeNs / 1000000.0);
+            }
+        }
+    }
+    if (csv) fclose(csv);
+
+    printf("images: %d processed, %d failed, %d threads, %.1f s wall time, %.2f images/s\n\n",
+           (int) records.size() - numFailed, numFailed, numThreads, wallTimeS, (records.size() - numFailed) / wallTimeS);
+
+    printf("%-6s %-22s %8s %10s %10s %10s %10s %10s\n", "format", "prediction error", "samples", "bias", "p50", "p90", "p99", "max");
+    for (int format = 0;  format < 2;  format++)
+    {
+        const char *name = format == 0 ? "jpeg" : "webp";
+        printDistribution(name, "file size, %", sizeErrors[format]);
+        printDistribution(name, "Y-PSNR, dB", psnrErrors[format]);
+        printDistribution(name, "Y-MSSIM", mssimErrors[format]);
+        printDistribution(name, "QF for size target", qfSizeErrors[format]);
+        printDistribution(name, "QF for Y-PSNR target", qfPSNRErrors[format]);
+        printDistribution(name, "QF for Y-MSSIM target", qfMSSIMErrors[format]);
+    }
+
+    // quality factors chosen with quantized inference minus the ones chosen with the reference models
+    printf("\n%-6s %-22s %8s %10s %10s %10s %10s %10s\n", "format", "quantized QF deviation", "samples", "bias", "p50", "p90", "p99", "max");
+    for (int format = 0;  format < 2;  format++)
+    {
+        const char *name = format == 0 ? "jpeg" : "webp";
+        printDistribution(name, "size target", quantizedQFDeviations[format][0]);
+        printDistribution(name, "Y-PSNR target", quantizedQFDeviations[format][1]);
+        printDistribution(name, "Y-MSSIM target", quantizedQFDeviations[format][2]);
+    }
+
+    // throughput
+
+    StageTimes total = StageTimes();
+    for (const StageTimes &t : times)
+    {
+        total.decode += t.decode;
+        total.conversion += t.conversion;
+        total.features += t.features;
+        total.inference += t.inference;
+        total.search += t.search;
+        total.encode += t.encode;
+        total.measure += t.measure;
+        total.numPredictions += t.numPredictions;
+        total.numSearches += t.numSearches;
+        total.numEncodes += t.numEncodes;
+        total.megapixels += t.megapixels;
+        total.encodedMegapixels += t.encodedMegapixels;
+    }
+
+    printf("\n%-12s %12s %12s %10s\n", "stage", "time, ms", "MP/s/core", "share");
+    printStage("decode", total.decode, total.megapixels, numThreads, wallTimeS);
+    printStage("conversion", total.conversion, total.megapixels, numThreads, wallTimeS);
+    printStage("features", total.features, total.megapixels, numThreads, wallTimeS);
+    printStage("encode", total.encode, total.encodedMegapixels, numThreads, wallTimeS);
+    printStage("measure", total.measure, total.encodedMegapixels, numThreads, wallTimeS);
+    printf("%-12s %12.1f %12s %9.1f%%   (%.0f ns per prediction)\n", "inference", total.inference / 1000000.0, "-",
+           100.0 * total.inference / (wallTimeS * 1000000000.0 * numThreads), total.numPredictions ? (double) total.inference / total.numPredictions : 0.0);
+    printf("%-12s %12.1f %12s %9.1f%%   (%.0f ns per QF search)\n", "QF search", total.search / 1000000.0, "-",
+           100.0 * total.search / (wallTimeS * 1000000000.0 * numThreads), total.numSearches ? (double) total.search / total.numSearches : 0.0);
+
+    return numFailed == (int) records.size() ? -1 : 0;
+}
@@ -0,0 +1,27 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Corpus-level evaluation of ACACIA predictions.
+#
+# Every image of a directory is compressed with the real encoders over a sweep of quality factors,
+# the actual file size, Y-PSNR and Y-MSSIM are measured and compared with the predictions of the
+# regression models. The report contains error distributions and per-stage throughput.
+#
+# It's built together with the rest of the project (see acacia.pro):
+#   evaluate/evaluate -dir <images> -threads 8 -csv samples.csv
+#
+# -------------------------------------------------------------------------------------------------
+
+
+QT      += core gui
+
+CONFIG  += console
+CONFIG  -= app_bundle
+
+TARGET   = evaluate
+
+TEMPLATE = app
+
+include(../libacacia/libacacia.pri)
+
+SOURCES += \
+    evaluate.cpp
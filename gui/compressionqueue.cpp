@@ -0,0 +1,128 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "compressionqueue.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+
+#include "encoder.h"
+
+CompressionQueue::CompressionQueue() : lastJob(0) {}
+
+CompressionQueue::~CompressionQueue()
+{
+    for (QMap<int, CompressedImage>::iterator i = compressedImages.begin();  i != compressedImages.end();  ++i) Encoder::freeBuffer(i.value().buffer);
+}
+
+int CompressionQueue::newJob()
+{
+    return ++lastJob;
+}
+
+void CompressionQueue::cancel(int job)
+{
+    {
+        QMutexLocker locker(&cancelledMutex);
+        cancelledJobs.insert(job);
+    }
+
+    // an empty destination releases the result if the job is already done
+    QMetaObject::invokeMethod(this, "setDestination", Qt::QueuedConnection, Q_ARG(int, job), Q_ARG(QString, QString()));
+}
+
+bool CompressionQueue::takeCancelled(int job)
+{
+    QMutexLocker locker(&cancelledMutex);
+    return cancelledJobs.remove(job);
+}
+
+void CompressionQueue::compress(int job, QImage image, bool isjpeg, int qualityFactor)
+{
+    // the dialog was cancelled before the job started
+    if (takeCancelled(job)) return;
+
+    const qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+
+    CompressedImage result;
+    result.size = 0;
+    result.buffer = isjpeg ? Encoder::compressToJpeg(image.constBits(), image.width(), image.height(), qualityFactor, &result.size) :
+                             Encoder::compressToWebp(image.constBits(), image.width(), image.height(), qualityFactor, &result.size);
+    if (!result.buffer) {
+        destinations.remove(job);
+        if (!takeCancelled(job)) emit failed(job, "Can't compress the image");
+        return;
+    }
+    emit compressed(job, result.size, QDateTime::currentMSecsSinceEpoch() - startTime);
+
+    // the dialog may have been confirmed while the encoder was running
+    if (destinations.contains(job)) {
+        save(job, result, destinations.take(job));
+        Encoder::freeBuffer(result.buffer);
+    } else {
+        compressedImages.insert(job, result);
+    }
+}
+
+void CompressionQueue::setDestination(int job, QString path)
+{
+    if (path.isEmpty()) {
+        // cancelled, the result of a finished job is not needed any more
+        if (compressedImages.contains(job)) {
+            Encoder::freeBuffer(compressedImages.take(job).buffer);
+            takeCancelled(job);
+        }
+        return;
+    }
+
+    if (!compressedImages.contains(job)) {
+        destinations.insert(job, path);
+        return;
+    }
+
+    const CompressedImage result = compressedImages.take(job);
+    save(job, result, path);
+    Encoder::freeBuffer(result.buffer);
+}
+
+void CompressionQueue::finish()
+{
+    this->thread()->quit();
+}
+
+void CompressionQueue::save(int job, const CompressedImage &image, const QString &path)
+{
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly) || f.write((const char *) image.buffer, image.size) != (qint64) image.size) {
+        emit failed(job, "Can't write \"" + path + "\"");
+        return;
+    }
+
+    // close() flushes the buffered data, so e.g. a full disk is reported only here
+    f.close();
+    if (f.error() != QFile::NoError) {
+        emit failed(job, "Can't write \"" + path + "\"");
+        return;
+    }
+    emit saved(job, path);
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef COMPRESSIONQUEUE_H
+#define COMPRESSIONQUEUE_H
+
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#include <atomic>
+
+// Compresses images and saves them in a worker thread, so the save dialog can be shown while the encoder runs.
+//
+// A job starts with compress(), its file name is passed later by setDestination() when the user confirms the dialog;
+// the compressed data waits in memory for whichever comes last. Both slots are invoked through queued connections,
+// so jobs are processed one after another in the order of submission. cancel() can be called from the GUI thread.
+class CompressionQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    CompressionQueue();
+    ~CompressionQueue();
+
+    int newJob();
+
+    // the job is skipped if it hasn't started yet, otherwise its result is dropped
+    void cancel(int job);
+
+public slots:
+    // image must be in RGB32 format
+    void compress(int job, QImage image, bool isjpeg, int qualityFactor);
+    void setDestination(int job, QString path);
+
+    // stops the worker thread after all jobs queued before this call
+    void finish();
+
+signals:
+    void compressed(int job, qulonglong compressedSize, qint64 compressionTimeMs);
+    void saved(int job, QString path);
+    void failed(int job, QString message);
+
+private:
+    struct CompressedImage
+    {
+        unsigned char *buffer;
+        unsigned long long int size;
+    };
+
+    bool takeCancelled(int job);
+    void save(int job, const CompressedImage &image, const QString &path);
+
+    std::atomic<int> lastJob;
+
+    QMutex cancelledMutex;
+    QSet<int> cancelledJobs;
+
+    // used only in the worker thread
+    QMap<int, CompressedImage> compressedImages;
+    QMap<int, QString> destinations;
+};
+
+#endif // COMPRESSIONQUEUE_H
@@ -0,0 +1,35 @@
+# -------------------------------------------------------------------------------------------------
+#
+# GUI version of ACACIA. It uses Qt4 or Qt5 for the interface and image loading, all processing
+# is done by the core library.
+#
+# -------------------------------------------------------------------------------------------------
+
+
+QT += core
+QT += gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET   = acacia-gui
+
+TEMPLATE = app
+
+include(../libacacia/libacacia.pri)
+
+SOURCES += \
+    main.cpp \
+    mainwindow.cpp \
+    imagebox.cpp \
+    imageanalyzer.cpp \
+    previewengine.cpp \
+    compressionqueue.cpp
+
+HEADERS += \
+    mainwindow.h \
+    imagebox.h \
+    imageanalyzer.h \
+    previewengine.h \
+    compressionqueue.h
+
+FORMS += \
+    mainwindow.ui
@@ -0,0 +1,84 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "imageanalyzer.h"
+
+#include <QDateTime>
+
+#include "featureextractor.h"
+
+ImageAnalyzer::ImageAnalyzer() : currentRequest(0), runningRequest(0), lastPercent(-1) {}
+
+int ImageAnalyzer::newRequest()
+{
+    return ++currentRequest;
+}
+
+bool ImageAnalyzer::isCurrent(int request) const
+{
+    return request == currentRequest.load();
+}
+
+bool ImageAnalyzer::reportProgress(void *context, double fraction)
+{
+    ImageAnalyzer *analyzer = (ImageAnalyzer *) context;
+    if (!analyzer->isCurrent(analyzer->runningRequest)) return false;
+
+    // the progress bar doesn't need more than one update per percent
+    const int percent = (int) (fraction * 100);
+    if (percent != analyzer->lastPercent) {
+        analyzer->lastPercent = percent;
+        emit analyzer->progressChanged(analyzer->runningRequest, percent);
+    }
+    return true;
+}
+
+void ImageAnalyzer::analyze(int request, const QString &path)
+{
+    // another image was opened while this request was waiting
+    if (!isCurrent(request)) return;
+
+    // decoding can't be interrupted, obsolete results are dropped after it
+    QImage image(path);
+    if (!isCurrent(request)) return;
+    if (image.isNull()) {
+        emit analysisFailed(request, path);
+        return;
+    }
+    emit imageDecoded(request, image);
+
+    // check if image is not 24 bpp, e.g. grayscale, and convert it to 24 bpp
+    if (image.format() != QImage::Format_RGB32) image = image.convertToFormat(QImage::Format_RGB32);
+    if (!isCurrent(request)) return;
+
+    const qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+
+    runningRequest = request;
+    lastPercent = -1;
+    const FeatureProgress progress = {reportProgress, this};
+
+    double features [10];
+    if (!FeatureExtractor::calculateFeatures((const unsigned int *) image.constBits(), image.width(), image.height(), image.bytesPerLine() / 4, features, &progress)) return;
+
+    QVector<double> result (10);
+    for (int i = 0;  i < 10;  i++) result[i] = features[i];
+    emit analysisFinished(request, image, result, QDateTime::currentMSecsSinceEpoch() - startTime);
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef IMAGEANALYZER_H
+#define IMAGEANALYZER_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+// Decodes images and calculates their features in a worker thread, so the window stays responsive.
+//
+// The object lives in the worker thread, analyze() is invoked through a queued connection.
+// Every image gets a request number from newRequest() in the GUI thread, which makes all earlier requests
+// obsolete: a running analysis stops at the next progress report and queued ones are skipped.
+// Signals carry the request number, so the receiver can drop results that arrive late.
+class ImageAnalyzer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImageAnalyzer();
+
+    int newRequest();
+
+public slots:
+    void analyze(int request, const QString &path);
+
+signals:
+    // the decoded image is available for preview before its features are ready
+    void imageDecoded(int request, QImage image);
+    void progressChanged(int request, int percent);
+    // image in RGB32 format and 10 content features
+    void analysisFinished(int request, QImage image, QVector<double> features, qint64 extractionTimeMs);
+    void analysisFailed(int request, QString path);
+
+private:
+    bool isCurrent(int request) const;
+    static bool reportProgress(void *context, double fraction);
+
+    std::atomic<int> currentRequest;
+
+    // state of the running analysis for reportProgress()
+    int runningRequest;
+    int lastPercent;
+};
+
+#endif // IMAGEANALYZER_H
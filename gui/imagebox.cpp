@@ -0,0 +1,164 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include <QPainter>
+#include "imagebox.h"
+
+// levels larger than this are never needed for the preview, smaller ones are not worth keeping
+static const int maxLevelSize = 2048;
+static const int minLevelSize = 64;
+
+PyramidBuilder::PyramidBuilder() : latestGeneration(0) {}
+
+void PyramidBuilder::build(int generation, QImage image)
+{
+    QVector<QImage> levels;
+    QImage level = image;
+    while (qMax(level.width(), level.height()) > minLevelSize)
+    {
+        if (generation != latestGeneration.load()) return;
+
+        // smooth scaling to a half averages 2x2 pixels, so every level is a proper box filter of the previous one
+        level = level.scaled(qMax(1, level.width() / 2), qMax(1, level.height() / 2), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        if (qMax(level.width(), level.height()) <= maxLevelSize) levels.append(level);
+    }
+
+    emit built(generation, levels);
+}
+
+ImageBox::ImageBox(QWidget *parent) : QWidget(parent), generation(0), cachedFromPyramid(false)
+{
+    qRegisterMetaType<QVector<QImage> >("QVector<QImage>");
+
+    pyramidThread = new QThread(this);
+    pyramidBuilder = new PyramidBuilder();
+    pyramidBuilder->moveToThread(pyramidThread);
+    connect(pyramidBuilder, SIGNAL(built(int,QVector<QImage>)), this, SLOT(setPyramid(int,QVector<QImage>)));
+    pyramidThread->start();
+}
+
+ImageBox::~ImageBox()
+{
+    pyramidBuilder->latestGeneration = -1;
+    pyramidThread->quit();
+    pyramidThread->wait();
+    delete pyramidBuilder;
+}
+
+void ImageBox::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+
+    painter.fillRect(QRect(0, 0, this->width(), this->height()), Qt::gray);
+
+    QPen pen(Qt::darkGray);
+    pen.setWidth(4);
+    painter.setPen(pen);
+    for (int i = 0;  i < this->width() + this->height();  i += 12) painter.drawLine(i, 0, 0, i);
+
+    if (!comparisonOriginal.isNull()) {
+        // comparison images are cut to the widget size, so they are usually drawn without scaling
+        QSize size = comparisonOriginal.size();
+        if (size.width() > this->width() || size.height() > this->height()) size.scale(this->size(), Qt::KeepAspectRatio);
+        const QRect target ((this->width() - size.width()) / 2, (this->height() - size.height()) / 2, size.width(), size.height());
+        const int half = size.width() / 2;
+
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, size != comparisonOriginal.size());
+        painter.save();
+        painter.setClipRect(target.x(), target.y(), half, target.height());
+        painter.drawImage(target, comparisonOriginal);
+        painter.setClipRect(target.x() + half, target.y(), target.width() - half, target.height());
+        painter.drawImage(target, comparisonCompressed);
+        painter.restore();
+
+        painter.setPen(QPen(Qt::white, 1));
+        painter.drawLine(target.x() + half, target.y(), target.x() + half, target.bottom());
+        painter.drawText(target.adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignBottom, tr("original"));
+        painter.drawText(target.adjusted(6, 4, -6, -4), Qt::AlignRight | Qt::AlignBottom, tr("compressed"));
+        return;
+    }
+
+    if (!image.isNull()) painter.drawImage(0, 0, fittedImage(image.size().scaled(this->size(), Qt::KeepAspectRatio)));
+}
+
+const QImage &ImageBox::fittedImage(const QSize &size)
+{
+    const bool pyramidReady = !levels.isEmpty() || qMax(image.width(), image.height()) <= minLevelSize;
+    if (cachedImage.size() == size && (cachedFromPyramid || !pyramidReady)) return cachedImage;
+
+    if (!pyramidReady) {
+        cachedImage = image.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        cachedFromPyramid = false;
+        return cachedImage;
+    }
+
+    // the smallest level which is still at least as large as the target
+    const QImage *source = &image;
+    for (int i = 0;  i < levels.size();  i++)
+        if (levels[i].width() >= size.width() && levels[i].height() >= size.height()) source = &levels[i];
+
+    cachedImage = source->scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    cachedFromPyramid = true;
+    return cachedImage;
+}
+
+void ImageBox::setPyramid(int generation, QVector<QImage> levels)
+{
+    if (generation != this->generation) return;
+    this->levels = levels;
+    cachedImage = QImage();
+    this->update();
+}
+
+QImage ImageBox::getImage()
+{
+    return image;
+}
+
+void ImageBox::setImage(QImage image)
+{
+    this->image = image;
+    levels.clear();
+    cachedImage = QImage();
+    comparisonOriginal = QImage();
+    comparisonCompressed = QImage();
+
+    generation++;
+    pyramidBuilder->latestGeneration = generation;
+    if (!image.isNull()) QMetaObject::invokeMethod(pyramidBuilder, "build", Qt::QueuedConnection, Q_ARG(int, generation), Q_ARG(QImage, image));
+
+    this->update();
+}
+
+void ImageBox::setComparison(QImage original, QImage compressed)
+{
+    comparisonOriginal = original;
+    comparisonCompressed = compressed;
+    this->update();
+}
+
+void ImageBox::clearComparison()
+{
+    if (comparisonOriginal.isNull()) return;
+    comparisonOriginal = QImage();
+    comparisonCompressed = QImage();
+    this->update();
+}
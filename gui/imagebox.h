@@ -0,0 +1,95 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef IMAGEBOX_H
+#define IMAGEBOX_H
+
+#include <QImage>
+#include <QThread>
+#include <QVector>
+#include <QWidget>
+
+#include <atomic>
+
+// Builds the downscaled levels of a preview pyramid, lives in the worker thread of ImageBox
+class PyramidBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    PyramidBuilder();
+
+    // the newest image, building of older pyramids is abandoned between levels
+    std::atomic<int> latestGeneration;
+
+public slots:
+    void build(int generation, QImage image);
+
+signals:
+    void built(int generation, QVector<QImage> levels);
+};
+
+// Preview of an image scaled to the widget keeping the aspect ratio.
+//
+// Scaling a large image on every repaint is slow, so setImage() starts building a pyramid of images
+// halved in both dimensions in a worker thread. The picture for the current widget size is scaled once
+// from the smallest level that is still larger than the widget and repaints only draw this cached picture.
+// Until the pyramid is ready a fast nearest neighbour scaling of the full image is shown.
+class ImageBox : public QWidget
+{
+    Q_OBJECT
+
+public:
+    ImageBox(QWidget *parent);
+    ~ImageBox();
+
+    QImage getImage();
+    void setImage(QImage image);
+
+    // shows a part of the image next to its compressed version instead of the whole image: the left half
+    // of the widget is taken from original and the right half from compressed, both have the same size
+    void setComparison(QImage original, QImage compressed);
+    void clearComparison();
+
+protected:
+    QImage image;
+    void paintEvent(QPaintEvent *event);
+
+private slots:
+    void setPyramid(int generation, QVector<QImage> levels);
+
+private:
+    const QImage &fittedImage(const QSize &size);
+
+    QVector<QImage> levels;    // from the largest to the smallest, all smaller than the image
+    int generation;
+
+    QImage cachedImage;
+    bool cachedFromPyramid;
+
+    QImage comparisonOriginal;
+    QImage comparisonCompressed;
+
+    QThread *pyramidThread;
+    PyramidBuilder *pyramidBuilder;
+};
+
+#endif // IMAGEBOX_H
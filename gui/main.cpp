@@ -17,14 +17,20 @@
 */
 
 
-#ifndef ENCODER_H
-#define ENCODER_H
+#include <QApplication>
+#include <QDesktopWidget>
 
-class Encoder
-{
-public:
-    static unsigned char *compressToJpeg(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size);
-    static unsigned char *compressToWebp(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size);
-};
+#include "mainwindow.h"
+#include "version.h"
 
-#endif // ENCODER_H
+int main(int argc, char *argv[])
+{
+    // console compression is provided by the separate Qt-free "acacia" executable
+    QApplication app(argc, argv);
+    MainWindow w;
+    w.setFixedSize(w.size());
+    w.move(QApplication::desktop()->screenGeometry().center() - w.rect().center());
+    w.setWindowTitle(QString("ACACIA v") + ACACIA_VERSION);
+    w.show();
+    return app.exec();
+}
@@ -25,7 +25,6 @@
 
 #include "math.h"
 
-#include "featureextractor.h"
 #include "optimizer.h"
 #include "encoder.h"
 
@@ -37,6 +36,12 @@ MainWindow::MainWindow(QWidget *parent) :
     imageBox = new ImageBox(ui->centralWidget);
     imageBox->setGeometry(QRect(10, 40, 530, 300));
 
+    // progress of the image analysis is shown over the bottom of the preview
+    analysisProgress = new QProgressBar(ui->centralWidget);
+    analysisProgress->setGeometry(QRect(10, 322, 530, 18));
+    analysisProgress->setRange(0, 100);
+    analysisProgress->hide();
+
     labelsList = new QLabel* [6];
     labelsList[0] = ui->labelSize_1;
     labelsList[1] = ui->labelSize_2;
@@ -64,10 +69,65 @@ MainWindow::MainWindow(QWidget *parent) :
 
     minDisplayMSSIM = 0.6;    // anything smaller is clipped to this value
     minImageMSSIM = 0;        // minimal estimated MSSIM for current image
+
+    // worker thread for decoding and feature extraction, results arrive through queued connections
+    qRegisterMetaType<QVector<double> >("QVector<double>");
+    analysisRequest = 0;
+    analysisThread = new QThread(this);
+    analyzer = new ImageAnalyzer();
+    analyzer->moveToThread(analysisThread);
+    connect(analyzer, SIGNAL(imageDecoded(int,QImage)), this, SLOT(onImageDecoded(int,QImage)));
+    connect(analyzer, SIGNAL(progressChanged(int,int)), this, SLOT(onAnalysisProgress(int,int)));
+    connect(analyzer, SIGNAL(analysisFinished(int,QImage,QVector<double>,qint64)), this, SLOT(onAnalysisFinished(int,QImage,QVector<double>,qint64)));
+    connect(analyzer, SIGNAL(analysisFailed(int,QString)), this, SLOT(onAnalysisFailed(int,QString)));
+    analysisThread->start();
+
+    // the preview is shown in the image box, the check box also displays the actual compressed size
+    checkPreview = new QCheckBox("Compressed preview", ui->centralWidget);
+    checkPreview->setGeometry(QRect(16, 46, 150, 20));
+    checkPreview->setAutoFillBackground(true);
+    connect(checkPreview, SIGNAL(toggled(bool)), this, SLOT(onPreviewToggled(bool)));
+
+    // dragging a slider changes QF many times per second, only the position where it stops is encoded
+    previewTimer = new QTimer(this);
+    previewTimer->setSingleShot(true);
+    previewTimer->setInterval(200);
+    connect(previewTimer, SIGNAL(timeout()), this, SLOT(startPreview()));
+
+    previewRequest = 0;
+    previewThread = new QThread(this);
+    previewEngine = new PreviewEngine();
+    previewEngine->moveToThread(previewThread);
+    connect(previewEngine, SIGNAL(previewReady(int,QImage,QImage,qulonglong,qint64)), this, SLOT(onPreviewReady(int,QImage,QImage,qulonglong,qint64)));
+    previewThread->start();
+
+    compressionThread = new QThread(this);
+    compressionQueue = new CompressionQueue();
+    compressionQueue->moveToThread(compressionThread);
+    connect(compressionQueue, SIGNAL(compressed(int,qulonglong,qint64)), this, SLOT(onImageCompressed(int,qulonglong,qint64)));
+    connect(compressionQueue, SIGNAL(saved(int,QString)), this, SLOT(onImageSaved(int,QString)));
+    connect(compressionQueue, SIGNAL(failed(int,QString)), this, SLOT(onCompressionFailed(int,QString)));
+    compressionThread->start();
 }
 
 MainWindow::~MainWindow()
 {
+    // a running analysis stops at its next progress report
+    analyzer->newRequest();
+    analysisThread->quit();
+    analysisThread->wait();
+    delete analyzer;
+
+    previewEngine->newRequest();
+    previewThread->quit();
+    previewThread->wait();
+    delete previewEngine;
+
+    // confirmed jobs are saved before exit
+    QMetaObject::invokeMethod(compressionQueue, "finish", Qt::QueuedConnection);
+    compressionThread->wait();
+    delete compressionQueue;
+
     delete ui;
     delete labelsList;
     delete inputVector;
@@ -134,6 +194,8 @@ void MainWindow::updateProcedure(int triggerId, int newQF)
         ui->spinBoxQF->setValue(newQF);
         moveQualitySlider(expectedYMSSIM);
     }
+
+    schedulePreview();
 }
 
 void MainWindow::moveQualitySlider(double expectedYMSSIM)
@@ -167,44 +229,130 @@ void MainWindow::on_btnOpenImage_clicked()
     dialog.setWindowTitle("Select image");
     if (!dialog.exec()) return;
 
-    // open image
+    // decoding and feature extraction continue in the background, an analysis of the previous image is cancelled
     QString imagePath = dialog.selectedFiles()[0];
-    inputImage = QImage(imagePath);
-    if (inputImage.isNull()) {
-        QMessageBox::warning(this, "Error", "Can't open selected file as image", QMessageBox::Ok);
-        return;
-    }
+    analysisRequest = analyzer->newRequest();
+    QMetaObject::invokeMethod(analyzer, "analyze", Qt::QueuedConnection, Q_ARG(int, analysisRequest), Q_ARG(QString, imagePath));
 
-    // image-related GUI update
+    // predictions are not available until the features are calculated
+    setPredictionControlsEnabled(false);
+    cancelPreview();
     ui->editImagePath->setText(imagePath);
-    imageBox->setImage(inputImage);
+    ui->editExtractionTime->clear();
     ui->editCompressionTime->clear();
+    analysisProgress->setValue(0);
+    analysisProgress->show();
+}
 
-    // check if image is not 24 bpp, e.g. grayscale, and convert it to 24 bpp
-    if (inputImage.format() != QImage::Format_RGB32) inputImage = inputImage.convertToFormat(QImage::Format_RGB32);
+void MainWindow::onImageDecoded(int request, QImage image)
+{
+    if (request != analysisRequest) return;
+    imageBox->setImage(image);
+}
 
-    // get uncompressed image data (each pixel has format xBGR)
-    const int w = inputImage.width();
-    const int h = inputImage.height();
-    const unsigned char *inputImageData = inputImage.constBits();
+void MainWindow::onAnalysisProgress(int request, int percent)
+{
+    if (request != analysisRequest) return;
+    analysisProgress->setValue(percent);
+}
 
-    // stage 1 - feature extraction
-    const unsigned long long int featureExtractionStartTime = QDateTime::currentMSecsSinceEpoch();
+void MainWindow::onAnalysisFinished(int request, QImage image, QVector<double> features, qint64 extractionTimeMs)
+{
+    if (request != analysisRequest) return;
+    analysisProgress->hide();
 
-    // actual function that calculated 10 image features from uncompressed data
-    FeatureExtractor::calculateFeatures((const unsigned int *) inputImageData, w, h, inputVector);
+    // image in 24 bpp format (each pixel has format xBGR) is kept for compression
+    inputImage = image;
+    inputImagePath = ui->editImagePath->text();
+    for (int i = 0;  i < 10;  i++) inputVector[i] = features[i];
 
     // calculate 11-th input (image size)
-    inputVector[10] = log(w * h / 1000000.0);
+    inputVector[10] = log(image.width() * image.height() / 1000000.0);
 
     // display feature extraction time
-    ui->editExtractionTime->setText(QString::number(QDateTime::currentMSecsSinceEpoch() - featureExtractionStartTime));
+    ui->editExtractionTime->setText(QString::number(extractionTimeMs));
 
     // before resetting QF to default value 75 we need to update file size scale
+    setPredictionControlsEnabled(true);
     updateSizeScale();
     resetQF();
 }
 
+void MainWindow::onAnalysisFailed(int request, QString path)
+{
+    if (request != analysisRequest) return;
+    analysisProgress->hide();
+
+    // the previous image stays active
+    ui->editImagePath->setText(inputImagePath);
+    imageBox->setImage(inputImage);
+    setPredictionControlsEnabled(true);
+    schedulePreview();
+    QMessageBox::warning(this, "Error", "Can't open \"" + path + "\" as image", QMessageBox::Ok);
+}
+
+void MainWindow::setPredictionControlsEnabled(bool enabled)
+{
+    ui->groupBoxQF->setEnabled(enabled);
+    ui->groupBoxQuality->setEnabled(enabled);
+    ui->groupBoxFileSize->setEnabled(enabled);
+    ui->btnCompress->setEnabled(enabled);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void MainWindow::schedulePreview()
+{
+    if (!checkPreview->isChecked() || inputImage.isNull()) return;
+
+    // results of the previous quality factor are outdated, the timer is restarted by every change
+    previewRequest = previewEngine->newRequest();
+    previewTimer->start();
+}
+
+void MainWindow::cancelPreview()
+{
+    previewRequest = previewEngine->newRequest();
+    previewTimer->stop();
+    imageBox->clearComparison();
+    checkPreview->setText("Compressed preview");
+    checkPreview->adjustSize();
+}
+
+void MainWindow::startPreview()
+{
+    if (!checkPreview->isChecked() || inputImage.isNull()) return;
+
+    // a large image is represented by its central part at 1:1 scale, which is the size of the image box,
+    // so the encoding time doesn't depend on the image size and compression artifacts are visible
+    const int w = qMin(inputImage.width(), imageBox->width());
+    const int h = qMin(inputImage.height(), imageBox->height());
+    const QImage part = inputImage.copy((inputImage.width() - w) / 2, (inputImage.height() - h) / 2, w, h);
+
+    previewRequest = previewEngine->newRequest();
+    QMetaObject::invokeMethod(previewEngine, "encode", Qt::QueuedConnection, Q_ARG(int, previewRequest), Q_ARG(QImage, part),
+                              Q_ARG(bool, isjpeg), Q_ARG(int, ui->spinBoxQF->value()));
+}
+
+void MainWindow::onPreviewToggled(bool checked)
+{
+    if (checked) schedulePreview();
+    else cancelPreview();
+}
+
+void MainWindow::onPreviewReady(int request, QImage original, QImage compressed, qulonglong compressedSize, qint64 compressionTimeMs)
+{
+    if (request != previewRequest) return;
+    imageBox->setComparison(original, compressed);
+
+    // the size of a cut part is not comparable with the predicted file size, so it's marked
+    const bool isWholeImage = (original.size() == inputImage.size());
+    checkPreview->setText("Compressed preview: " + formatFileSize((unsigned int) compressedSize) +
+                          (isWholeImage ? "" : QString(" for %1x%2 part").arg(original.width()).arg(original.height())) +
+                          QString(", %1 ms").arg(compressionTimeMs));
+    checkPreview->adjustSize();
+}
+
 void MainWindow::updateSizeScale()
 {
     // min and max estimated file size
@@ -319,22 +467,13 @@ void MainWindow::on_btnCompress_clicked()
     if (inputImage.isNull()) return;
 
     // in this function we don't need to do any predictions,
-    // only compress an image with a QF, which was previously determined
-
-    const int w = inputImage.width();
-    const int h = inputImage.height();
-    const unsigned char *inputImageData = inputImage.constBits();
-
-    const int qualityFactor = ui->spinBoxQF->value();
-
-    const unsigned long long int compressionStartTime = QDateTime::currentMSecsSinceEpoch();
-
-    unsigned long long int compressedBufferSize = 0;
-    const unsigned char *compressedImageBuffer = isjpeg ? Encoder::compressToJpeg(inputImageData, w, h, qualityFactor, &compressedBufferSize) :
-                                                          Encoder::compressToWebp(inputImageData, w, h, qualityFactor, &compressedBufferSize);
-
-    // display compression time
-    ui->editExtractionTime->setText(QString::number(QDateTime::currentMSecsSinceEpoch() - compressionStartTime));
+    // only compress an image with a QF, which was previously determined;
+    // the encoder runs in the background while the user chooses the file name
+    const int job = compressionQueue->newJob();
+    QMetaObject::invokeMethod(compressionQueue, "compress", Qt::QueuedConnection, Q_ARG(int, job), Q_ARG(QImage, inputImage),
+                              Q_ARG(bool, isjpeg), Q_ARG(int, ui->spinBoxQF->value()));
+    pendingJobs.insert(job);
+    updateCompressButton();
 
     // open dialog to save compressed image
     QString suffix = isjpeg ? "jpg" : "webp";
@@ -344,16 +483,40 @@ void MainWindow::on_btnCompress_clicked()
     dialog.setDefaultSuffix(suffix);
     dialog.setNameFilter(isjpeg ? "JPEG images (*.jpg)" : "WebP images (*.webp)");
     dialog.setWindowTitle("Save image");
-    if (!dialog.exec()) return;
+    if (!dialog.exec()) {
+        compressionQueue->cancel(job);
+        pendingJobs.remove(job);
+        updateCompressButton();
+        return;
+    }
 
     QString filePath = dialog.selectedFiles()[0];
     if (!filePath.endsWith("." + suffix)) filePath += "." + suffix;
 
-    // save compressed image to file
-    QFile f(filePath);
-    if (!f.open(QFile::WriteOnly)) return;
-    f.write((const char *) compressedImageBuffer, compressedBufferSize);
-    f.close();
+    // the file is written as soon as both the compressed data and the name are available
+    QMetaObject::invokeMethod(compressionQueue, "setDestination", Qt::QueuedConnection, Q_ARG(int, job), Q_ARG(QString, filePath));
+}
+
+void MainWindow::onImageCompressed(int, qulonglong, qint64 compressionTimeMs)
+{
+    // display compression time
+    ui->editCompressionTime->setText(QString::number(compressionTimeMs));
+}
 
-    delete [] compressedImageBuffer;
+void MainWindow::onImageSaved(int job, QString)
+{
+    pendingJobs.remove(job);
+    updateCompressButton();
+}
+
+void MainWindow::onCompressionFailed(int job, QString message)
+{
+    pendingJobs.remove(job);
+    updateCompressButton();
+    QMessageBox::warning(this, "Error", message, QMessageBox::Ok);
+}
+
+void MainWindow::updateCompressButton()
+{
+    ui->btnCompress->setText(pendingJobs.isEmpty() ? QString("Compress!") : QString("Compress! (%1 in progress)").arg(pendingJobs.size()));
 }
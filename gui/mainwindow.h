@@ -21,8 +21,16 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QCheckBox>
 #include <QLabel>
+#include <QProgressBar>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
 #include "imagebox.h"
+#include "imageanalyzer.h"
+#include "previewengine.h"
+#include "compressionqueue.h"
 
 namespace Ui {
 class MainWindow;
@@ -39,9 +47,29 @@ public:
 private slots:
     void on_btnOpenImage_clicked();
 
+    // results of the background analysis
+    void onImageDecoded(int request, QImage image);
+    void onAnalysisProgress(int request, int percent);
+    void onAnalysisFinished(int request, QImage image, QVector<double> features, qint64 extractionTimeMs);
+    void onAnalysisFailed(int request, QString path);
+
+    // compressed preview with the current quality factor
+    void onPreviewToggled(bool checked);
+    void startPreview();
+    void onPreviewReady(int request, QImage original, QImage compressed, qulonglong compressedSize, qint64 compressionTimeMs);
+
+    // results of the compression queue
+    void onImageCompressed(int job, qulonglong compressedSize, qint64 compressionTimeMs);
+    void onImageSaved(int job, QString path);
+    void onCompressionFailed(int job, QString message);
+
 private:
     void updateSizeScale();
     void resetQF();
+    void setPredictionControlsEnabled(bool enabled);
+    void schedulePreview();
+    void cancelPreview();
+    void updateCompressButton();
 
 private slots:
     void on_spinBoxQF_valueChanged(int qualityFactor);
@@ -63,6 +91,26 @@ private:
     QLabel **labelsList;
 
     QImage inputImage;
+    QString inputImagePath;
+
+    // decoding and feature extraction run in analysisThread, analysisRequest is the latest request
+    QThread *analysisThread;
+    ImageAnalyzer *analyzer;
+    int analysisRequest;
+    QProgressBar *analysisProgress;
+
+    // preview encoding runs in previewThread after the quality factor stays unchanged for a while
+    QThread *previewThread;
+    PreviewEngine *previewEngine;
+    int previewRequest;
+    QTimer *previewTimer;
+    QCheckBox *checkPreview;
+
+    // compression and saving run in compressionThread, pendingJobs are not saved yet
+    QThread *compressionThread;
+    CompressionQueue *compressionQueue;
+    QSet<int> pendingJobs;
+
     bool isjpeg;
     int numPositions;
 
@@ -0,0 +1,66 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "previewengine.h"
+
+#include <QDateTime>
+
+#include <cstring>
+
+#include "encoder.h"
+#include "decoder.h"
+
+PreviewEngine::PreviewEngine() : currentRequest(0) {}
+
+int PreviewEngine::newRequest()
+{
+    return ++currentRequest;
+}
+
+void PreviewEngine::encode(int request, QImage image, bool isjpeg, int qualityFactor)
+{
+    // while the user drags a slider only the last position matters
+    if (request != currentRequest.load()) return;
+
+    const int w = image.width();
+    const int h = image.height();
+    const qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+
+    // the encoder expects rows without padding, which RGB32 images always have
+    unsigned long long int compressedSize = 0;
+    unsigned char *compressedBuffer = isjpeg ? Encoder::compressToJpeg(image.constBits(), w, h, qualityFactor, &compressedSize) :
+                                               Encoder::compressToWebp(image.constBits(), w, h, qualityFactor, &compressedSize);
+    if (!compressedBuffer) return;
+    const qint64 compressionTime = QDateTime::currentMSecsSinceEpoch() - startTime;
+
+    int decodedWidth = 0, decodedHeight = 0;
+    unsigned int *decodedData = isjpeg ? Decoder::decompressJpeg(compressedBuffer, compressedSize, &decodedWidth, &decodedHeight) :
+                                         Decoder::decompressWebp(compressedBuffer, compressedSize, &decodedWidth, &decodedHeight);
+    Encoder::freeBuffer(compressedBuffer);
+    if (!decodedData) return;
+
+    QImage decoded (decodedWidth, decodedHeight, QImage::Format_RGB32);
+    for (int y = 0;  y < decodedHeight;  y++) memcpy(decoded.scanLine(y), decodedData + (size_t) y * decodedWidth, decodedWidth * 4);
+    delete [] decodedData;
+
+    if (request != currentRequest.load()) return;
+    emit previewReady(request, image, decoded, compressedSize, compressionTime);
+}
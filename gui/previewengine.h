@@ -0,0 +1,54 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef PREVIEWENGINE_H
+#define PREVIEWENGINE_H
+
+#include <QObject>
+#include <QImage>
+
+#include <atomic>
+
+// Encodes and decodes preview images in a worker thread, the same way as ImageAnalyzer:
+// encode() is invoked through a queued connection with a number from newRequest(), newer requests
+// make the queued ones obsolete and results are delivered with the request number.
+class PreviewEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    PreviewEngine();
+
+    int newRequest();
+
+public slots:
+    // image must be in RGB32 format
+    void encode(int request, QImage image, bool isjpeg, int qualityFactor);
+
+signals:
+    // the original image, its decoded compressed version and the compressed size
+    void previewReady(int request, QImage original, QImage compressed, qulonglong compressedSize, qint64 compressionTimeMs);
+
+private:
+    std::atomic<int> currentRequest;
+};
+
+#endif // PREVIEWENGINE_H
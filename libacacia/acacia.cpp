@@ -0,0 +1,368 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "acacia.h"
+
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "math.h"
+
+#include "featureextractor.h"
+#include "sequenceanalyzer.h"
+#include "optimizer.h"
+#include "calibration.h"
+#include "modelset.h"
+#include "encoder.h"
+#include "yuvimage.h"
+#include "version.h"
+
+// MLP input vector: 10 content features, image size and quality factor (in this order)
+static const int inputVectorSize = 12;
+
+struct acacia_session
+{
+    // analyzed image, owned by the caller
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int stride;
+
+    // analyzed YUV frame, used instead of the above if isYuv
+    YuvImage yuv;
+    bool isYuv;
+
+    bool analyzed;
+    double inputVector [inputVectorSize];
+
+    // fragments of the previous frame of acacia_analyze_frame(), allocated with the first frame
+    SequenceAnalyzer *sequence;
+};
+
+// callback adapter for EncoderSink
+struct CallbackContext
+{
+    acacia_write_function write;
+    void *context;
+};
+
+static bool callbackWrite(void *context, const unsigned char *data, unsigned long long int size)
+{
+    const CallbackContext *callback = (const CallbackContext *) context;
+    return callback->write(callback->context, data, (size_t) size) != 0;
+}
+
+// the actual size corrects later predictions if a calibration is loaded (acacia_load_calibration())
+static void recordFileSize(const acacia_session *session, acacia_format format, int quality, unsigned long long int size)
+{
+    double inputVector [inputVectorSize];
+    for (int i = 0;  i < inputVectorSize - 1;  i++) inputVector[i] = session->inputVector[i];
+    inputVector[11] = quality;
+    Optimizer::recordResult(format == ACACIA_FORMAT_JPEG, 's', inputVector, (double) size, InferenceFast);
+}
+
+static acacia_status encode(acacia_session *session, acacia_format format, int quality, EncoderSink *sink)
+{
+    if (!session || (format != ACACIA_FORMAT_JPEG && format != ACACIA_FORMAT_WEBP) || quality < 0 || quality > 100) return ACACIA_ERROR_INVALID_ARGUMENT;
+    if (!session->analyzed) return ACACIA_ERROR_NOT_ANALYZED;
+
+    EncoderResult result;
+    if (session->isYuv) {
+        result = (format == ACACIA_FORMAT_JPEG) ? Encoder::compressYuvToJpeg(session->yuv, quality, sink) :
+                                                  Encoder::compressYuvToWebp(session->yuv, quality, sink);
+    } else {
+        result = (format == ACACIA_FORMAT_JPEG) ?
+                    Encoder::compressToJpeg(session->pixels, session->width, session->height, session->stride, quality, sink) :
+                    Encoder::compressToWebp(session->pixels, session->width, session->height, session->stride, quality, sink);
+    }
+
+    switch (result) {
+    case EncoderOk:
+        recordFileSize(session, format, quality, sink->size);
+        return ACACIA_OK;
+    case EncoderBufferTooSmall:
+        return ACACIA_ERROR_BUFFER_TOO_SMALL;
+    case EncoderWriteFailed:
+        return ACACIA_ERROR_WRITE_FAILED;
+    default:
+        return ACACIA_ERROR_ENCODING_FAILED;
+    }
+}
+
+extern "C" {
+
+int acacia_api_version(void)
+{
+    return ACACIA_API_VERSION;
+}
+
+const char *acacia_version_string(void)
+{
+    return ACACIA_VERSION;
+}
+
+const char *acacia_status_string(acacia_status status)
+{
+    switch (status) {
+    case ACACIA_OK:                      return "ok";
+    case ACACIA_ERROR_INVALID_ARGUMENT:  return "invalid argument";
+    case ACACIA_ERROR_VERSION_MISMATCH:  return "API version mismatch";
+    case ACACIA_ERROR_OUT_OF_MEMORY:     return "out of memory";
+    case ACACIA_ERROR_NOT_ANALYZED:      return "image is not analyzed";
+    case ACACIA_ERROR_IMAGE_TOO_SMALL:   return "image is smaller than 8x8 pixels";
+    case ACACIA_ERROR_BUFFER_TOO_SMALL:  return "output buffer is too small";
+    case ACACIA_ERROR_WRITE_FAILED:      return "write callback failed";
+    case ACACIA_ERROR_ENCODING_FAILED:   return "encoding failed";
+    case ACACIA_ERROR_MODEL_FILE:        return "invalid model file";
+    case ACACIA_ERROR_CALIBRATION_FILE:  return "calibration file can't be read or written";
+    }
+    return "unknown status";
+}
+
+acacia_status acacia_load_models(const char *path)
+{
+    if (!path) {
+        Optimizer::setModelSet(nullptr);
+        return ACACIA_OK;
+    }
+
+    std::shared_ptr<const ModelSet> models = ModelSet::load(path);
+    if (!models) return ACACIA_ERROR_MODEL_FILE;
+    Optimizer::setModelSet(models);
+    return ACACIA_OK;
+}
+
+acacia_status acacia_load_calibration(const char *path)
+{
+    if (!path) {
+        Optimizer::setCalibration(nullptr);
+        return ACACIA_OK;
+    }
+
+    std::shared_ptr<Calibration> calibration (new (std::nothrow) Calibration());
+    if (!calibration) return ACACIA_ERROR_OUT_OF_MEMORY;
+
+    // a missing file is created by acacia_save_calibration(), an invalid one is an error
+    FILE *existing = fopen(path, "r");
+    if (existing) {
+        fclose(existing);
+        if (!calibration->load(path)) return ACACIA_ERROR_CALIBRATION_FILE;
+    }
+    Optimizer::setCalibration(calibration);
+    return ACACIA_OK;
+}
+
+acacia_status acacia_save_calibration(const char *path)
+{
+    std::shared_ptr<Calibration> calibration = Optimizer::calibration();
+    if (!path || !calibration) return ACACIA_ERROR_INVALID_ARGUMENT;
+    return calibration->save(path) ? ACACIA_OK : ACACIA_ERROR_CALIBRATION_FILE;
+}
+
+acacia_status acacia_session_create(int api_version, acacia_session **session)
+{
+    if (!session) return ACACIA_ERROR_INVALID_ARGUMENT;
+    *session = nullptr;
+    if (api_version != ACACIA_API_VERSION) return ACACIA_ERROR_VERSION_MISMATCH;
+
+    acacia_session *result = new (std::nothrow) acacia_session();
+    if (!result) return ACACIA_ERROR_OUT_OF_MEMORY;
+
+    result->analyzed = false;
+    result->isYuv = false;
+    result->sequence = nullptr;
+    *session = result;
+    return ACACIA_OK;
+}
+
+void acacia_session_destroy(acacia_session *session)
+{
+    if (session) delete session->sequence;
+    delete session;
+}
+
+// Rows of rowBytes with stride bytes between them; the sizes are calculated in 64 bits, so very wide images can't
+// overflow into a stride that is too small, and the whole plane must fit into the address space.
+static bool validPlane(long long int rowBytes, int stride, int height)
+{
+    return stride >= rowBytes && (unsigned long long int) stride * (unsigned long long int) height <= SIZE_MAX;
+}
+
+static acacia_status analyzeImage(acacia_session *session, const void *pixels, int width, int height, int stride, bool isFrame)
+{
+    if (!session || !pixels || width <= 0 || height <= 0 || stride % 4 != 0 || !validPlane((long long int) width * 4, stride, height)) {
+        return ACACIA_ERROR_INVALID_ARGUMENT;
+    }
+    session->analyzed = false;
+
+    // features are averaged over 8x8 fragments
+    if (width < 8 || height < 8) return ACACIA_ERROR_IMAGE_TOO_SMALL;
+
+    session->pixels = (const unsigned char *) pixels;
+    session->width = width;
+    session->height = height;
+    session->stride = stride;
+    session->isYuv = false;
+
+    if (!isFrame) {
+        FeatureExtractor::calculateFeatures((const unsigned int *) pixels, width, height, stride / 4, session->inputVector);
+    } else {
+        if (!session->sequence) session->sequence = new (std::nothrow) SequenceAnalyzer();
+        if (!session->sequence) return ACACIA_ERROR_OUT_OF_MEMORY;
+
+        // the fragments are reallocated when the size changes; a failed analyzer is replaced by a new one next time
+        try {
+            session->sequence->analyzeFrame((const unsigned int *) pixels, width, height, stride / 4, session->inputVector);
+        } catch (const std::bad_alloc &) {
+            delete session->sequence;
+            session->sequence = nullptr;
+            return ACACIA_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    session->inputVector[10] = log(width * (double) height / 1000000.0);
+
+    session->analyzed = true;
+    return ACACIA_OK;
+}
+
+acacia_status acacia_analyze(acacia_session *session, const void *pixels, int width, int height, int stride)
+{
+    return analyzeImage(session, pixels, width, height, stride, false);
+}
+
+acacia_status acacia_analyze_frame(acacia_session *session, const void *pixels, int width, int height, int stride)
+{
+    return analyzeImage(session, pixels, width, height, stride, true);
+}
+
+acacia_status acacia_analyze_yuv(acacia_session *session, acacia_yuv_layout layout, const void *y, int y_stride,
+                                 const void *u, const void *v, int uv_stride, int width, int height, int full_range)
+{
+    if (!session || !y || width <= 0 || height <= 0 || !validPlane(width, y_stride, height)) return ACACIA_ERROR_INVALID_ARGUMENT;
+    session->analyzed = false;
+
+    YuvImage image;
+    image.y = (const unsigned char *) y;
+    image.yStride = y_stride;
+    image.uvStride = uv_stride;
+    image.width = width;
+    image.height = height;
+    image.fullRange = full_range != 0;
+    image.padded = false;
+
+    switch (layout) {
+    case ACACIA_YUV_I420:
+        image.u = (const unsigned char *) u;
+        image.v = (const unsigned char *) v;
+        image.uvStep = 1;
+        break;
+    case ACACIA_YUV_NV12:
+        image.u = (const unsigned char *) u;
+        image.v = image.u + 1;
+        image.uvStep = 2;
+        break;
+    case ACACIA_YUV_NV21:
+        image.v = (const unsigned char *) v;
+        image.u = image.v + 1;
+        image.uvStep = 2;
+        break;
+    default:
+        return ACACIA_ERROR_INVALID_ARGUMENT;
+    }
+    const long long int chromaWidth = ((long long int) width + 1) / 2;
+    if (!image.u || !image.v || !validPlane(chromaWidth * image.uvStep, uv_stride, height / 2 + height % 2)) return ACACIA_ERROR_INVALID_ARGUMENT;
+
+    if (width < 8 || height < 8) return ACACIA_ERROR_IMAGE_TOO_SMALL;
+
+    session->yuv = image;
+    session->isYuv = true;
+    session->width = width;
+    session->height = height;
+
+    FeatureExtractor::calculateYuvFeatures(image, session->inputVector, nullptr);
+    session->inputVector[10] = log(width * (double) height / 1000000.0);
+
+    session->analyzed = true;
+    return ACACIA_OK;
+}
+
+acacia_status acacia_predict(acacia_session *session, acacia_format format, int quality, double *file_size, double *y_mssim, double *y_psnr)
+{
+    if (!session || (format != ACACIA_FORMAT_JPEG && format != ACACIA_FORMAT_WEBP) || quality < 0 || quality > 100) return ACACIA_ERROR_INVALID_ARGUMENT;
+    if (!session->analyzed) return ACACIA_ERROR_NOT_ANALYZED;
+
+    // the session's vector is not modified, so predictions don't depend on previous calls
+    double inputVector [inputVectorSize];
+    for (int i = 0;  i < inputVectorSize - 1;  i++) inputVector[i] = session->inputVector[i];
+    inputVector[11] = quality;
+
+    const bool isjpeg = (format == ACACIA_FORMAT_JPEG);
+    if (file_size) *file_size = Optimizer::estimateFileSize(isjpeg, inputVector, InferenceFast);
+    if (y_mssim) *y_mssim = Optimizer::estimateYMSSIM(isjpeg, inputVector, InferenceFast);
+    if (y_psnr) *y_psnr = Optimizer::estimateYPSNR(isjpeg, inputVector, InferenceFast);
+    return ACACIA_OK;
+}
+
+acacia_status acacia_choose_quality(acacia_session *session, acacia_format format, acacia_target target, double target_value, int *quality)
+{
+    if (!session || !quality || (format != ACACIA_FORMAT_JPEG && format != ACACIA_FORMAT_WEBP)) return ACACIA_ERROR_INVALID_ARGUMENT;
+    if (!session->analyzed) return ACACIA_ERROR_NOT_ANALYZED;
+
+    char targetObjective;
+    switch (target) {
+    case ACACIA_TARGET_SIZE:
+        targetObjective = 's';
+        break;
+    case ACACIA_TARGET_MSSIM:
+        targetObjective = 'm';
+        break;
+    case ACACIA_TARGET_PSNR:
+        targetObjective = 'p';
+        break;
+    default:
+        return ACACIA_ERROR_INVALID_ARGUMENT;
+    }
+
+    *quality = Optimizer::findQualityFactor(format == ACACIA_FORMAT_JPEG, targetObjective, target_value, session->inputVector, InferenceFast);
+    return ACACIA_OK;
+}
+
+acacia_status acacia_encode(acacia_session *session, acacia_format format, int quality, unsigned char *buffer, size_t capacity, size_t *size)
+{
+    if (!size || (!buffer && capacity > 0)) return ACACIA_ERROR_INVALID_ARGUMENT;
+
+    EncoderSink sink = {buffer, capacity, nullptr, nullptr, 0};
+    const acacia_status status = encode(session, format, quality, &sink);
+    *size = (size_t) sink.size;
+    return status;
+}
+
+acacia_status acacia_encode_to_callback(acacia_session *session, acacia_format format, int quality, acacia_write_function write, void *context, size_t *size)
+{
+    if (!write) return ACACIA_ERROR_INVALID_ARGUMENT;
+
+    CallbackContext callback = {write, context};
+    EncoderSink sink = {nullptr, 0, callbackWrite, &callback, 0};
+    const acacia_status status = encode(session, format, quality, &sink);
+    if (size) *size = (size_t) sink.size;
+    return status;
+}
+
+}    // extern "C"
@@ -0,0 +1,163 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ACACIA_H
+#define ACACIA_H
+
+/*
+    C interface of the ACACIA library for embedding into other programs.
+
+    Typical use in a worker thread:
+
+        acacia_session *session;
+        acacia_session_create(ACACIA_API_VERSION, &session);    // once per worker
+
+        acacia_analyze(session, pixels, width, height, stride);
+        acacia_choose_quality(session, ACACIA_FORMAT_JPEG, ACACIA_TARGET_SIZE, 50000, &quality);
+        acacia_encode(session, ACACIA_FORMAT_JPEG, quality, buffer, capacity, &size);
+
+        acacia_session_destroy(session);
+
+    Pixels are 32-bit xRGB in native (little endian) byte order, i.e. bytes B, G, R, x; stride is the distance
+    between rows in bytes, at least 4 * width and a multiple of 4. The session keeps a pointer to the analyzed
+    image, so it must stay valid until the last acacia_encode() call.
+
+    Thread safety: a session must not be used by several threads at the same time, different sessions are
+    otherwise independent. The process has two global states shared by all sessions: the regression models,
+    which can be replaced with acacia_load_models() at any time, and the online calibration of the predictions
+    (acacia_load_calibration()), which every successful acacia_encode() updates with the actual file size.
+
+    Predictions use the single precision models (see mlpmodel.h), they differ from the double precision
+    results of the command line tool by less than 0.1% of the file size.
+
+    Memory: only acacia_session_create(), acacia_load_models() and acacia_load_calibration() allocate memory, and
+    acacia_analyze_frame() for the state of its sequence when the frame size changes. Analysis, prediction and
+    the quality factor search work on the stack; encoding writes directly into the caller's buffer or callback,
+    only the codec libraries allocate their internal working memory.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* incremented on incompatible changes of this interface */
+#define ACACIA_API_VERSION 1
+
+typedef struct acacia_session acacia_session;
+
+typedef enum acacia_status
+{
+    ACACIA_OK = 0,
+    ACACIA_ERROR_INVALID_ARGUMENT,
+    ACACIA_ERROR_VERSION_MISMATCH,
+    ACACIA_ERROR_OUT_OF_MEMORY,
+    ACACIA_ERROR_NOT_ANALYZED,         /* acacia_analyze() was not called for the session */
+    ACACIA_ERROR_IMAGE_TOO_SMALL,      /* features need at least one 8x8 fragment */
+    ACACIA_ERROR_BUFFER_TOO_SMALL,     /* the required size is returned, the call can be repeated */
+    ACACIA_ERROR_WRITE_FAILED,         /* the write callback returned 0 */
+    ACACIA_ERROR_ENCODING_FAILED,
+    ACACIA_ERROR_MODEL_FILE,           /* the model file can't be read or is invalid, details are printed to stderr */
+    ACACIA_ERROR_CALIBRATION_FILE      /* the calibration file can't be read or written or is invalid, details are printed to stderr */
+} acacia_status;
+
+typedef enum acacia_format
+{
+    ACACIA_FORMAT_JPEG = 0,
+    ACACIA_FORMAT_WEBP
+} acacia_format;
+
+typedef enum acacia_target
+{
+    ACACIA_TARGET_SIZE = 0,    /* file size in bytes */
+    ACACIA_TARGET_MSSIM,       /* mean SSIM of the luminance channel */
+    ACACIA_TARGET_PSNR         /* PSNR of the luminance channel */
+} acacia_target;
+
+/* planar YUV 4:2:0 layouts of acacia_analyze_yuv() */
+typedef enum acacia_yuv_layout
+{
+    ACACIA_YUV_I420 = 0,    /* Y plane, U plane, V plane */
+    ACACIA_YUV_NV12,        /* Y plane, interleaved UV plane (u points to it, v is ignored) */
+    ACACIA_YUV_NV21         /* Y plane, interleaved VU plane (v points to it, u is ignored) */
+} acacia_yuv_layout;
+
+/* receives compressed data in chunks; returns non-zero to continue, 0 to abort encoding */
+typedef int (*acacia_write_function)(void *context, const unsigned char *data, size_t size);
+
+/* ACACIA_API_VERSION the library was built with */
+int acacia_api_version(void);
+
+/* version of the library, e.g. "0.17" */
+const char *acacia_version_string(void);
+
+const char *acacia_status_string(acacia_status status);
+
+/* Replaces the regression models of the whole process with a binary model file (see modelset.h), NULL restores
+   the built-in models. The file is memory-mapped and shared by all processes using it; calls running
+   in other threads finish with the previous models. */
+acacia_status acacia_load_models(const char *path);
+
+/* Turns on the correction of all predictions of the process by the actual sizes of the images compressed
+   with acacia_encode() and acacia_encode_to_callback() (see calibration.h) and loads its state from a file;
+   a missing file starts without correction, NULL turns the calibration off. */
+acacia_status acacia_load_calibration(const char *path);
+
+/* writes the state of the calibration turned on by acacia_load_calibration(), e.g. before the process exits,
+   so it accumulates over runs */
+acacia_status acacia_save_calibration(const char *path);
+
+/* api_version must be ACACIA_API_VERSION of the header used by the caller */
+acacia_status acacia_session_create(int api_version, acacia_session **session);
+void acacia_session_destroy(acacia_session *session);
+
+/* calculates image features; the result is kept in the session for the calls below */
+acacia_status acacia_analyze(acacia_session *session, const void *pixels, int width, int height, int stride);
+
+/* the same for the next frame of a sequence of similar images, e.g. a burst of photos or an animation: the session
+   keeps the contribution of every 8x8 fragment, so only the fragments which changed since the previous frame are
+   calculated again; the features are the same as from acacia_analyze(). A frame of another size starts a new
+   sequence, calls of acacia_analyze() or acacia_analyze_yuv() in between don't interrupt it. */
+acacia_status acacia_analyze_frame(acacia_session *session, const void *pixels, int width, int height, int stride);
+
+/* the same for a YUV 4:2:0 frame, e.g. from a video decoder or a camera, without conversion to xRGB; strides are in bytes,
+   full_range is non-zero for the 0..255 range of JPEG and 0 for the 16..235 video range (BT.601 in both cases);
+   the planes must stay valid until the last acacia_encode() call, which encodes the frame directly */
+acacia_status acacia_analyze_yuv(acacia_session *session, acacia_yuv_layout layout, const void *y, int y_stride,
+                                 const void *u, const void *v, int uv_stride, int width, int height, int full_range);
+
+/* predicted properties of the analyzed image compressed with a quality factor; any output pointer may be NULL */
+acacia_status acacia_predict(acacia_session *session, acacia_format format, int quality, double *file_size, double *y_mssim, double *y_psnr);
+
+/* quality factor whose predicted value is the closest to the target */
+acacia_status acacia_choose_quality(acacia_session *session, acacia_format format, acacia_target target, double target_value, int *quality);
+
+/* compresses the analyzed image into the caller's buffer; size receives the compressed size,
+   also with ACACIA_ERROR_BUFFER_TOO_SMALL; the size of a successful encode updates the calibration if it is on */
+acacia_status acacia_encode(acacia_session *session, acacia_format format, int quality, unsigned char *buffer, size_t capacity, size_t *size);
+
+/* compresses the analyzed image passing the data to a callback; size may be NULL */
+acacia_status acacia_encode_to_callback(acacia_session *session, acacia_format format, int quality, acacia_write_function write, void *context, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACACIA_H */
@@ -0,0 +1,453 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "archive.h"
+#include "profiler.h"
+
+#include <new>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+static const int tarBlockSize = 512;
+
+// standard streams are opened in text mode on Windows
+static FILE *openStream(const char *path, bool write, bool *ownsFile)
+{
+    *ownsFile = strcmp(path, "-") != 0;
+    if (*ownsFile) return fopen(path, write ? "wb" : "rb");
+#ifdef _WIN32
+    _setmode(_fileno(write ? stdout : stdin), _O_BINARY);
+#endif
+    return write ? stdout : stdin;
+}
+
+static unsigned long long int readLittleEndian(const unsigned char *data, int bytes)
+{
+    unsigned long long int value = 0;
+    for (int i = bytes - 1;  i >= 0;  i--) value = (value << 8) | data[i];
+    return value;
+}
+
+static void writeLittleEndian(unsigned char *data, unsigned long long int value, int bytes)
+{
+    for (int i = 0;  i < bytes;  i++) data[i] = (unsigned char) (value >> (8 * i));
+}
+
+// numeric fields are octal, optionally terminated by a space or NUL; GNU tar stores large values in base 256
+static unsigned long long int readTarNumber(const unsigned char *field, int length)
+{
+    unsigned long long int value = 0;
+    if (field[0] & 0x80) {
+        value = field[0] & 0x7f;
+        for (int i = 1;  i < length;  i++) value = (value << 8) | field[i];
+        return value;
+    }
+    for (int i = 0;  i < length && field[i] != 0;  i++) {
+        if (field[i] >= '0' && field[i] <= '7') value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+// the checksum is the sum of the header bytes with the checksum field read as spaces
+static unsigned int tarChecksum(const unsigned char *header)
+{
+    unsigned int sum = 0;
+    for (int i = 0;  i < tarBlockSize;  i++) sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    return sum;
+}
+
+static bool isTarHeader(const unsigned char *header)
+{
+    return readTarNumber(header + 148, 8) == tarChecksum(header);
+}
+
+// a string field, which is NUL-terminated only if it's shorter than the field
+static std::string tarString(const unsigned char *field, int length)
+{
+    int size = 0;
+    while (size < length && field[size] != 0) size++;
+    return std::string((const char *) field, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------------------------------------------------
+
+ArchiveReader::ArchiveReader() :
+    f(nullptr),
+    ownsFile(false),
+    archiveFormat(ArchiveTar),
+    error(false),
+    firstBlockSize(0),
+    firstBlockPosition(0)
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    if (f && ownsFile) fclose(f);
+}
+
+bool ArchiveReader::open(const char *path)
+{
+    f = openStream(path, false, &ownsFile);
+    if (!f) return false;
+
+    // a stream can't be rewound, so the first block is kept; an empty input is an empty tar
+    firstBlockSize = fread(firstBlock, 1, tarBlockSize, f);
+    firstBlockPosition = 0;
+    archiveFormat = (firstBlockSize == 0 || (firstBlockSize == tarBlockSize && isTarHeader(firstBlock))) ? ArchiveTar : ArchiveLengthPrefixed;
+    return true;
+}
+
+ArchiveFormat ArchiveReader::format() const
+{
+    return archiveFormat;
+}
+
+bool ArchiveReader::failed() const
+{
+    return error;
+}
+
+bool ArchiveReader::read(unsigned char *out, unsigned long long int size)
+{
+    const unsigned long long int buffered = firstBlockSize - firstBlockPosition < size ? firstBlockSize - firstBlockPosition : size;
+    memcpy(out, firstBlock + firstBlockPosition, buffered);
+    firstBlockPosition += buffered;
+    return buffered == size || fread(out + buffered, 1, size - buffered, f) == size - buffered;
+}
+
+bool ArchiveReader::skip(unsigned long long int size)
+{
+    unsigned char buffer [4096];
+    while (size > 0)
+    {
+        const unsigned long long int part = size < sizeof(buffer) ? size : sizeof(buffer);
+        if (!read(buffer, part)) return false;
+        size -= part;
+    }
+    return true;
+}
+
+unsigned char *ArchiveReader::readData(unsigned long long int size)
+{
+    // at least one byte, so an empty file is not taken for the end
+    unsigned char *data = new (std::nothrow) unsigned char [size > 0 ? size : 1];
+    if (!data || !read(data, size)) {
+        delete [] data;
+        return nullptr;
+    }
+    return data;
+}
+
+unsigned char *ArchiveReader::next(std::string *name, unsigned long long int *size)
+{
+    if (error || !f) return nullptr;
+    unsigned char *data = (archiveFormat == ArchiveTar) ? nextTar(name, size) : nextLengthPrefixed(name, size);
+    if (!data && !error && ferror(f)) error = true;
+    return data;
+}
+
+unsigned char *ArchiveReader::nextTar(std::string *name, unsigned long long int *size)
+{
+    // a long name from a GNU or pax entry applies to the next file
+    std::string longName;
+    unsigned char header [tarBlockSize];
+
+    while (true)
+    {
+        // the end is marked by zero blocks, but a stream ending at a block boundary is accepted as well
+        if (!read(header, 1)) {
+            error = !feof(f);
+            return nullptr;
+        }
+        if (!read(header + 1, tarBlockSize - 1)) {
+            error = true;
+            return nullptr;
+        }
+        bool zero = true;
+        for (int i = 0;  i < tarBlockSize && zero;  i++) zero = (header[i] == 0);
+        if (zero) return nullptr;
+        if (!isTarHeader(header)) {
+            error = true;
+            return nullptr;
+        }
+
+        const unsigned long long int entrySize = readTarNumber(header + 124, 12);
+        const unsigned long long int padding = (tarBlockSize - entrySize % tarBlockSize) % tarBlockSize;
+        const char type = (char) header[156];
+
+        if (type == 'L' || type == 'x')
+        {
+            unsigned char *data = readData(entrySize);
+            if (!data || !skip(padding)) {
+                delete [] data;
+                error = true;
+                return nullptr;
+            }
+            if (type == 'L') {
+                longName = tarString(data, (int) entrySize);
+            } else {
+                // records "<length> <key>=<value>\n"
+                unsigned long long int position = 0;
+                while (position < entrySize)
+                {
+                    const unsigned long long int recordLength = strtoull((const char *) data + position, nullptr, 10);
+                    if (recordLength == 0 || position + recordLength > entrySize) break;
+                    const std::string record ((const char *) data + position, recordLength);
+                    const size_t space = record.find(' ');
+                    if (space != std::string::npos && record.compare(space + 1, 5, "path=") == 0) {
+                        longName = record.substr(space + 6, record.size() - space - 7);
+                    }
+                    position += recordLength;
+                }
+            }
+            delete [] data;
+            continue;
+        }
+
+        // regular files; directories, links and other entries have no data to process
+        if (type != '0' && type != '\0' && type != '7')
+        {
+            if (!skip(entrySize + padding)) {
+                error = true;
+                return nullptr;
+            }
+            longName.clear();
+            continue;
+        }
+
+        if (!longName.empty()) {
+            *name = longName;
+        } else {
+            *name = tarString(header, 100);
+            const std::string prefix = tarString(header + 345, 155);
+            if (memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty()) *name = prefix + "/" + *name;
+        }
+
+        unsigned char *data = readData(entrySize);
+        if (!data || !skip(padding)) {
+            delete [] data;
+            error = true;
+            return nullptr;
+        }
+        *size = entrySize;
+        return data;
+    }
+}
+
+unsigned char *ArchiveReader::nextLengthPrefixed(std::string *name, unsigned long long int *size)
+{
+    // the end of the stream is expected only between records
+    unsigned char length [8];
+    if (!read(length, 1)) {
+        error = !feof(f);
+        return nullptr;
+    }
+    if (!read(length + 1, 3)) {
+        error = true;
+        return nullptr;
+    }
+
+    const unsigned long long int nameLength = readLittleEndian(length, 4);
+    if (nameLength > 65535) {
+        error = true;
+        return nullptr;
+    }
+    std::string entryName (nameLength, '\0');
+    if ((nameLength > 0 && !read((unsigned char *) &entryName[0], nameLength)) || !read(length, 8)) {
+        error = true;
+        return nullptr;
+    }
+
+    const unsigned long long int entrySize = readLittleEndian(length, 8);
+    unsigned char *data = readData(entrySize);
+    if (!data) {
+        error = true;
+        return nullptr;
+    }
+    *name = entryName;
+    *size = entrySize;
+    return data;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Writing
+// ---------------------------------------------------------------------------------------------------------------------
+
+ArchiveWriter::ArchiveWriter(unsigned long long int maxQueuedBytes) :
+    maxQueuedBytes(maxQueuedBytes),
+    f(nullptr),
+    ownsFile(false),
+    archiveFormat(ArchiveTar),
+    ok(true),
+    queuedBytes(0),
+    finishing(false)
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    finish();
+}
+
+bool ArchiveWriter::open(const char *path, ArchiveFormat format)
+{
+    f = openStream(path, true, &ownsFile);
+    if (!f) return false;
+    archiveFormat = format;
+    thread = std::thread(&ArchiveWriter::run, this);
+    return true;
+}
+
+void ArchiveWriter::add(const std::string &name, unsigned char *data, unsigned long long int size)
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    // a single entry larger than the limit is queued when the queue is empty
+    changed.wait(lock, [&] { return queue.empty() || queuedBytes + size <= maxQueuedBytes; });
+    Entry entry = {name, data, size};
+    queue.push_back(entry);
+    queuedBytes += size;
+    changed.notify_all();
+}
+
+void ArchiveWriter::run()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+    while (true)
+    {
+        changed.wait(lock, [&] { return !queue.empty() || finishing; });
+        if (queue.empty()) return;
+
+        // the entry stays counted until it's written, so add() doesn't let the queue grow meanwhile
+        const Entry entry = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        ProfilerSample sample;
+        Profiler::start(&sample);
+        const bool written = ok && writeEntry(entry);
+        if (written) Profiler::stop(StageWrite, sample);
+        free(entry.data);
+        lock.lock();
+
+        if (!written) ok = false;
+        queuedBytes -= entry.size;
+        changed.notify_all();
+    }
+}
+
+bool ArchiveWriter::finish()
+{
+    if (!f) return false;
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        finishing = true;
+        changed.notify_all();
+    }
+    if (thread.joinable()) thread.join();
+
+    // two zero blocks end a tar archive
+    if (ok && archiveFormat == ArchiveTar) ok = writePadding(2 * tarBlockSize);
+    if (fflush(f) != 0) ok = false;
+    if (ownsFile && fclose(f) != 0) ok = false;
+    f = nullptr;
+    return ok;
+}
+
+bool ArchiveWriter::writePadding(unsigned long long int size)
+{
+    static const unsigned char zeros [tarBlockSize] = {};
+    while (size > 0)
+    {
+        const unsigned long long int part = size < (unsigned long long int) tarBlockSize ? size : tarBlockSize;
+        if (fwrite(zeros, 1, part, f) != part) return false;
+        size -= part;
+    }
+    return true;
+}
+
+bool ArchiveWriter::writeTarHeader(const std::string &name, unsigned long long int size, char type)
+{
+    unsigned char header [tarBlockSize] = {};
+
+    // names up to 100 bytes fit the name field, up to 256 bytes into the prefix and the name split at a slash
+    if (name.size() <= 100) {
+        memcpy(header, name.data(), name.size());
+    } else {
+        const size_t slash = name.find('/', name.size() - 101);
+        if (slash == std::string::npos || slash > 155) return false;
+        memcpy(header + 345, name.data(), slash);
+        memcpy(header, name.data() + slash + 1, name.size() - slash - 1);
+    }
+
+    snprintf((char *) header + 100, 8, "%07o", 0644);
+    snprintf((char *) header + 108, 8, "%07o", 0);
+    snprintf((char *) header + 116, 8, "%07o", 0);
+    if (size < (1ull << 33)) {
+        snprintf((char *) header + 124, 12, "%011llo", size);
+    } else {
+        header[124] = 0x80;
+        for (int i = 0;  i < 8;  i++) header[135 - i] = (unsigned char) (size >> (8 * i));
+    }
+    snprintf((char *) header + 136, 12, "%011llo", (unsigned long long int) time(nullptr));
+    header[156] = (unsigned char) type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    snprintf((char *) header + 148, 8, "%06o", tarChecksum(header));
+    header[155] = ' ';
+
+    return fwrite(header, 1, tarBlockSize, f) == tarBlockSize;
+}
+
+bool ArchiveWriter::writeEntry(const Entry &entry)
+{
+    if (archiveFormat == ArchiveLengthPrefixed)
+    {
+        unsigned char length [8];
+        writeLittleEndian(length, entry.name.size(), 4);
+        if (entry.name.size() > 65535 || fwrite(length, 1, 4, f) != 4 || fwrite(entry.name.data(), 1, entry.name.size(), f) != entry.name.size()) return false;
+        writeLittleEndian(length, entry.size, 8);
+        return fwrite(length, 1, 8, f) == 8 && fwrite(entry.data, 1, entry.size, f) == entry.size;
+    }
+
+    // longer names are written as a GNU long name entry before the file, like GNU tar does
+    const bool splittable = entry.name.size() <= 100 ||
+            (entry.name.size() <= 256 && entry.name.find('/', entry.name.size() - 101) <= 155);
+    if (!splittable)
+    {
+        const unsigned long long int nameSize = entry.name.size() + 1;
+        if (!writeTarHeader("././@LongLink", nameSize, 'L') || fwrite(entry.name.c_str(), 1, nameSize, f) != nameSize ||
+            !writePadding((tarBlockSize - nameSize % tarBlockSize) % tarBlockSize)) return false;
+    }
+
+    const std::string headerName = splittable ? entry.name : entry.name.substr(entry.name.size() - 100);
+    return writeTarHeader(headerName, entry.size, '0') && fwrite(entry.data, 1, entry.size, f) == entry.size &&
+           writePadding((tarBlockSize - entry.size % tarBlockSize) % tarBlockSize);
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <stdio.h>
+
+// Streams of many small files in one file or pipe, so batches of large corpora don't open and close a file per image.
+// Two formats are supported:
+//  - tar (POSIX ustar, GNU long names and pax paths); only regular files are returned, other entries are skipped;
+//  - a concatenation of records: name length (4 bytes), name, data length (8 bytes), data; lengths are little endian.
+// The format of an input is detected from its first block.
+enum ArchiveFormat
+{
+    ArchiveTar = 0,
+    ArchiveLengthPrefixed
+};
+
+// Sequential reader of an archive file or of the standard input ("-"); not thread-safe.
+class ArchiveReader
+{
+public:
+    ArchiveReader();
+    ~ArchiveReader();
+
+    bool open(const char *path);
+    ArchiveFormat format() const;
+
+    // the next file as a new [] buffer, or nullptr at the end of the archive or on an error
+    unsigned char *next(std::string *name, unsigned long long int *size);
+    bool failed() const;
+
+private:
+    ArchiveReader(const ArchiveReader &) = delete;
+    ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+    bool read(unsigned char *out, unsigned long long int size);
+    bool skip(unsigned long long int size);
+    unsigned char *readData(unsigned long long int size);
+
+    unsigned char *nextTar(std::string *name, unsigned long long int *size);
+    unsigned char *nextLengthPrefixed(std::string *name, unsigned long long int *size);
+
+    FILE *f;
+    bool ownsFile;
+    ArchiveFormat archiveFormat;
+    bool error;
+
+    // the first block is read to detect the format and returned by read() before the rest of the stream
+    unsigned char firstBlock [512];
+    unsigned long long int firstBlockSize;
+    unsigned long long int firstBlockPosition;
+};
+
+// Writer of an archive file or of the standard output ("-"). Entries are written in the order of add() calls by
+// a background thread, so the threads adding them don't wait for a slow disk or pipe; add() blocks only while more
+// than maxQueuedBytes are waiting.
+class ArchiveWriter
+{
+public:
+    explicit ArchiveWriter(unsigned long long int maxQueuedBytes = 64ull << 20);
+    ~ArchiveWriter();    // finishes the archive
+
+    bool open(const char *path, ArchiveFormat format);
+
+    // takes data allocated with malloc() (e.g. by Encoder) and frees it when it's written; thread-safe
+    void add(const std::string &name, unsigned char *data, unsigned long long int size);
+
+    // writes the queued entries and the end of the archive; false if anything couldn't be written
+    bool finish();
+
+private:
+    ArchiveWriter(const ArchiveWriter &) = delete;
+    ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+    struct Entry
+    {
+        std::string name;
+        unsigned char *data;
+        unsigned long long int size;
+    };
+
+    void run();
+    bool writeEntry(const Entry &entry);
+    bool writeTarHeader(const std::string &name, unsigned long long int size, char type);
+    bool writePadding(unsigned long long int size);
+
+    const unsigned long long int maxQueuedBytes;
+
+    FILE *f;
+    bool ownsFile;
+    ArchiveFormat archiveFormat;
+    bool ok;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Entry> queue;
+    unsigned long long int queuedBytes;
+    bool finishing;
+    std::thread thread;
+};
+
+#endif // ARCHIVE_H
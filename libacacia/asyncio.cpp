@@ -0,0 +1,514 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "asyncio.h"
+#include "profiler.h"
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef USE_IO_URING
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #include <linux/io_uring.h>
+#endif
+
+struct AsyncRequest
+{
+    bool isWrite;
+    std::string path;
+    unsigned long long int device;
+
+    unsigned char *data;
+    unsigned long long int size;
+    unsigned long long int transferred;
+
+    int fd;      // io_uring only
+    int slot;    // registered buffer or -1
+
+    bool finished;
+    bool ok;
+
+    unsigned long long int submittedNs;    // writes are recorded as StageWrite
+
+    void (*done)(void *context, bool ok);
+    void *context;
+};
+
+// requests on the same device share its queue; a file being written doesn't exist yet, so its directory is used
+static bool deviceOf(const std::string &path, bool isWrite, unsigned long long int *device, unsigned long long int *size)
+{
+    std::string statPath = path;
+    if (isWrite) {
+        const size_t slash = path.find_last_of("/\\");
+        statPath = (slash == std::string::npos) ? std::string(".") : path.substr(0, slash + 1);
+    }
+
+    struct stat info;
+    if (stat(statPath.c_str(), &info) != 0) return false;
+    *device = (unsigned long long int) info.st_dev;
+    if (size) *size = (unsigned long long int) info.st_size;
+    return true;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// io_uring without liburing: the three system calls and the shared rings
+// ---------------------------------------------------------------------------------------------------------------------
+
+#ifdef USE_IO_URING
+
+struct AsyncIO::Ring
+{
+    int fd;
+    unsigned int entries;
+
+    unsigned int *sqHead;
+    unsigned int *sqTail;
+    unsigned int *sqMask;
+    unsigned int *sqArray;
+    io_uring_sqe *sqes;
+
+    unsigned int *cqHead;
+    unsigned int *cqTail;
+    unsigned int *cqMask;
+    io_uring_cqe *cqes;
+
+    void *sqMap;
+    size_t sqMapSize;
+    void *cqMap;
+    size_t cqMapSize;
+    size_t sqesSize;
+
+    bool fixedBuffers;
+};
+
+static int ioUringSetup(unsigned int entries, io_uring_params *params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int ioUringRegister(int fd, unsigned int opcode, const void *arg, unsigned int numArgs)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, numArgs);
+}
+
+bool AsyncIO::setupRing()
+{
+    // every device can have queueDepth requests in flight, the ring is shared by all of them
+    unsigned int entries = 8;
+    while (entries < (unsigned int) queueDepth * 4 && entries < 4096) entries *= 2;
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = ioUringSetup(entries, &params);
+    if (fd < 0) return false;
+
+    Ring *r = new Ring();
+    r->fd = fd;
+    r->entries = params.sq_entries;
+    r->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    r->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    r->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    // kernels with IORING_FEAT_SINGLE_MMAP map both rings at once
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && r->cqMapSize > r->sqMapSize) r->sqMapSize = r->cqMapSize;
+
+    r->sqMap = mmap(nullptr, r->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    r->cqMap = singleMap ? r->sqMap : mmap(nullptr, r->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(nullptr, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqMap == MAP_FAILED || r->cqMap == MAP_FAILED || sqes == MAP_FAILED) {
+        if (r->sqMap != MAP_FAILED) munmap(r->sqMap, r->sqMapSize);
+        if (!singleMap && r->cqMap != MAP_FAILED) munmap(r->cqMap, r->cqMapSize);
+        if (sqes != MAP_FAILED) munmap(sqes, r->sqesSize);
+        close(fd);
+        delete r;
+        return false;
+    }
+
+    unsigned char *sq = (unsigned char *) r->sqMap;
+    unsigned char *cq = (unsigned char *) r->cqMap;
+    r->sqHead = (unsigned int *) (sq + params.sq_off.head);
+    r->sqTail = (unsigned int *) (sq + params.sq_off.tail);
+    r->sqMask = (unsigned int *) (sq + params.sq_off.ring_mask);
+    r->sqArray = (unsigned int *) (sq + params.sq_off.array);
+    r->sqes = (io_uring_sqe *) sqes;
+    r->cqHead = (unsigned int *) (cq + params.cq_off.head);
+    r->cqTail = (unsigned int *) (cq + params.cq_off.tail);
+    r->cqMask = (unsigned int *) (cq + params.cq_off.ring_mask);
+    r->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    // registering pins the buffers, which fails if RLIMIT_MEMLOCK is too low; plain reads are used then
+    std::vector<iovec> buffers;
+    for (int i = 0;  i < queueDepth;  i++)
+    {
+        void *slot = nullptr;
+        if (posix_memalign(&slot, 4096, slotSize) != 0) break;
+        slots.push_back((unsigned char *) slot);
+        freeSlots.push_back(i);
+        iovec buffer = {slot, slotSize};
+        buffers.push_back(buffer);
+    }
+    r->fixedBuffers = !buffers.empty() && ioUringRegister(fd, IORING_REGISTER_BUFFERS, buffers.data(), (unsigned int) buffers.size()) == 0;
+    if (!r->fixedBuffers) {
+        for (size_t i = 0;  i < slots.size();  i++) free(slots[i]);
+        slots.clear();
+        freeSlots.clear();
+    }
+
+    ring = r;
+    return true;
+}
+
+void AsyncIO::submitToRing(AsyncRequest *request)
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+
+    const unsigned int tail = *ring->sqTail;
+    const unsigned int index = tail & *ring->sqMask;
+    io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    if (request) {
+        // one request transfers at most 1 GB, larger files continue after the completion
+        const unsigned long long int remaining = request->size - request->transferred;
+        sqe->opcode = request->isWrite ? IORING_OP_WRITE : (request->slot >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ);
+        sqe->fd = request->fd;
+        sqe->addr = (unsigned long long int) (request->data + request->transferred);
+        sqe->len = (unsigned int) (remaining < (1ULL << 30) ? remaining : (1ULL << 30));
+        sqe->off = request->transferred;
+        if (request->slot >= 0) sqe->buf_index = (unsigned short) request->slot;
+    } else {
+        sqe->opcode = IORING_OP_NOP;    // wakes the completion thread
+    }
+    sqe->user_data = (unsigned long long int) request;
+
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    while (ioUringEnter(ring->fd, 1, 0, 0) < 0 && errno == EINTR) {}
+}
+
+void AsyncIO::runCompletionThread()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return pendingRequests > 0 || stopping; });
+            if (stopping && pendingRequests == 0) return;
+        }
+
+        ioUringEnter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+
+        unsigned int head = *ring->cqHead;
+        while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+        {
+            const io_uring_cqe cqe = ring->cqes[head & *ring->cqMask];
+            __atomic_store_n(ring->cqHead, ++head, __ATOMIC_RELEASE);
+            if (cqe.user_data) complete((AsyncRequest *) cqe.user_data, cqe.res);
+        }
+    }
+}
+
+#endif
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+AsyncIO::AsyncIO(int queueDepth) : queueDepth(queueDepth > 0 ? queueDepth : 1), pendingRequests(0), stopping(false)
+{
+#ifdef USE_IO_URING
+    ring = nullptr;
+    if (setupRing()) {
+        threads.push_back(std::thread(&AsyncIO::runCompletionThread, this));
+        return;
+    }
+#endif
+
+    // blocking I/O: one thread per request that can be in flight on one device
+    for (int i = 0;  i < this->queueDepth;  i++) threads.push_back(std::thread(&AsyncIO::runPoolThread, this));
+}
+
+AsyncIO::~AsyncIO()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+#ifdef USE_IO_URING
+    if (ring) submitToRing(nullptr);
+#endif
+
+    for (size_t i = 0;  i < threads.size();  i++) threads[i].join();
+
+#ifdef USE_IO_URING
+    if (ring) {
+        munmap(ring->sqes, ring->sqesSize);
+        if (ring->cqMap != ring->sqMap) munmap(ring->cqMap, ring->cqMapSize);
+        munmap(ring->sqMap, ring->sqMapSize);
+        close(ring->fd);
+        delete ring;
+    }
+    for (size_t i = 0;  i < slots.size();  i++) free(slots[i]);
+#endif
+}
+
+bool AsyncIO::usesIoUring() const
+{
+#ifdef USE_IO_URING
+    return ring != nullptr;
+#else
+    return false;
+#endif
+}
+
+AsyncRequest *AsyncIO::startRead(const char *path, void (*done)(void *, bool), void *context)
+{
+    AsyncRequest *request = new AsyncRequest();
+    request->isWrite = false;
+    request->path = path;
+    request->data = nullptr;
+    request->size = 0;
+    request->transferred = 0;
+    request->fd = -1;
+    request->slot = -1;
+    request->finished = false;
+    request->ok = false;
+    request->done = done;
+    request->context = context;
+
+    if (!deviceOf(request->path, false, &request->device, &request->size)) {
+        request->finished = true;
+        if (done) done(context, false);
+        return request;
+    }
+
+    acquireDevice(request);
+    submit(request);
+    return request;
+}
+
+const unsigned char *AsyncIO::waitRead(AsyncRequest *request, unsigned long long int *size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return request->finished; });
+
+    *size = request->size;
+    return request->ok ? request->data : nullptr;
+}
+
+void AsyncIO::release(AsyncRequest *request)
+{
+#ifdef USE_IO_URING
+    if (request->slot >= 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeSlots.push_back(request->slot);
+    } else
+#endif
+    {
+        delete [] request->data;
+    }
+    delete request;
+}
+
+void AsyncIO::write(const char *path, unsigned char *data, unsigned long long int size, void (*done)(void *, bool), void *context)
+{
+    AsyncRequest *request = new AsyncRequest();
+    request->isWrite = true;
+    request->path = path;
+    request->data = data;
+    request->size = size;
+    request->transferred = 0;
+    request->fd = -1;
+    request->slot = -1;
+    request->finished = false;
+    request->ok = false;
+    request->done = done;
+    request->context = context;
+
+    if (!deviceOf(request->path, true, &request->device, nullptr)) {
+        free(data);
+        if (done) done(context, false);
+        delete request;
+        return;
+    }
+
+    acquireDevice(request);
+    request->submittedNs = Profiler::nowNs();
+    submit(request);
+}
+
+void AsyncIO::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return pendingRequests == 0; });
+}
+
+bool AsyncIO::acquireDevice(AsyncRequest *request)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return deviceRequests[request->device] < queueDepth; });
+    deviceRequests[request->device]++;
+    pendingRequests++;
+    lock.unlock();
+
+    // the completion thread may wait for the first request
+    changed.notify_all();
+    return true;
+}
+
+void AsyncIO::submit(AsyncRequest *request)
+{
+#ifdef USE_IO_URING
+    if (ring) {
+        request->fd = request->isWrite ? open(request->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) :
+                                         open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (request->fd < 0) {
+            finish(request, false);
+            return;
+        }
+
+        if (!request->isWrite) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (request->size <= slotSize && !freeSlots.empty()) {
+                request->slot = freeSlots.back();
+                freeSlots.pop_back();
+                request->data = slots[request->slot];
+            }
+            lock.unlock();
+            if (request->slot < 0) request->data = new unsigned char [request->size > 0 ? request->size : 1];
+        }
+
+        if (request->size == 0) finish(request, true);
+        else submitToRing(request);
+        return;
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        poolQueue.push_back(request);
+    }
+    changed.notify_all();
+}
+
+void AsyncIO::complete(AsyncRequest *request, long long int result)
+{
+#ifdef USE_IO_URING
+    if (result == -EINTR || result == -EAGAIN) {
+        submitToRing(request);
+        return;
+    }
+
+    // an error or an unexpected end of file
+    if (result <= 0) {
+        finish(request, false);
+        return;
+    }
+
+    request->transferred += (unsigned long long int) result;
+    if (request->transferred < request->size) submitToRing(request);
+    else finish(request, true);
+#else
+    finish(request, result >= 0);
+#endif
+}
+
+void AsyncIO::finish(AsyncRequest *request, bool ok)
+{
+#ifdef USE_IO_URING
+    if (request->fd >= 0) {
+        if (close(request->fd) != 0) ok = false;
+        request->fd = -1;
+    }
+#endif
+
+    const unsigned long long int device = request->device;
+    const bool isWrite = request->isWrite;
+    void (*done)(void *, bool) = request->done;
+    void *context = request->context;
+    if (isWrite) {
+        if (ok) Profiler::record(StageWrite, Profiler::nowNs() - request->submittedNs);
+        else remove(request->path.c_str());
+        free(request->data);
+        if (done) done(context, ok);
+        delete request;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isWrite) {
+            request->ok = ok;
+            request->finished = true;
+        }
+        deviceRequests[device]--;
+        pendingRequests--;
+    }
+    changed.notify_all();
+
+    // the consumer started by done may release the read request, it's not touched afterwards
+    if (!isWrite && done) done(context, ok);
+}
+
+void AsyncIO::runPoolThread()
+{
+    while (true)
+    {
+        AsyncRequest *request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return !poolQueue.empty() || stopping; });
+            if (poolQueue.empty()) return;
+            request = poolQueue.front();
+            poolQueue.pop_front();
+        }
+
+        bool ok = false;
+        FILE *f = fopen(request->path.c_str(), request->isWrite ? "wb" : "rb");
+        if (f) {
+            if (request->isWrite) {
+                ok = fwrite(request->data, 1, (size_t) request->size, f) == request->size;
+            } else {
+                request->data = new unsigned char [request->size > 0 ? request->size : 1];
+                ok = fread(request->data, 1, (size_t) request->size, f) == request->size;
+            }
+            if (fclose(f) != 0) ok = false;
+        }
+        finish(request, ok);
+    }
+}
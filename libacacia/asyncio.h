@@ -0,0 +1,104 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AsyncRequest;
+
+// Asynchronous reading and writing of whole files for batch processing, so compute threads don't wait for the disk.
+//
+// With USE_IO_URING (Linux) requests are submitted to an io_uring and completed by one I/O thread; small files are read
+// into buffers registered with the kernel, which saves mapping the pages for every request. If io_uring is not
+// available at runtime or not compiled in, a pool of threads does blocking I/O with the same interface.
+//
+// At most queueDepth requests per device (st_dev of the file) are in flight; further requests block the calling thread
+// until one completes, which also limits the memory held by pending writes.
+class AsyncIO
+{
+public:
+    explicit AsyncIO(int queueDepth);
+    ~AsyncIO();    // waits for all requests
+
+    bool usesIoUring() const;
+
+    // starts reading a whole file; the returned request is passed to waitRead() and release(); done, if not null,
+    // is called when the file is read or has failed, from an I/O thread or from startRead() itself, and waitRead()
+    // returns without blocking from then on, so the consumer can be started by done instead of waiting
+    AsyncRequest *startRead(const char *path, void (*done)(void *context, bool ok) = nullptr, void *context = nullptr);
+
+    // blocks until the file is read; returns nullptr if it can't be read, the data is valid until release()
+    const unsigned char *waitRead(AsyncRequest *request, unsigned long long int *size);
+    void release(AsyncRequest *request);
+
+    // writes data (allocated with malloc(), e.g. by Encoder) to a new file and frees it; done is called from an I/O thread
+    // with the result and may be null; a file that can't be written completely is removed
+    void write(const char *path, unsigned char *data, unsigned long long int size, void (*done)(void *context, bool ok), void *context);
+
+    // waits for all writes
+    void flush();
+
+private:
+    bool acquireDevice(AsyncRequest *request);
+    void submit(AsyncRequest *request);
+    void complete(AsyncRequest *request, long long int result);
+    void finish(AsyncRequest *request, bool ok);
+
+    void runPoolThread();
+#ifdef USE_IO_URING
+    bool setupRing();
+    void submitToRing(AsyncRequest *request);
+    void runCompletionThread();
+#endif
+
+    const int queueDepth;
+
+    // requests in flight per device, all pending writes and the condition of both
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<unsigned long long int, int> deviceRequests;
+    int pendingRequests;
+    bool stopping;
+
+    // thread pool
+    std::deque<AsyncRequest *> poolQueue;
+    std::vector<std::thread> threads;
+
+#ifdef USE_IO_URING
+    struct Ring;
+    Ring *ring;
+    std::mutex submitMutex;
+
+    // registered buffers for small files, one per request that can be in flight
+    std::vector<unsigned char *> slots;
+    std::vector<int> freeSlots;
+    static const unsigned long long int slotSize = 1 << 20;
+#endif
+};
+
+#endif // ASYNCIO_H
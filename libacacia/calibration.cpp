@@ -0,0 +1,207 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "calibration.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "math.h"
+
+// weight of an observation relative to the next one
+static const double forgettingFactor = 0.998;
+
+// initial covariance of the weights, i.e. how far the first observations can move them
+static const double initialVariance = 10.0;
+
+// regression inputs of the residual model: constant, quality factor scaled to -1..1, log of the image size
+static void residualInputs(double qualityFactor, double logSize, double *x)
+{
+    x[0] = 1.0;
+    x[1] = (qualityFactor - 50.0) / 50.0;
+    x[2] = logSize;
+}
+
+double CalibrationCorrection::value(double qualityFactor, double logSize) const
+{
+    double x [3];
+    residualInputs(qualityFactor, logSize, x);
+    return weights[0] * x[0] + weights[1] * x[1] + weights[2] * x[2];
+}
+
+Calibration::Calibration()
+{
+    reset();
+}
+
+int Calibration::modelIndex(bool isjpeg, char targetObjective)
+{
+    const int objective = (targetObjective == 's') ? 0 : (targetObjective == 'm') ? 1 : 2;
+    return (isjpeg ? 0 : 3) + objective;
+}
+
+void Calibration::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int m = 0;  m < numModels;  m++)
+    {
+        models[m].count = 0;
+        for (int i = 0;  i < 3;  i++)
+        {
+            models[m].weights[i] = 0;
+            for (int j = 0;  j < 3;  j++) models[m].covariance[i][j] = (i == j) ? initialVariance : 0;
+        }
+    }
+}
+
+CalibrationCorrection Calibration::correction(bool isjpeg, char targetObjective) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const ModelState &model = models[modelIndex(isjpeg, targetObjective)];
+    CalibrationCorrection result;
+    for (int i = 0;  i < 3;  i++) result.weights[i] = model.weights[i];
+    return result;
+}
+
+unsigned long long int Calibration::observations(bool isjpeg, char targetObjective) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return models[modelIndex(isjpeg, targetObjective)].count;
+}
+
+void Calibration::update(bool isjpeg, char targetObjective, double qualityFactor, double logSize, double residual)
+{
+    if (!isfinite(residual) || !isfinite(qualityFactor) || !isfinite(logSize)) return;
+
+    double x [3];
+    residualInputs(qualityFactor, logSize, x);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ModelState &model = models[modelIndex(isjpeg, targetObjective)];
+
+    // without forgetting while the covariance exceeds the initial one: if all observations are alike
+    // (e.g. the same quality factor), the uncertainty in the other directions would otherwise grow without limit
+    const double trace = model.covariance[0][0] + model.covariance[1][1] + model.covariance[2][2];
+    const double lambda = (trace < 3 * initialVariance) ? forgettingFactor : 1.0;
+
+    double px [3];
+    for (int i = 0;  i < 3;  i++) px[i] = model.covariance[i][0] * x[0] + model.covariance[i][1] * x[1] + model.covariance[i][2] * x[2];
+    const double denominator = lambda + x[0] * px[0] + x[1] * px[1] + x[2] * px[2];
+
+    const double error = residual - (model.weights[0] * x[0] + model.weights[1] * x[1] + model.weights[2] * x[2]);
+    for (int i = 0;  i < 3;  i++) model.weights[i] += px[i] / denominator * error;
+
+    // the covariance is symmetric, so P x is also x^T P
+    for (int i = 0;  i < 3;  i++) {
+        for (int j = 0;  j < 3;  j++) model.covariance[i][j] = (model.covariance[i][j] - px[i] * px[j] / denominator) / lambda;
+    }
+    model.count++;
+}
+
+bool Calibration::load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[acacia] error: cannot read calibration file \"%s\"\n", path);
+        return false;
+    }
+
+    ModelState loaded [numModels];
+    bool present [numModels] = {};
+    int version = 0;
+    bool ok = (fscanf(f, "acacia-calibration %d", &version) == 1 && version == 1);
+
+    char format [16];
+    char objective;
+    while (ok)
+    {
+        ModelState model;
+        double c [6];
+        const int n = fscanf(f, "%15s %c %llu %lf %lf %lf %lf %lf %lf %lf %lf %lf", format, &objective, &model.count,
+                             &model.weights[0], &model.weights[1], &model.weights[2], &c[0], &c[1], &c[2], &c[3], &c[4], &c[5]);
+        if (n == EOF) break;
+        const bool isjpeg = (strcmp(format, "jpeg") == 0);
+        ok = (n == 12 && (isjpeg || strcmp(format, "webp") == 0) && (objective == 's' || objective == 'm' || objective == 'p'));
+        for (int i = 0;  ok && i < 3;  i++) ok = isfinite(model.weights[i]);
+        for (int i = 0;  ok && i < 6;  i++) ok = isfinite(c[i]);
+        if (!ok) break;
+
+        model.covariance[0][0] = c[0];
+        model.covariance[0][1] = model.covariance[1][0] = c[1];
+        model.covariance[0][2] = model.covariance[2][0] = c[2];
+        model.covariance[1][1] = c[3];
+        model.covariance[1][2] = model.covariance[2][1] = c[4];
+        model.covariance[2][2] = c[5];
+
+        const int m = modelIndex(isjpeg, objective);
+        loaded[m] = model;
+        present[m] = true;
+    }
+    fclose(f);
+
+    for (int m = 0;  ok && m < numModels;  m++) ok = present[m];
+    if (!ok) {
+        fprintf(stderr, "[acacia] error: \"%s\" is not a valid calibration file\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int m = 0;  m < numModels;  m++) models[m] = loaded[m];
+    return true;
+}
+
+bool Calibration::save(const char *path) const
+{
+    ModelState saved [numModels];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int m = 0;  m < numModels;  m++) saved[m] = models[m];
+    }
+
+    const std::string temporaryPath = std::string(path) + ".tmp";
+    FILE *f = fopen(temporaryPath.c_str(), "w");
+    bool ok = (f != nullptr);
+    if (ok)
+    {
+        const char objectives [] = {'s', 'm', 'p'};
+        fprintf(f, "acacia-calibration 1\n");
+        for (int m = 0;  m < numModels;  m++)
+        {
+            const ModelState &model = saved[m];
+            fprintf(f, "%s %c %llu %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g\n", m < 3 ? "jpeg" : "webp", objectives[m % 3], model.count,
+                    model.weights[0], model.weights[1], model.weights[2], model.covariance[0][0], model.covariance[0][1], model.covariance[0][2],
+                    model.covariance[1][1], model.covariance[1][2], model.covariance[2][2]);
+        }
+        ok = !ferror(f);
+        ok = (fclose(f) == 0) && ok;
+    }
+
+#ifdef _WIN32
+    // rename() doesn't replace existing files on Windows
+    if (ok) remove(path);
+#endif
+    if (ok) ok = (rename(temporaryPath.c_str(), path) == 0);
+
+    if (!ok) {
+        remove(temporaryPath.c_str());
+        fprintf(stderr, "[acacia] error: cannot write calibration file \"%s\"\n", path);
+    }
+    return ok;
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <mutex>
+
+// Correction of one model, added to the network output (the logarithm of the file size, Y-MSSIM or Y-PSNR):
+// a linear function of the quality factor and the logarithm of the image size in megapixels
+struct CalibrationCorrection
+{
+    double weights [3];
+
+    double value(double qualityFactor, double logSize) const;
+};
+
+// Online calibration of the six models by the results of completed encodes.
+//
+// The models are trained on a general image set, so for a particular mix of content the predictions can have
+// a consistent bias. Every observation updates a small residual model of its format and objective by recursive
+// least squares with exponential forgetting, so the correction follows a slowly changing content mix; older
+// observations lose half of their weight after about 350 newer ones. The state is a few numbers per model and is
+// saved to a text file, so it accumulates over runs. A Calibration is used by any number of threads.
+//
+// File format: the line "acacia-calibration 1", then one line per model: format (jpeg or webp), objective
+// ('s', 'm' or 'p'), number of observations, 3 weights and the upper triangle of the 3x3 covariance matrix.
+class Calibration
+{
+public:
+    Calibration();
+
+    // returns false and prints a message if the file can't be read or is invalid, the state is unchanged then
+    bool load(const char *path);
+
+    // written under a temporary name and renamed, so readers never see a partial file
+    bool save(const char *path) const;
+
+    // all models return to zero correction
+    void reset();
+
+    // targetObjective is 's', 'm' or 'p' like in Optimizer::findQualityFactor()
+    CalibrationCorrection correction(bool isjpeg, char targetObjective) const;
+    unsigned long long int observations(bool isjpeg, char targetObjective) const;
+
+    // residual is the observed value minus the network output without correction (see Optimizer::recordResult())
+    void update(bool isjpeg, char targetObjective, double qualityFactor, double logSize, double residual);
+
+private:
+    struct ModelState
+    {
+        unsigned long long int count;
+        double weights [3];
+        double covariance [3][3];
+    };
+
+    static const int numModels = 6;
+    static int modelIndex(bool isjpeg, char targetObjective);
+
+    mutable std::mutex mutex;
+    ModelState models [numModels];
+};
+
+#endif // CALIBRATION_H
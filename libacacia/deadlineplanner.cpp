@@ -0,0 +1,98 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "deadlineplanner.h"
+
+// time per pixel in nanoseconds; the full analysis for JPEG writes the colour conversion for the encoder (yuvimage.h),
+// so it's slower and the encoding faster than from xRGB pixels
+static const double analysisNsPerPixel = 1.8;
+static const double conversionNsPerPixel = 1.6;
+static const double jpegNsPerPixel [2] = {11.5, 36.0};                       // without, with Huffman optimization
+static const double jpegFromPlanesNsPerPixel [2] = {11.0, 34.0};
+static const double webpNsPerPixel [EncoderOptions::defaultWebpMethod + 1] = {22.0, 30.0, 40.0, 50.0, 70.0};    // by method
+static const double writeNsPerPixel = 1.0;
+
+// the search of the quality factor doesn't depend on the image size
+static const double inferenceNs [2] = {250000.0, 50000.0};                   // reference, fast
+static const double fixedNs = 500000.0;                                      // opening and closing the output file
+
+// the estimates are averages, the choices must leave room for the variation of encoding times and the load of the machine
+static const double budgetShare = 0.8;
+
+// losses in percent: the error of the size prediction by sampled analysis (measured on large images, it grows
+// for images near minSampledRows), larger files with less encoder effort
+static const int numRowSteps = 5;
+static const int rowSteps [numRowSteps] = {1, 2, 4, 8, 16};
+static const double samplingLoss [numRowSteps] = {0.0, 0.5, 1.0, 2.0, 4.0};
+static const double fastInferenceLoss = 0.1;
+static const double jpegWithoutOptimizationLoss = 7.0;
+static const double webpMethodLoss [EncoderOptions::defaultWebpMethod + 1] = {8.0, 5.0, 3.0, 1.0, 0.0};
+
+DeadlinePlan DeadlinePlanner::plan(bool isjpeg, int width, int height, double budgetNs)
+{
+    const double pixels = (double) width * height;
+    const int numFragmentRows = height / 8;
+    const int numEncoderChoices = isjpeg ? 2 : EncoderOptions::defaultWebpMethod + 1;
+
+    DeadlinePlan best;
+    double bestLoss = 0;
+    bool found = false;
+
+    for (int s = 0;  s < numRowSteps;  s++)
+    {
+        if (s > 0 && numFragmentRows / rowSteps[s] < minSampledRows) break;
+
+        for (int inference = 0;  inference < 2;  inference++)
+        {
+            for (int e = 0;  e < numEncoderChoices;  e++)
+            {
+                DeadlinePlan plan;
+                plan.analysisRowStep = rowSteps[s];
+                plan.inference = inference ? InferenceFast : InferenceReference;
+
+                double encodeNsPerPixel;
+                double loss = samplingLoss[s] + (inference ? fastInferenceLoss : 0.0);
+                if (isjpeg) {
+                    plan.encoder.optimizeHuffman = (e == 1);
+                    encodeNsPerPixel = (s == 0) ? jpegFromPlanesNsPerPixel[e] + conversionNsPerPixel : jpegNsPerPixel[e];
+                    plan.sizeFactor = (e == 1) ? 1.0 : 1.0 + jpegWithoutOptimizationLoss / 100;
+                } else {
+                    plan.encoder.webpMethod = e;
+                    encodeNsPerPixel = webpNsPerPixel[e];
+                    plan.sizeFactor = 1.0 + webpMethodLoss[e] / 100;
+                }
+                loss += (plan.sizeFactor - 1.0) * 100;
+
+                plan.estimatedNs = pixels * (analysisNsPerPixel / rowSteps[s] + encodeNsPerPixel + writeNsPerPixel) + inferenceNs[inference] + fixedNs;
+                plan.withinBudget = plan.estimatedNs <= budgetNs * budgetShare;
+
+                // the smallest loss within the budget, otherwise the fastest choices
+                const bool better = !found ||
+                        (plan.withinBudget && (!best.withinBudget || loss < bestLoss)) ||
+                        (!plan.withinBudget && !best.withinBudget && plan.estimatedNs < best.estimatedNs);
+                if (better) {
+                    best = plan;
+                    bestLoss = loss;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    return best;
+}
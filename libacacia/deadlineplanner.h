@@ -0,0 +1,54 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEADLINEPLANNER_H
+#define DEADLINEPLANNER_H
+
+#include "encoder.h"
+#include "optimizer.h"
+
+// Choices of a compression with a latency budget
+struct DeadlinePlan
+{
+    int analysisRowStep;        // 1 is the full analysis, n analyzes every n-th row of fragments (FeatureExtractor::sampleFeatures())
+    InferenceMode inference;
+    EncoderOptions encoder;
+
+    // expected file size relative to the prediction of the models, which were trained with the default encoder effort;
+    // a size target should be divided by it
+    double sizeFactor;
+
+    double estimatedNs;         // analysis, inference, encoding and writing
+    bool withinBudget;          // false if even the fastest choices exceed the budget, they are chosen then
+};
+
+// Up-front cost model of analysis, inference and encoding, linear in the number of pixels. Among the combinations
+// that fit into the budget the planner chooses the one with the smallest loss of prediction accuracy and compression,
+// e.g. sampled analysis is preferred to JPEG without Huffman optimization, which is 3 times faster but makes
+// the files about 7% larger. The quality factor is not known before the inference, so the encoder costs are those
+// of quality factor 100 with one thread and rather pessimistic for typical targets.
+class DeadlinePlanner
+{
+public:
+    static DeadlinePlan plan(bool isjpeg, int width, int height, double budgetNs);
+
+    // sampling needs enough rows of fragments, otherwise the features of small images are not representative
+    static const int minSampledRows = 32;
+};
+
+#endif // DEADLINEPLANNER_H
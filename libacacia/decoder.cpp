@@ -0,0 +1,170 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "decoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <jpeglib.h>
+
+#include "webp/decode.h"
+
+
+#define USE_LIBJPEG_TURBO
+
+#ifndef USE_LIBJPEG_TURBO
+    #define USE_LIBJPEG
+#endif
+
+
+// libjpeg terminates the process on errors by default, which is not acceptable for corrupted data
+struct DecoderErrorManager
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmpBuffer;
+};
+
+static void decoderErrorExit(j_common_ptr cinfo)
+{
+    DecoderErrorManager *err = (DecoderErrorManager *) cinfo->err;
+    longjmp(err->setjmpBuffer, 1);
+}
+
+unsigned int *Decoder::decompressJpeg(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    struct jpeg_decompress_struct cinfo;
+    DecoderErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = decoderErrorExit;
+
+    // image_data is volatile, because it's modified between setjmp() and longjmp()
+    unsigned int * volatile image_data = nullptr;
+
+    if (setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        delete [] image_data;
+        return nullptr;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *) buffer, (unsigned long) buffer_size);
+    jpeg_read_header(&cinfo, true);
+
+#ifdef USE_LIBJPEG_TURBO
+    cinfo.out_color_space = JCS_EXT_BGRX;
+#endif
+
+#ifdef USE_LIBJPEG
+    cinfo.out_color_space = JCS_RGB;
+#endif
+
+    jpeg_start_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    image_data = new unsigned int [(size_t) cinfo.output_width * cinfo.output_height];
+
+#ifdef USE_LIBJPEG_TURBO
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row_pointer [1];
+        row_pointer[0] = (JSAMPLE *) (image_data + (size_t) cinfo.output_scanline * cinfo.output_width);
+        jpeg_read_scanlines(&cinfo, row_pointer, 1);
+    }
+#endif
+
+#ifdef USE_LIBJPEG
+    unsigned char *row = new unsigned char [cinfo.output_width * cinfo.output_components];
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        unsigned int *pixel = image_data + (size_t) cinfo.output_scanline * cinfo.output_width;
+        JSAMPROW row_pointer [1] = {row};
+        jpeg_read_scanlines(&cinfo, row_pointer, 1);
+        for (unsigned int x = 0;  x < cinfo.output_width;  x++)
+        {
+            const unsigned char *rgb = row + x * cinfo.output_components;
+            pixel[x] = cinfo.output_components == 1 ? (0xff000000u | (rgb[0] << 16) | (rgb[0] << 8) | rgb[0]) :
+                                                      (0xff000000u | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2]);
+        }
+    }
+    delete [] row;
+#endif
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    return image_data;
+}
+
+unsigned char *Decoder::decompressJpegGray(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    struct jpeg_decompress_struct cinfo;
+    DecoderErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = decoderErrorExit;
+
+    unsigned char * volatile image_data = nullptr;
+
+    if (setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        delete [] image_data;
+        return nullptr;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *) buffer, (unsigned long) buffer_size);
+    jpeg_read_header(&cinfo, true);
+
+    // both libjpeg variants output luminance directly, for colour JPEGs the chroma is not decoded
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    image_data = new unsigned char [(size_t) cinfo.output_width * cinfo.output_height];
+
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row_pointer [1];
+        row_pointer[0] = (JSAMPLE *) (image_data + (size_t) cinfo.output_scanline * cinfo.output_width);
+        jpeg_read_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    return image_data;
+}
+
+unsigned int *Decoder::decompressWebp(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    if (!WebPGetInfo((const uint8_t *) buffer, buffer_size, width, height)) return nullptr;
+
+    const size_t num_pixels = (size_t) *width * *height;
+    unsigned int *image_data = new unsigned int [num_pixels];
+
+    // BGRA byte order is the same as xRGB in little endian integers
+    if (!WebPDecodeBGRAInto((const uint8_t *) buffer, buffer_size, (uint8_t *) image_data, num_pixels * 4, *width * 4)) {
+        delete [] image_data;
+        return nullptr;
+    }
+
+    return image_data;
+}
@@ -1,48 +1,36 @@
-/*
-    Copyright 2016 Oleksandr Murashko, John Thomson.
-    This file is part of ACACIA Image Processing Tool.
-
-    ACACIA is free software: you can redistribute it and/or modify
-    it under the terms of the GNU General Public License as published by
-    the Free Software Foundation, either version 3 of the License, or
-    (at your option) any later version.
-
-    ACACIA is distributed in the hope that it will be useful,
-    but WITHOUT ANY WARRANTY; without even the implied warranty of
-    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-    GNU General Public License for more details.
-
-    You should have received a copy of the GNU General Public License
-    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
-*/
-
-
-#include <QPainter>
-#include "imagebox.h"
-
-ImageBox::ImageBox(QWidget *parent) : QWidget(parent) {}
-
-void ImageBox::paintEvent(QPaintEvent*)
-{
-    QPainter painter(this);
-
-    painter.fillRect(QRect(0, 0, this->width(), this->height()), Qt::gray);
-
-    QPen pen(Qt::darkGray);
-    pen.setWidth(4);
-    painter.setPen(pen);
-    for (int i = 0;  i < this->width() + this->height();  i += 12) painter.drawLine(i, 0, 0, i);
-
-    if (!image.isNull()) painter.drawImage(0, 0, image.scaled(this->width(), this->height(), Qt::KeepAspectRatio));
-}
-
-QImage ImageBox::getImage()
-{
-    return image;
-}
-
-void ImageBox::setImage(QImage image)
-{
-    this->image = image;
-    this->update();
-}
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DECODER_H
+#define DECODER_H
+
+// Decoders for images produced by Encoder.
+// Both functions return a newly allocated (new []) xRGB buffer in the same layout as the encoder input,
+// or nullptr if the data can't be decoded.
+class Decoder
+{
+public:
+    static unsigned int *decompressJpeg(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+    static unsigned int *decompressWebp(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+
+    // 8-bit luminance without row padding (new []), for single-component JPEGs
+    static unsigned char *decompressJpegGray(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+};
+
+#endif // DECODER_H
@@ -0,0 +1,768 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "encoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+#include <jerror.h>
+
+#include "webp/encode.h"
+
+#include "yuvimage.h"
+
+
+#define USE_LIBJPEG_TURBO
+
+#ifndef USE_LIBJPEG_TURBO
+    #define USE_LIBJPEG
+#endif
+
+
+unsigned char *Encoder::compressToJpeg(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long *out_buffer_size,
+                                       const EncoderOptions &options)
+{
+    // Input parameters
+
+    const bool optimize_coding = options.optimizeHuffman;    // Huffman code optimization option - very important
+
+#ifdef USE_LIBJPEG_TURBO
+    const int num_input_components = 4;
+    const J_COLOR_SPACE input_color_space = JCS_EXT_BGRX;
+    const unsigned char *image_data = bgrx_image_data;
+#endif
+
+#ifdef USE_LIBJPEG
+    const int num_input_components = 3;
+    const J_COLOR_SPACE input_color_space = JCS_RGB;
+    unsigned char *image_data = new unsigned char [width * height * num_input_components];
+    int counter = 0;
+    for (int pixel_num = 0;  pixel_num < width * height;  pixel_num++)
+    {
+        const unsigned int pixel = ((unsigned int *) bgrx_image_data) [pixel_num];
+        image_data[counter++] = (unsigned char) (pixel >> 16);
+        image_data[counter++] = (unsigned char) (pixel >> 8);
+        image_data[counter++] = (unsigned char) (pixel);
+    }
+#endif
+
+    // Initialize compression structure
+
+    struct jpeg_error_mgr jerr;
+    struct jpeg_compress_struct cinfo;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    // Specify destination in memory
+
+    unsigned char *out_buffer = NULL;
+    jpeg_mem_dest(&cinfo, &out_buffer, (long unsigned int*) out_buffer_size);
+
+    // Set main parameters for compression
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = num_input_components;
+    cinfo.in_color_space = input_color_space;
+    jpeg_set_defaults(&cinfo);
+
+    // Set optional parameters
+
+    cinfo.optimize_coding = optimize_coding;
+    jpeg_set_quality(&cinfo, quality, true);
+
+    // Start compression
+
+    jpeg_start_compress(&cinfo, true);
+
+    JSAMPROW row_pointer [1];
+
+    const int row_stride = cinfo.image_width * num_input_components;
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        row_pointer[0] = (JSAMPLE *) (image_data + cinfo.next_scanline * row_stride);
+        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    // Image is compressed into memory!
+
+#ifdef USE_LIBJPEG
+    delete [] image_data;
+#endif
+
+    return out_buffer;
+}
+
+// The fourth byte of xRGB pixels is not alpha: they are imported as BGRX, so the encoder sees an opaque image whatever
+// the caller left there. For opaque pixels this is the same conversion as in WebPEncodeBGRA(). The picture owns
+// the converted planes, they are released by WebPPictureFree().
+static bool importBgrx(WebPPicture *picture, const unsigned char *bgrx_image_data, int width, int height, int stride)
+{
+    picture->use_argb = 0;
+    picture->width = width;
+    picture->height = height;
+    return WebPPictureImportBGRX(picture, (const uint8_t *) bgrx_image_data, stride) != 0;
+}
+
+unsigned char *Encoder::compressToWebp(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long *out_buffer_size,
+                                       const EncoderOptions &options)
+{
+    // the default preset, like WebPEncodeBGRA(), which has no method and would take x as alpha
+    *out_buffer_size = 0;
+    WebPConfig config;
+    WebPPicture picture;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float) quality) || !WebPPictureInit(&picture)) return NULL;
+    config.method = options.webpMethod;
+
+    if (!importBgrx(&picture, bgrx_image_data, width, height, width * 4)) return NULL;
+
+    WebPMemoryWriter writer;
+    WebPMemoryWriterInit(&writer);
+    picture.writer = WebPMemoryWrite;
+    picture.custom_ptr = &writer;
+
+    const bool ok = WebPEncode(&config, &picture);
+    WebPPictureFree(&picture);
+    if (!ok) {
+        WebPMemoryWriterClear(&writer);
+        return NULL;
+    }
+
+    *out_buffer_size = writer.size;
+    return writer.mem;
+}
+
+unsigned char *Encoder::compressGrayToJpeg(const unsigned char *gray_image_data, int width, int height, int quality, unsigned long long *out_buffer_size,
+                                           const EncoderOptions &options)
+{
+    // luminance and its quantization are the same as in a colour JPEG of the expanded image,
+    // only the chroma components (constant for gray pixels) are not stored
+    struct jpeg_error_mgr jerr;
+    struct jpeg_compress_struct cinfo;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char *out_buffer = NULL;
+    jpeg_mem_dest(&cinfo, &out_buffer, (long unsigned int*) out_buffer_size);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 1;
+    cinfo.in_color_space = JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+
+    cinfo.optimize_coding = options.optimizeHuffman;
+    jpeg_set_quality(&cinfo, quality, true);
+
+    jpeg_start_compress(&cinfo, true);
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        JSAMPROW row_pointer [1];
+        row_pointer[0] = (JSAMPLE *) (gray_image_data + (long long int) cinfo.next_scanline * width);
+        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    return out_buffer;
+}
+
+unsigned char *Encoder::compressGrayToWebp(const unsigned char *gray_image_data, int width, int height, int quality, unsigned long long *out_buffer_size,
+                                           const EncoderOptions &options)
+{
+    *out_buffer_size = 0;
+
+    // the same preset as compressToWebp()
+    WebPConfig config;
+    WebPPicture picture;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float) quality) || !WebPPictureInit(&picture)) return NULL;
+    config.method = options.webpMethod;
+
+    picture.use_argb = 0;
+    picture.colorspace = WEBP_YUV420;
+    picture.width = width;
+    picture.height = height;
+    if (!WebPPictureAlloc(&picture)) return NULL;
+
+    // the RGB to Y conversion of libwebp for R = G = B = v: (16839 + 33059 + 6420) * v + 16.5 * 65536 >> 16,
+    // chroma is 128 for any gray pixel, so the result is the same as importing the expanded image
+    unsigned char luma [256];
+    for (int v = 0;  v < 256;  v++) luma[v] = (unsigned char) ((56318 * v + (16 << 16) + (1 << 15)) >> 16);
+
+    for (int y = 0;  y < height;  y++)
+    {
+        const unsigned char *gray_row = gray_image_data + (long long int) y * width;
+        unsigned char *y_row = picture.y + (long long int) y * picture.y_stride;
+        for (int x = 0;  x < width;  x++) y_row[x] = luma[gray_row[x]];
+    }
+    for (int y = 0;  y < (height + 1) / 2;  y++)
+    {
+        memset(picture.u + (long long int) y * picture.uv_stride, 128, (width + 1) / 2);
+        memset(picture.v + (long long int) y * picture.uv_stride, 128, (width + 1) / 2);
+    }
+
+    WebPMemoryWriter writer;
+    WebPMemoryWriterInit(&writer);
+    picture.writer = WebPMemoryWrite;
+    picture.custom_ptr = &writer;
+
+    const bool ok = WebPEncode(&config, &picture);
+    WebPPictureFree(&picture);
+    if (!ok) {
+        WebPMemoryWriterClear(&writer);
+        return NULL;
+    }
+
+    *out_buffer_size = writer.size;
+    return writer.mem;
+}
+
+void Encoder::freeBuffer(unsigned char *buffer)
+{
+    // jpeg_mem_dest() and WebPMemoryWriter allocate output with malloc()
+    free(buffer);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Encoding into EncoderSink
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Size of the intermediate chunk used for callbacks and for counting bytes after the caller's buffer is full.
+// It's a part of the destination manager on the stack, so encoding doesn't allocate output memory.
+static const int sinkChunkSize = 16384;
+
+// Output window of a sink: the caller's buffer first (in buffer mode), then the chunk.
+// Returns false if a callback asked to abort encoding.
+struct SinkWriter
+{
+    EncoderSink *sink;
+    unsigned long long int flushed;    // bytes before the current window
+    bool overflow;
+    bool aborted;
+    unsigned char chunk [sinkChunkSize];
+
+    void init(EncoderSink *s)
+    {
+        sink = s;
+        flushed = 0;
+        overflow = false;
+        aborted = false;
+    }
+
+    // appends data of any size; used by the WebP writer callback
+    bool append(const unsigned char *data, unsigned long long int size)
+    {
+        if (sink->write)
+        {
+            if (!sink->write(sink->context, data, size)) aborted = true;
+        }
+        else if (!overflow && size <= sink->capacity - flushed)
+        {
+            memcpy(sink->buffer + flushed, data, size);
+        }
+        else overflow = true;
+
+        flushed += size;
+        return !aborted;
+    }
+};
+
+// libjpeg terminates the process on errors by default, which is not acceptable in a library
+struct EncoderErrorManager
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmpBuffer;
+};
+
+static void encoderErrorExit(j_common_ptr cinfo)
+{
+    EncoderErrorManager *err = (EncoderErrorManager *) cinfo->err;
+    longjmp(err->setjmpBuffer, 1);
+}
+
+// libjpeg destination manager writing into a sink
+struct SinkDestination
+{
+    struct jpeg_destination_mgr pub;
+    SinkWriter writer;
+    bool inChunk;    // the current window is the chunk, not the caller's buffer
+};
+
+static void sinkInitDestination(j_compress_ptr cinfo)
+{
+    SinkDestination *dest = (SinkDestination *) cinfo->dest;
+    EncoderSink *sink = dest->writer.sink;
+    dest->inChunk = sink->write || sink->capacity == 0;
+    dest->pub.next_output_byte = dest->inChunk ? dest->writer.chunk : sink->buffer;
+    dest->pub.free_in_buffer = dest->inChunk ? sinkChunkSize : sink->capacity;
+}
+
+static boolean sinkEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+    // libjpeg calls this only when the whole window is full
+    SinkDestination *dest = (SinkDestination *) cinfo->dest;
+    if (!dest->inChunk)
+    {
+        // the caller's buffer is full; libjpeg calls this right after the last byte fits,
+        // so it's an overflow only if anything else is written, the rest is then counted to report the required size
+        dest->writer.flushed = dest->writer.sink->capacity;
+        dest->inChunk = true;
+    }
+    else if (!dest->writer.append(dest->writer.chunk, sinkChunkSize))
+    {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+
+    dest->pub.next_output_byte = dest->writer.chunk;
+    dest->pub.free_in_buffer = sinkChunkSize;
+    return TRUE;
+}
+
+static void sinkTermDestination(j_compress_ptr cinfo)
+{
+    SinkDestination *dest = (SinkDestination *) cinfo->dest;
+    if (!dest->inChunk) {
+        dest->writer.flushed = dest->writer.sink->capacity - dest->pub.free_in_buffer;
+        return;
+    }
+    if (!dest->writer.append(dest->writer.chunk, sinkChunkSize - dest->pub.free_in_buffer)) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+}
+
+EncoderResult Encoder::compressToJpeg(const unsigned char *bgrx_image_data, int width, int height, int stride, int quality, EncoderSink *sink)
+{
+    // the same parameters as for the allocating version, otherwise predictions would not match
+    const bool optimize_coding = true;
+
+    struct jpeg_compress_struct cinfo;
+    EncoderErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = encoderErrorExit;
+
+    SinkDestination dest;
+    dest.writer.init(sink);
+    sink->size = 0;
+
+    if (setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_compress(&cinfo);
+        return dest.writer.aborted ? EncoderWriteFailed : EncoderFailed;
+    }
+
+    jpeg_create_compress(&cinfo);
+
+    dest.pub.init_destination = sinkInitDestination;
+    dest.pub.empty_output_buffer = sinkEmptyOutputBuffer;
+    dest.pub.term_destination = sinkTermDestination;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+
+#ifdef USE_LIBJPEG_TURBO
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_EXT_BGRX;
+#endif
+
+#ifdef USE_LIBJPEG
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+#endif
+
+    jpeg_set_defaults(&cinfo);
+    cinfo.optimize_coding = optimize_coding;
+    jpeg_set_quality(&cinfo, quality, true);
+
+    jpeg_start_compress(&cinfo, true);
+
+#ifdef USE_LIBJPEG
+    // a single RGB row from the image pool of the compressor, freed by jpeg_finish_compress()
+    JSAMPARRAY rgb_row = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, width * 3, 1);
+#endif
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        const unsigned char *row = bgrx_image_data + (long long int) cinfo.next_scanline * stride;
+        JSAMPROW row_pointer [1];
+
+#ifdef USE_LIBJPEG_TURBO
+        row_pointer[0] = (JSAMPROW) row;
+#endif
+
+#ifdef USE_LIBJPEG
+        for (int x = 0;  x < width;  x++)
+        {
+            rgb_row[0][x * 3]     = row[x * 4 + 2];
+            rgb_row[0][x * 3 + 1] = row[x * 4 + 1];
+            rgb_row[0][x * 3 + 2] = row[x * 4];
+        }
+        row_pointer[0] = rgb_row[0];
+#endif
+
+        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    sink->size = dest.writer.flushed;
+    return dest.writer.overflow ? EncoderBufferTooSmall : EncoderOk;
+}
+
+static int webpSinkWriter(const uint8_t *data, size_t data_size, const WebPPicture *picture)
+{
+    SinkWriter *writer = (SinkWriter *) picture->custom_ptr;
+    return writer->append(data, data_size) ? 1 : 0;
+}
+
+EncoderResult Encoder::compressToWebp(const unsigned char *bgrx_image_data, int width, int height, int stride, int quality, EncoderSink *sink)
+{
+    // the same preset and import as the allocating compressToWebp(), so the files are identical
+    WebPConfig config;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float) quality)) return EncoderFailed;
+
+    WebPPicture picture;
+    if (!WebPPictureInit(&picture)) return EncoderFailed;
+    if (!importBgrx(&picture, bgrx_image_data, width, height, stride)) return EncoderFailed;
+
+    // the writer is a local variable, its chunk is not used for WebP
+    SinkWriter writer;
+    writer.init(sink);
+    picture.writer = webpSinkWriter;
+    picture.custom_ptr = &writer;
+
+    const bool ok = WebPEncode(&config, &picture);
+    WebPPictureFree(&picture);
+
+    sink->size = writer.flushed;
+    if (writer.aborted) return EncoderWriteFailed;
+    if (!ok) return EncoderFailed;
+    return writer.overflow ? EncoderBufferTooSmall : EncoderOk;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Planar YUV input
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Lookup tables between the full range of JPEG and the video range of WebP, both with the BT.601 matrix,
+// so a change of range is only a scaling of every sample around 0 (luma) or 128 (chroma)
+static void makeRangeTables(bool toFullRange, unsigned char *luma, unsigned char *chroma)
+{
+    for (int i = 0;  i < 256;  i++)
+    {
+        const double y = toFullRange ? (i - 16) * 255.0 / 219.0 : 16 + i * 219.0 / 255.0;
+        const double c = toFullRange ? 128 + (i - 128) * 255.0 / 224.0 : 128 + (i - 128) * 224.0 / 255.0;
+        luma[i] = (unsigned char) (y < 0 ? 0 : y > 255 ? 255 : (int) (y + 0.5));
+        chroma[i] = (unsigned char) (c < 0 ? 0 : c > 255 ? 255 : (int) (c + 0.5));
+    }
+}
+
+EncoderResult Encoder::compressYuvToJpeg(const YuvImage &image, int quality, EncoderSink *sink, const EncoderOptions &options)
+{
+    // the same parameters as for the xRGB versions, otherwise predictions would not match
+    const bool optimize_coding = options.optimizeHuffman;
+
+    struct jpeg_compress_struct cinfo;
+    EncoderErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = encoderErrorExit;
+
+    SinkDestination dest;
+    dest.writer.init(sink);
+    sink->size = 0;
+
+    if (setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_compress(&cinfo);
+        return dest.writer.aborted ? EncoderWriteFailed : EncoderFailed;
+    }
+
+    jpeg_create_compress(&cinfo);
+
+    dest.pub.init_destination = sinkInitDestination;
+    dest.pub.empty_output_buffer = sinkEmptyOutputBuffer;
+    dest.pub.term_destination = sinkTermDestination;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = image.width;
+    cinfo.image_height = image.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+
+    // the default sampling of YCbCr is 2x2 for luma and 1x1 for chroma, i.e. 4:2:0 like the xRGB versions
+    jpeg_set_defaults(&cinfo);
+    cinfo.optimize_coding = optimize_coding;
+    jpeg_set_quality(&cinfo, quality, true);
+    cinfo.raw_data_in = TRUE;
+
+    jpeg_start_compress(&cinfo, true);
+
+    // raw data is written in units of 16 lines padded to whole MCUs; the rows are copied into buffers from the image
+    // pool with the last row and column repeated, which also interleaved chroma and the range need
+    const int mcuLines = 16;
+    const int lumaWidth = (image.width + 15) / 16 * 16;
+    const int chromaWidth = lumaWidth / 2;
+    const int chromaSamples = (image.width + 1) / 2;
+    const int chromaHeight = (image.height + 1) / 2;
+    JSAMPARRAY rows [3];
+
+    // padded full range I420 planes (e.g. the conversion written by FeatureExtractor) are passed in place
+    const bool inPlace = image.padded && image.fullRange && image.uvStep == 1;
+    JSAMPROW planeRows [mcuLines * 2];
+    if (inPlace)
+    {
+        rows[0] = planeRows;
+        rows[1] = planeRows + mcuLines;
+        rows[2] = planeRows + mcuLines * 3 / 2;
+    }
+    else
+    {
+        rows[0] = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, lumaWidth, mcuLines);
+        rows[1] = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, chromaWidth, mcuLines / 2);
+        rows[2] = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, chromaWidth, mcuLines / 2);
+    }
+
+    unsigned char luma [256];
+    unsigned char chroma [256];
+    makeRangeTables(true, luma, chroma);
+    if (image.fullRange) {
+        for (int i = 0;  i < 256;  i++) luma[i] = chroma[i] = (unsigned char) i;
+    }
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        const int top = cinfo.next_scanline;
+        if (inPlace)
+        {
+            for (int line = 0;  line < mcuLines;  line++) rows[0][line] = (JSAMPROW) image.y + (long long int) (top + line) * image.yStride;
+            for (int line = 0;  line < mcuLines / 2;  line++)
+            {
+                rows[1][line] = (JSAMPROW) image.u + (long long int) (top / 2 + line) * image.uvStride;
+                rows[2][line] = (JSAMPROW) image.v + (long long int) (top / 2 + line) * image.uvStride;
+            }
+        }
+        else
+        {
+            for (int line = 0;  line < mcuLines;  line++)
+            {
+                const int row = (top + line < image.height) ? top + line : image.height - 1;
+                const unsigned char *source = image.y + (long long int) row * image.yStride;
+                JSAMPROW target = rows[0][line];
+                for (int x = 0;  x < image.width;  x++) target[x] = luma[source[x]];
+                for (int x = image.width;  x < lumaWidth;  x++) target[x] = target[image.width - 1];
+            }
+            for (int line = 0;  line < mcuLines / 2;  line++)
+            {
+                const int row = (top / 2 + line < chromaHeight) ? top / 2 + line : chromaHeight - 1;
+                const unsigned char *source [2] = {image.u + (long long int) row * image.uvStride, image.v + (long long int) row * image.uvStride};
+                for (int c = 0;  c < 2;  c++)
+                {
+                    JSAMPROW target = rows[c + 1][line];
+                    for (int x = 0;  x < chromaSamples;  x++) target[x] = chroma[source[c][x * image.uvStep]];
+                    for (int x = chromaSamples;  x < chromaWidth;  x++) target[x] = target[chromaSamples - 1];
+                }
+            }
+        }
+        jpeg_write_raw_data(&cinfo, rows, mcuLines);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    sink->size = dest.writer.flushed;
+    return dest.writer.overflow ? EncoderBufferTooSmall : EncoderOk;
+}
+
+// EncoderSink callback collecting the output in a malloc() buffer, which is released with freeBuffer()
+struct GrowingBuffer
+{
+    unsigned char *data;
+    unsigned long long int size;
+    unsigned long long int capacity;
+};
+
+static bool growingBufferWrite(void *context, const unsigned char *data, unsigned long long int size)
+{
+    GrowingBuffer *buffer = (GrowingBuffer *) context;
+    if (size > buffer->capacity - buffer->size)
+    {
+        unsigned long long int capacity = buffer->capacity ? buffer->capacity : 65536;
+        while (capacity - buffer->size < size) capacity *= 2;
+        unsigned char *grown = (unsigned char *) realloc(buffer->data, capacity);
+        if (!grown) return false;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return true;
+}
+
+unsigned char *Encoder::compressYuvToJpeg(const YuvImage &image, int quality, unsigned long long *out_buffer_size,
+                                          const EncoderOptions &options)
+{
+    GrowingBuffer buffer = {nullptr, 0, 0};
+    EncoderSink sink = {nullptr, 0, growingBufferWrite, &buffer, 0};
+    if (compressYuvToJpeg(image, quality, &sink, options) != EncoderOk) {
+        free(buffer.data);
+        *out_buffer_size = 0;
+        return nullptr;
+    }
+    *out_buffer_size = buffer.size;
+    return buffer.data;
+}
+
+EncoderResult Encoder::compressYuvToWebp(const YuvImage &image, int quality, EncoderSink *sink)
+{
+    WebPConfig config;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float) quality)) return EncoderFailed;
+
+    WebPPicture picture;
+    if (!WebPPictureInit(&picture)) return EncoderFailed;
+
+    picture.use_argb = 0;
+    picture.colorspace = WEBP_YUV420;
+    picture.width = image.width;
+    picture.height = image.height;
+
+    // I420 in the video range is exactly the picture format of libwebp and is read in place;
+    // other frames are copied into planes allocated by the encoder, freed by WebPPictureFree()
+    if (image.uvStep == 1 && !image.fullRange) {
+        picture.y = (uint8_t *) image.y;
+        picture.u = (uint8_t *) image.u;
+        picture.v = (uint8_t *) image.v;
+        picture.y_stride = image.yStride;
+        picture.uv_stride = image.uvStride;
+    } else {
+        if (!WebPPictureAlloc(&picture)) return EncoderFailed;
+
+        unsigned char luma [256];
+        unsigned char chroma [256];
+        makeRangeTables(false, luma, chroma);
+        if (!image.fullRange) {
+            for (int i = 0;  i < 256;  i++) luma[i] = chroma[i] = (unsigned char) i;
+        }
+
+        for (int y = 0;  y < image.height;  y++)
+        {
+            const unsigned char *source = image.y + (long long int) y * image.yStride;
+            unsigned char *target = picture.y + (long long int) y * picture.y_stride;
+            for (int x = 0;  x < image.width;  x++) target[x] = luma[source[x]];
+        }
+        for (int y = 0;  y < (image.height + 1) / 2;  y++)
+        {
+            const unsigned char *u = image.u + (long long int) y * image.uvStride;
+            const unsigned char *v = image.v + (long long int) y * image.uvStride;
+            unsigned char *uTarget = picture.u + (long long int) y * picture.uv_stride;
+            unsigned char *vTarget = picture.v + (long long int) y * picture.uv_stride;
+            for (int x = 0;  x < (image.width + 1) / 2;  x++)
+            {
+                uTarget[x] = chroma[u[x * image.uvStep]];
+                vTarget[x] = chroma[v[x * image.uvStep]];
+            }
+        }
+    }
+
+    SinkWriter writer;
+    writer.init(sink);
+    picture.writer = webpSinkWriter;
+    picture.custom_ptr = &writer;
+
+    const bool ok = WebPEncode(&config, &picture);
+    WebPPictureFree(&picture);    // releases only the planes allocated above
+
+    sink->size = writer.flushed;
+    if (writer.aborted) return EncoderWriteFailed;
+    if (!ok) return EncoderFailed;
+    return writer.overflow ? EncoderBufferTooSmall : EncoderOk;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Lossless transcoding
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned char *Encoder::optimizeJpeg(const unsigned char *jpeg_data, unsigned long long int jpeg_size, bool progressive,
+                                     unsigned long long int *out_buffer_size)
+{
+    *out_buffer_size = 0;
+
+    // both structures report errors to one manager; zeroed, so destroying a structure which wasn't created is harmless
+    struct jpeg_decompress_struct srcinfo;
+    struct jpeg_compress_struct dstinfo;
+    memset(&srcinfo, 0, sizeof(srcinfo));
+    memset(&dstinfo, 0, sizeof(dstinfo));
+    EncoderErrorManager jerr;
+    srcinfo.err = jpeg_std_error(&jerr.pub);
+    dstinfo.err = &jerr.pub;
+    jerr.pub.error_exit = encoderErrorExit;
+
+    unsigned char *out_buffer = NULL;
+    unsigned long out_size = 0;
+
+    if (setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_compress(&dstinfo);
+        jpeg_destroy_decompress(&srcinfo);
+        free(out_buffer);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&srcinfo);
+    jpeg_create_compress(&dstinfo);
+
+    jpeg_mem_src(&srcinfo, (unsigned char *) jpeg_data, (unsigned long) jpeg_size);
+    jpeg_save_markers(&srcinfo, JPEG_COM, 0xffff);
+    for (int i = 0;  i < 16;  i++) jpeg_save_markers(&srcinfo, JPEG_APP0 + i, 0xffff);
+    jpeg_read_header(&srcinfo, TRUE);
+    jvirt_barray_ptr *coefficients = jpeg_read_coefficients(&srcinfo);
+
+    jpeg_copy_critical_parameters(&srcinfo, &dstinfo);
+    dstinfo.optimize_coding = TRUE;
+    if (progressive || srcinfo.progressive_mode) jpeg_simple_progression(&dstinfo);
+
+    jpeg_mem_dest(&dstinfo, &out_buffer, &out_size);
+    jpeg_write_coefficients(&dstinfo, coefficients);
+
+    // like jpegtran, JFIF and Adobe markers are not copied if libjpeg writes its own
+    for (jpeg_saved_marker_ptr marker = srcinfo.marker_list;  marker;  marker = marker->next)
+    {
+        const bool jfif = marker->marker == JPEG_APP0 && marker->data_length >= 5 && memcmp(marker->data, "JFIF", 5) == 0;
+        const bool adobe = marker->marker == JPEG_APP0 + 14 && marker->data_length >= 5 && memcmp(marker->data, "Adobe", 5) == 0;
+        if ((jfif && dstinfo.write_JFIF_header) || (adobe && dstinfo.write_Adobe_marker)) continue;
+        jpeg_write_marker(&dstinfo, marker->marker, marker->data, marker->data_length);
+    }
+
+    jpeg_finish_compress(&dstinfo);
+    jpeg_destroy_compress(&dstinfo);
+    jpeg_finish_decompress(&srcinfo);
+    jpeg_destroy_decompress(&srcinfo);
+
+    *out_buffer_size = out_size;
+    return out_buffer;
+}
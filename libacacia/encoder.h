@@ -0,0 +1,98 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+// Destination of compressed data: a buffer owned by the caller or a callback receiving the data in chunks.
+// If write is null the buffer is used. In both cases size receives the total size of the compressed image,
+// also when the buffer was too small, so the caller can retry with a larger one.
+struct EncoderSink
+{
+    unsigned char *buffer;
+    unsigned long long int capacity;
+
+    // returns false to abort encoding
+    bool (*write)(void *context, const unsigned char *data, unsigned long long int size);
+    void *context;
+
+    unsigned long long int size;
+};
+
+struct YuvImage;
+
+// Encoder effort. The defaults are the settings the models were trained with and are used by all functions
+// without options; lower effort is faster, but the files are larger than predicted (see deadlineplanner.h).
+struct EncoderOptions
+{
+    bool optimizeHuffman;    // JPEG: optimized Huffman tables, an additional pass over the coefficients
+    int webpMethod;          // WebP: speed and compression trade-off, 0 (fastest) to 6
+
+    EncoderOptions() : optimizeHuffman(true), webpMethod(defaultWebpMethod) {}
+
+    static const int defaultWebpMethod = 4;    // WEBP_PRESET_DEFAULT
+};
+
+enum EncoderResult
+{
+    EncoderOk = 0,
+    EncoderBufferTooSmall,
+    EncoderWriteFailed,
+    EncoderFailed
+};
+
+class Encoder
+{
+public:
+    // compressed data is allocated by the codec libraries, release it with freeBuffer()
+    static unsigned char *compressToJpeg(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size,
+                                         const EncoderOptions &options = EncoderOptions());
+    static unsigned char *compressToWebp(const unsigned char *bgrx_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size,
+                                         const EncoderOptions &options = EncoderOptions());
+    static void freeBuffer(unsigned char *buffer);
+
+    // 8-bit grayscale images: a single-component JPEG, and a WebP whose YUV planes are filled directly
+    // (luminance converted to the video range, constant chroma), without the RGB import of the encoder
+    static unsigned char *compressGrayToJpeg(const unsigned char *gray_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size,
+                                             const EncoderOptions &options = EncoderOptions());
+    static unsigned char *compressGrayToWebp(const unsigned char *gray_image_data, int width, int height, int quality, unsigned long long int *out_buffer_size,
+                                             const EncoderOptions &options = EncoderOptions());
+
+    // the same without an output allocation; stride is the distance between rows in bytes
+    static EncoderResult compressToJpeg(const unsigned char *bgrx_image_data, int width, int height, int stride, int quality, EncoderSink *sink);
+    static EncoderResult compressToWebp(const unsigned char *bgrx_image_data, int width, int height, int stride, int quality, EncoderSink *sink);
+
+    // planar YUV 4:2:0 frames (see yuvimage.h) without colour conversion: JPEG receives the planes as raw data,
+    // in place if they are padded, WebP reads an I420 frame in the video range in place; other layouts and ranges
+    // are only copied or rescaled
+    static EncoderResult compressYuvToJpeg(const YuvImage &image, int quality, EncoderSink *sink, const EncoderOptions &options = EncoderOptions());
+    static EncoderResult compressYuvToWebp(const YuvImage &image, int quality, EncoderSink *sink);
+
+    // the same with the output allocated like compressToJpeg()
+    static unsigned char *compressYuvToJpeg(const YuvImage &image, int quality, unsigned long long int *out_buffer_size,
+                                            const EncoderOptions &options = EncoderOptions());
+
+    // Lossless transcoding of a JPEG file: the DCT coefficients are copied and the Huffman tables optimized, a progressive
+    // file stays progressive and a baseline one becomes progressive if requested; metadata (APPn, COM) is copied.
+    // The output is allocated like compressToJpeg(); nullptr if the data can't be read.
+    static unsigned char *optimizeJpeg(const unsigned char *jpeg_data, unsigned long long int jpeg_size, bool progressive,
+                                       unsigned long long int *out_buffer_size);
+};
+
+#endif // ENCODER_H
@@ -0,0 +1,746 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "featureextractor.h"
+#include "featurekernels.h"
+#include "taskscheduler.h"
+#include "yuvimage.h"
+#include "math.h"
+
+#include <string.h>
+#include <functional>
+#include <vector>
+
+void FeatureExtractor::calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, double *features)
+{
+    calculateFeatures(imageData, imageWidth, imageHeight, imageWidth, features);
+}
+
+void FeatureExtractor::calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features)
+{
+    calculateFeatures(imageData, imageWidth, imageHeight, imageStride, features, (const FeatureProgress *) nullptr);
+}
+
+void FeatureSums::clear()
+{
+    absSumG1x1 = sqrSumG1x1 = 0;
+    absSumG2x2 = sqrSumG2x2 = 0;
+    absSumG4x4 = sqrSumG4x4 = 0;
+    absSumD2x2 = absSumD4x4 = 0;
+    absSumG2UV = 0;
+    absSumCheckboard = 0;
+    numFragments = 0;
+}
+
+void FeatureSums::add(const FeatureSums &other)
+{
+    absSumG1x1 += other.absSumG1x1;
+    sqrSumG1x1 += other.sqrSumG1x1;
+    absSumG2x2 += other.absSumG2x2;
+    sqrSumG2x2 += other.sqrSumG2x2;
+    absSumG4x4 += other.absSumG4x4;
+    sqrSumG4x4 += other.sqrSumG4x4;
+    absSumD2x2 += other.absSumD2x2;
+    absSumD4x4 += other.absSumD4x4;
+    absSumG2UV += other.absSumG2UV;
+    absSumCheckboard += other.absSumCheckboard;
+    numFragments += other.numFragments;
+}
+
+/**
+ * @brief calculateFeatures - this function calculates all necessaary features for entire image fragment by fragment
+ * Note: when training regression models features F9 and F10 were mixed up, so this function was corrected to reflect the changes.
+ * imageStride is the distance between rows in pixels, so images with padded rows can be processed in place.
+ * Progress is reported (and cancellation checked) after every 16 rows of fragments, i.e. 128 lines of the image.
+ */
+bool FeatureExtractor::calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, const FeatureProgress *progress)
+{
+    const int fragmentSize = 8;
+    const int progressInterval = 16;
+    const int numFragmentsInCol = imageHeight / fragmentSize;
+
+    FeatureSums sums;
+    sums.clear();
+
+    for (int frow = 0;  frow < numFragmentsInCol;  frow += progressInterval)
+    {
+        const int endRow = (frow + progressInterval < numFragmentsInCol) ? frow + progressInterval : numFragmentsInCol;
+        accumulateFeatures(imageData, imageWidth, imageStride, frow, endRow, &sums);
+
+        if (progress && endRow < numFragmentsInCol && !progress->report(progress->context, (double) endRow / numFragmentsInCol)) return false;
+    }
+
+    if (progress) progress->report(progress->context, 1.0);
+
+    finishFeatures(sums, features);
+    return true;
+}
+
+// Sums over all rows of fragments; large images are split into bands of fragment rows calculated as tasks
+static bool accumulateInBands(int imageWidth, int imageHeight, TaskScheduler *scheduler, FeatureSums *sums,
+                              const std::function<void (int firstFragmentRow, int endFragmentRow, FeatureSums *sums)> &accumulate)
+{
+    const int fragmentSize = 8;
+    const int numFragmentsInCol = imageHeight / fragmentSize;
+
+    // a band should be long enough to amortize the task overhead, small images are calculated by the caller
+    const int bandRows = 32;
+    if (!scheduler || (long long int) imageWidth * imageHeight < FeatureExtractor::minParallelPixels || numFragmentsInCol < 2 * bandRows) return false;
+
+    // every band has its own sums, they are integers, so the result doesn't depend on the order of addition
+    const int numBands = (numFragmentsInCol + bandRows - 1) / bandRows;
+    std::vector<FeatureSums> bandSums (numBands);
+    scheduler->parallelFor(numBands, 1, [&](int begin, int end) {
+        for (int band = begin;  band < end;  band++) {
+            bandSums[band].clear();
+            const int lastRow = (band + 1) * bandRows < numFragmentsInCol ? (band + 1) * bandRows : numFragmentsInCol;
+            accumulate(band * bandRows, lastRow, &bandSums[band]);
+        }
+    });
+
+    sums->clear();
+    for (int band = 0;  band < numBands;  band++) sums->add(bandSums[band]);
+    return true;
+}
+
+void FeatureExtractor::calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, TaskScheduler *scheduler)
+{
+    FeatureSums sums;
+    const bool split = accumulateInBands(imageWidth, imageHeight, scheduler, &sums, [&](int firstRow, int endRow, FeatureSums *bandSums) {
+        accumulateFeatures(imageData, imageWidth, imageStride, firstRow, endRow, bandSums);
+    });
+    if (!split) {
+        calculateFeatures(imageData, imageWidth, imageHeight, imageStride, features, (const FeatureProgress *) nullptr);
+        return;
+    }
+    finishFeatures(sums, features);
+}
+
+void FeatureExtractor::calculateGrayFeatures(const unsigned char *imageData, int imageWidth, int imageHeight, int imageStride, double *features, TaskScheduler *scheduler)
+{
+    FeatureSums sums;
+    const bool split = accumulateInBands(imageWidth, imageHeight, scheduler, &sums, [&](int firstRow, int endRow, FeatureSums *bandSums) {
+        accumulateGrayFeatures(imageData, imageWidth, imageStride, firstRow, endRow, bandSums);
+    });
+    if (!split) {
+        sums.clear();
+        accumulateGrayFeatures(imageData, imageWidth, imageStride, 0, imageHeight / 8, &sums);
+    }
+    finishFeatures(sums, features);
+}
+
+void FeatureExtractor::calculateYuvFeatures(const YuvImage &image, double *features, TaskScheduler *scheduler)
+{
+    FeatureSums sums;
+    const bool split = accumulateInBands(image.width, image.height, scheduler, &sums, [&](int firstRow, int endRow, FeatureSums *bandSums) {
+        accumulateYuvFeatures(image, firstRow, endRow, bandSums);
+    });
+    if (!split) {
+        sums.clear();
+        accumulateYuvFeatures(image, 0, image.height / 8, &sums);
+    }
+    finishFeatures(sums, features);
+}
+
+// Sums over every rowStep-th row of fragments, the middle one of each group of rowStep rows; at least one row is taken
+static void accumulateSampled(int imageHeight, int rowStep, FeatureSums *sums,
+                              const std::function<void (int firstFragmentRow, int endFragmentRow, FeatureSums *sums)> &accumulate)
+{
+    const int fragmentSize = 8;
+    const int numFragmentsInCol = imageHeight / fragmentSize;
+
+    sums->clear();
+    if (rowStep <= 1) {
+        accumulate(0, numFragmentsInCol, sums);
+        return;
+    }
+    const int firstRow = (numFragmentsInCol >= rowStep) ? rowStep / 2 : 0;
+    for (int frow = firstRow;  frow < numFragmentsInCol;  frow += rowStep) accumulate(frow, frow + 1, sums);
+}
+
+void FeatureExtractor::sampleFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, int rowStep, double *features)
+{
+    FeatureSums sums;
+    accumulateSampled(imageHeight, rowStep, &sums, [&](int firstRow, int endRow, FeatureSums *rowSums) {
+        accumulateFeatures(imageData, imageWidth, imageStride, firstRow, endRow, rowSums);
+    });
+    finishFeatures(sums, features);
+}
+
+void FeatureExtractor::sampleGrayFeatures(const unsigned char *imageData, int imageWidth, int imageHeight, int imageStride, int rowStep, double *features)
+{
+    FeatureSums sums;
+    accumulateSampled(imageHeight, rowStep, &sums, [&](int firstRow, int endRow, FeatureSums *rowSums) {
+        accumulateGrayFeatures(imageData, imageWidth, imageStride, firstRow, endRow, rowSums);
+    });
+    finishFeatures(sums, features);
+}
+
+// JPEG colour conversion of libjpeg (jccolor.c, the same in libjpeg-turbo): FIX(x) = x * 65536 + 0.5, luminance rounded
+// to nearest, chroma rounded down with an offset of 128. The luminance is identical to Y of the features; the chroma
+// of the features has slightly different coefficients of U and rounding, which the models were trained with.
+static inline int jpegLuma(unsigned int pixel)
+{
+    const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+    return (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+}
+
+static inline int jpegCb(unsigned int pixel)
+{
+    const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+    return (-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32767) >> 16;
+}
+
+static inline int jpegCr(unsigned int pixel)
+{
+    const int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+    return (32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32767) >> 16;
+}
+
+// 2x2 average of libjpeg's h2v2 downsampling (jcsample.c), rounded with a bias alternating 1, 2 from column to column
+static inline int jpegChromaAverage(int sum, int column)
+{
+    return (sum + 1 + (column & 1)) >> 2;
+}
+
+// 8 values of 0..255 to the low 8 bytes
+static inline __m128i packBytes(int32x8 x)
+{
+    const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    return _mm_packus_epi16(words, words);
+}
+
+// Downsamples two lines of 8 chroma values to 4 samples
+static inline void storeJpegChroma(int32x8 line0, int32x8 line1, unsigned char *target)
+{
+    const int32x8 sum = _mm256_add_epi32(line0, line1);
+    const __m128i pairs = _mm_hadd_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    const __m128i average = _mm_srli_epi32(_mm_add_epi32(pairs, _mm_setr_epi32(1, 2, 1, 2)), 2);
+    const __m128i words = _mm_packus_epi32(average, average);
+    const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    memcpy(target, &bytes, 4);
+}
+
+// Pixels of the conversion outside of whole fragments: the right and bottom edges of the image and the padding to whole
+// MCUs. libjpeg repeats the last column and, within the last pair of lines, the last line before the chroma is
+// downsampled, then the last line of every component to the end of the MCU row.
+static void convertJpegEdges(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, YuvBuffer *conversion)
+{
+    const int fragmentSize = 8;
+    const int fragmentWidth = imageWidth / fragmentSize * fragmentSize;
+    const int fragmentHeight = imageHeight / fragmentSize * fragmentSize;
+    const int lumaWidth = conversion->paddedWidth();
+    const int lumaHeight = conversion->paddedHeight();
+    const int chromaWidth = lumaWidth / 2;
+    const int chromaHeight = lumaHeight / 2;
+    const int chromaLines = (imageHeight + 1) / 2;
+
+    for (int line = 0;  line < imageHeight;  line++)
+    {
+        const unsigned int *source = imageData + (long long int) line * imageStride;
+        unsigned char *target = conversion->y() + (long long int) line * lumaWidth;
+        for (int x = (line < fragmentHeight) ? fragmentWidth : 0;  x < lumaWidth;  x++) {
+            target[x] = (unsigned char) jpegLuma(source[x < imageWidth ? x : imageWidth - 1]);
+        }
+    }
+    for (int line = imageHeight;  line < lumaHeight;  line++) {
+        memcpy(conversion->y() + (long long int) line * lumaWidth, conversion->y() + (long long int) (imageHeight - 1) * lumaWidth, lumaWidth);
+    }
+
+    for (int line = 0;  line < chromaLines;  line++)
+    {
+        const unsigned int *source0 = imageData + (long long int) (2 * line) * imageStride;
+        const unsigned int *source1 = (2 * line + 1 < imageHeight) ? source0 + imageStride : source0;
+        unsigned char *targetCb = conversion->u() + (long long int) line * chromaWidth;
+        unsigned char *targetCr = conversion->v() + (long long int) line * chromaWidth;
+        for (int x = (2 * line < fragmentHeight) ? fragmentWidth / 2 : 0;  x < chromaWidth;  x++)
+        {
+            const int x0 = (2 * x < imageWidth) ? 2 * x : imageWidth - 1;
+            const int x1 = (2 * x + 1 < imageWidth) ? 2 * x + 1 : imageWidth - 1;
+            const int sumCb = jpegCb(source0[x0]) + jpegCb(source0[x1]) + jpegCb(source1[x0]) + jpegCb(source1[x1]);
+            const int sumCr = jpegCr(source0[x0]) + jpegCr(source0[x1]) + jpegCr(source1[x0]) + jpegCr(source1[x1]);
+            targetCb[x] = (unsigned char) jpegChromaAverage(sumCb, x);
+            targetCr[x] = (unsigned char) jpegChromaAverage(sumCr, x);
+        }
+    }
+    for (int line = chromaLines;  line < chromaHeight;  line++) {
+        memcpy(conversion->u() + (long long int) line * chromaWidth, conversion->u() + (long long int) (chromaLines - 1) * chromaWidth, chromaWidth);
+        memcpy(conversion->v() + (long long int) line * chromaWidth, conversion->v() + (long long int) (chromaLines - 1) * chromaWidth, chromaWidth);
+    }
+}
+
+bool FeatureExtractor::calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, YuvBuffer *conversion, TaskScheduler *scheduler)
+{
+    if (!conversion->resize(imageWidth, imageHeight)) {
+        calculateFeatures(imageData, imageWidth, imageHeight, imageStride, features, scheduler);
+        return false;
+    }
+
+    FeatureSums sums;
+    const bool split = accumulateInBands(imageWidth, imageHeight, scheduler, &sums, [&](int firstRow, int endRow, FeatureSums *bandSums) {
+        accumulateFeatures(imageData, imageWidth, imageStride, firstRow, endRow, bandSums, conversion);
+    });
+    if (!split) {
+        sums.clear();
+        accumulateFeatures(imageData, imageWidth, imageStride, 0, imageHeight / 8, &sums, conversion);
+    }
+    convertJpegEdges(imageData, imageWidth, imageHeight, imageStride, conversion);
+    finishFeatures(sums, features);
+    return true;
+}
+
+// Processes the rows of 8x8 fragments from firstFragmentRow up to (excluding) endFragmentRow
+void FeatureExtractor::accumulateFeatures(const unsigned int *imageData, int imageWidth, int imageStride, int firstFragmentRow, int endFragmentRow, FeatureSums *sums, YuvBuffer *conversion)
+{
+    // Here we consider only 8x8 fragments
+
+    const int fragmentSize = 8;
+    const int numFragmentsInRow = imageWidth / fragmentSize;
+
+    sums->numFragments += numFragmentsInRow * (endFragmentRow - firstFragmentRow);
+
+    // In a loop we load one fragment from the image and
+    // calculate its features accumulating results among all fragments.
+    // All necessary features are calculated simultaneously.
+
+    // Main loop across fragments 8x8
+
+    for (int frow = firstFragmentRow;  frow < endFragmentRow;  frow++)
+    {
+        const int fy = frow * fragmentSize;
+        unsigned int *currentFragmentPointer = (unsigned int *) imageData + ((long long int) fy * imageStride);
+
+        // rows of the JPEG colour conversion, if requested
+        const int lumaStride = conversion ? conversion->paddedWidth() : 0;
+        unsigned char *lumaPointer = conversion ? conversion->y() + (long long int) fy * lumaStride : nullptr;
+        unsigned char *cbPointer = conversion ? conversion->u() + (long long int) fy / 2 * lumaStride / 2 : nullptr;
+        unsigned char *crPointer = conversion ? conversion->v() + (long long int) fy / 2 * lumaStride / 2 : nullptr;
+
+        for (int fcol = 0;  fcol < numFragmentsInRow;  fcol++)
+        {
+            // Extract current fragment
+
+            int32x8 Y [fragmentSize];
+            int32x8 U [fragmentSize];
+            int32x8 V [fragmentSize];
+            int32x8 Cb [fragmentSize];
+            int32x8 Cr [fragmentSize];
+
+            unsigned int *linePointer = currentFragmentPointer;
+
+            for (int line = 0;  line < fragmentSize;  line++)
+            {
+                // Load a line of xRGB into int8 register
+
+                const int32x8 pixel = _mm256_loadu_si256((const int32x8 *) linePointer);
+
+                // Some constants
+
+                const int32x8 _0xff  = _mm256_set1_epi32(0xff);
+                const int32x8 _32768 = _mm256_set1_epi32(32768);
+                const int32x8 _8388608 = _mm256_set1_epi32(8388608);  // 128 * 65536
+
+                // Get R, G and B components
+
+                const int32x8 r = _mm256_and_si256(_mm256_bsrli_epi128(pixel, 2), _0xff);  // shift in 2 bytes from the right and crop result to a byte
+                const int32x8 g = _mm256_and_si256(_mm256_bsrli_epi128(pixel, 1), _0xff);
+                const int32x8 b = _mm256_and_si256(pixel, _0xff);
+
+                // Calculate Y
+                // const unsigned int y = (19595 * r + 38470 * g + 7471 * b + _32768) >> 16;
+
+                const int32x8 y_t0 = _mm256_mullo_epi32(_mm256_set1_epi32(19595), r);
+                const int32x8 y_t1 = _mm256_mullo_epi32(_mm256_set1_epi32(38470), g);
+                const int32x8 y_t2 = _mm256_mullo_epi32(_mm256_set1_epi32(7471), b);
+                const int32x8 y =    _mm256_srli_epi32(y_t0 + y_t1 + y_t2 + _32768, 16);
+                Y[line] = y;
+
+                // Calculate U
+                // const unsigned int u = (-11058 * r  - 21710 * g + _32768 * b + _8388608) >> 16;
+
+                const int32x8 u_t0 = _mm256_mullo_epi32(_mm256_set1_epi32(-11058), r);
+                const int32x8 u_t1 = _mm256_mullo_epi32(_mm256_set1_epi32(-21710), g);
+                const int32x8 u_t2 = _mm256_mullo_epi32(_32768, b);
+                //const int32x8 u = _mm256_srli_epi32(u_t0 + u_t1 + u_t2 + _8388608, 16);  // CAUTION: int64 addition possible
+                const int32x8 u = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(u_t0, u_t1), _mm256_add_epi32(u_t2, _8388608)), 16);
+                U[line] = u;
+
+                // Calculate V
+                // const unsigned int v = (_32768 * r - 27439 * g - 5329 * b + _8388608) >> 16;
+
+                const int32x8 v_t0 = _mm256_mullo_epi32(_32768, r);
+                const int32x8 v_t1 = _mm256_mullo_epi32(_mm256_set1_epi32(-27439), g);
+                const int32x8 v_t2 = _mm256_mullo_epi32(_mm256_set1_epi32(-5329), b);
+                //const int32x8 v = _mm256_srli_epi32(v_t0 + v_t1 + v_t2 + _8388608, 16);  // CAUTION: int64 addition possible
+                const int32x8 v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(v_t0, v_t1), _mm256_add_epi32(v_t2, _8388608)), 16);
+                V[line] = v;
+
+                // Chroma of the JPEG colour conversion, see jpegCb() and jpegCr()
+
+                if (conversion)
+                {
+                    const int32x8 offset = _mm256_set1_epi32((128 << 16) + 32767);
+                    const int32x8 cb_t0 = _mm256_mullo_epi32(_mm256_set1_epi32(-11059), r);
+                    const int32x8 cb_t1 = _mm256_mullo_epi32(_mm256_set1_epi32(-21709), g);
+                    Cb[line] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(cb_t0, cb_t1), _mm256_add_epi32(u_t2, offset)), 16);
+                    Cr[line] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(v_t0, v_t1), _mm256_add_epi32(v_t2, offset)), 16);
+                    _mm_storel_epi64((__m128i *) (lumaPointer + (long long int) line * lumaStride), packBytes(y));
+                }
+
+                // Move line pointer to the next line in fragment
+
+                linePointer += imageStride;
+            }
+
+            // Current fragment is in local array
+            // Process current fragment
+
+            // -----
+            // F1, F4
+            // Calculating gradient 1x1
+            // -----
+
+            {
+                unsigned int absSum, sqrSum;
+                G1x1(Y, &absSum, &sqrSum);
+                sums->absSumG1x1 += absSum;
+                sums->sqrSumG1x1 += sqrSum;
+            }
+
+            // -----
+            // F2, F5
+            // Calculating gradient 2x2
+            // -----
+
+            {
+                unsigned int absSum, sqrSum;
+                G2x2(Y, &absSum, &sqrSum);
+                sums->absSumG2x2 += absSum;
+                sums->sqrSumG2x2 += sqrSum;
+            }
+
+            // -----
+            // F3, F6
+            // Calculating gradient 4x4
+            // -----
+
+            {
+                unsigned int absSum, sqrSum;
+                G4x4(Y, &absSum, &sqrSum);
+                sums->absSumG4x4 += absSum;
+                sums->sqrSumG4x4 += sqrSum;
+            }
+
+            // -----
+            // F7
+            // Calculating diagonal differences in 2x2 blocks
+            // -----
+
+            sums->absSumD2x2 += D2x2(Y);
+
+            // -----
+            // F8
+            // Calculating diagonal differences in 4x4 blocks
+            // -----
+
+            sums->absSumD4x4 += D4x4(Y);
+
+            // -----
+            // F9
+            // Calculating checkboard convolution for Y component
+            // -----
+
+            sums->absSumCheckboard += absCheckboardConvolution(Y);
+
+            // -----
+            // F10
+            // Calculating gradient 2x2 for UV components
+            // -----
+
+            sums->absSumG2UV += G2x2_UV(U, V);
+
+            // 4x4 samples of each chroma component of the JPEG colour conversion
+
+            if (conversion)
+            {
+                for (int line = 0;  line < fragmentSize / 2;  line++)
+                {
+                    storeJpegChroma(Cb[2 * line], Cb[2 * line + 1], cbPointer + (long long int) line * lumaStride / 2);
+                    storeJpegChroma(Cr[2 * line], Cr[2 * line + 1], crPointer + (long long int) line * lumaStride / 2);
+                }
+                lumaPointer += fragmentSize;
+                cbPointer += fragmentSize / 2;
+                crPointer += fragmentSize / 2;
+            }
+
+            // Current fragment is processed
+
+            // Move pointer to the neighbour fragment in current row
+
+            currentFragmentPointer += fragmentSize;
+        }
+    }
+}
+
+// Features F1-F9 of one fragment, all of them are calculated from the luminance
+static inline void accumulateLuma(const int32x8 *Y, FeatureSums *sums)
+{
+    unsigned int absSum, sqrSum;
+    G1x1(Y, &absSum, &sqrSum);
+    sums->absSumG1x1 += absSum;
+    sums->sqrSumG1x1 += sqrSum;
+
+    G2x2(Y, &absSum, &sqrSum);
+    sums->absSumG2x2 += absSum;
+    sums->sqrSumG2x2 += sqrSum;
+
+    G4x4(Y, &absSum, &sqrSum);
+    sums->absSumG4x4 += absSum;
+    sums->sqrSumG4x4 += sqrSum;
+
+    sums->absSumD2x2 += D2x2(Y);
+    sums->absSumD4x4 += D4x4(Y);
+    sums->absSumCheckboard += absCheckboardConvolution(Y);
+}
+
+// The same as accumulateFeatures() for 8-bit gray pixels, which are the luminance itself: for R = G = B the Y formula
+// gives exactly the gray value and U = V = 128, so the colour conversion and the UV gradient (always zero) are skipped
+void FeatureExtractor::accumulateGrayFeatures(const unsigned char *imageData, int imageWidth, int imageStride, int firstFragmentRow, int endFragmentRow, FeatureSums *sums)
+{
+    const int fragmentSize = 8;
+    const int numFragmentsInRow = imageWidth / fragmentSize;
+
+    sums->numFragments += numFragmentsInRow * (endFragmentRow - firstFragmentRow);
+
+    for (int frow = firstFragmentRow;  frow < endFragmentRow;  frow++)
+    {
+        const unsigned char *currentFragmentPointer = imageData + (long long int) frow * fragmentSize * imageStride;
+
+        for (int fcol = 0;  fcol < numFragmentsInRow;  fcol++)
+        {
+            // 8 bytes of every line are widened to int32x8, the layout of the kernels
+
+            int32x8 Y [fragmentSize];
+            const unsigned char *linePointer = currentFragmentPointer;
+            for (int line = 0;  line < fragmentSize;  line++)
+            {
+                Y[line] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) linePointer));
+                linePointer += imageStride;
+            }
+
+            accumulateLuma(Y, sums);
+
+            currentFragmentPointer += fragmentSize;
+        }
+    }
+}
+
+// Video range samples scaled to the full range of the xRGB path, in 14-bit fixed point:
+// luma 16..235 and chroma 16..240 (centred at 128) to 0..255
+static inline int32x8 expandVideoLuma(int32x8 y)
+{
+    const int32x8 scaled = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(y, _mm256_set1_epi32(16)), _mm256_set1_epi32(19077)), _mm256_set1_epi32(8192)), 14);
+    return _mm256_min_epi32(_mm256_max_epi32(scaled, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+static inline int32x8 expandVideoChroma(int32x8 c)
+{
+    const int32x8 scaled = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(c, _mm256_set1_epi32(128)), _mm256_set1_epi32(18651)), _mm256_set1_epi32(8192)), 14);
+    return _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(scaled, _mm256_set1_epi32(128)), _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+// The same as accumulateFeatures() for a YUV 4:2:0 frame. A fragment covers 4x4 samples of each chroma plane;
+// every sample is repeated for 2 columns by a byte shuffle and for 2 lines by storing it twice, which gives the
+// layout of G2x2_UV without any arithmetic
+void FeatureExtractor::accumulateYuvFeatures(const YuvImage &image, int firstFragmentRow, int endFragmentRow, FeatureSums *sums)
+{
+    const int fragmentSize = 8;
+    const int numFragmentsInRow = image.width / fragmentSize;
+
+    sums->numFragments += numFragmentsInRow * (endFragmentRow - firstFragmentRow);
+
+    // interleaved chroma (NV12, NV21) is loaded as 8 bytes from the first sample of the pair and split by the shuffle
+    const bool interleaved = (image.uvStep == 2);
+    const unsigned char *chromaBase = (interleaved && image.v < image.u) ? image.v : image.u;
+    const int u = interleaved ? (int) (image.u - chromaBase) : 0;
+    const int v = interleaved ? (int) (image.v - chromaBase) : 0;
+    const int step = interleaved ? 2 : 1;
+    const __m128i uShuffle = _mm_setr_epi8(u, u, u + step, u + step, u + 2 * step, u + 2 * step, u + 3 * step, u + 3 * step, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i vShuffle = _mm_setr_epi8(v, v, v + step, v + step, v + 2 * step, v + 2 * step, v + 3 * step, v + 3 * step, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    for (int frow = firstFragmentRow;  frow < endFragmentRow;  frow++)
+    {
+        const unsigned char *lumaPointer = image.y + (long long int) frow * fragmentSize * image.yStride;
+        const long long int chromaRow = (long long int) frow * (fragmentSize / 2);
+
+        for (int fcol = 0;  fcol < numFragmentsInRow;  fcol++)
+        {
+            int32x8 Y [fragmentSize];
+            int32x8 U [fragmentSize];
+            int32x8 V [fragmentSize];
+
+            const unsigned char *linePointer = lumaPointer + fcol * fragmentSize;
+            for (int line = 0;  line < fragmentSize;  line++)
+            {
+                const int32x8 y = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) linePointer));
+                Y[line] = image.fullRange ? y : expandVideoLuma(y);
+                linePointer += image.yStride;
+            }
+
+            for (int line = 0;  line < fragmentSize / 2;  line++)
+            {
+                __m128i uSamples, vSamples;
+                if (interleaved) {
+                    uSamples = vSamples = _mm_loadl_epi64((const __m128i *) (chromaBase + (chromaRow + line) * image.uvStride + fcol * fragmentSize));
+                } else {
+                    int uBytes, vBytes;
+                    memcpy(&uBytes, image.u + (chromaRow + line) * image.uvStride + fcol * (fragmentSize / 2), 4);
+                    memcpy(&vBytes, image.v + (chromaRow + line) * image.uvStride + fcol * (fragmentSize / 2), 4);
+                    uSamples = _mm_cvtsi32_si128(uBytes);
+                    vSamples = _mm_cvtsi32_si128(vBytes);
+                }
+
+                int32x8 uLine = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uSamples, uShuffle));
+                int32x8 vLine = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(vSamples, vShuffle));
+                if (!image.fullRange) {
+                    uLine = expandVideoChroma(uLine);
+                    vLine = expandVideoChroma(vLine);
+                }
+                U[2 * line] = U[2 * line + 1] = uLine;
+                V[2 * line] = V[2 * line + 1] = vLine;
+            }
+
+            accumulateLuma(Y, sums);
+            sums->absSumG2UV += G2x2_UV(U, V);
+        }
+    }
+}
+
+void FeatureExtractor::finishFeatures(const FeatureSums &sums, double *features)
+{
+    const int fragmentSize = 8;
+
+    // Calculate main values and logarithmize features
+
+    // -----
+    // Finishing gradient 1x1 (F1, F4)
+    // -----
+
+    {
+        const int numDifferences = fragmentSize * fragmentSize;
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumG1x1 / totalDifferences;
+        const double meanSqrValue = (double) sums.sqrSumG1x1 / totalDifferences;
+
+        features[0] = log(meanAbsValue + 1);
+        features[3] = log(meanSqrValue + 1);
+    }
+
+    // -----
+    // Finishing gradient 2x2 (F2, F5)
+    // -----
+
+    {
+        const int blockSize = 2;
+        const int normalizationCoef = blockSize * blockSize;  // Number of pixels in a block
+
+        const int numDifferences = (fragmentSize / blockSize) * (fragmentSize / blockSize);
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumG2x2 / (totalDifferences * normalizationCoef);
+        const double meanSqrValue = (double) sums.sqrSumG2x2 / (totalDifferences * normalizationCoef * normalizationCoef);
+
+        features[1] = log(meanAbsValue + 1);
+        features[4] = log(meanSqrValue + 1);
+    }
+
+    // -----
+    // Finishing gradient 4x4 (F3, F6)
+    // -----
+
+    {
+        const int blockSize = 4;
+        const int normalizationCoef = blockSize * blockSize;  // Number of pixels in a block
+
+        const int numDifferences = (fragmentSize / blockSize) * (fragmentSize / blockSize);
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumG4x4 / (totalDifferences * normalizationCoef);
+        const double meanSqrValue = (double) sums.sqrSumG4x4 / (totalDifferences * normalizationCoef * normalizationCoef);
+
+        features[2] = log(meanAbsValue + 1);
+        features[5] = log(meanSqrValue + 1);
+    }
+
+    // -----
+    // Finishing diagonal differences in blocks 2x2 (F7)
+    // -----
+
+    {
+        const int blockSize = 2;
+        const int normalizationCoef = 2;
+        const int numDifferences = (fragmentSize / blockSize) * (fragmentSize / blockSize);
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumD2x2 / (totalDifferences * normalizationCoef);
+        features[6] = log(meanAbsValue + 1);
+    }
+
+    // -----
+    // Finishing diagonal differences in blocks 4x4 (F8)
+    // -----
+
+    {
+        const int blockSize = 4;
+        const int normalizationCoef = 8;
+        const int numDifferences = (fragmentSize / blockSize) * (fragmentSize / blockSize);
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumD4x4 / (totalDifferences * normalizationCoef);
+        features[7] = log(meanAbsValue + 1);
+    }
+
+    // -----
+    // Finishing gradient 2x2 for UV components (F10)
+    // -----
+
+    {
+        const int blockSize = 2;
+        const int normalizationCoef = blockSize * blockSize * 2;  // Number of pixels in a block times the number of blocks in 2 colour channels
+
+        const int numDifferences = (fragmentSize / blockSize) * (fragmentSize / blockSize);  // Number of differences in 1 fragment per colour channel
+        const int totalDifferences = numDifferences * sums.numFragments;
+
+        const double meanAbsValue = (double) sums.absSumG2UV / (totalDifferences * normalizationCoef);
+        features[8] = log(meanAbsValue + 1);
+    }
+
+    // -----
+    // Finishing chechboard convolution for Y components (F9)
+    // -----
+
+    {
+        const int normalizationCoef = fragmentSize * fragmentSize / 2;  // Half positive cells and half negative
+        const double meanAbsValue = (double) sums.absSumCheckboard / (sums.numFragments * normalizationCoef);
+        features[9] = log(meanAbsValue + 1);
+    }
+
+    // -----
+}
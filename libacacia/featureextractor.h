@@ -0,0 +1,98 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FEATUREEXTRACTOR_H
+#define FEATUREEXTRACTOR_H
+
+// Progress reporting of long calculations. The callback is called from the calculating thread
+// every few rows of fragments with the processed fraction of the image (0..1);
+// returning false cancels the calculation.
+struct FeatureProgress
+{
+    bool (*report)(void *context, double fraction);
+    void *context;
+};
+
+class TaskScheduler;
+struct YuvImage;
+class YuvBuffer;
+
+// Accumulators of all features over a part of the image; sums of parts are added before finishFeatures()
+struct FeatureSums
+{
+    unsigned long long int absSumG1x1;
+    unsigned long long int sqrSumG1x1;
+    unsigned long long int absSumG2x2;
+    unsigned long long int sqrSumG2x2;
+    unsigned long long int absSumG4x4;
+    unsigned long long int sqrSumG4x4;
+    unsigned long long int absSumD2x2;
+    unsigned long long int absSumD4x4;
+    unsigned long long int absSumG2UV;
+    unsigned long long int absSumCheckboard;
+    int numFragments;
+
+    void clear();
+    void add(const FeatureSums &other);
+};
+
+class FeatureExtractor
+{
+public:
+    // images smaller than this are not split into tasks
+    static const int minParallelPixels = 4 << 20;
+
+    static void calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, double *features);
+    static void calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features);
+
+    // returns false if the calculation was cancelled, features are not valid then
+    static bool calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, const FeatureProgress *progress);
+
+    // large images are split into bands of fragment rows calculated as tasks of the scheduler; the result is identical
+    static void calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, TaskScheduler *scheduler);
+
+    // also fills conversion with the colour conversion of libjpeg (its coefficients and rounding, 2x2 chroma averages
+    // and the padding of the edges), so Encoder::compressYuvToJpeg() of the buffer writes the same file as compressToJpeg()
+    // of the image without converting the pixels again; returns false if the buffer can't be allocated, the features
+    // are valid anyway
+    static bool calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features, YuvBuffer *conversion, TaskScheduler *scheduler);
+
+    // 8-bit grayscale images (stride in bytes): only luminance is calculated, chroma of gray pixels is constant,
+    // so the UV gradient is zero; the result is identical to the xRGB image with R = G = B
+    static void calculateGrayFeatures(const unsigned char *imageData, int imageWidth, int imageHeight, int imageStride, double *features, TaskScheduler *scheduler);
+
+    // planar YUV 4:2:0 (see yuvimage.h): luminance is read directly, every chroma sample is repeated for the 2x2 pixels
+    // it covers, so the UV gradient is that of the upsampled chroma; identical to the xRGB image when its chroma
+    // is constant over every 2x2 block, close to it otherwise
+    static void calculateYuvFeatures(const YuvImage &image, double *features, TaskScheduler *scheduler);
+
+    // estimates from every rowStep-th row of fragments for a bounded analysis time (see deadlineplanner.h); the features
+    // are means over fragments, so they stay close to the full calculation, which is rowStep 1
+    static void sampleFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, int rowStep, double *features);
+    static void sampleGrayFeatures(const unsigned char *imageData, int imageWidth, int imageHeight, int imageStride, int rowStep, double *features);
+
+    // building blocks of the above: sums over rows of 8x8 fragments [firstFragmentRow, endFragmentRow), then the features
+    // (conversion, if any, receives the fragments only, the edges are filled by calculateFeatures())
+    static void accumulateFeatures(const unsigned int *imageData, int imageWidth, int imageStride, int firstFragmentRow, int endFragmentRow, FeatureSums *sums, YuvBuffer *conversion = nullptr);
+    static void accumulateGrayFeatures(const unsigned char *imageData, int imageWidth, int imageStride, int firstFragmentRow, int endFragmentRow, FeatureSums *sums);
+    static void accumulateYuvFeatures(const YuvImage &image, int firstFragmentRow, int endFragmentRow, FeatureSums *sums);
+    static void finishFeatures(const FeatureSums &sums, double *features);
+};
+
+#endif // FEATUREEXTRACTOR_H
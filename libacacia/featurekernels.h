@@ -0,0 +1,257 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FEATUREKERNELS_H
+#define FEATUREKERNELS_H
+
+// Vectorized kernels that process a single 8x8 fragment stored as 8 rows of int32x8.
+// They are shared by the feature extractor and the benchmark suite.
+
+#include "immintrin.h"
+
+typedef __m256i int32x8;
+
+/**
+ * @brief G1x1 used to calculate features F1, F4
+ */
+static inline void G1x1(const int32x8 *Y, unsigned int *absSum, unsigned int *sqrSum)
+{
+    // Initialize accumulators
+
+    int32x8 absSum8 = _mm256_setzero_si256();
+    int32x8 sqrSum8 = _mm256_setzero_si256();
+
+    // Loop for differences in rows and columns simultaneously
+
+    for (int i = 0;  i < 8;  )  // fragmentSize = 8
+    {
+        const int32x8 row_hi = Y[i++];
+        const int32x8 row_lo = Y[i++];
+
+        const int32x8 dh = _mm256_hsub_epi32(row_hi, row_lo);
+        const int32x8 dv = _mm256_sub_epi32(row_hi, row_lo);
+
+        absSum8 += _mm256_add_epi32(_mm256_abs_epi32(dh), _mm256_abs_epi32(dv));
+        sqrSum8 += _mm256_add_epi32(_mm256_mullo_epi32(dh, dh), _mm256_mullo_epi32(dv, dv));
+    }
+
+    // Sum the vector components
+
+    const int32x8 sum_aassaass = _mm256_hadd_epi32(absSum8, sqrSum8);
+    const int32x8 sum_as__as__ = _mm256_hadd_epi32(sum_aassaass, sum_aassaass);
+
+    *absSum = _mm256_extract_epi32(sum_as__as__, 0) + _mm256_extract_epi32(sum_as__as__, 4);
+    *sqrSum = _mm256_extract_epi32(sum_as__as__, 1) + _mm256_extract_epi32(sum_as__as__, 5);
+}
+
+
+/**
+ * @brief G2x2 used to calculate features F2, F5
+ */
+static inline void G2x2(const int32x8 *Y, unsigned int *absSum, unsigned int *sqrSum)
+{
+    const int32x8 row0 = _mm256_add_epi32(Y[0], Y[1]);
+    const int32x8 row1 = _mm256_add_epi32(Y[2], Y[3]);
+    const int32x8 row2 = _mm256_add_epi32(Y[4], Y[5]);
+    const int32x8 row3 = _mm256_add_epi32(Y[6], Y[7]);
+
+    // Horisontal differences
+
+    const int32x8 row0_hadd_row1 = _mm256_hadd_epi32(row0, row1);
+    const int32x8 row2_hadd_row3 = _mm256_hadd_epi32(row2, row3);
+
+    const int32x8 hor_differences = _mm256_hsub_epi32(row0_hadd_row1, row2_hadd_row3);
+
+    // Vertical differences
+
+    const int32x8 row0_sub_row1 = _mm256_sub_epi32(row0, row1);
+    const int32x8 row2_sub_row3 = _mm256_sub_epi32(row2, row3);
+
+    const int32x8 ver_differences = _mm256_hadd_epi32(row0_sub_row1, row2_sub_row3);
+
+    // Absolute and squared differences
+
+    const int32x8 absSum8 = _mm256_add_epi32(_mm256_abs_epi32(hor_differences), _mm256_abs_epi32(ver_differences));
+    const int32x8 sqrSum8 = _mm256_add_epi32(_mm256_mullo_epi32(hor_differences, hor_differences), _mm256_mullo_epi32(ver_differences, ver_differences));
+
+    // Sum the vector components
+
+    const int32x8 sum_aassaass = _mm256_hadd_epi32(absSum8, sqrSum8);
+    const int32x8 sum_as__as__ = _mm256_hadd_epi32(sum_aassaass, sum_aassaass);
+
+    *absSum = _mm256_extract_epi32(sum_as__as__, 0) + _mm256_extract_epi32(sum_as__as__, 4);
+    *sqrSum = _mm256_extract_epi32(sum_as__as__, 1) + _mm256_extract_epi32(sum_as__as__, 5);
+}
+
+
+/**
+ * @brief G4x4 used to calculate features F3, F6
+ */
+static inline void G4x4(const int32x8 *Y, unsigned int *absSum, unsigned int *sqrSum)
+{
+    const int32x8 row0 = Y[0] + Y[1] + Y[2] + Y[3];  // sum_ab_128
+    const int32x8 row1 = Y[4] + Y[5] + Y[6] + Y[7];  // sum_cd_128
+
+    const int32x8 sum_aaccbbdd = _mm256_hadd_epi32(row0, row1);
+    const int32x8 sum_aabbccdd = _mm256_permute4x64_epi64(sum_aaccbbdd, 216);  // acbd -> abcd
+
+    const int32x8 sum_acabbdcd_32 = _mm256_hadd_epi32(sum_aaccbbdd, sum_aabbccdd);
+
+    const int32x8 differences = _mm256_permute4x64_epi64(_mm256_hsub_epi32(sum_acabbdcd_32, sum_acabbdcd_32), 216);  // only lower 128 bit store data
+    const int32x8 abs_differences = _mm256_abs_epi32(differences);
+    const int32x8 sqr_differences = _mm256_mullo_epi32(differences, differences);
+
+    const int32x8 sum_aass____ = _mm256_hadd_epi32(abs_differences, sqr_differences);
+    const int32x8 sum_as______ = _mm256_hadd_epi32(sum_aass____, sum_aass____);
+
+    *absSum = _mm256_extract_epi32(sum_as______, 0);
+    *sqrSum = _mm256_extract_epi32(sum_as______, 1);
+}
+
+
+/**
+ * @brief D2x2 used to calculate feature F7
+ */
+static inline unsigned int D2x2(const int32x8 *Y)
+{
+    // Process 4 rows in one operation
+
+    const int32x8 sum = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_hsub_epi32(Y[0], Y[2]), _mm256_hsub_epi32(Y[1], Y[3]))) +
+                        _mm256_abs_epi32(_mm256_sub_epi32(_mm256_hsub_epi32(Y[4], Y[6]), _mm256_hsub_epi32(Y[5], Y[7])));
+
+    // Sum all components of the vector
+
+    const int32x8 sum_xx__xx__ = _mm256_hadd_epi32(sum, sum);
+    const int32x8 sum_x___x___ = _mm256_hadd_epi32(sum_xx__xx__, sum_xx__xx__);
+
+    return _mm256_extract_epi32(sum_x___x___, 0) + _mm256_extract_epi32(sum_x___x___, 4);
+}
+
+
+/**
+ * @brief D4x4 used to calculate feature F8
+ */
+static inline unsigned int D4x4(const int32x8 *Y)
+{
+    const int32x8 r0 = _mm256_add_epi32(Y[0], Y[1]);
+    const int32x8 r1 = _mm256_add_epi32(Y[2], Y[3]);
+    const int32x8 r2 = _mm256_add_epi32(Y[4], Y[5]);
+    const int32x8 r3 = _mm256_add_epi32(Y[6], Y[7]);
+
+    const int32x8 r0_hadd_r2 = _mm256_hadd_epi32(r0, r2);
+    const int32x8 r1_hadd_r3 = _mm256_hadd_epi32(r1, r3);
+
+    const int32x8 partial_diff = _mm256_sub_epi32(r0_hadd_r2, r1_hadd_r3);
+
+    const int32x8 diff_12__34__ = _mm256_hsub_epi32(partial_diff, partial_diff);
+
+    const int32x8 abs_diff_12__34__ = _mm256_abs_epi32(diff_12__34__);
+
+    const int32x8 sum_1___2___ = _mm256_hadd_epi32(abs_diff_12__34__, abs_diff_12__34__);
+
+    return _mm256_extract_epi32(sum_1___2___, 0) + _mm256_extract_epi32(sum_1___2___, 4);
+}
+
+
+/**
+ * @brief G2x2_UV used to calculate feature F10
+ */
+static inline unsigned int G2x2_UV(const int32x8 *U, const int32x8 *V)
+{
+    // Part 1: process U
+
+    const int32x8 row0 = _mm256_add_epi32(U[0], U[1]);
+    const int32x8 row1 = _mm256_add_epi32(U[2], U[3]);
+    const int32x8 row2 = _mm256_add_epi32(U[4], U[5]);
+    const int32x8 row3 = _mm256_add_epi32(U[6], U[7]);
+
+    // Horisontal differences
+
+    const int32x8 row0_hadd_row1 = _mm256_hadd_epi32(row0, row1);
+    const int32x8 row2_hadd_row3 = _mm256_hadd_epi32(row2, row3);
+    const int32x8 hor_differences_u = _mm256_hsub_epi32(row0_hadd_row1, row2_hadd_row3);
+
+    // Vertical differences
+
+    const int32x8 row0_sub_row1 = _mm256_sub_epi32(row0, row1);
+    const int32x8 row2_sub_row3 = _mm256_sub_epi32(row2, row3);
+    const int32x8 ver_differences_u = _mm256_hadd_epi32(row0_sub_row1, row2_sub_row3);
+
+    // Absolute differences only
+
+    const int32x8 absSum8u = _mm256_add_epi32(_mm256_abs_epi32(hor_differences_u), _mm256_abs_epi32(ver_differences_u));
+
+    // Part 2: process V
+
+    const int32x8 row4 = _mm256_add_epi32(V[0], V[1]);
+    const int32x8 row5 = _mm256_add_epi32(V[2], V[3]);
+    const int32x8 row6 = _mm256_add_epi32(V[4], V[5]);
+    const int32x8 row7 = _mm256_add_epi32(V[6], V[7]);
+
+    // Horisontal differences
+
+    const int32x8 row4_hadd_row5 = _mm256_hadd_epi32(row4, row5);
+    const int32x8 row6_hadd_row7 = _mm256_hadd_epi32(row6, row7);
+    const int32x8 hor_differences_v = _mm256_hsub_epi32(row4_hadd_row5, row6_hadd_row7);
+
+    // Vertical differences
+
+    const int32x8 row4_sub_row5 = _mm256_sub_epi32(row4, row5);
+    const int32x8 row6_sub_row7 = _mm256_sub_epi32(row6, row7);
+    const int32x8 ver_differences_v = _mm256_hadd_epi32(row4_sub_row5, row6_sub_row7);
+
+    // Absolute differences only
+
+    const int32x8 absSum8v = _mm256_add_epi32(_mm256_abs_epi32(hor_differences_v), _mm256_abs_epi32(ver_differences_v));
+
+    // Sum components from part 1 and 2
+
+    const int32x8 sum_xxxxxxxx = _mm256_add_epi32(absSum8u, absSum8v);  // 8 integers
+    const int32x8 sum_xx__xx__ = _mm256_hadd_epi32(sum_xxxxxxxx, sum_xxxxxxxx);  // 4 integers
+    const int32x8 sum_x___x___ = _mm256_hadd_epi32(sum_xx__xx__, sum_xx__xx__);  // 2 integers
+
+    return _mm256_extract_epi32(sum_x___x___, 0) + _mm256_extract_epi32(sum_x___x___, 4);
+}
+
+
+/**
+ * @brief absCheckboardConvolution used to calculate feature F9
+ */
+static inline unsigned int absCheckboardConvolution(const int32x8 *Y)
+{
+    const int32x8 d0 = _mm256_sub_epi32(Y[0], Y[1]);
+    const int32x8 d1 = _mm256_sub_epi32(Y[2], Y[3]);
+    const int32x8 d2 = _mm256_sub_epi32(Y[4], Y[5]);
+    const int32x8 d3 = _mm256_sub_epi32(Y[6], Y[7]);
+
+    const int32x8 fourRows0 = _mm256_hsub_epi32(d0, d1);
+    const int32x8 fourRows1 = _mm256_hsub_epi32(d2, d3);
+
+    const int32x8 sum_xxxxxxxx = _mm256_add_epi32(fourRows0, fourRows1);
+
+    const int32x8 sum_xx__xx__ = _mm256_hadd_epi32(sum_xxxxxxxx, sum_xxxxxxxx);
+
+    const int32x8 sum_x___x___ = _mm256_hadd_epi32(sum_xx__xx__, sum_xx__xx__);
+
+    const int sum = _mm256_extract_epi32(sum_x___x___, 0) + _mm256_extract_epi32(sum_x___x___, 4);
+
+    return sum >= 0 ? sum : -sum;
+}
+
+#endif // FEATUREKERNELS_H
@@ -0,0 +1,76 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "groundtruth.h"
+
+#include <chrono>
+#include <vector>
+
+#include <stdlib.h>
+
+#include "encoder.h"
+#include "decoder.h"
+#include "metrics.h"
+
+static unsigned long long int nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool GroundTruth::measure(bool isjpeg, const unsigned int *imageData, const unsigned char *referenceLuma, int width, int height, int qualityFactor, GroundTruthSample *sample)
+{
+    sample->qualityFactor = qualityFactor;
+
+    // encoding
+
+    const unsigned long long int encodeStartTime = nowNs();
+
+    const unsigned char *inputImageData = (const unsigned char *) imageData;
+    unsigned long long int compressedBufferSize = 0;
+    unsigned char *compressedImageBuffer = isjpeg ? Encoder::compressToJpeg(inputImageData, width, height, qualityFactor, &compressedBufferSize) :
+                                                    Encoder::compressToWebp(inputImageData, width, height, qualityFactor, &compressedBufferSize);
+    if (!compressedImageBuffer) return false;
+
+    const unsigned long long int measureStartTime = nowNs();
+    sample->encodeTimeNs = measureStartTime - encodeStartTime;
+    sample->fileSize = (double) compressedBufferSize;
+
+    // decoding and quality measurement
+
+    int decodedWidth = 0, decodedHeight = 0;
+    unsigned int *decodedImage = isjpeg ? Decoder::decompressJpeg(compressedImageBuffer, compressedBufferSize, &decodedWidth, &decodedHeight) :
+                                          Decoder::decompressWebp(compressedImageBuffer, compressedBufferSize, &decodedWidth, &decodedHeight);
+    Encoder::freeBuffer(compressedImageBuffer);
+
+    if (!decodedImage) return false;
+    if (decodedWidth != width || decodedHeight != height) {
+        delete [] decodedImage;
+        return false;
+    }
+
+    std::vector<unsigned char> decodedLuma ((size_t) width * height);
+    Metrics::extractLuma(decodedImage, width, height, decodedLuma.data());
+    delete [] decodedImage;
+
+    sample->yPSNR = Metrics::computePSNR(referenceLuma, decodedLuma.data(), width, height);
+    sample->yMSSIM = Metrics::computeMSSIM(referenceLuma, decodedLuma.data(), width, height);
+    sample->measureTimeNs = nowNs() - measureStartTime;
+
+    return true;
+}
@@ -0,0 +1,45 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GROUNDTRUTH_H
+#define GROUNDTRUTH_H
+
+// Actual compression results for one image and one quality factor,
+// i.e. the values that regression models try to predict.
+struct GroundTruthSample
+{
+    int    qualityFactor;
+    double fileSize;
+    double yPSNR;
+    double yMSSIM;
+
+    // time spent in the encoder and in decoding with metric calculation, in nanoseconds
+    unsigned long long int encodeTimeNs;
+    unsigned long long int measureTimeNs;
+};
+
+class GroundTruth
+{
+public:
+    // compresses an image with the real encoder, decodes it back and measures size, Y-PSNR and Y-MSSIM;
+    // referenceLuma is the luminance of the original image (see Metrics::extractLuma)
+    static bool measure(bool isjpeg, const unsigned int *imageData, const unsigned char *referenceLuma, int width, int height, int qualityFactor, GroundTruthSample *sample);
+};
+
+#endif // GROUNDTRUTH_H
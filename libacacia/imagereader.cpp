@@ -0,0 +1,779 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "imagereader.h"
+#include "decoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_LIBPNG
+    #include <png.h>
+#endif
+
+#ifdef USE_LIBTIFF
+    #include <tiffio.h>
+#endif
+
+
+// the largest accepted image side, protects against absurd sizes in corrupted headers
+static const int maxImageSide = 1 << 16;
+
+static bool validSize(long long int width, long long int height)
+{
+    return width > 0 && height > 0 && width <= maxImageSide && height <= maxImageSide;
+}
+
+static unsigned int readLittleEndian(const unsigned char *data, int bytes)
+{
+    unsigned int value = 0;
+    for (int i = bytes - 1;  i >= 0;  i--) value = (value << 8) | data[i];
+    return value;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// BMP, only uncompressed 24 bpp and 32 bpp (including BI_BITFIELDS with 8-bit channels)
+// ---------------------------------------------------------------------------------------------------------------------
+
+static bool maskToShift(unsigned int mask, int *shift)
+{
+    if (mask == 0) return false;
+    *shift = 0;
+    while (!((mask >> *shift) & 1)) (*shift)++;
+    return (mask >> *shift) == 0xff;
+}
+
+static unsigned int *decodeBmp(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    if (buffer_size < 54) return nullptr;
+
+    const unsigned int data_offset = readLittleEndian(buffer + 10, 4);
+    const unsigned int header_size = readLittleEndian(buffer + 14, 4);
+    if (header_size < 40) return nullptr;    // OS/2 headers are not supported
+
+    const int w = (int) readLittleEndian(buffer + 18, 4);
+    const int h = (int) readLittleEndian(buffer + 22, 4);
+    const int bits_per_pixel = readLittleEndian(buffer + 28, 2);
+    const unsigned int compression = readLittleEndian(buffer + 30, 4);
+
+    // negative height means rows are stored top-down
+    const bool bottom_up = h > 0;
+    const int abs_h = bottom_up ? h : -h;
+    if (!validSize(w, abs_h)) return nullptr;
+
+    int shifts [3] = {16, 8, 0};    // red, green, blue
+    if (bits_per_pixel == 32 && compression == 3)
+    {
+        // BI_BITFIELDS masks follow the 40-byte header, in V4/V5 headers they are at the same offset
+        if (buffer_size < 14 + 40 + 12) return nullptr;
+        for (int c = 0;  c < 3;  c++) {
+            if (!maskToShift(readLittleEndian(buffer + 54 + c * 4, 4), &shifts[c])) return nullptr;
+        }
+    }
+    else if ((bits_per_pixel != 24 && bits_per_pixel != 32) || compression != 0) return nullptr;
+
+    const unsigned long long int stride = ((unsigned long long int) w * bits_per_pixel + 31) / 32 * 4;
+    if (data_offset > buffer_size || stride * abs_h > buffer_size - data_offset) return nullptr;
+
+    *width = w;
+    *height = abs_h;
+    unsigned int *image_data = new unsigned int [(size_t) w * abs_h];
+
+    for (int y = 0;  y < abs_h;  y++)
+    {
+        const unsigned char *row = buffer + data_offset + stride * (bottom_up ? abs_h - 1 - y : y);
+        unsigned int *pixel = image_data + (size_t) y * w;
+        if (bits_per_pixel == 24)
+        {
+            for (int x = 0;  x < w;  x++, row += 3) pixel[x] = 0xff000000u | (row[2] << 16) | (row[1] << 8) | row[0];
+        }
+        else
+        {
+            for (int x = 0;  x < w;  x++, row += 4) {
+                const unsigned int value = readLittleEndian(row, 4);
+                pixel[x] = 0xff000000u | (((value >> shifts[0]) & 0xff) << 16) | (((value >> shifts[1]) & 0xff) << 8) | ((value >> shifts[2]) & 0xff);
+            }
+        }
+    }
+
+    return image_data;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// PNM, binary PGM (P5) and PPM (P6) with 8 or 16 bits per sample
+// ---------------------------------------------------------------------------------------------------------------------
+
+// reads a decimal header field skipping whitespace and comments; returns -1 on error
+static long long int readPnmField(const unsigned char *buffer, unsigned long long int buffer_size, unsigned long long int *position)
+{
+    while (*position < buffer_size)
+    {
+        const unsigned char c = buffer[*position];
+        if (c == '#') {
+            while (*position < buffer_size && buffer[*position] != '\n') (*position)++;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            (*position)++;
+        } else {
+            break;
+        }
+    }
+
+    long long int value = -1;
+    while (*position < buffer_size && buffer[*position] >= '0' && buffer[*position] <= '9' && value < maxImageSide * 2LL)
+    {
+        value = (value < 0 ? 0 : value * 10) + (buffer[*position] - '0');
+        (*position)++;
+    }
+    return value;
+}
+
+// Pixel is unsigned int for xRGB or unsigned char for 8-bit gray, which requires a PGM
+template <typename Pixel>
+static Pixel *decodePnm(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    const int channels = (buffer[1] == '6') ? 3 : 1;
+    const bool gray = sizeof(Pixel) == 1;
+    if (gray && channels != 1) return nullptr;
+
+    unsigned long long int position = 2;
+    const long long int w = readPnmField(buffer, buffer_size, &position);
+    const long long int h = readPnmField(buffer, buffer_size, &position);
+    const long long int max_value = readPnmField(buffer, buffer_size, &position);
+    if (!validSize(w, h) || max_value < 1 || max_value > 65535) return nullptr;
+
+    // exactly one whitespace character separates the header from the samples
+    position++;
+
+    const int sample_bytes = (max_value > 255) ? 2 : 1;
+    const unsigned long long int data_size = (unsigned long long int) w * h * channels * sample_bytes;
+    if (position > buffer_size || data_size > buffer_size - position) return nullptr;
+
+    *width = (int) w;
+    *height = (int) h;
+    Pixel *image_data = new Pixel [(size_t) w * h];
+
+    const unsigned char *sample = buffer + position;
+    for (size_t i = 0;  i < (size_t) w * h;  i++)
+    {
+        unsigned int rgb [3];
+        for (int c = 0;  c < channels;  c++, sample += sample_bytes)
+        {
+            const unsigned int value = (sample_bytes == 2) ? ((sample[0] << 8) | sample[1]) : sample[0];
+            rgb[c] = (max_value == 255) ? value : (value * 255 + max_value / 2) / max_value;
+            if (rgb[c] > 255) rgb[c] = 255;
+        }
+        if (channels == 1) rgb[1] = rgb[2] = rgb[0];
+        image_data[i] = gray ? (Pixel) rgb[0] : (Pixel) (0xff000000u | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2]);
+    }
+
+    return image_data;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// PNG via libpng
+// ---------------------------------------------------------------------------------------------------------------------
+
+#ifdef USE_LIBPNG
+
+struct PngMemorySource
+{
+    const unsigned char *data;
+    unsigned long long int size;
+    unsigned long long int position;
+};
+
+static void pngReadFromMemory(png_structp png, png_bytep out, png_size_t count)
+{
+    PngMemorySource *source = (PngMemorySource *) png_get_io_ptr(png);
+    if (count > source->size - source->position) png_error(png, "unexpected end of data");
+    memcpy(out, source->data + source->position, count);
+    source->position += count;
+}
+
+// Pixel is unsigned int for xRGB or unsigned char for 8-bit gray, which requires a grayscale PNG
+template <typename Pixel>
+static Pixel *decodePng(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    const bool gray = sizeof(Pixel) == 1;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png) return nullptr;
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        return nullptr;
+    }
+
+    // image_data and row_pointers are volatile, because they are modified between setjmp() and longjmp()
+    Pixel * volatile image_data = nullptr;
+    png_bytep * volatile row_pointers = nullptr;
+
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        delete [] image_data;
+        delete [] row_pointers;
+        return nullptr;
+    }
+
+    PngMemorySource source = {buffer, buffer_size, 0};
+    png_set_read_fn(png, &source, pngReadFromMemory);
+    png_read_info(png, info);
+
+    const png_uint_32 w = png_get_image_width(png, info);
+    const png_uint_32 h = png_get_image_height(png, info);
+    if (!validSize(w, h)) png_error(png, "unsupported image size");
+    if (gray && (png_get_color_type(png, info) & PNG_COLOR_MASK_COLOR)) png_error(png, "not a grayscale image");
+
+    // convert everything to 8-bit BGRX, i.e. xRGB in little endian integers, or to 8-bit gray
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_strip_alpha(png);
+    if (!gray) {
+        png_set_gray_to_rgb(png);
+        png_set_bgr(png);
+        png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+    }
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    image_data = new Pixel [(size_t) w * h];
+    row_pointers = new png_bytep [h];
+    for (png_uint_32 y = 0;  y < h;  y++) row_pointers[y] = (png_bytep) (image_data + (size_t) y * w);
+
+    png_read_image(png, row_pointers);
+    png_read_end(png, nullptr);
+    png_destroy_read_struct(&png, &info, nullptr);
+    delete [] row_pointers;
+
+    *width = (int) w;
+    *height = (int) h;
+    return image_data;
+}
+
+#endif
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// TIFF via libtiff
+// ---------------------------------------------------------------------------------------------------------------------
+
+#ifdef USE_LIBTIFF
+
+struct TiffMemorySource
+{
+    const unsigned char *data;
+    toff_t size;
+    toff_t position;
+};
+
+static tsize_t tiffRead(thandle_t handle, tdata_t out, tsize_t count)
+{
+    TiffMemorySource *source = (TiffMemorySource *) handle;
+    if (source->position >= source->size) return 0;
+    if ((toff_t) count > source->size - source->position) count = (tsize_t) (source->size - source->position);
+    memcpy(out, source->data + source->position, count);
+    source->position += count;
+    return count;
+}
+
+static tsize_t tiffWrite(thandle_t, tdata_t, tsize_t)
+{
+    return -1;
+}
+
+static toff_t tiffSeek(thandle_t handle, toff_t offset, int whence)
+{
+    TiffMemorySource *source = (TiffMemorySource *) handle;
+    if (whence == SEEK_CUR) offset += source->position;
+    else if (whence == SEEK_END) offset += source->size;
+    source->position = offset;
+    return offset;
+}
+
+static int tiffClose(thandle_t)
+{
+    return 0;
+}
+
+static toff_t tiffSize(thandle_t handle)
+{
+    return ((TiffMemorySource *) handle)->size;
+}
+
+static unsigned int *decodeTiff(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    TiffMemorySource source = {buffer, buffer_size, 0};
+    TIFF *tiff = TIFFClientOpen("memory", "rm", (thandle_t) &source, tiffRead, tiffWrite, tiffSeek, tiffClose, tiffSize, nullptr, nullptr);
+    if (!tiff) return nullptr;
+
+    uint32 w = 0, h = 0;
+    TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &w);
+    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &h);
+    if (!validSize(w, h)) {
+        TIFFClose(tiff);
+        return nullptr;
+    }
+
+    // libtiff converts any photometric interpretation to ABGR (red in the lowest byte)
+    unsigned int *image_data = new unsigned int [(size_t) w * h];
+    if (!TIFFReadRGBAImageOriented(tiff, w, h, (uint32 *) image_data, ORIENTATION_TOPLEFT, 0)) {
+        TIFFClose(tiff);
+        delete [] image_data;
+        return nullptr;
+    }
+    TIFFClose(tiff);
+
+    for (size_t i = 0;  i < (size_t) w * h;  i++) {
+        const unsigned int abgr = image_data[i];
+        image_data[i] = 0xff000000u | (TIFFGetR(abgr) << 16) | (TIFFGetG(abgr) << 8) | TIFFGetB(abgr);
+    }
+
+    *width = (int) w;
+    *height = (int) h;
+    return image_data;
+}
+
+#endif
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned int *ImageReader::decode(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    if (!buffer || buffer_size < 12) return nullptr;
+
+    if (buffer[0] == 0xff && buffer[1] == 0xd8 && buffer[2] == 0xff) {
+        return Decoder::decompressJpeg(buffer, buffer_size, width, height);
+    }
+    if (memcmp(buffer, "RIFF", 4) == 0 && memcmp(buffer + 8, "WEBP", 4) == 0) {
+        return Decoder::decompressWebp(buffer, buffer_size, width, height);
+    }
+    if (memcmp(buffer, "\x89PNG", 4) == 0) {
+#ifdef USE_LIBPNG
+        return decodePng<unsigned int>(buffer, buffer_size, width, height);
+#else
+        return nullptr;
+#endif
+    }
+    if (memcmp(buffer, "II*\0", 4) == 0 || memcmp(buffer, "MM\0*", 4) == 0) {
+#ifdef USE_LIBTIFF
+        return decodeTiff(buffer, buffer_size, width, height);
+#else
+        return nullptr;
+#endif
+    }
+    if (buffer[0] == 'B' && buffer[1] == 'M') {
+        return decodeBmp(buffer, buffer_size, width, height);
+    }
+    if (buffer[0] == 'P' && (buffer[1] == '5' || buffer[1] == '6')) {
+        return decodePnm<unsigned int>(buffer, buffer_size, width, height);
+    }
+
+    return nullptr;
+}
+
+unsigned char *ImageReader::readFileData(const char *path, unsigned long long int *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return nullptr;
+
+    fseek(f, 0, SEEK_END);
+    const long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (file_size <= 0) {
+        fclose(f);
+        return nullptr;
+    }
+
+    unsigned char *buffer = new unsigned char [file_size];
+    const bool ok = fread(buffer, 1, file_size, f) == (size_t) file_size;
+    fclose(f);
+    if (!ok) {
+        delete [] buffer;
+        return nullptr;
+    }
+
+    *size = (unsigned long long int) file_size;
+    return buffer;
+}
+
+unsigned int *ImageReader::readFile(const char *path, int *width, int *height)
+{
+    // the whole file is decoded from memory, the same way as images received by an embedding service
+    unsigned long long int file_size = 0;
+    unsigned char *buffer = readFileData(path, &file_size);
+    if (!buffer) return nullptr;
+
+    unsigned int *image_data = decode(buffer, file_size, width, height);
+    delete [] buffer;
+    return image_data;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Grayscale sources
+// ---------------------------------------------------------------------------------------------------------------------
+
+// number of components in the frame header, or 0 if there is none
+static int jpegComponents(const unsigned char *buffer, unsigned long long int buffer_size)
+{
+    unsigned long long int position = 2;
+    while (position + 4 <= buffer_size)
+    {
+        if (buffer[position] != 0xff) return 0;
+        const int marker = buffer[position + 1];
+        if (marker == 0xff) {    // fill byte
+            position++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {    // markers without length
+            position += 2;
+            continue;
+        }
+
+        // SOF0..SOF15 except DHT, JPG and DAC
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            return position + 10 <= buffer_size ? buffer[position + 9] : 0;
+        }
+        if (marker == 0xd9 || marker == 0xda) return 0;
+
+        position += 2 + ((buffer[position + 2] << 8) | buffer[position + 3]);
+    }
+    return 0;
+}
+
+bool ImageReader::isGrayscale(const unsigned char *buffer, unsigned long long int buffer_size)
+{
+    if (!buffer || buffer_size < 12) return false;
+
+    if (buffer[0] == 0xff && buffer[1] == 0xd8 && buffer[2] == 0xff) {
+        return jpegComponents(buffer, buffer_size) == 1;
+    }
+    if (memcmp(buffer, "\x89PNG", 4) == 0 && buffer_size >= 26) {
+#ifdef USE_LIBPNG
+        // colour type in IHDR: 0 is gray, 4 is gray with alpha
+        return buffer[25] == 0 || buffer[25] == 4;
+#else
+        return false;
+#endif
+    }
+    return buffer[0] == 'P' && buffer[1] == '5';
+}
+
+unsigned char *ImageReader::decodeGray(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    if (!isGrayscale(buffer, buffer_size)) return nullptr;
+
+    if (buffer[0] == 0xff) {
+        return Decoder::decompressJpegGray(buffer, buffer_size, width, height);
+    }
+#ifdef USE_LIBPNG
+    if (buffer[0] == 0x89) {
+        return decodePng<unsigned char>(buffer, buffer_size, width, height);
+    }
+#endif
+    return decodePnm<unsigned char>(buffer, buffer_size, width, height);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Quality of JPEG inputs
+// ---------------------------------------------------------------------------------------------------------------------
+
+// luminance quantization table of the JPEG standard (K.1) in natural order, scaled by jpeg_set_quality() of libjpeg
+static const int standardLuminanceTable [64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+// position in natural order of every coefficient in the zigzag order of DQT segments
+static const int zigzagToNatural [64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// jpeg_quality_scaling() and jpeg_add_quant_table() with force_baseline
+static int scaledQuantizer(int quality, int i)
+{
+    const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    const int value = (standardLuminanceTable[i] * scale + 50) / 100;
+    return value < 1 ? 1 : (value > 255 ? 255 : value);
+}
+
+bool ImageReader::readJpegHeader(const unsigned char *buffer, unsigned long long int buffer_size, JpegHeader *header)
+{
+    if (!buffer || buffer_size < 4 || buffer[0] != 0xff || buffer[1] != 0xd8) return false;
+
+    // tables can be redefined before the scan, the last definition is used
+    int tables [4][64];
+    bool defined [4] = {false, false, false, false};
+    int lumaTable = -1;
+
+    unsigned long long int position = 2;
+    while (position + 4 <= buffer_size)
+    {
+        if (buffer[position] != 0xff) return false;
+        const int marker = buffer[position + 1];
+        if (marker == 0xff) {    // fill byte
+            position++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {    // markers without length
+            position += 2;
+            continue;
+        }
+        if (marker == 0xd9 || marker == 0xda) break;
+
+        const unsigned long long int length = (buffer[position + 2] << 8) | buffer[position + 3];
+        if (length < 2 || position + 2 + length > buffer_size) return false;
+        const unsigned char *segment = buffer + position + 4;
+        const unsigned long long int segmentSize = length - 2;
+
+        if (marker == 0xdb)
+        {
+            // any number of tables, each with precision (8 or 16 bits) and index
+            unsigned long long int offset = 0;
+            while (offset < segmentSize)
+            {
+                const int precision = segment[offset] >> 4, index = segment[offset] & 0x0f;
+                const unsigned long long int tableSize = precision ? 128 : 64;
+                if (index > 3 || offset + 1 + tableSize > segmentSize) return false;
+                for (int i = 0;  i < 64;  i++) {
+                    const unsigned char *value = segment + offset + 1 + (precision ? 2 * i : i);
+                    tables[index][zigzagToNatural[i]] = precision ? (value[0] << 8) | value[1] : value[0];
+                }
+                defined[index] = true;
+                offset += 1 + tableSize;
+            }
+        }
+        else if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)    // SOF
+        {
+            if (segmentSize < 9) return false;
+            header->height = (segment[1] << 8) | segment[2];
+            header->width = (segment[3] << 8) | segment[4];
+            header->numComponents = segment[5];
+            header->progressive = (marker == 0xc2 || marker == 0xc6 || marker == 0xca || marker == 0xce);
+            lumaTable = segment[8] & 0x0f;
+        }
+
+        position += 2 + length;
+    }
+
+    if (lumaTable < 0 || lumaTable > 3 || !defined[lumaTable]) return false;
+
+    // the quality factor with the smallest difference, the highest one of equal ones
+    const int *table = tables[lumaTable];
+    long long int bestDifference = -1;
+    for (int quality = 100;  quality >= 1;  quality--)
+    {
+        long long int difference = 0;
+        for (int i = 0;  i < 64;  i++) {
+            const int d = table[i] - scaledQuantizer(quality, i);
+            difference += d < 0 ? -d : d;
+        }
+        if (bestDifference < 0 || difference < bestDifference) {
+            bestDifference = difference;
+            header->quality = quality;
+        }
+    }
+    header->standardTable = (bestDifference == 0);
+    return true;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Dimensions from headers, used to estimate memory before an image is decoded
+// ---------------------------------------------------------------------------------------------------------------------
+
+static unsigned int readBigEndian(const unsigned char *data, int bytes)
+{
+    unsigned int value = 0;
+    for (int i = 0;  i < bytes;  i++) value = (value << 8) | data[i];
+    return value;
+}
+
+// a file or a buffer, e.g. an entry of an archive
+struct HeaderSource
+{
+    FILE *f;
+    const unsigned char *buffer;
+    unsigned long long int buffer_size;
+};
+
+static bool readAt(const HeaderSource &source, long offset, unsigned char *out, size_t size)
+{
+    if (!source.f) {
+        if (offset < 0 || (unsigned long long int) offset > source.buffer_size || size > source.buffer_size - offset) return false;
+        memcpy(out, source.buffer + offset, size);
+        return true;
+    }
+    return fseek(source.f, offset, SEEK_SET) == 0 && fread(out, 1, size, source.f) == size;
+}
+
+// walks the segments up to the first SOF marker, the metadata before it can be of any size
+static bool readJpegDimensions(const HeaderSource &f, int *width, int *height)
+{
+    long position = 2;
+    unsigned char segment [9];
+    while (readAt(f, position, segment, 4))
+    {
+        if (segment[0] != 0xff) return false;
+        const int marker = segment[1];
+        if (marker == 0xff) {    // fill byte
+            position++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {    // markers without length
+            position += 2;
+            continue;
+        }
+
+        // SOF0..SOF15 except DHT, JPG and DAC
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            if (!readAt(f, position, segment, 9)) return false;
+            *height = (int) readBigEndian(segment + 5, 2);
+            *width = (int) readBigEndian(segment + 7, 2);
+            return true;
+        }
+        if (marker == 0xd9 || marker == 0xda) return false;    // no frame header before the image data
+
+        position += 2 + readBigEndian(segment + 2, 2);
+    }
+    return false;
+}
+
+static bool readTiffDimensions(const HeaderSource &f, const unsigned char *header, int *width, int *height)
+{
+    const bool little_endian = header[0] == 'I';
+    unsigned char entry [12];
+
+    const unsigned int ifd_offset = little_endian ? readLittleEndian(header + 4, 4) : readBigEndian(header + 4, 4);
+    if (!readAt(f, (long) ifd_offset, entry, 2)) return false;
+    const int num_entries = (int) (little_endian ? readLittleEndian(entry, 2) : readBigEndian(entry, 2));
+
+    *width = 0;
+    *height = 0;
+    for (int i = 0;  i < num_entries && (*width == 0 || *height == 0);  i++)
+    {
+        if (!readAt(f, (long) ifd_offset + 2 + i * 12, entry, 12)) return false;
+        const unsigned int tag = little_endian ? readLittleEndian(entry, 2) : readBigEndian(entry, 2);
+        const unsigned int type = little_endian ? readLittleEndian(entry + 2, 2) : readBigEndian(entry + 2, 2);
+        if (tag != 256 && tag != 257) continue;    // ImageWidth, ImageLength
+
+        // SHORT or LONG, stored in the first bytes of the value field
+        const int bytes = (type == 3) ? 2 : 4;
+        const unsigned int value = little_endian ? readLittleEndian(entry + 8, bytes) : readBigEndian(entry + 8, bytes);
+        if (tag == 256) *width = (int) value;
+        else *height = (int) value;
+    }
+    return *width > 0 && *height > 0;
+}
+
+static bool readDimensionsFrom(const HeaderSource &f, int *width, int *height)
+{
+    // enough for the headers of all formats except JPEG and TIFF, which are read by offsets
+    unsigned char header [64] = {};
+    size_t header_size = sizeof(header);
+    if (f.f) header_size = fread(header, 1, sizeof(header), f.f);
+    else if (f.buffer_size < header_size) header_size = (size_t) f.buffer_size;
+    if (!f.f) memcpy(header, f.buffer, header_size);
+
+    int w = 0;
+    int h = 0;
+    bool ok = false;
+    if (header_size < 12) {
+        ok = false;
+    } else if (header[0] == 0xff && header[1] == 0xd8 && header[2] == 0xff) {
+        ok = readJpegDimensions(f, &w, &h);
+    } else if (memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WEBP", 4) == 0 && header_size >= 30) {
+        if (memcmp(header + 12, "VP8 ", 4) == 0 && header[23] == 0x9d && header[24] == 0x01 && header[25] == 0x2a) {
+            w = readLittleEndian(header + 26, 2) & 0x3fff;
+            h = readLittleEndian(header + 28, 2) & 0x3fff;
+            ok = true;
+        } else if (memcmp(header + 12, "VP8L", 4) == 0 && header[20] == 0x2f) {
+            const unsigned int bits = readLittleEndian(header + 21, 4);
+            w = (bits & 0x3fff) + 1;
+            h = ((bits >> 14) & 0x3fff) + 1;
+            ok = true;
+        } else if (memcmp(header + 12, "VP8X", 4) == 0) {
+            w = readLittleEndian(header + 24, 3) + 1;
+            h = readLittleEndian(header + 27, 3) + 1;
+            ok = true;
+        }
+    } else if (memcmp(header, "\x89PNG", 4) == 0 && header_size >= 24) {
+        w = (int) readBigEndian(header + 16, 4);
+        h = (int) readBigEndian(header + 20, 4);
+        ok = true;
+    } else if (memcmp(header, "II*\0", 4) == 0 || memcmp(header, "MM\0*", 4) == 0) {
+        ok = readTiffDimensions(f, header, &w, &h);
+    } else if (header[0] == 'B' && header[1] == 'M' && header_size >= 26) {
+        w = (int) readLittleEndian(header + 18, 4);
+        h = (int) readLittleEndian(header + 22, 4);
+        if (h < 0) h = -h;
+        ok = true;
+    } else if (header[0] == 'P' && (header[1] == '5' || header[1] == '6')) {
+        unsigned long long int position = 2;
+        const long long int pnm_width = readPnmField(header, header_size, &position);
+        const long long int pnm_height = readPnmField(header, header_size, &position);
+        ok = validSize(pnm_width, pnm_height);
+        if (ok) {
+            w = (int) pnm_width;
+            h = (int) pnm_height;
+        }
+    }
+
+    if (!ok || !validSize(w, h)) return false;
+    *width = w;
+    *height = h;
+    return true;
+}
+
+bool ImageReader::readDimensions(const char *path, int *width, int *height)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    const HeaderSource source = {f, nullptr, 0};
+    const bool ok = readDimensionsFrom(source, width, height);
+    fclose(f);
+    return ok;
+}
+
+bool ImageReader::readDimensions(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height)
+{
+    if (!buffer) return false;
+    const HeaderSource source = {nullptr, buffer, buffer_size};
+    return readDimensionsFrom(source, width, height);
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+
+// Parameters of a JPEG file from its headers
+struct JpegHeader
+{
+    int width;
+    int height;
+    int numComponents;
+    bool progressive;
+
+    // IJG quality factor (as in jpeg_set_quality()) whose luminance quantization table is the closest to the table of
+    // the first component; exact if standardTable is true, an approximation for files of other encoders
+    int quality;
+    bool standardTable;
+};
+
+// Qt-free image loading for the command line tool and for applications embedding the library.
+// Images are returned as a newly allocated (new []) xRGB buffer without row padding, i.e. the layout
+// expected by FeatureExtractor and Encoder, or nullptr if the format is unknown or the data is corrupted.
+//
+// The format is detected from the data, not from the file name:
+//  - JPEG and WebP, decoded by the codec libraries the encoders use anyway;
+//  - PNG if built with USE_LIBPNG, TIFF if built with USE_LIBTIFF;
+//  - uncompressed 24 and 32 bpp BMP and binary 8-bit PNM (PGM, PPM), which need no library.
+// Alpha channel is discarded, grayscale images are expanded to RGB by decode(); decodeGray() returns them
+// as 8-bit luminance instead, a quarter of the memory, for the luma-only path of FeatureExtractor and Encoder.
+class ImageReader
+{
+public:
+    static unsigned int *readFile(const char *path, int *width, int *height);
+    static unsigned int *decode(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+
+    // the whole file in a new [] buffer, or nullptr if it can't be read or is empty
+    static unsigned char *readFileData(const char *path, unsigned long long int *size);
+
+    // single-component JPEG, grayscale PNG (with USE_LIBPNG) and PGM; other formats are always decoded to xRGB
+    static bool isGrayscale(const unsigned char *buffer, unsigned long long int buffer_size);
+
+    // 8-bit gray without row padding (new []), or nullptr if the data is not a grayscale image or is corrupted
+    static unsigned char *decodeGray(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+
+    // reads only the dimensions from the header, without decoding; TIFF is supported even without libtiff
+    static bool readDimensions(const char *path, int *width, int *height);
+    static bool readDimensions(const unsigned char *buffer, unsigned long long int buffer_size, int *width, int *height);
+
+    // parses the markers up to the first scan, without decoding; false if the data is not a JPEG or has no
+    // frame header or quantization table of the first component before the scan
+    static bool readJpegHeader(const unsigned char *buffer, unsigned long long int buffer_size, JpegHeader *header);
+};
+
+#endif // IMAGEREADER_H
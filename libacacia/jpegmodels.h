@@ -30,7 +30,7 @@
 // Each line represents a set of neuron weights starting from bias.
 // Hidden layer neurons use a sigmoid activation function.
 // Output neuron doesn't have an activation function.
-double jpeg_fsize_model [] = {
+constexpr double jpeg_fsize_model [] = {
     -2.08379949331769e+00, -3.31696216584228e-01,  3.67875757620769e-01,  8.97286424251348e-01,  1.37755514975399e+00, -8.26159276663461e-01, -4.03569048070199e-01,  8.66812442139388e-02, -1.44783333186952e-01, -1.55190181754401e-01, -4.79121621695831e-01, -2.18788203870453e-01, -5.01149607086779e-01,
     -1.08892839400367e+00,  2.95931075152784e-01,  8.50315386632042e-02, -7.35258656445459e-01,  5.74982682384002e-02, -7.80579169111082e-01,  1.13325291734651e-01, -1.35603159542050e-01,  8.97070866151554e-02, -1.47320319640621e-02,  4.40130983285798e-02, -8.15272408120509e-03, -1.75291360387076e+00,
     -2.51315963300187e+00, -9.64297150944953e-03,  2.30850800901785e-01, -9.09754871627380e-01, -1.07293244873102e+00,  1.14647123245099e+00,  6.80521479659345e-01, -4.97398522319954e-01,  4.98319669366867e-01,  1.18743173704620e-02,  1.08011232729450e-01, -1.01574195426818e-01, -4.77224424333547e-01,
@@ -86,7 +86,7 @@ double jpeg_fsize_model [] = {
 
 // This array describes a neural network model for predicting Y-MSSIM metric for JPEG images.
 // The network topology is the same as for the file size model.
-double jpeg_ymssim_model [] = {
+constexpr double jpeg_ymssim_model [] = {
     -6.88935982091703e-01, -9.80286165694310e-01,  1.04060277704740e-01,  3.90755040766013e-01,  5.58080891801451e-01, -4.79885765390929e-02, -3.76728748810626e-01, -1.91402524502127e-01,  2.43486594047023e-02, -8.74443142412441e-02,  1.24302602011771e-01,  1.24857562252717e-02,  1.52018553258814e-01,
     -8.22846792279406e-01,  1.39435982147135e-01,  2.92729393288896e-01, -2.89137282978187e-02, -5.38483718446782e-01,  4.77595568649737e-01, -1.25901603181144e-01,  2.68277204955558e-01, -5.18043304032229e-01,  4.69373116324889e-01, -1.63607694422893e-01,  8.70838390841254e-02,  2.29748503343113e-01,
     -1.38241486123700e-01,  9.70233756820086e-02,  3.04153046543380e-01, -1.09091240703824e-01, -3.21426864511985e-01,  2.45608077665555e-01,  2.07346128977096e-01, -5.16854002579622e-01, -1.01334979293614e-01,  1.28421021082994e-02,  1.56282187871969e-01,  1.18566756229845e-01,  3.69503842970750e-01,
@@ -142,7 +142,7 @@ double jpeg_ymssim_model [] = {
 
 // This array describes a neural network model for predicting Y-PSNR metric for JPEG images.
 // The network topology is the same as for the file size model.
-double jpeg_ypsnr_model [] = {
+constexpr double jpeg_ypsnr_model [] = {
      3.82153634860580e+01,  6.11256938689804e+00,  5.48612390355302e+00, -2.97589602510741e-01,  1.56059477537567e+00, -1.57278981544128e+00,  6.90725475949734e-01,  5.60120807092384e-02,  1.06646852925658e+00, -2.53497078604886e+00,  2.30518050850968e+00, -9.64751265017115e-01, -7.60562674431338e-01,
     -1.65180371581972e+00,  2.85918430372228e+00, -4.84602309894709e+00,  1.48027442372086e+00,  1.53709288891370e+00, -8.23071403443364e-01, -5.15819160150546e-03, -3.76634443486737e+00,  1.19004377975556e+00, -2.36348216922586e-01,  7.55423798942650e-02,  4.91079381978774e-01,  4.93868198229812e-01,
      8.38690203842953e-01,  5.17487582595112e+00, -4.66952785356888e+00,  1.35985876710827e+00,  4.11701138682857e-01, -3.07858992583262e+00,  2.55473475995566e+00, -8.12023216122846e-01,  2.94210167716689e-01, -2.91484800365965e-01, -1.25584508350684e+00,  1.58361730508104e-01,  9.59965349496224e-01,
@@ -0,0 +1,22 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Include this file into a project which uses the ACACIA core library.
+# The project has to be placed next to the library directory, e.g. in a subdirectory of acacia.pro.
+#
+# -------------------------------------------------------------------------------------------------
+
+
+include($$PWD/../acacia.pri)
+
+INCLUDEPATH += $$PWD
+DEPENDPATH  += $$PWD
+
+LIBS += -L$$OUT_PWD/../libacacia -lacacia
+
+acacia_shared {
+    unix: QMAKE_RPATHDIR += $$OUT_PWD/../libacacia
+} else {
+    # codec libraries are linked into the executable together with the static library
+    LIBS += $$ACACIA_LIBS
+    unix|win32-g++: PRE_TARGETDEPS += $$OUT_PWD/../libacacia/libacacia.a
+}
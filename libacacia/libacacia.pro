@@ -0,0 +1,77 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Core of ACACIA without Qt dependency: image features, regression models, quality factor
+# optimization, encoders, decoders, quality metrics and profiling.
+#
+# Applications use it via libacacia.pri. It can be embedded into other C++ programs as well,
+# the C interface is declared in acacia.h, C++ classes in featureextractor.h, optimizer.h, modelset.h, encoder.h
+# and imagereader.h.
+#
+# -------------------------------------------------------------------------------------------------
+
+
+include(../acacia.pri)
+
+CONFIG  -= qt
+
+TARGET   = acacia
+
+TEMPLATE = lib
+
+# static library by default, so the executables don't need it at runtime
+acacia_shared {
+    CONFIG += shared
+    LIBS   += $$ACACIA_LIBS
+} else {
+    CONFIG += staticlib
+}
+
+# the same location for all platforms and build modes, libacacia.pri relies on it
+DESTDIR = $$OUT_PWD
+
+SOURCES += \
+    acacia.cpp \
+    featureextractor.cpp \
+    sequenceanalyzer.cpp \
+    optimizer.cpp \
+    calibration.cpp \
+    modelset.cpp \
+    encoder.cpp \
+    decoder.cpp \
+    imagereader.cpp \
+    yuvimage.cpp \
+    metrics.cpp \
+    groundtruth.cpp \
+    memorybudget.cpp \
+    deadlineplanner.cpp \
+    taskscheduler.cpp \
+    asyncio.cpp \
+    archive.cpp \
+    profiler.cpp \
+    perfcounters.cpp
+
+HEADERS += \
+    acacia.h \
+    version.h \
+    featureextractor.h \
+    sequenceanalyzer.h \
+    featurekernels.h \
+    optimizer.h \
+    calibration.h \
+    modelset.h \
+    mlpmodel.h \
+    jpegmodels.h \
+    webpmodels.h \
+    encoder.h \
+    decoder.h \
+    imagereader.h \
+    yuvimage.h \
+    metrics.h \
+    groundtruth.h \
+    memorybudget.h \
+    deadlineplanner.h \
+    taskscheduler.h \
+    asyncio.h \
+    archive.h \
+    profiler.h \
+    perfcounters.h
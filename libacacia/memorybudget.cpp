@@ -0,0 +1,89 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "memorybudget.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+MemoryBudget::MemoryBudget(unsigned long long int bytes) : totalBytes(bytes), usedBytes(0), nextTicket(0), servedTicket(0) {}
+
+unsigned long long int MemoryBudget::estimatePeakMemory(int width, int height, unsigned long long int fileSize, bool isjpeg)
+{
+    const unsigned long long int pixels = (unsigned long long int) width * height;
+    const unsigned long long int image = pixels * 4;
+
+    // libjpeg keeps all DCT coefficients of a 4:2:0 image for Huffman optimization (1.5 coefficients of 2 bytes per pixel)
+    // and receives the YCbCr planes written during the analysis (1.5 bytes per pixel);
+    // libwebp converts the image to 4:2:0 YUV and keeps the compressed partitions until the end (at most about 1 byte per pixel)
+    const unsigned long long int encoder = isjpeg ? pixels * 9 / 2 : pixels * 5 / 2;
+
+    // codec structures, row buffers and the thread's stack are not proportional to the image
+    const unsigned long long int overhead = 4 << 20;
+
+    return image + (fileSize > encoder ? fileSize : encoder) + overhead;
+}
+
+unsigned long long int MemoryBudget::defaultBudget()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) return status.ullTotalPhys / 2;
+#else
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) return (unsigned long long int) pages * pageSize / 2;
+#endif
+    return 2048ULL << 20;
+}
+
+unsigned long long int MemoryBudget::acquire(unsigned long long int bytes)
+{
+    // an oversized job takes the whole budget, so it's admitted only when nothing else runs
+    if (bytes > totalBytes) bytes = totalBytes;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    const unsigned long long int ticket = nextTicket++;
+    admitted.wait(lock, [&] { return ticket == servedTicket && usedBytes + bytes <= totalBytes; });
+
+    usedBytes += bytes;
+    servedTicket++;
+
+    // the next job in the queue may fit as well
+    admitted.notify_all();
+    return bytes;
+}
+
+void MemoryBudget::release(unsigned long long int bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    usedBytes -= bytes;
+    admitted.notify_all();
+}
+
+unsigned long long int MemoryBudget::budget() const
+{
+    return totalBytes;
+}
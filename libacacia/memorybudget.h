@@ -0,0 +1,62 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <condition_variable>
+#include <mutex>
+
+// Admission control for images processed in parallel.
+//
+// Every job reserves its estimated peak memory before it starts and releases it when it's done, so a few very large
+// images arriving together are processed one after another instead of exhausting the memory. Jobs are admitted
+// in the order of their acquire() calls, so a large image is not overtaken forever by small ones; a job larger than
+// the whole budget waits until all others are finished and then runs alone.
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(unsigned long long int bytes);
+
+    // peak memory of reading, analyzing and encoding an image: the file data and the decoded xRGB image during decoding,
+    // the image and the codec's working memory, which includes the compressed data, during encoding
+    static unsigned long long int estimatePeakMemory(int width, int height, unsigned long long int fileSize, bool isjpeg);
+
+    // the budget used when none is given: half of the physical memory
+    static unsigned long long int defaultBudget();
+
+    // blocks until the job is admitted; the returned amount (bytes limited to the budget) must be passed to release()
+    unsigned long long int acquire(unsigned long long int bytes);
+    void release(unsigned long long int bytes);
+
+    unsigned long long int budget() const;
+
+private:
+    const unsigned long long int totalBytes;
+
+    std::mutex mutex;
+    std::condition_variable admitted;
+    unsigned long long int usedBytes;
+    unsigned long long int nextTicket;
+    unsigned long long int servedTicket;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,141 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "metrics.h"
+
+#include <vector>
+
+#include "math.h"
+
+void Metrics::extractLuma(const unsigned int *imageData, int width, int height, unsigned char *luma)
+{
+    const size_t numPixels = (size_t) width * height;
+    for (size_t i = 0;  i < numPixels;  i++)
+    {
+        const unsigned int pixel = imageData[i];
+        const unsigned int r = (pixel >> 16) & 0xff;
+        const unsigned int g = (pixel >> 8) & 0xff;
+        const unsigned int b = pixel & 0xff;
+        luma[i] = (unsigned char) ((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+    }
+}
+
+double Metrics::computePSNR(const unsigned char *reference, const unsigned char *distorted, int width, int height)
+{
+    const size_t numPixels = (size_t) width * height;
+
+    unsigned long long int sqrErrorSum = 0;
+    for (size_t i = 0;  i < numPixels;  i++)
+    {
+        const int difference = (int) reference[i] - (int) distorted[i];
+        sqrErrorSum += difference * difference;
+    }
+
+    // identical images would give infinity, so PSNR is clipped to 100 dB like in most tools
+    if (sqrErrorSum == 0) return 100.0;
+
+    const double mse = (double) sqrErrorSum / numPixels;
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+/**
+ * @brief computeMSSIM - mean SSIM index as defined by Wang et al.: 11x11 Gaussian window with sigma 1.5,
+ * K1 = 0.01, K2 = 0.03, dynamic range 255, only windows completely inside the image are used.
+ * Local statistics are calculated with a separable filter over a ring buffer of 11 rows,
+ * so memory consumption doesn't depend on the image height.
+ */
+double Metrics::computeMSSIM(const unsigned char *reference, const unsigned char *distorted, int width, int height)
+{
+    const int windowSize = 11;
+    const double sigma = 1.5;
+
+    if (width < windowSize || height < windowSize) return 1.0;
+
+    const double C1 = (0.01 * 255) * (0.01 * 255);
+    const double C2 = (0.03 * 255) * (0.03 * 255);
+
+    // normalized 1D Gaussian window
+    double window [windowSize];
+    double windowSum = 0;
+    for (int i = 0;  i < windowSize;  i++) {
+        const double d = i - windowSize / 2;
+        window[i] = exp(-d * d / (2 * sigma * sigma));
+        windowSum += window[i];
+    }
+    for (int i = 0;  i < windowSize;  i++) window[i] /= windowSum;
+
+    // horizontally filtered rows of x, y, x^2, y^2 and xy
+    const int outWidth = width - windowSize + 1;
+    const int outHeight = height - windowSize + 1;
+    const int numStats = 5;
+    std::vector<double> ring ((size_t) windowSize * numStats * outWidth);
+
+    double ssimSum = 0;
+
+    for (int row = 0;  row < height;  row++)
+    {
+        const unsigned char *x = reference + (size_t) row * width;
+        const unsigned char *y = distorted + (size_t) row * width;
+        double *filtered = &ring[(size_t) (row % windowSize) * numStats * outWidth];
+
+        for (int col = 0;  col < outWidth;  col++)
+        {
+            double mx = 0, my = 0, xx = 0, yy = 0, xy = 0;
+            for (int k = 0;  k < windowSize;  k++)
+            {
+                const double vx = x[col + k];
+                const double vy = y[col + k];
+                mx += window[k] * vx;
+                my += window[k] * vy;
+                xx += window[k] * vx * vx;
+                yy += window[k] * vy * vy;
+                xy += window[k] * vx * vy;
+            }
+            filtered[col] = mx;
+            filtered[outWidth + col] = my;
+            filtered[2 * outWidth + col] = xx;
+            filtered[3 * outWidth + col] = yy;
+            filtered[4 * outWidth + col] = xy;
+        }
+
+        if (row < windowSize - 1) continue;
+
+        // vertical filtering: the oldest row in the ring corresponds to the first window coefficient
+        const int firstRow = row - windowSize + 1;
+        for (int col = 0;  col < outWidth;  col++)
+        {
+            double stats [numStats] = {0, 0, 0, 0, 0};
+            for (int k = 0;  k < windowSize;  k++)
+            {
+                const double *source = &ring[(size_t) ((firstRow + k) % windowSize) * numStats * outWidth];
+                for (int s = 0;  s < numStats;  s++) stats[s] += window[k] * source[s * outWidth + col];
+            }
+
+            const double muX = stats[0];
+            const double muY = stats[1];
+            const double sigmaXX = stats[2] - muX * muX;
+            const double sigmaYY = stats[3] - muY * muY;
+            const double sigmaXY = stats[4] - muX * muY;
+
+            ssimSum += ((2 * muX * muY + C1) * (2 * sigmaXY + C2)) / ((muX * muX + muY * muY + C1) * (sigmaXX + sigmaYY + C2));
+        }
+    }
+
+    return ssimSum / ((double) outWidth * outHeight);
+}
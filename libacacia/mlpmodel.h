@@ -0,0 +1,432 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MLPMODEL_H
+#define MLPMODEL_H
+
+#include "immintrin.h"
+
+// Single precision MLP with one sigmoid hidden layer, built at compile time from the double models
+// in jpegmodels.h and webpmodels.h.
+//
+// The hidden layer is transposed: for every input there is a row of weights of all hidden neurons,
+// so 8 neurons are processed by one AVX instruction. The number of neurons is padded to whole registers
+// with zero weights, padded neurons output sigmoid(0) = 0.5 multiplied by a zero output weight.
+// A 12-50-1 network takes 792 floats (3 KB), all six models fit into L1 cache together.
+//
+// The quantized variant at the end of the file uses 16-bit integer arithmetic in the hidden layer.
+
+template <int NumInputs, int NumHidden>
+struct MlpModel
+{
+    static const int numInputs = NumInputs;
+    static const int numHidden = NumHidden;
+    static const int paddedHidden = (NumHidden + 7) / 8 * 8;
+    static const int numBlocks = paddedHidden / 8;
+
+    static const int hiddenWeightsOffset = 0;    // [NumInputs][paddedHidden]
+    static const int hiddenBiasOffset = NumInputs * paddedHidden;
+    static const int outputWeightsOffset = hiddenBiasOffset + paddedHidden;
+    static const int outputBiasOffset = outputWeightsOffset + paddedHidden;
+    static const int size = outputBiasOffset + 8;
+
+    alignas(64) float weights [size];
+};
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Compile-time conversion
+// ---------------------------------------------------------------------------------------------------------------------
+
+// integer sequence (C++11 has no std::index_sequence), built with logarithmic template depth
+template <int... I> struct MlpIndices {};
+
+template <class A, class B> struct MlpConcatIndices;
+template <int... A, int... B> struct MlpConcatIndices<MlpIndices<A...>, MlpIndices<B...> >
+{
+    typedef MlpIndices<A..., (int) sizeof...(A) + B...> type;
+};
+
+template <int N> struct MlpMakeIndices
+{
+    typedef typename MlpConcatIndices<typename MlpMakeIndices<N / 2>::type, typename MlpMakeIndices<N - N / 2>::type>::type type;
+};
+template <> struct MlpMakeIndices<0> { typedef MlpIndices<> type; };
+template <> struct MlpMakeIndices<1> { typedef MlpIndices<0> type; };
+
+// Element i of the float layout. The double model stores every hidden neuron as bias followed by input weights,
+// then the output bias followed by output weights.
+template <int NumInputs, int NumHidden>
+constexpr float mlpModelElement(const double *model, int i)
+{
+    typedef MlpModel<NumInputs, NumHidden> M;
+    return
+        (i < M::hiddenBiasOffset)    ? ((i % M::paddedHidden < NumHidden) ? (float) model[(i % M::paddedHidden) * (1 + NumInputs) + 1 + i / M::paddedHidden] : 0.0f) :
+        (i < M::outputWeightsOffset) ? ((i - M::hiddenBiasOffset < NumHidden) ? (float) model[(i - M::hiddenBiasOffset) * (1 + NumInputs)] : 0.0f) :
+        (i < M::outputBiasOffset)    ? ((i - M::outputWeightsOffset < NumHidden) ? (float) model[(1 + NumInputs) * NumHidden + 1 + (i - M::outputWeightsOffset)] : 0.0f) :
+        (i == M::outputBiasOffset)   ? (float) model[(1 + NumInputs) * NumHidden] : 0.0f;
+}
+
+template <int NumInputs, int NumHidden, int... I>
+constexpr MlpModel<NumInputs, NumHidden> makeMlpModel(const double *model, MlpIndices<I...>)
+{
+    return MlpModel<NumInputs, NumHidden> {{mlpModelElement<NumInputs, NumHidden>(model, I)...}};
+}
+
+template <int NumInputs, int NumHidden>
+constexpr MlpModel<NumInputs, NumHidden> makeMlpModel(const double *model)
+{
+    return makeMlpModel<NumInputs, NumHidden>(model, typename MlpMakeIndices<MlpModel<NumInputs, NumHidden>::size>::type());
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Inference kernels
+// ---------------------------------------------------------------------------------------------------------------------
+
+// exp(x) for 8 floats, Cephes polynomial with relative error below 2e-7; no branches
+static inline __m256 mlpExp(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+
+    // x = n * ln(2) + r, ln(2) is split into two constants for precision
+    const __m256 n = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _mm256_set1_ps(0.5f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(0.693359375f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(-2.12194440e-4f)));
+
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, x), x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    // 2^n is built directly in the exponent bits
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(exponent));
+}
+
+// Hidden layer pre-activations for the first NumUsed inputs. With NumUsed < NumInputs the result can be
+// reused for many values of the remaining inputs, e.g. for all quality factors.
+template <int NumUsed, int NumInputs, int NumHidden>
+static inline void mlpHiddenSums(const MlpModel<NumInputs, NumHidden> &model, const float *input, __m256 *sums)
+{
+    typedef MlpModel<NumInputs, NumHidden> M;
+    for (int b = 0;  b < M::numBlocks;  b++) sums[b] = _mm256_load_ps(model.weights + M::hiddenBiasOffset + b * 8);
+
+    for (int k = 0;  k < NumUsed;  k++)
+    {
+        const __m256 x = _mm256_set1_ps(input[k]);
+        const float *row = model.weights + M::hiddenWeightsOffset + k * M::paddedHidden;
+        for (int b = 0;  b < M::numBlocks;  b++) sums[b] = _mm256_add_ps(sums[b], _mm256_mul_ps(x, _mm256_load_ps(row + b * 8)));
+    }
+}
+
+// adds one input to pre-activations computed by mlpHiddenSums()
+template <int NumInputs, int NumHidden>
+static inline void mlpAddInput(const MlpModel<NumInputs, NumHidden> &model, int k, float value, const __m256 *sums, __m256 *result)
+{
+    typedef MlpModel<NumInputs, NumHidden> M;
+    const __m256 x = _mm256_set1_ps(value);
+    const float *row = model.weights + M::hiddenWeightsOffset + k * M::paddedHidden;
+    for (int b = 0;  b < M::numBlocks;  b++) result[b] = _mm256_add_ps(sums[b], _mm256_mul_ps(x, _mm256_load_ps(row + b * 8)));
+}
+
+// adds 8 weighted activations of the output neuron; the sum is kept in double, because the file size model
+// predicts a logarithm and float rounding of the sum would be amplified by exp()
+static inline __m256d mlpAccumulateOutput(__m256d result, __m256 activation, const float *outputWeights)
+{
+    const __m256 weighted = _mm256_mul_ps(activation, _mm256_load_ps(outputWeights));
+    return _mm256_add_pd(result, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(weighted)), _mm256_cvtps_pd(_mm256_extractf128_ps(weighted, 1))));
+}
+
+static inline float mlpFinishOutput(__m256d result, float outputBias)
+{
+    __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(result), _mm256_extractf128_pd(result, 1));
+    sum2 = _mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2));
+    return (float) (_mm_cvtsd_f64(sum2) + outputBias);
+}
+
+// sigmoid activations and the linear output neuron
+template <int NumInputs, int NumHidden>
+static inline float mlpOutput(const MlpModel<NumInputs, NumHidden> &model, const __m256 *sums)
+{
+    typedef MlpModel<NumInputs, NumHidden> M;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    __m256d result = _mm256_setzero_pd();
+    for (int b = 0;  b < M::numBlocks;  b++)
+    {
+        const __m256 activation = _mm256_div_ps(one, _mm256_add_ps(one, mlpExp(_mm256_xor_ps(sums[b], signMask))));
+        result = mlpAccumulateOutput(result, activation, model.weights + M::outputWeightsOffset + b * 8);
+    }
+
+    return mlpFinishOutput(result, model.weights[M::outputBiasOffset]);
+}
+
+// complete forward pass for a standardized input vector
+template <int NumInputs, int NumHidden>
+static inline float mlpForward(const MlpModel<NumInputs, NumHidden> &model, const float *input)
+{
+    __m256 sums [MlpModel<NumInputs, NumHidden>::numBlocks];
+    mlpHiddenSums<NumInputs>(model, input, sums);
+    return mlpOutput(model, sums);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Quantized models
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Hidden layer with 16-bit weights and inputs and 32-bit sums, two inputs per _mm256_madd_epi16.
+// 8-bit weights (maddubs) were not used: they give only 255 levels per neuron and need unsigned inputs.
+//
+// Inputs are standardized values in 5.11 fixed point, clamped to +-16 (16 standard deviations). Unusual images
+// exceed 8 standard deviations in some features, and clamping there changed PSNR predictions by over 0.5 dB,
+// far more than rounding to 1/2048 costs. Every neuron has its own weight scale, chosen as large as possible
+// while the worst case sum of 12 inputs and the bias still fits into 31 bits, so no saturation checks are
+// needed. The sums are converted back to float with the inverse scale, the sigmoid is taken from a table,
+// the output neuron stays in floating point.
+
+static const int mlpInputScale = 2048;
+static const float mlpMaxInput = 32767.0f / mlpInputScale;
+
+template <int NumInputs, int NumHidden>
+struct MlpQuantizedModel
+{
+    static const int numInputs = NumInputs;
+    static const int numHidden = NumHidden;
+    static const int numPairs = (NumInputs + 1) / 2;
+    static const int paddedHidden = (NumHidden + 7) / 8 * 8;
+    static const int numBlocks = paddedHidden / 8;
+    static const int numWeights = numPairs * paddedHidden * 2;
+
+    alignas(64) short hiddenWeights [numWeights];    // [numPairs][paddedHidden][2]
+    alignas(32) int hiddenBias [paddedHidden];
+    alignas(32) float sumScale [paddedHidden];       // converts a sum back to the float pre-activation
+    alignas(32) float outputWeights [paddedHidden];
+    float outputBias;
+};
+
+constexpr double mlpAbs(double x)
+{
+    return x < 0 ? -x : x;
+}
+
+constexpr double mlpMin(double a, double b)
+{
+    return a < b ? a : b;
+}
+
+constexpr double mlpMax(double a, double b)
+{
+    return a > b ? a : b;
+}
+
+constexpr int mlpRound(double x)
+{
+    return (int) (x < 0 ? x - 0.5 : x + 0.5);
+}
+
+// weight of input k of hidden neuron n in the double model, zero for padding
+template <int NumInputs, int NumHidden>
+constexpr double mlpHiddenWeight(const double *model, int n, int k)
+{
+    return (n < NumHidden && k < NumInputs) ? model[n * (1 + NumInputs) + 1 + k] : 0.0;
+}
+
+template <int NumInputs, int NumHidden>
+constexpr double mlpHiddenBias(const double *model, int n)
+{
+    return n < NumHidden ? model[n * (1 + NumInputs)] : 0.0;
+}
+
+template <int NumInputs, int NumHidden>
+constexpr double mlpMaxAbsWeight(const double *model, int n, int k = 0)
+{
+    return k == NumInputs ? 0.0 : mlpMax(mlpAbs(mlpHiddenWeight<NumInputs, NumHidden>(model, n, k)), mlpMaxAbsWeight<NumInputs, NumHidden>(model, n, k + 1));
+}
+
+template <int NumInputs, int NumHidden>
+constexpr double mlpSumAbsWeights(const double *model, int n, int k = 0)
+{
+    return k == NumInputs ? 0.0 : mlpAbs(mlpHiddenWeight<NumInputs, NumHidden>(model, n, k)) + mlpSumAbsWeights<NumInputs, NumHidden>(model, n, k + 1);
+}
+
+// 16-bit weights, and the sum of all inputs at the clamping limit plus the bias stays below 1.9e9
+template <int NumInputs, int NumHidden>
+constexpr double mlpWeightScale(const double *model, int n)
+{
+    return (n >= NumHidden || mlpMaxAbsWeight<NumInputs, NumHidden>(model, n) == 0.0) ? 0.0 :
+        mlpMin(32767.0 / mlpMaxAbsWeight<NumInputs, NumHidden>(model, n),
+               1.9e9 / (32767.0 * mlpSumAbsWeights<NumInputs, NumHidden>(model, n) + mlpInputScale * mlpAbs(mlpHiddenBias<NumInputs, NumHidden>(model, n))));
+}
+
+template <int NumInputs, int NumHidden>
+constexpr short mlpQuantizedWeight(const double *model, int i)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+    return (short) mlpRound(mlpHiddenWeight<NumInputs, NumHidden>(model, (i % (2 * M::paddedHidden)) / 2, i / (2 * M::paddedHidden) * 2 + i % 2) *
+                            mlpWeightScale<NumInputs, NumHidden>(model, (i % (2 * M::paddedHidden)) / 2));
+}
+
+template <int NumInputs, int NumHidden>
+constexpr float mlpSumScale(const double *model, int n)
+{
+    return mlpWeightScale<NumInputs, NumHidden>(model, n) == 0.0 ? 0.0f : (float) (1.0 / (mlpInputScale * mlpWeightScale<NumInputs, NumHidden>(model, n)));
+}
+
+template <int NumInputs, int NumHidden>
+constexpr float mlpOutputWeight(const double *model, int n)
+{
+    return n < NumHidden ? (float) model[(1 + NumInputs) * NumHidden + 1 + n] : 0.0f;
+}
+
+template <int NumInputs, int NumHidden, int... W, int... N>
+constexpr MlpQuantizedModel<NumInputs, NumHidden> makeMlpQuantizedModel(const double *model, MlpIndices<W...>, MlpIndices<N...>)
+{
+    return MlpQuantizedModel<NumInputs, NumHidden> {
+        {mlpQuantizedWeight<NumInputs, NumHidden>(model, W)...},
+        {mlpRound(mlpHiddenBias<NumInputs, NumHidden>(model, N) * mlpWeightScale<NumInputs, NumHidden>(model, N) * mlpInputScale)...},
+        {mlpSumScale<NumInputs, NumHidden>(model, N)...},
+        {mlpOutputWeight<NumInputs, NumHidden>(model, N)...},
+        (float) model[(1 + NumInputs) * NumHidden]
+    };
+}
+
+template <int NumInputs, int NumHidden>
+constexpr MlpQuantizedModel<NumInputs, NumHidden> makeMlpQuantizedModel(const double *model)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+    return makeMlpQuantizedModel<NumInputs, NumHidden>(model, typename MlpMakeIndices<M::numWeights>::type(), typename MlpMakeIndices<M::paddedHidden>::type());
+}
+
+// Sigmoid table on [-16, 16] with 32 steps per unit and linear interpolation, the error is below 1e-5.
+// C++11 has no constexpr exp(), so it's calculated by halving the argument down to a short Taylor series.
+static const int mlpSigmoidSteps = 32;
+static const int mlpSigmoidRange = 16;
+static const int mlpSigmoidTableSize = 2 * mlpSigmoidRange * mlpSigmoidSteps + 1;
+
+struct MlpSigmoidTable
+{
+    alignas(64) float value [mlpSigmoidTableSize];
+    alignas(64) float slope [mlpSigmoidTableSize];    // difference to the next value
+};
+
+constexpr double mlpConstExpSquare(double y)
+{
+    return y * y;
+}
+
+constexpr double mlpConstExp(double x)
+{
+    return mlpAbs(x) > 0.0625 ? mlpConstExpSquare(mlpConstExp(x / 2)) : 1 + x * (1 + x / 2 * (1 + x / 3 * (1 + x / 4 * (1 + x / 5 * (1 + x / 6)))));
+}
+
+constexpr double mlpTableSigmoid(int i)
+{
+    return 1.0 / (1.0 + mlpConstExp(mlpSigmoidRange - (double) i / mlpSigmoidSteps));
+}
+
+template <int... I>
+constexpr MlpSigmoidTable makeMlpSigmoidTable(MlpIndices<I...>)
+{
+    return MlpSigmoidTable {
+        {(float) mlpTableSigmoid(I)...},
+        {(float) (I + 1 < mlpSigmoidTableSize ? mlpTableSigmoid(I + 1) - mlpTableSigmoid(I) : 0.0)...}
+    };
+}
+
+static constexpr MlpSigmoidTable mlpSigmoidTable = makeMlpSigmoidTable(MlpMakeIndices<mlpSigmoidTableSize>::type());
+
+static inline __m256 mlpSigmoidLookup(__m256 x)
+{
+    __m256 position = _mm256_mul_ps(_mm256_add_ps(x, _mm256_set1_ps((float) mlpSigmoidRange)), _mm256_set1_ps((float) mlpSigmoidSteps));
+    position = _mm256_min_ps(_mm256_max_ps(position, _mm256_setzero_ps()), _mm256_set1_ps(mlpSigmoidTableSize - 1.0f));
+    const __m256i index = _mm256_cvttps_epi32(position);
+    const __m256 fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+
+    const __m256 value = _mm256_i32gather_ps(mlpSigmoidTable.value, index, 4);
+    const __m256 slope = _mm256_i32gather_ps(mlpSigmoidTable.slope, index, 4);
+    return _mm256_add_ps(value, _mm256_mul_ps(fraction, slope));
+}
+
+// 5.11 fixed point input
+static inline short mlpQuantizeInput(float x)
+{
+    x = x < -mlpMaxInput ? -mlpMaxInput : (x > mlpMaxInput ? mlpMaxInput : x);
+    return (short) _mm_cvtss_si32(_mm_set_ss(x * mlpInputScale));
+}
+
+// Hidden layer sums of the first NumPairsUsed input pairs; input holds quantized values padded to whole pairs.
+template <int NumPairsUsed, int NumInputs, int NumHidden>
+static inline void mlpQuantizedHiddenSums(const MlpQuantizedModel<NumInputs, NumHidden> &model, const short *input, __m256i *sums)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+    for (int b = 0;  b < M::numBlocks;  b++) sums[b] = _mm256_load_si256((const __m256i *) (model.hiddenBias + b * 8));
+
+    for (int p = 0;  p < NumPairsUsed;  p++)
+    {
+        // both inputs of the pair in every 32-bit lane
+        const __m256i x = _mm256_set1_epi32((int) (((unsigned int) (unsigned short) input[2 * p + 1] << 16) | (unsigned short) input[2 * p]));
+        const short *row = model.hiddenWeights + p * 2 * M::paddedHidden;
+        for (int b = 0;  b < M::numBlocks;  b++) sums[b] = _mm256_add_epi32(sums[b], _mm256_madd_epi16(x, _mm256_load_si256((const __m256i *) (row + b * 16))));
+    }
+}
+
+// adds input pair p to sums computed by mlpQuantizedHiddenSums()
+template <int NumInputs, int NumHidden>
+static inline void mlpQuantizedAddPair(const MlpQuantizedModel<NumInputs, NumHidden> &model, int p, short first, short second, const __m256i *sums, __m256i *result)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+    const __m256i x = _mm256_set1_epi32((int) (((unsigned int) (unsigned short) second << 16) | (unsigned short) first));
+    const short *row = model.hiddenWeights + p * 2 * M::paddedHidden;
+    for (int b = 0;  b < M::numBlocks;  b++) result[b] = _mm256_add_epi32(sums[b], _mm256_madd_epi16(x, _mm256_load_si256((const __m256i *) (row + b * 16))));
+}
+
+template <int NumInputs, int NumHidden>
+static inline float mlpQuantizedOutput(const MlpQuantizedModel<NumInputs, NumHidden> &model, const __m256i *sums)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+
+    __m256d result = _mm256_setzero_pd();
+    for (int b = 0;  b < M::numBlocks;  b++)
+    {
+        const __m256 preActivation = _mm256_mul_ps(_mm256_cvtepi32_ps(sums[b]), _mm256_load_ps(model.sumScale + b * 8));
+        result = mlpAccumulateOutput(result, mlpSigmoidLookup(preActivation), model.outputWeights + b * 8);
+    }
+
+    return mlpFinishOutput(result, model.outputBias);
+}
+
+template <int NumInputs, int NumHidden>
+static inline float mlpQuantizedForward(const MlpQuantizedModel<NumInputs, NumHidden> &model, const float *input)
+{
+    typedef MlpQuantizedModel<NumInputs, NumHidden> M;
+    short quantizedInput [2 * M::numPairs] = {};
+    for (int k = 0;  k < NumInputs;  k++) quantizedInput[k] = mlpQuantizeInput(input[k]);
+
+    __m256i sums [M::numBlocks];
+    mlpQuantizedHiddenSums<M::numPairs>(model, quantizedInput, sums);
+    return mlpQuantizedOutput(model, sums);
+}
+
+#endif // MLPMODEL_H
@@ -0,0 +1,330 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "modelset.h"
+#include "jpegmodels.h"
+#include "webpmodels.h"
+
+#include <new>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static const char modelFileMagic [8] = {'A', 'C', 'A', 'C', 'I', 'A', 'M', 'S'};
+static const unsigned int modelFileVersion = 1;
+static const size_t headerSize = 64;
+static const size_t directoryEntrySize = 32;
+static const size_t dataAlignment = 64;
+
+static const int builtInInputs = 12;
+static const int builtInHidden = 50;
+
+// built-in input layout: 10 content features, log of megapixels and quality factor in the order of the input vector
+static const unsigned int builtInLayout [builtInInputs] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+// z-score standardization of the built-in models, only the quality factor differs between formats
+static const double builtInMean [2][builtInInputs] = {
+    {1.67857871738869, 1.84940743362902, 2.03573723917577, 4.32308662342086, 4.77520341534466, 5.18429697435992, 1.07480309472305, 1.19925725148692, 0.785210507241508, 0.344762186269797, 0.875428671146136, 52.5},
+    {1.67857871738869, 1.84940743362902, 2.03573723917577, 4.32308662342086, 4.77520341534466, 5.18429697435992, 1.07480309472305, 1.19925725148692, 0.785210507241508, 0.344762186269797, 0.875428671146136, 50.0}
+};
+static const double builtInSd [2][builtInInputs] = {
+    {0.570680274424306, 0.570547669481748, 0.551873365309837, 1.28965887561942, 1.18708941771867, 1.04983787410284, 0.498536202400926, 0.520063844702872, 0.404995922117509, 0.22549143978714, 1.34954012555432, 27.8567765543682},
+    {0.570680274424306, 0.570547669481748, 0.551873365309837, 1.28965887561942, 1.18708941771867, 1.04983787410284, 0.498536202400926, 0.520063844702872, 0.404995922117509, 0.22549143978714, 1.34954012555432, 29.3001706479672}
+};
+
+static size_t modelDataSize(int numInputs, int numHidden)
+{
+    const size_t layoutSize = (numInputs * sizeof(unsigned int) + 7) / 8 * 8;
+    return layoutSize + (2 * numInputs + (numInputs + 1) * numHidden + numHidden + 1) * sizeof(double);
+}
+
+static size_t alignedOffset(size_t offset)
+{
+    return (offset + dataAlignment - 1) / dataAlignment * dataAlignment;
+}
+
+static unsigned int readUint32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned long long int readUint64(const unsigned char *p)
+{
+    return readUint32(p) | ((unsigned long long int) readUint32(p + 4) << 32);
+}
+
+static void writeUint32(unsigned char *p, unsigned int value)
+{
+    for (int i = 0;  i < 4;  i++) p[i] = (unsigned char) (value >> (8 * i));
+}
+
+static void writeUint64(unsigned char *p, unsigned long long int value)
+{
+    writeUint32(p, (unsigned int) value);
+    writeUint32(p + 4, (unsigned int) (value >> 32));
+}
+
+ModelSet::ModelSet() : data(nullptr), size(0), mapped(false)
+{
+    memset(models, 0, sizeof(models));
+}
+
+ModelSet::~ModelSet()
+{
+    if (!data) return;
+#ifdef _WIN32
+    free(data);
+#else
+    if (mapped) munmap(data, size);
+    else free(data);
+#endif
+}
+
+const ModelSet &ModelSet::builtIn()
+{
+    struct BuiltInModelSet : ModelSet
+    {
+        BuiltInModelSet()
+        {
+            const double *weights [2][3] = {{jpeg_fsize_model, jpeg_ymssim_model, jpeg_ypsnr_model},
+                                            {webp_fsize_model, webp_ymssim_model, webp_ypsnr_model}};
+            for (int format = 0;  format < 2;  format++)
+                for (int objective = 0;  objective < 3;  objective++)
+                    models[format][objective] = {builtInInputs, builtInHidden, builtInLayout, builtInMean[format], builtInSd[format], weights[format][objective]};
+        }
+    };
+
+    static const BuiltInModelSet set;
+    return set;
+}
+
+int ModelSet::objectiveIndex(char targetObjective)
+{
+    switch (targetObjective) {
+    case 's':
+        return 0;
+    case 'm':
+        return 1;
+    case 'p':
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+const ModelView &ModelSet::model(bool isjpeg, char targetObjective) const
+{
+    const int objective = objectiveIndex(targetObjective);
+    return models[isjpeg ? 0 : 1][objective < 0 ? 0 : objective];
+}
+
+std::shared_ptr<const ModelSet> ModelSet::load(const char *path)
+{
+    ModelSet *set = new (std::nothrow) ModelSet();
+    if (!set) return nullptr;
+
+#ifdef _WIN32
+    // no shared mapping, the file is read into memory
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        const long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        set->data = length > 0 ? malloc(length) : nullptr;
+        if (set->data && fread(set->data, 1, length, file) == (size_t) length) set->size = length;
+        fclose(file);
+    }
+#else
+    const int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd >= 0 && fstat(fd, &status) == 0 && status.st_size > 0) {
+        void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            set->data = mapping;
+            set->size = status.st_size;
+            set->mapped = true;
+        }
+    }
+    if (fd >= 0) close(fd);    // the mapping remains valid
+#endif
+
+    if (!set->size) {
+        fprintf(stderr, "[acacia] error: cannot read model file \"%s\"\n", path);
+        delete set;
+        return nullptr;
+    }
+
+    if (!set->parse(path)) {
+        delete set;
+        return nullptr;
+    }
+
+    return std::shared_ptr<const ModelSet>(set);
+}
+
+// checks the whole file once, so inference doesn't need any checks later
+bool ModelSet::parse(const char *path)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+
+    if (size < headerSize || memcmp(bytes, modelFileMagic, sizeof(modelFileMagic)) != 0) {
+        fprintf(stderr, "[acacia] error: \"%s\" is not an ACACIA model file\n", path);
+        return false;
+    }
+    if (readUint32(bytes + 8) != modelFileVersion) {
+        fprintf(stderr, "[acacia] error: model file \"%s\" has unsupported version %u\n", path, readUint32(bytes + 8));
+        return false;
+    }
+
+    const unsigned int numModels = readUint32(bytes + 12);
+    if (readUint64(bytes + 16) != size || numModels > 64 || headerSize + numModels * directoryEntrySize > size) {
+        fprintf(stderr, "[acacia] error: model file \"%s\" is truncated or corrupted\n", path);
+        return false;
+    }
+
+    bool present [2][3] = {};
+    for (unsigned int m = 0;  m < numModels;  m++)
+    {
+        const unsigned char *entry = bytes + headerSize + m * directoryEntrySize;
+        const unsigned int format = readUint32(entry);
+        const int objective = objectiveIndex((char) readUint32(entry + 4));
+        const unsigned int numInputs = readUint32(entry + 8);
+        const unsigned int numHidden = readUint32(entry + 12);
+        const unsigned long long int offset = readUint64(entry + 16);
+        const unsigned long long int dataSize = readUint64(entry + 24);
+
+        if (format > 1 || objective < 0 || present[format][objective] || numInputs == 0 || numInputs > (unsigned int) builtInInputs ||
+            numHidden == 0 || numHidden > 4096 || offset % dataAlignment != 0 || offset > size || dataSize > size - offset ||
+            dataSize != modelDataSize(numInputs, numHidden)) {
+            fprintf(stderr, "[acacia] error: model %u in \"%s\" has an invalid description\n", m, path);
+            return false;
+        }
+
+        ModelView &view = models[format][objective];
+        view.numInputs = numInputs;
+        view.numHidden = numHidden;
+        view.layout = (const unsigned int *) (bytes + offset);
+        view.mean = (const double *) (bytes + offset + (numInputs * sizeof(unsigned int) + 7) / 8 * 8);
+        view.sd = view.mean + numInputs;
+        view.weights = view.sd + numInputs;
+
+        // every input of the vector at most once, the quality factor is required for the search
+        bool usesQualityFactor = false;
+        unsigned int usedInputs = 0;
+        for (unsigned int i = 0;  i < numInputs;  i++)
+        {
+            const unsigned int index = view.layout[i];
+            if (index >= (unsigned int) builtInInputs || ((usedInputs >> index) & 1) || !(view.sd[i] > 0) || !isfinite(view.mean[i])) {
+                fprintf(stderr, "[acacia] error: model %u in \"%s\" has an invalid input layout or standardization\n", m, path);
+                return false;
+            }
+            usedInputs |= 1u << index;
+            if (index == 11) usesQualityFactor = true;
+        }
+
+        bool finite = true;
+        const size_t numWeights = (numInputs + 1) * numHidden + numHidden + 1;
+        for (size_t i = 0;  i < numWeights;  i++) finite = finite && isfinite(view.weights[i]);
+
+        if (!usesQualityFactor || !finite) {
+            fprintf(stderr, "[acacia] error: model %u in \"%s\" has no quality factor input or invalid weights\n", m, path);
+            return false;
+        }
+
+        present[format][objective] = true;
+    }
+
+    for (int format = 0;  format < 2;  format++)
+        for (int objective = 0;  objective < 3;  objective++)
+            if (!present[format][objective]) {
+                fprintf(stderr, "[acacia] error: model file \"%s\" doesn't contain all six models\n", path);
+                return false;
+            }
+
+    return true;
+}
+
+bool ModelSet::save(const char *path) const
+{
+    return save(path, models);
+}
+
+bool ModelSet::save(const char *path, const ModelView (&models)[2][3])
+{
+    const char objectives [] = {'s', 'm', 'p'};
+
+    // layout of the file
+    size_t offsets [2][3];
+    size_t fileSize = alignedOffset(headerSize + 6 * directoryEntrySize);
+    for (int format = 0;  format < 2;  format++)
+        for (int objective = 0;  objective < 3;  objective++)
+        {
+            offsets[format][objective] = fileSize;
+            fileSize = alignedOffset(fileSize + modelDataSize(models[format][objective].numInputs, models[format][objective].numHidden));
+        }
+
+    unsigned char *buffer = (unsigned char *) calloc(fileSize, 1);
+    if (!buffer) return false;
+
+    memcpy(buffer, modelFileMagic, sizeof(modelFileMagic));
+    writeUint32(buffer + 8, modelFileVersion);
+    writeUint32(buffer + 12, 6);
+    writeUint64(buffer + 16, fileSize);
+
+    for (int format = 0;  format < 2;  format++)
+        for (int objective = 0;  objective < 3;  objective++)
+        {
+            const ModelView &view = models[format][objective];
+            const size_t offset = offsets[format][objective];
+
+            unsigned char *entry = buffer + headerSize + (format * 3 + objective) * directoryEntrySize;
+            writeUint32(entry, format);
+            writeUint32(entry + 4, objectives[objective]);
+            writeUint32(entry + 8, view.numInputs);
+            writeUint32(entry + 12, view.numHidden);
+            writeUint64(entry + 16, offset);
+            writeUint64(entry + 24, modelDataSize(view.numInputs, view.numHidden));
+
+            // the library requires a little endian CPU (x86 with AVX2), so values are copied as they are
+            memcpy(buffer + offset, view.layout, view.numInputs * sizeof(unsigned int));
+            double *values = (double *) (buffer + offset + (view.numInputs * sizeof(unsigned int) + 7) / 8 * 8);
+            memcpy(values, view.mean, view.numInputs * sizeof(double));
+            memcpy(values + view.numInputs, view.sd, view.numInputs * sizeof(double));
+            memcpy(values + 2 * view.numInputs, view.weights, ((view.numInputs + 1) * view.numHidden + view.numHidden + 1) * sizeof(double));
+        }
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file && fwrite(buffer, 1, fileSize, file) == fileSize;
+    if (file && fclose(file) != 0) ok = false;
+    free(buffer);
+
+    if (!ok) fprintf(stderr, "[acacia] error: cannot write model file \"%s\"\n", path);
+    return ok;
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef MODELSET_H
+#define MODELSET_H
+
+#include <memory>
+#include <stddef.h>
+
+// One regression model: a multilayer perceptron with a sigmoid hidden layer and a linear output.
+// All pointers refer either to the built-in tables or into a memory-mapped model file.
+struct ModelView
+{
+    int numInputs;
+    int numHidden;
+    const unsigned int *layout;    // for every network input, the index in the optimizer's 12-element input vector
+    const double *mean;            // z-score standardization of every network input
+    const double *sd;
+    const double *weights;         // per hidden neuron: bias and input weights; then output bias and output weights
+};
+
+// Set of the six models (JPEG and WebP; file size, Y-MSSIM and Y-PSNR).
+//
+// Model files are mapped read-only, so processes loading the same file share one copy in the page cache
+// and a ModelSet can be used by any number of threads. A file should be replaced atomically (written
+// under another name and renamed): the mapping of a loaded set stays valid until the set is destroyed.
+//
+// File format, all values little endian:
+//   header, 64 bytes:    char magic[8] = "ACACIAMS", uint32 version, uint32 number of models, uint64 file size, zero padding
+//   directory entries:   32 bytes each: uint32 format (0 = JPEG, 1 = WebP), uint32 objective ('s', 'm' or 'p'),
+//                        uint32 number of inputs, uint32 number of hidden neurons, uint64 data offset, uint64 data size
+//   model data:          at 64-byte aligned offsets: uint32 layout[inputs] padded to 8 bytes, double mean[inputs],
+//                        double sd[inputs], double weights[(inputs + 1) * hidden + hidden + 1]
+class ModelSet
+{
+public:
+    ~ModelSet();
+
+    // models compiled into the library (jpegmodels.h and webpmodels.h)
+    static const ModelSet &builtIn();
+
+    // returns nullptr and prints a message if the file can't be mapped or is not a valid model file
+    static std::shared_ptr<const ModelSet> load(const char *path);
+
+    // writes the set in the binary format, e.g. to export the built-in models
+    bool save(const char *path) const;
+
+    // the same for models held by the caller, e.g. newly trained ones; [format][objective] as in model()
+    static bool save(const char *path, const ModelView (&models)[2][3]);
+
+    // targetObjective is 's', 'm' or 'p' like in Optimizer::findQualityFactor()
+    const ModelView &model(bool isjpeg, char targetObjective) const;
+
+private:
+    ModelSet();
+    ModelSet(const ModelSet &) = delete;
+    ModelSet &operator=(const ModelSet &) = delete;
+
+    static int objectiveIndex(char targetObjective);
+
+    bool parse(const char *path);
+
+    ModelView models [2][3];    // [format][objective]
+
+    // file contents, mapped or (on Windows) read into memory
+    void *data;
+    size_t size;
+    bool mapped;
+};
+
+#endif // MODELSET_H
@@ -0,0 +1,362 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "optimizer.h"
+#include "modelset.h"
+#include "calibration.h"
+#include "jpegmodels.h"
+#include "webpmodels.h"
+#include "mlpmodel.h"
+
+#include <atomic>
+
+#include "math.h"
+
+// models loaded at runtime; while none are set, the built-in models are used
+static std::shared_ptr<const ModelSet> loadedModels;
+static std::atomic<bool> hasLoadedModels(false);
+
+// online correction of the models, none by default
+static std::shared_ptr<Calibration> currentCalibration;
+static std::atomic<bool> hasCalibration(false);
+
+// single precision models for fast inference, converted at compile time
+typedef MlpModel<12, 50> PredictionModel;
+
+static constexpr PredictionModel jpegFileSizeModel = makeMlpModel<12, 50>(jpeg_fsize_model);
+static constexpr PredictionModel jpegYMSSIMModel   = makeMlpModel<12, 50>(jpeg_ymssim_model);
+static constexpr PredictionModel jpegYPSNRModel    = makeMlpModel<12, 50>(jpeg_ypsnr_model);
+static constexpr PredictionModel webpFileSizeModel = makeMlpModel<12, 50>(webp_fsize_model);
+static constexpr PredictionModel webpYMSSIMModel   = makeMlpModel<12, 50>(webp_ymssim_model);
+static constexpr PredictionModel webpYPSNRModel    = makeMlpModel<12, 50>(webp_ypsnr_model);
+
+// quantized models for InferenceQuantized
+typedef MlpQuantizedModel<12, 50> QuantizedPredictionModel;
+
+static constexpr QuantizedPredictionModel jpegFileSizeQuantizedModel = makeMlpQuantizedModel<12, 50>(jpeg_fsize_model);
+static constexpr QuantizedPredictionModel jpegYMSSIMQuantizedModel   = makeMlpQuantizedModel<12, 50>(jpeg_ymssim_model);
+static constexpr QuantizedPredictionModel jpegYPSNRQuantizedModel    = makeMlpQuantizedModel<12, 50>(jpeg_ypsnr_model);
+static constexpr QuantizedPredictionModel webpFileSizeQuantizedModel = makeMlpQuantizedModel<12, 50>(webp_fsize_model);
+static constexpr QuantizedPredictionModel webpYMSSIMQuantizedModel   = makeMlpQuantizedModel<12, 50>(webp_ymssim_model);
+static constexpr QuantizedPredictionModel webpYPSNRQuantizedModel    = makeMlpQuantizedModel<12, 50>(webp_ypsnr_model);
+
+static const QuantizedPredictionModel &quantizedModel(bool isjpeg, char targetObjective)
+{
+    switch (targetObjective) {
+    case 's':
+        return isjpeg ? jpegFileSizeQuantizedModel : webpFileSizeQuantizedModel;
+    case 'm':
+        return isjpeg ? jpegYMSSIMQuantizedModel : webpYMSSIMQuantizedModel;
+    default:
+        return isjpeg ? jpegYPSNRQuantizedModel : webpYPSNRQuantizedModel;
+    }
+}
+
+static const PredictionModel &fastModel(bool isjpeg, char targetObjective)
+{
+    switch (targetObjective) {
+    case 's':
+        return isjpeg ? jpegFileSizeModel : webpFileSizeModel;
+    case 'm':
+        return isjpeg ? jpegYMSSIMModel : webpYMSSIMModel;
+    default:
+        return isjpeg ? jpegYPSNRModel : webpYPSNRModel;
+    }
+}
+
+// the size models predict the logarithm of the file size, rounded to bytes in double precision, since extrapolations
+// for very large images exceed 32 bits; SSIM cannot exceed 1
+static double finishPrediction(char targetObjective, double networkResult)
+{
+    switch (targetObjective) {
+    case 's':
+        return floor(exp(networkResult) + 0.5);
+    case 'm':
+        return networkResult > 1.0 ? 1.0 : networkResult;
+    default:
+        return networkResult;
+    }
+}
+
+// the fast and quantized models are built from the built-in ones and use their standardization
+static float standardizeBuiltIn(const ModelView &model, const double *inputVector, int i)
+{
+    return (float) ((inputVector[i] - model.mean[i]) / model.sd[i]);
+}
+
+static double networkOutputFast(bool isjpeg, char targetObjective, const double *inputVector, InferenceMode mode)
+{
+    const ModelView &builtInModel = ModelSet::builtIn().model(isjpeg, targetObjective);
+    float standardizedInputVector [12];
+    for (int i = 0;  i < 12;  i++) standardizedInputVector[i] = standardizeBuiltIn(builtInModel, inputVector, i);
+
+    return (mode == InferenceQuantized) ? mlpQuantizedForward(quantizedModel(isjpeg, targetObjective), standardizedInputVector) :
+                                          mlpForward(fastModel(isjpeg, targetObjective), standardizedInputVector);
+}
+
+// The same exhaustive search as in the reference version, but the hidden layer sums of the 11 fixed inputs
+// are calculated once, so every quality factor costs only one multiply-add and the activations.
+static int findQualityFactorFast(bool isjpeg, char targetObjective, double targetValue, const double *inputVector, const CalibrationCorrection &correction)
+{
+    const PredictionModel &model = fastModel(isjpeg, targetObjective);
+    const ModelView &builtInModel = ModelSet::builtIn().model(isjpeg, targetObjective);
+
+    float standardizedInputVector [12];
+    for (int i = 0;  i < 11;  i++) standardizedInputVector[i] = standardizeBuiltIn(builtInModel, inputVector, i);
+
+    __m256 fixedSums [PredictionModel::numBlocks];
+    mlpHiddenSums<11>(model, standardizedInputVector, fixedSums);
+
+    const int minQF = isjpeg ? 5 : 0;
+
+    double minDifference = 1000000000;
+    int bestQualityFactor = -1;
+    for (int qualityFactor = minQF;  qualityFactor <= 100;  qualityFactor++)
+    {
+        __m256 sums [PredictionModel::numBlocks];
+        mlpAddInput(model, 11, (float) ((qualityFactor - builtInModel.mean[11]) / builtInModel.sd[11]), fixedSums, sums);
+        const double predictedValue = finishPrediction(targetObjective, mlpOutput(model, sums) + correction.value(qualityFactor, inputVector[10]));
+        double difference = predictedValue - targetValue;
+        if (difference < 0) difference = -difference;
+        if (difference < minDifference) {
+            bestQualityFactor = qualityFactor;
+            minDifference = difference;
+        }
+    }
+
+    return bestQualityFactor;
+}
+
+// Quantized search: the image size and the quality factor form the last input pair,
+// so the sums of the first 5 pairs (10 content features) are shared by all quality factors.
+static int findQualityFactorQuantized(bool isjpeg, char targetObjective, double targetValue, const double *inputVector, const CalibrationCorrection &correction)
+{
+    const QuantizedPredictionModel &model = quantizedModel(isjpeg, targetObjective);
+    const ModelView &builtInModel = ModelSet::builtIn().model(isjpeg, targetObjective);
+
+    short quantizedInputVector [12];
+    for (int i = 0;  i < 11;  i++) quantizedInputVector[i] = mlpQuantizeInput(standardizeBuiltIn(builtInModel, inputVector, i));
+
+    __m256i fixedSums [QuantizedPredictionModel::numBlocks];
+    mlpQuantizedHiddenSums<5>(model, quantizedInputVector, fixedSums);
+
+    const int minQF = isjpeg ? 5 : 0;
+
+    double minDifference = 1000000000;
+    int bestQualityFactor = -1;
+    for (int qualityFactor = minQF;  qualityFactor <= 100;  qualityFactor++)
+    {
+        const short quantizedQualityFactor = mlpQuantizeInput((float) ((qualityFactor - builtInModel.mean[11]) / builtInModel.sd[11]));
+        __m256i sums [QuantizedPredictionModel::numBlocks];
+        mlpQuantizedAddPair(model, 5, quantizedInputVector[10], quantizedQualityFactor, fixedSums, sums);
+        const double predictedValue = finishPrediction(targetObjective, mlpQuantizedOutput(model, sums) + correction.value(qualityFactor, inputVector[10]));
+        double difference = predictedValue - targetValue;
+        if (difference < 0) difference = -difference;
+        if (difference < minDifference) {
+            bestQualityFactor = qualityFactor;
+            minDifference = difference;
+        }
+    }
+
+    return bestQualityFactor;
+}
+
+void Optimizer::setModelSet(std::shared_ptr<const ModelSet> models)
+{
+    std::atomic_store(&loadedModels, models);
+    hasLoadedModels.store(models != nullptr);
+}
+
+std::shared_ptr<const ModelSet> Optimizer::modelSet()
+{
+    return std::atomic_load(&loadedModels);
+}
+
+void Optimizer::setCalibration(std::shared_ptr<Calibration> calibration)
+{
+    std::atomic_store(&currentCalibration, calibration);
+    hasCalibration.store(calibration != nullptr);
+}
+
+std::shared_ptr<Calibration> Optimizer::calibration()
+{
+    return std::atomic_load(&currentCalibration);
+}
+
+// the correction is read once per call, so a search uses consistent weights while other threads record results
+CalibrationCorrection Optimizer::currentCorrection(bool isjpeg, char targetObjective)
+{
+    std::shared_ptr<Calibration> calibration;
+    if (hasCalibration.load()) calibration = std::atomic_load(&currentCalibration);
+    if (calibration) return calibration->correction(isjpeg, targetObjective);
+
+    const CalibrationCorrection none = {{0, 0, 0}};
+    return none;
+}
+
+void Optimizer::recordResult(bool isjpeg, char targetObjective, const double *inputVector, double actualValue, InferenceMode mode)
+{
+    std::shared_ptr<Calibration> calibration = Optimizer::calibration();
+    if (!calibration) return;
+
+    // the size models predict its logarithm
+    if (targetObjective == 's') {
+        if (actualValue <= 0) return;
+        actualValue = log(actualValue);
+    }
+    const double residual = actualValue - networkOutput(isjpeg, targetObjective, inputVector, mode);
+    calibration->update(isjpeg, targetObjective, inputVector[11], inputVector[10], residual);
+}
+
+int Optimizer::findQualityFactor(bool isjpeg, char targetObjective, double targetValue, const double *inputVector, InferenceMode mode)
+{
+    // a set loaded by another thread stays alive until the search is finished
+    std::shared_ptr<const ModelSet> models;
+    if (hasLoadedModels.load()) models = std::atomic_load(&loadedModels);
+
+    const CalibrationCorrection correction = currentCorrection(isjpeg, targetObjective);
+
+    if (!models && mode == InferenceFast) return findQualityFactorFast(isjpeg, targetObjective, targetValue, inputVector, correction);
+    if (!models && mode == InferenceQuantized) return findQualityFactorQuantized(isjpeg, targetObjective, targetValue, inputVector, correction);
+
+    const ModelView &model = (models ? *models : ModelSet::builtIn()).model(isjpeg, targetObjective);
+
+    // perform standardization of all inputs, the quality factor is replaced in the loop below
+    double standardizedInputVector [maxModelInputs];
+    standardizeInput(model, inputVector, standardizedInputVector);
+
+    int qualityFactorInput = 0;
+    while (model.layout[qualityFactorInput] != 11) qualityFactorInput++;    // checked when the model is loaded
+
+    // for JPEG minimal useful QF is set to 5
+    const int minQF = isjpeg ? 5 : 0;
+
+    // the following search with a break may cause problems in some rare cases because
+    // it assumes that the regression function is strictly monotonic,
+    // but at least MSSIM model has some minor deviations from this trend,
+    // which can lead to early exit from the loop with a wrong result
+    //
+    // the binary search may also be affected by this (although in a much smaller extent)
+    //
+    // therefore, for the sake of avoiding bugs in an easy way
+    // we exaustively enumerate all QFs and choose the smallest
+    //
+    // old version of the loop will remain here for the record
+
+    /*
+    // start search using a simple approach:
+    // changing quality factor from 5 to 100 we check when the difference between predicted and target values is minimal
+    // obviously, this approach can be improved with binary search, but it's already fast enough (< 1 ms)
+    double minDifference = 1000000000;    // just a big number
+    int qualityFactor;
+    for (qualityFactor = minQF;  qualityFactor <= 100;  qualityFactor++)    // 100 is not included as it's the maximum possible QF (101 is invalid)
+    {
+        standardizedInputVector[11] = (qualityFactor - qualityFactorMean(isjpeg)) / qualityFactorSd(isjpeg);
+        const double predictedValue = estimatingFunction(mlpModel, standardizedInputVector);
+        double difference = predictedValue - targetValue;
+        if (difference < 0) difference = -difference;
+        if (difference >= minDifference) {
+            // qualityFactor decrement was moved outside the loop when to fix a bug
+            break;
+        } else {
+            minDifference = difference;
+        }
+    }
+
+    // this decrement has 2 functions: prevents QF = 101 and makes a step back after jumping over the best solution
+    qualityFactor--;
+    */
+
+    double minDifference = 1000000000;    // just a big number
+    int bestQualityFactor = -1;           // solution
+    for (int qualityFactor = minQF;  qualityFactor <= 100;  qualityFactor++)
+    {
+        standardizedInputVector[qualityFactorInput] = (qualityFactor - model.mean[qualityFactorInput]) / model.sd[qualityFactorInput];
+        const double predictedValue = finishPrediction(targetObjective, evaluateModel(model, standardizedInputVector) + correction.value(qualityFactor, inputVector[10]));
+        double difference = predictedValue - targetValue;
+        if (difference < 0) difference = -difference;
+        if (difference < minDifference) {
+            bestQualityFactor = qualityFactor;
+            minDifference = difference;
+        }
+    }
+
+    return bestQualityFactor;
+}
+
+double Optimizer::estimateFileSize(bool isjpeg, const double *inputVector, InferenceMode mode)
+{
+    return estimate(isjpeg, 's', inputVector, mode);
+}
+
+double Optimizer::estimateYMSSIM(bool isjpeg, const double *inputVector, InferenceMode mode)
+{
+    return estimate(isjpeg, 'm', inputVector, mode);
+}
+
+double Optimizer::estimateYPSNR(bool isjpeg, const double *inputVector, InferenceMode mode)
+{
+    return estimate(isjpeg, 'p', inputVector, mode);
+}
+
+double Optimizer::estimate(bool isjpeg, char targetObjective, const double *inputVector, InferenceMode mode)
+{
+    const double correction = currentCorrection(isjpeg, targetObjective).value(inputVector[11], inputVector[10]);
+    return finishPrediction(targetObjective, networkOutput(isjpeg, targetObjective, inputVector, mode) + correction);
+}
+
+// prediction without calibration and before the final transformation of finishPrediction()
+double Optimizer::networkOutput(bool isjpeg, char targetObjective, const double *inputVector, InferenceMode mode)
+{
+    std::shared_ptr<const ModelSet> models;
+    if (hasLoadedModels.load()) models = std::atomic_load(&loadedModels);
+
+    if (!models && mode != InferenceReference) return networkOutputFast(isjpeg, targetObjective, inputVector, mode);
+
+    const ModelView &model = (models ? *models : ModelSet::builtIn()).model(isjpeg, targetObjective);
+
+    double standardizedInputVector [maxModelInputs];
+    standardizeInput(model, inputVector, standardizedInputVector);
+    return evaluateModel(model, standardizedInputVector);
+}
+
+void Optimizer::standardizeInput(const ModelView &model, const double *inputVector, double *standardizedInputVector)
+{
+    // the model takes its inputs from the input vector in the order of its layout
+    for (int i = 0;  i < model.numInputs;  i++) standardizedInputVector[i] = (inputVector[model.layout[i]] - model.mean[i]) / model.sd[i];
+}
+
+double Optimizer::evaluateModel(const ModelView &model, const double *standardizedInputVector)
+{
+    const double *mlpModel = model.weights;
+
+    int counterHiddenLayer = 0;    // counters for NN coefficients
+    int counterOutputNeuron = (1 + model.numInputs) * model.numHidden;
+
+    double networkResult = mlpModel[counterOutputNeuron++];    // output bias
+
+    for (int h = 0;  h < model.numHidden;  h++)    // loop over hidden neurons
+    {
+        double linearCombination = mlpModel[counterHiddenLayer++];    // hidden neuron bias
+        for (int k = 0;  k < model.numInputs;  k++) linearCombination += standardizedInputVector[k] * mlpModel[counterHiddenLayer++];
+        networkResult += mlpModel[counterOutputNeuron++] / (1 + exp(-linearCombination));
+    }
+
+    return networkResult;
+}
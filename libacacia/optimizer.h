@@ -0,0 +1,76 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <memory>
+
+class ModelSet;
+class Calibration;
+struct ModelView;
+struct CalibrationCorrection;
+
+// Reference inference evaluates the original double precision models.
+// Fast inference uses single precision AVX kernels, quantized inference 16-bit integer weights
+// in the hidden layer and a sigmoid table (see mlpmodel.h); bench -validate compares them with the reference.
+enum InferenceMode
+{
+    InferenceReference = 0,
+    InferenceFast,
+    InferenceQuantized
+};
+
+// upper limit of the number of model inputs, i.e. the size of the input vector
+static const int maxModelInputs = 12;
+
+// Input vectors have 12 elements: 10 content features, log of the image size in megapixels and quality factor.
+// The fast and quantized modes exist only for the built-in models; while a model set is loaded
+// with setModelSet(), all modes evaluate its double precision models.
+class Optimizer
+{
+public:
+    static int    findQualityFactor(bool isjpeg, char targetObjective, double targetValue, const double *inputVector, InferenceMode mode = InferenceReference);
+
+    static double estimateFileSize(bool isjpeg, const double *inputVector, InferenceMode mode = InferenceReference);
+    static double estimateYMSSIM(bool isjpeg, const double *inputVector, InferenceMode mode = InferenceReference);
+    static double estimateYPSNR(bool isjpeg, const double *inputVector, InferenceMode mode = InferenceReference);
+
+    // Replaces the models used by all threads, nullptr returns to the built-in ones.
+    // Calls running in other threads finish with the previous set, it is released after them.
+    static void   setModelSet(std::shared_ptr<const ModelSet> models);
+    static std::shared_ptr<const ModelSet> modelSet();
+
+    // Online correction of all predictions by observed results (see calibration.h), nullptr turns it off.
+    // recordResult() adds the actual file size, Y-MSSIM or Y-PSNR of an encoded image to it; inputVector contains
+    // the quality factor used, mode should be the one used to choose it.
+    static void   setCalibration(std::shared_ptr<Calibration> calibration);
+    static std::shared_ptr<Calibration> calibration();
+    static void   recordResult(bool isjpeg, char targetObjective, const double *inputVector, double actualValue, InferenceMode mode = InferenceReference);
+
+private:
+    static double estimate(bool isjpeg, char targetObjective, const double *inputVector, InferenceMode mode);
+    static double networkOutput(bool isjpeg, char targetObjective, const double *inputVector, InferenceMode mode);
+    static CalibrationCorrection currentCorrection(bool isjpeg, char targetObjective);
+
+    static void   standardizeInput(const ModelView &model, const double *inputVector, double *standardizedInputVector);
+    static double evaluateModel(const ModelView &model, const double *standardizedInputVector);
+};
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,191 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "perfcounters.h"
+
+#include <atomic>
+
+#include <string.h>
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+
+static std::atomic<bool> countersEnabled(false);
+static std::atomic<unsigned int> availableCounters(0);    // bit mask of counters opened successfully
+
+const char *PerfCounters::counterName(int counter)
+{
+    static const char *names [NumPerfCounters] = {"cycles", "instructions", "cache_misses", "dtlb_misses", "branch_misses"};
+    return (counter >= 0 && counter < NumPerfCounters) ? names[counter] : "unknown";
+}
+
+bool PerfCounters::isEnabled()
+{
+    return countersEnabled.load(std::memory_order_relaxed);
+}
+
+bool PerfCounters::isAvailable(int counter)
+{
+    return (availableCounters.load() >> counter) & 1;
+}
+
+void PerfCounters::difference(const PerfSnapshot &start, const PerfSnapshot &end, unsigned long long int *events)
+{
+    // if the kernel multiplexed counters during the interval, extrapolate them to the time it was enabled;
+    // raw values only grow, so the differences can't wrap around
+    const unsigned long long int timeEnabled = (end.timeEnabled > start.timeEnabled) ? end.timeEnabled - start.timeEnabled : 0;
+    const unsigned long long int timeRunning = (end.timeRunning > start.timeRunning) ? end.timeRunning - start.timeRunning : 0;
+    const double scale = (timeRunning > 0 && timeRunning < timeEnabled) ? (double) timeEnabled / timeRunning : 1.0;
+
+    for (int i = 0;  i < NumPerfCounters;  i++)
+    {
+        const unsigned long long int counted = (end.values[i] > start.values[i]) ? end.values[i] - start.values[i] : 0;
+        events[i] = (unsigned long long int) (counted * scale);
+    }
+}
+
+#ifdef __linux__
+
+// Counter group of one thread. The first opened counter is the group leader,
+// so all counters are read with a single system call and are scheduled on the PMU together.
+struct ThreadPerfGroup
+{
+    ThreadPerfGroup() : opened(false), leaderFd(-1), numOpened(0)
+    {
+        for (int i = 0;  i < NumPerfCounters;  i++) fds[i] = -1;
+    }
+
+    ~ThreadPerfGroup()
+    {
+        for (int i = 0;  i < NumPerfCounters;  i++) if (fds[i] >= 0) close(fds[i]);
+    }
+
+    bool opened;
+    int  leaderFd;
+    int  numOpened;
+    int  fds [NumPerfCounters];
+    int  groupIndex [NumPerfCounters];    // position of the counter in group read results
+};
+
+static int perfEventOpen(struct perf_event_attr *attr, int groupFd)
+{
+    // pid = 0 and cpu = -1 count the calling thread on any CPU
+    return (int) syscall(__NR_perf_event_open, attr, 0, -1, groupFd, 0);
+}
+
+static void openGroup(ThreadPerfGroup *group)
+{
+    group->opened = true;
+
+    const unsigned int types [NumPerfCounters] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    const unsigned long long int configs [NumPerfCounters] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    unsigned int opened = 0;
+    for (int i = 0;  i < NumPerfCounters;  i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = (group->leaderFd < 0) ? 1 : 0;    // the whole group is started by the leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const int fd = perfEventOpen(&attr, group->leaderFd);
+        if (fd < 0) continue;    // some PMUs don't support all events, the rest is still useful
+
+        if (group->leaderFd < 0) group->leaderFd = fd;
+        group->fds[i] = fd;
+        group->groupIndex[i] = group->numOpened++;
+        opened |= 1u << i;
+    }
+
+    if (group->leaderFd >= 0) {
+        ioctl(group->leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group->leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    availableCounters.fetch_or(opened);
+}
+
+static ThreadPerfGroup *currentThreadGroup()
+{
+    thread_local ThreadPerfGroup group;
+    if (!group.opened) openGroup(&group);
+    return &group;
+}
+
+bool PerfCounters::enable()
+{
+    countersEnabled = true;
+    if (currentThreadGroup()->leaderFd < 0) {
+        countersEnabled = false;
+        return false;
+    }
+    return true;
+}
+
+void PerfCounters::read(PerfSnapshot *snapshot)
+{
+    memset(snapshot, 0, sizeof(PerfSnapshot));
+    if (!isEnabled()) return;
+
+    ThreadPerfGroup *group = currentThreadGroup();
+    if (group->leaderFd < 0) return;
+
+    // layout for PERF_FORMAT_GROUP: number of counters, time enabled, time running, values
+    unsigned long long int buffer [3 + NumPerfCounters];
+    const ssize_t expectedSize = (3 + group->numOpened) * sizeof(unsigned long long int);
+    if (::read(group->leaderFd, buffer, sizeof(buffer)) < expectedSize) return;
+
+    snapshot->timeEnabled = buffer[1];
+    snapshot->timeRunning = buffer[2];
+    for (int i = 0;  i < NumPerfCounters;  i++)
+    {
+        if (group->fds[i] < 0) continue;
+        snapshot->values[i] = buffer[3 + group->groupIndex[i]];
+    }
+}
+
+#else
+
+bool PerfCounters::enable()
+{
+    return false;
+}
+
+void PerfCounters::read(PerfSnapshot *snapshot)
+{
+    memset(snapshot, 0, sizeof(PerfSnapshot));
+}
+
+#endif
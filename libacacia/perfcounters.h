@@ -0,0 +1,66 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+// Hardware events counted for every profiled stage
+enum PerfCounter
+{
+    PerfCycles = 0,
+    PerfInstructions,
+    PerfCacheMisses,     // last level cache misses
+    PerfDtlbMisses,      // data TLB read misses
+    PerfBranchMisses,
+    NumPerfCounters
+};
+
+// Raw counter values and the times the kernel had the group enabled and actually counting. While counters are
+// multiplexed the ratio of the times changes, so only differences of two snapshots are extrapolated.
+struct PerfSnapshot
+{
+    unsigned long long int timeEnabled;
+    unsigned long long int timeRunning;
+    unsigned long long int values [NumPerfCounters];
+};
+
+// Hardware performance counters of the calling thread (Linux perf_event_open, user space only).
+// Profiling is opt-in: until enable() succeeds read() returns zeros and costs nothing.
+// Every thread opens its own counter group on the first read.
+class PerfCounters
+{
+public:
+    // returns false if counters are not supported, e.g. on other OS, in VMs without PMU or with perf_event_paranoid > 2
+    static bool enable();
+    static bool isEnabled();
+
+    // current values of all counters for the calling thread; unavailable counters stay zero
+    static void read(PerfSnapshot *snapshot);
+
+    // events counted between two snapshots of the same thread, scaled if the kernel had to multiplex the counters
+    // meanwhile
+    static void difference(const PerfSnapshot &start, const PerfSnapshot &end, unsigned long long int *events);
+
+    // true if the counter could be opened on this machine
+    static bool isAvailable(int counter);
+
+    static const char *counterName(int counter);
+};
+
+#endif // PERFCOUNTERS_H
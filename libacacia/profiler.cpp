@@ -0,0 +1,406 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "profiler.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ------------------------------------------------------------------------------------------------
+// Histogram
+// ------------------------------------------------------------------------------------------------
+
+void ProfilerHistogram::clear()
+{
+    memset(this, 0, sizeof(ProfilerHistogram));
+}
+
+int ProfilerHistogram::bucketIndex(unsigned long long int durationNs)
+{
+    if (durationNs < 4) return (int) durationNs;
+
+    // position of the highest bit and 2 following bits select the bucket
+    const int exponent = 63 - __builtin_clzll(durationNs);
+    const int subBucket = (int) ((durationNs >> (exponent - 2)) & 3);
+    return 4 * (exponent - 1) + subBucket;
+}
+
+unsigned long long int ProfilerHistogram::bucketLowerBoundNs(int index)
+{
+    if (index < 4) return index;
+
+    const int exponent = index / 4 + 1;
+    const int subBucket = index % 4;
+    return (unsigned long long int) (4 + subBucket) << (exponent - 2);
+}
+
+void ProfilerHistogram::add(unsigned long long int durationNs)
+{
+    if (count == 0 || durationNs < minNs) minNs = durationNs;
+    if (durationNs > maxNs) maxNs = durationNs;
+    count++;
+    totalNs += durationNs;
+    buckets[bucketIndex(durationNs)]++;
+}
+
+void ProfilerHistogram::merge(const ProfilerHistogram &other)
+{
+    if (other.count == 0) return;
+    if (count == 0 || other.minNs < minNs) minNs = other.minNs;
+    if (other.maxNs > maxNs) maxNs = other.maxNs;
+    count += other.count;
+    totalNs += other.totalNs;
+    for (int i = 0;  i < numBuckets;  i++) buckets[i] += other.buckets[i];
+}
+
+unsigned long long int ProfilerHistogram::percentileNs(double p) const
+{
+    if (count == 0) return 0;
+
+    const unsigned long long int rank = (unsigned long long int) (p * count + 0.5);
+    unsigned long long int cumulative = 0;
+    for (int i = 0;  i < numBuckets;  i++)
+    {
+        cumulative += buckets[i];
+        if (cumulative >= rank && buckets[i] > 0)
+        {
+            // middle of the bucket, but never outside of the observed range
+            const unsigned long long int lower = bucketLowerBoundNs(i);
+            const unsigned long long int upper = (i + 1 < numBuckets) ? bucketLowerBoundNs(i + 1) : lower;
+            unsigned long long int value = (lower + upper) / 2;
+            if (value < minNs) value = minNs;
+            if (value > maxNs) value = maxNs;
+            return value;
+        }
+    }
+    return maxNs;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Per-thread counters
+// ------------------------------------------------------------------------------------------------
+
+// The mutex is taken only by the owning thread and by report generation, so it's practically never contended.
+// Counters are never deleted: they keep statistics of finished threads and the number of threads is limited.
+struct ThreadCounters
+{
+    std::mutex mutex;
+    int threadIndex;
+    ProfilerHistogram stages [NumProfilerStages];
+    unsigned long long int perfEvents [NumProfilerStages][NumPerfCounters];
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadCounters *> registry;
+
+// statistics loaded from files
+static ProfilerHistogram mergedStages [NumProfilerStages];
+static unsigned long long int mergedPerfEvents [NumProfilerStages][NumPerfCounters];
+
+static ThreadCounters *currentThreadCounters()
+{
+    thread_local ThreadCounters *counters = nullptr;
+    if (!counters)
+    {
+        counters = new ThreadCounters();
+        for (int s = 0;  s < NumProfilerStages;  s++) counters->stages[s].clear();
+        memset(counters->perfEvents, 0, sizeof(counters->perfEvents));
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        counters->threadIndex = (int) registry.size();
+        registry.push_back(counters);
+    }
+    return counters;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+unsigned long long int Profiler::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::start(ProfilerSample *sample)
+{
+    // counters are read before the clock, so that reading them is not included in the stage time
+    PerfCounters::read(&sample->perf);
+    sample->startNs = nowNs();
+}
+
+unsigned long long int Profiler::stop(ProfilerStage stage, const ProfilerSample &sample, unsigned long long int *perfEvents)
+{
+    const unsigned long long int durationNs = nowNs() - sample.startNs;
+
+    PerfSnapshot end;
+    PerfCounters::read(&end);
+    unsigned long long int events [NumPerfCounters];
+    PerfCounters::difference(sample.perf, end, events);
+
+    record(stage, durationNs, events);
+    if (perfEvents) {
+        for (int i = 0;  i < NumPerfCounters;  i++) perfEvents[i] = events[i];
+    }
+    return durationNs;
+}
+
+void Profiler::record(ProfilerStage stage, unsigned long long int durationNs, const unsigned long long int *perfEvents)
+{
+    ThreadCounters *counters = currentThreadCounters();
+    std::lock_guard<std::mutex> lock(counters->mutex);
+    counters->stages[stage].add(durationNs);
+    if (perfEvents) {
+        for (int i = 0;  i < NumPerfCounters;  i++) counters->perfEvents[stage][i] += perfEvents[i];
+    }
+}
+
+void Profiler::aggregate(ProfilerHistogram *stages, bool includeMerged, unsigned long long int (*perfEvents)[NumPerfCounters])
+{
+    for (int s = 0;  s < NumProfilerStages;  s++) stages[s].clear();
+    if (perfEvents) memset(perfEvents, 0, sizeof(unsigned long long int) * NumProfilerStages * NumPerfCounters);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (ThreadCounters *counters : registry)
+    {
+        std::lock_guard<std::mutex> threadLock(counters->mutex);
+        for (int s = 0;  s < NumProfilerStages;  s++)
+        {
+            stages[s].merge(counters->stages[s]);
+            if (perfEvents) {
+                for (int i = 0;  i < NumPerfCounters;  i++) perfEvents[s][i] += counters->perfEvents[s][i];
+            }
+        }
+    }
+    if (includeMerged)
+    {
+        for (int s = 0;  s < NumProfilerStages;  s++)
+        {
+            stages[s].merge(mergedStages[s]);
+            if (perfEvents) {
+                for (int i = 0;  i < NumPerfCounters;  i++) perfEvents[s][i] += mergedPerfEvents[s][i];
+            }
+        }
+    }
+}
+
+const char *Profiler::stageName(int stage)
+{
+    static const char *names [NumProfilerStages] = {"decode", "features", "inference", "encode", "write"};
+    return (stage >= 0 && stage < NumProfilerStages) ? names[stage] : "unknown";
+}
+
+// ------------------------------------------------------------------------------------------------
+// Reports
+// ------------------------------------------------------------------------------------------------
+
+// histogram is stored sparsely as "bucket:count;bucket:count"
+static std::string histogramToString(const ProfilerHistogram &histogram)
+{
+    std::string result;
+    for (int i = 0;  i < ProfilerHistogram::numBuckets;  i++)
+    {
+        if (histogram.buckets[i] == 0) continue;
+        char item [48];
+        snprintf(item, sizeof(item), "%s%d:%llu", result.empty() ? "" : ";", i, histogram.buckets[i]);
+        result += item;
+    }
+    return result;
+}
+
+static void histogramFromString(const char *text, ProfilerHistogram *histogram)
+{
+    while (true)
+    {
+        char *end = nullptr;
+        const long index = strtol(text, &end, 10);
+        if (end == text || *end != ':') return;
+
+        text = end + 1;
+        const unsigned long long int count = strtoull(text, &end, 10);
+        if (end == text) return;
+        if (index >= 0 && index < ProfilerHistogram::numBuckets) histogram->buckets[index] += count;
+
+        if (*end != ';') return;
+        text = end + 1;
+    }
+}
+
+static bool isCsvPath(const char *path)
+{
+    const size_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".csv") == 0;
+}
+
+// finds "key": value in a line of the JSON report
+static const char *findJsonValue(const char *line, const char *key)
+{
+    const std::string pattern = std::string("\"") + key + "\": ";
+    const char *position = strstr(line, pattern.c_str());
+    return position ? position + pattern.size() : nullptr;
+}
+
+bool Profiler::mergeReport(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    const bool csv = isCsvPath(path);
+    ProfilerHistogram loaded [NumProfilerStages];
+    unsigned long long int loadedEvents [NumProfilerStages][NumPerfCounters];
+    for (int s = 0;  s < NumProfilerStages;  s++) loaded[s].clear();
+    memset(loadedEvents, 0, sizeof(loadedEvents));
+
+    bool ok = true;
+    char line [16384];
+    while (fgets(line, sizeof(line), f))
+    {
+        int stage = -1;
+        ProfilerHistogram h;
+        h.clear();
+        unsigned long long int events [NumPerfCounters] = {};
+
+        if (csv)
+        {
+            // stage,count,total_ns,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns,histogram[,hardware events]
+            char name [64];
+            unsigned long long int mean, p50, p90, p99;
+            int consumed = 0;
+            if (sscanf(line, "%63[^,],%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%n", name, &h.count, &h.totalNs, &mean, &h.minNs, &p50, &p90, &p99, &h.maxNs, &consumed) < 9) continue;
+            for (int s = 0;  s < NumProfilerStages;  s++) if (strcmp(name, stageName(s)) == 0) stage = s;
+            histogramFromString(line + consumed + (line[consumed] == '"' ? 1 : 0), &h);
+
+            // hardware event columns follow the quoted histogram; files without them are still accepted
+            const char *closingQuote = (line[consumed] == '"') ? strchr(line + consumed + 1, '"') : nullptr;
+            if (closingQuote) {
+                char *text = const_cast<char *>(closingQuote) + 1;
+                for (int i = 0;  i < NumPerfCounters && *text == ',';  i++) {
+                    events[i] = strtoull(text + 1, &text, 10);
+                }
+            }
+        }
+        else
+        {
+            // per-thread lines describe only the run which produced the file
+            if (strstr(line, "\"thread\": ")) continue;
+
+            const char *name = findJsonValue(line, "stage");
+            const char *count = findJsonValue(line, "count");
+            const char *total = findJsonValue(line, "total_ns");
+            const char *minimum = findJsonValue(line, "min_ns");
+            const char *maximum = findJsonValue(line, "max_ns");
+            const char *histogram = findJsonValue(line, "histogram");
+            if (!name || !count || !total || !minimum || !maximum || !histogram) continue;
+
+            for (int s = 0;  s < NumProfilerStages;  s++) {
+                const std::string quoted = std::string("\"") + stageName(s) + "\"";
+                if (strncmp(name, quoted.c_str(), quoted.size()) == 0) stage = s;
+            }
+            h.count = strtoull(count, nullptr, 10);
+            h.totalNs = strtoull(total, nullptr, 10);
+            h.minNs = strtoull(minimum, nullptr, 10);
+            h.maxNs = strtoull(maximum, nullptr, 10);
+            histogramFromString(histogram + 1, &h);
+
+            for (int i = 0;  i < NumPerfCounters;  i++) {
+                const char *value = findJsonValue(line, PerfCounters::counterName(i));
+                if (value) events[i] = strtoull(value, nullptr, 10);
+            }
+        }
+
+        if (stage < 0) {
+            ok = false;
+            continue;
+        }
+        loaded[stage].merge(h);
+        for (int i = 0;  i < NumPerfCounters;  i++) loadedEvents[stage][i] += events[i];
+    }
+    fclose(f);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (int s = 0;  s < NumProfilerStages;  s++)
+    {
+        mergedStages[s].merge(loaded[s]);
+        for (int i = 0;  i < NumPerfCounters;  i++) mergedPerfEvents[s][i] += loadedEvents[s][i];
+    }
+    return ok;
+}
+
+bool Profiler::writeReport(const char *path)
+{
+    ProfilerHistogram stages [NumProfilerStages];
+    unsigned long long int perfEvents [NumProfilerStages][NumPerfCounters];
+    aggregate(stages, true, perfEvents);
+
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    if (isCsvPath(path))
+    {
+        fprintf(f, "stage,count,total_ns,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns,histogram");
+        for (int i = 0;  i < NumPerfCounters;  i++) fprintf(f, ",%s", PerfCounters::counterName(i));
+        fprintf(f, "\n");
+
+        for (int s = 0;  s < NumProfilerStages;  s++)
+        {
+            const ProfilerHistogram &h = stages[s];
+            fprintf(f, "%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,\"%s\"", stageName(s), h.count, h.totalNs, h.count ? h.totalNs / h.count : 0,
+                    h.minNs, h.percentileNs(0.5), h.percentileNs(0.9), h.percentileNs(0.99), h.maxNs, histogramToString(h).c_str());
+            for (int i = 0;  i < NumPerfCounters;  i++) fprintf(f, ",%llu", perfEvents[s][i]);
+            fprintf(f, "\n");
+        }
+    }
+    else
+    {
+        fprintf(f, "{\n  \"stages\": [\n");
+        for (int s = 0;  s < NumProfilerStages;  s++)
+        {
+            const ProfilerHistogram &h = stages[s];
+            fprintf(f, "    {\"stage\": \"%s\", \"count\": %llu, \"total_ns\": %llu, \"mean_ns\": %llu, \"min_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu, \"histogram\": \"%s\"",
+                    stageName(s), h.count, h.totalNs, h.count ? h.totalNs / h.count : 0, h.minNs, h.percentileNs(0.5), h.percentileNs(0.9), h.percentileNs(0.99), h.maxNs,
+                    histogramToString(h).c_str());
+            for (int i = 0;  i < NumPerfCounters;  i++) fprintf(f, ", \"%s\": %llu", PerfCounters::counterName(i), perfEvents[s][i]);
+            fprintf(f, "}%s\n", (s + 1 < NumProfilerStages) ? "," : "");
+        }
+        fprintf(f, "  ],\n  \"threads\": [\n");
+
+        // per-thread totals of the current run help to find imbalanced workers
+        std::lock_guard<std::mutex> lock(registryMutex);
+        bool first = true;
+        for (ThreadCounters *counters : registry)
+        {
+            std::lock_guard<std::mutex> threadLock(counters->mutex);
+            for (int s = 0;  s < NumProfilerStages;  s++)
+            {
+                const ProfilerHistogram &h = counters->stages[s];
+                if (h.count == 0) continue;
+                fprintf(f, "%s    {\"thread\": %d, \"stage\": \"%s\", \"count\": %llu, \"total_ns\": %llu, \"max_ns\": %llu}", first ? "" : ",\n",
+                        counters->threadIndex, stageName(s), h.count, h.totalNs, h.maxNs);
+                first = false;
+            }
+        }
+        fprintf(f, "%s  ]\n}\n", first ? "" : "\n");
+    }
+
+    return fclose(f) == 0;
+}
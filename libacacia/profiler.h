@@ -0,0 +1,94 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "perfcounters.h"
+
+// Pipeline stages measured by the profiler
+enum ProfilerStage
+{
+    StageDecode = 0,
+    StageFeatures,
+    StageInference,
+    StageEncode,
+    StageWrite,          // writes of AsyncIO are measured from submission until the file is closed
+    NumProfilerStages
+};
+
+// Latency histogram with logarithmic buckets: 4 buckets per power of two of nanoseconds,
+// i.e. relative resolution of about 19% over the whole range from 1 ns to hours.
+struct ProfilerHistogram
+{
+    static const int numBuckets = 256;
+
+    unsigned long long int count;
+    unsigned long long int totalNs;
+    unsigned long long int minNs;
+    unsigned long long int maxNs;
+    unsigned long long int buckets [numBuckets];
+
+    void clear();
+    void add(unsigned long long int durationNs);
+    void merge(const ProfilerHistogram &other);
+    unsigned long long int percentileNs(double p) const;
+
+    static int bucketIndex(unsigned long long int durationNs);
+    static unsigned long long int bucketLowerBoundNs(int index);
+};
+
+// State captured at the beginning of a measured stage
+struct ProfilerSample
+{
+    unsigned long long int startNs;
+    PerfSnapshot perf;
+};
+
+// Collects stage durations from all threads.
+// Recording is lock-free: every thread writes to its own counters, which are merged only when a report is produced.
+// Reports can be merged with a previously written file, so statistics accumulate over many batch runs.
+// If hardware performance counters are enabled, the events counted during each stage are accumulated too.
+class Profiler
+{
+public:
+    // monotonic clock with nanosecond resolution
+    static unsigned long long int nowNs();
+
+    // start() and stop() measure a stage in the calling thread including hardware events;
+    // stop() records the stage and returns its duration
+    static void start(ProfilerSample *sample);
+    static unsigned long long int stop(ProfilerStage stage, const ProfilerSample &sample, unsigned long long int *perfEvents = nullptr);
+
+    static void record(ProfilerStage stage, unsigned long long int durationNs, const unsigned long long int *perfEvents = nullptr);
+
+    // statistics of all threads, optionally only of the current process (without merged files);
+    // perfEvents, if not null, receives NumPerfCounters totals for every stage
+    static void aggregate(ProfilerHistogram *stages, bool includeMerged = true, unsigned long long int (*perfEvents)[NumPerfCounters] = nullptr);
+
+    // merges statistics from a file written earlier by writeReport(); returns false if the file can't be parsed
+    static bool mergeReport(const char *path);
+
+    // writes a JSON report, or CSV if the file name ends with ".csv"
+    static bool writeReport(const char *path);
+
+    static const char *stageName(int stage);
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,140 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "sequenceanalyzer.h"
+
+#include <string.h>
+
+#include "immintrin.h"
+
+static const int fragmentSize = 8;
+
+// CRC32-C of each of the 4 columns of pixel pairs, independent chains for the pipeline, folded into one value;
+// every fold is a bijection of the previous value, so a change detected in one column changes the result
+static inline unsigned int hashFragment(const unsigned int *fragment, int imageStride)
+{
+    unsigned long long int crc [4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    for (int line = 0;  line < fragmentSize;  line++)
+    {
+        const unsigned int *pixels = fragment + (long long int) line * imageStride;
+        for (int i = 0;  i < 4;  i++)
+        {
+            unsigned long long int pair;
+            memcpy(&pair, pixels + 2 * i, sizeof(pair));
+            crc[i] = _mm_crc32_u64(crc[i], pair);
+        }
+    }
+    unsigned int hash = (unsigned int) crc[0];
+    for (int i = 1;  i < 4;  i++) hash = _mm_crc32_u32(hash, (unsigned int) crc[i]);
+    return hash;
+}
+
+// sums of a single fragment, in the order of FeatureSums
+static void packFragment(const FeatureSums &sums, unsigned int *values)
+{
+    values[0] = (unsigned int) sums.absSumG1x1;
+    values[1] = (unsigned int) sums.sqrSumG1x1;
+    values[2] = (unsigned int) sums.absSumG2x2;
+    values[3] = (unsigned int) sums.sqrSumG2x2;
+    values[4] = (unsigned int) sums.absSumG4x4;
+    values[5] = (unsigned int) sums.sqrSumG4x4;
+    values[6] = (unsigned int) sums.absSumD2x2;
+    values[7] = (unsigned int) sums.absSumD4x4;
+    values[8] = (unsigned int) sums.absSumG2UV;
+    values[9] = (unsigned int) sums.absSumCheckboard;
+}
+
+// sums += newValues - oldValues; the sums are unsigned, so the subtraction wraps around correctly
+static void replaceFragment(FeatureSums *sums, const unsigned int *oldValues, const unsigned int *newValues)
+{
+    unsigned long long int *fields [10] = {
+        &sums->absSumG1x1, &sums->sqrSumG1x1, &sums->absSumG2x2, &sums->sqrSumG2x2, &sums->absSumG4x4,
+        &sums->sqrSumG4x4, &sums->absSumD2x2, &sums->absSumD4x4, &sums->absSumG2UV, &sums->absSumCheckboard
+    };
+    for (int i = 0;  i < 10;  i++) *fields[i] += (unsigned long long int) newValues[i] - oldValues[i];
+}
+
+SequenceAnalyzer::SequenceAnalyzer()
+{
+    reset();
+}
+
+void SequenceAnalyzer::reset()
+{
+    width = height = 0;
+    changed = 0;
+    sums.clear();
+    fragments.clear();
+    hashes.clear();
+}
+
+void SequenceAnalyzer::analyzeFrame(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features)
+{
+    const int numFragmentsInRow = imageWidth / fragmentSize;
+    const int numFragmentsInCol = imageHeight / fragmentSize;
+
+    // the first frame of a sequence: every fragment is calculated, zero contributions are replaced
+    const bool first = (imageWidth != width || imageHeight != height);
+    if (first)
+    {
+        width = imageWidth;
+        height = imageHeight;
+        sums.clear();
+        sums.numFragments = numFragmentsInRow * numFragmentsInCol;
+        fragments.assign((size_t) numFragmentsInRow * numFragmentsInCol, FragmentSums());
+        hashes.assign((size_t) numFragmentsInRow * numFragmentsInCol, 0);
+    }
+
+    changed = 0;
+    for (int frow = 0;  frow < numFragmentsInCol;  frow++)
+    {
+        const unsigned int *row = imageData + (long long int) frow * fragmentSize * imageStride;
+        for (int fcol = 0;  fcol < numFragmentsInRow;  fcol++)
+        {
+            const int index = frow * numFragmentsInRow + fcol;
+            const unsigned int *fragment = row + fcol * fragmentSize;
+            const unsigned int hash = hashFragment(fragment, imageStride);
+            if (!first && hash == hashes[index]) continue;
+
+            // the column of the fragment as an image one fragment wide
+            FeatureSums fragmentSums;
+            fragmentSums.clear();
+            FeatureExtractor::accumulateFeatures(imageData + fcol * fragmentSize, fragmentSize, imageStride, frow, frow + 1, &fragmentSums);
+
+            FragmentSums values;
+            packFragment(fragmentSums, values.values);
+            replaceFragment(&sums, fragments[index].values, values.values);
+            fragments[index] = values;
+            hashes[index] = hash;
+            changed++;
+        }
+    }
+
+    FeatureExtractor::finishFeatures(sums, features);
+}
+
+int SequenceAnalyzer::changedFragments() const
+{
+    return changed;
+}
+
+int SequenceAnalyzer::numFragments() const
+{
+    return (int) fragments.size();
+}
@@ -0,0 +1,66 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SEQUENCEANALYZER_H
+#define SEQUENCEANALYZER_H
+
+#include <vector>
+
+#include "featureextractor.h"
+
+// Features of a sequence of similar frames, e.g. a burst of photos or the frames of an animation.
+//
+// All features are sums over 8x8 fragments, so the analyzer keeps the contribution of every fragment and a hash
+// of its pixels; for the next frame only the fragments whose hash changed are calculated again and their difference
+// is applied to the sums. A frame which is nearly the same as the previous one costs the hashing, a fraction
+// of a full pass. The features are identical to FeatureExtractor::calculateFeatures() of the frame.
+//
+// The hash consists of CRC32-C of the fragment's pixel columns: it detects every change of up to 32 adjacent bits
+// of a column, a larger change is missed with probability 2^-32 per changed fragment.
+class SequenceAnalyzer
+{
+public:
+    SequenceAnalyzer();
+
+    // features of the next xRGB frame (stride in pixels); a frame of another size starts a new sequence
+    void analyzeFrame(const unsigned int *imageData, int imageWidth, int imageHeight, int imageStride, double *features);
+
+    // the next frame is calculated completely
+    void reset();
+
+    // fragments calculated for the last frame and all fragments of a frame
+    int changedFragments() const;
+    int numFragments() const;
+
+private:
+    // contribution of one fragment, the per-fragment values of FeatureSums fit into 32 bits
+    struct FragmentSums
+    {
+        unsigned int values [10];
+    };
+
+    int width;
+    int height;
+    int changed;
+    FeatureSums sums;
+    std::vector<FragmentSums> fragments;
+    std::vector<unsigned int> hashes;
+};
+
+#endif // SEQUENCEANALYZER_H
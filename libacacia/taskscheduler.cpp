@@ -0,0 +1,273 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "taskscheduler.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+// the worker running the current thread, used to push spawned tasks to the own deque
+static thread_local TaskScheduler *currentScheduler = nullptr;
+static thread_local int currentWorker = -1;
+
+TaskGroup::TaskGroup() : pending(0) {}
+
+TaskScheduler::TaskScheduler(int numThreads, TaskPlacement placement) : numQueued(0), stopping(false)
+{
+    if (numThreads < 1) numThreads = 1;
+    for (int i = 0;  i < numThreads;  i++) workers.push_back(new Worker());
+    placeWorkers(placement);
+
+    for (int i = 0;  i < numThreads;  i++) workers[i]->thread = std::thread(&TaskScheduler::run, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    // workers steal from each other until the last one exits
+    for (size_t i = 0;  i < workers.size();  i++) workers[i]->thread.join();
+    for (size_t i = 0;  i < workers.size();  i++) delete workers[i];
+}
+
+int TaskScheduler::numThreads() const
+{
+    return (int) workers.size();
+}
+
+void TaskScheduler::spawn(TaskGroup *group, std::function<void()> task)
+{
+    group->pending++;
+
+    if (currentScheduler == this) {
+        std::lock_guard<std::mutex> lock(workers[currentWorker]->mutex);
+        workers[currentWorker]->tasks.push_back({std::move(task), group});
+    } else {
+        std::lock_guard<std::mutex> lock(injectedMutex);
+        injected.push_back({std::move(task), group});
+    }
+
+    numQueued++;
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    workAvailable.notify_one();
+}
+
+void TaskScheduler::wait(TaskGroup *group)
+{
+    if (currentScheduler != this) {
+        std::unique_lock<std::mutex> lock(group->mutex);
+        group->finished.wait(lock, [&] { return group->pending.load() == 0; });
+        return;
+    }
+
+    // the remaining tasks of the group may be running in other workers, then there is nothing to do but yield
+    while (group->pending.load() > 0)
+    {
+        Task task;
+        if (takeTask(currentWorker, group, &task)) execute(task);
+        else std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(group->mutex);
+}
+
+void TaskScheduler::parallelFor(int count, int chunkSize, const std::function<void(int, int)> &body)
+{
+    TaskGroup group;
+    for (int begin = 0;  begin < count;  begin += chunkSize) {
+        const int end = std::min(begin + chunkSize, count);
+        spawn(&group, [&body, begin, end] { body(begin, end); });
+    }
+    wait(&group);
+}
+
+// the own deque is taken from the back, victims and then tasks of other threads from the front;
+// group limits the choice if it's not null
+bool TaskScheduler::takeTask(int index, TaskGroup *group, Task *task)
+{
+    {
+        Worker *worker = workers[index];
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        for (std::deque<Task>::reverse_iterator i = worker->tasks.rbegin();  i != worker->tasks.rend();  ++i) {
+            if (group && i->group != group) continue;
+            *task = std::move(*i);
+            worker->tasks.erase(std::next(i).base());
+            numQueued--;
+            return true;
+        }
+    }
+
+    const std::vector<int> &victims = workers[index]->victims;
+    for (size_t v = 0;  v < victims.size();  v++)
+    {
+        Worker *victim = workers[victims[v]];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        for (std::deque<Task>::iterator i = victim->tasks.begin();  i != victim->tasks.end();  ++i) {
+            if (group && i->group != group) continue;
+            *task = std::move(*i);
+            victim->tasks.erase(i);
+            numQueued--;
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(injectedMutex);
+    for (std::deque<Task>::iterator i = injected.begin();  i != injected.end();  ++i) {
+        if (group && i->group != group) continue;
+        *task = std::move(*i);
+        injected.erase(i);
+        numQueued--;
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::execute(Task &task)
+{
+    task.function();
+
+    // the group may be destroyed as soon as the waiter sees zero, so it's decremented under the lock
+    // which the waiter takes before returning
+    TaskGroup *group = task.group;
+    std::lock_guard<std::mutex> lock(group->mutex);
+    if (--group->pending == 0) group->finished.notify_all();
+}
+
+void TaskScheduler::run(int index)
+{
+    currentScheduler = this;
+    currentWorker = index;
+
+#ifdef __linux__
+    if (workers[index]->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(workers[index]->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+
+    while (true)
+    {
+        Task task;
+        if (takeTask(index, nullptr, &task)) {
+            execute(task);
+            continue;
+        }
+
+        // queued tasks are finished before the scheduler stops
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [&] { return numQueued.load() > 0 || stopping; });
+        if (stopping && numQueued.load() == 0) break;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Placement
+// ---------------------------------------------------------------------------------------------------------------------
+
+#ifdef __linux__
+
+// parses a list like "0-3,8-11"
+static void parseCpuList(const char *text, std::vector<int> *cpus)
+{
+    while (*text >= '0' && *text <= '9')
+    {
+        char *end = nullptr;
+        const long first = strtol(text, &end, 10);
+        long last = first;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        for (long cpu = first;  cpu <= last;  cpu++) cpus->push_back((int) cpu);
+        text = (*end == ',') ? end + 1 : end;
+    }
+}
+
+// NUMA node of every CPU from sysfs, all CPUs are on node 0 if it's not available
+static std::vector<int> cpuNodes()
+{
+    std::vector<int> nodes (CPU_SETSIZE, 0);
+    for (int node = 0;  node < 256;  node++)
+    {
+        char path [64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+
+        char line [1024] = {};
+        if (fgets(line, sizeof(line), f)) {
+            std::vector<int> cpus;
+            parseCpuList(line, &cpus);
+            for (size_t i = 0;  i < cpus.size();  i++) if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) nodes[cpus[i]] = node;
+        }
+        fclose(f);
+    }
+    return nodes;
+}
+
+#endif
+
+void TaskScheduler::placeWorkers(TaskPlacement placement)
+{
+    const int numWorkers = (int) workers.size();
+    for (int i = 0;  i < numWorkers;  i++) {
+        workers[i]->cpu = -1;
+        workers[i]->node = 0;
+    }
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (placement != PlacementNone && sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        const std::vector<int> nodes = cpuNodes();
+        std::vector<int> cpus;
+        for (int cpu = 0;  cpu < CPU_SETSIZE;  cpu++) if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+
+        // with NUMA placement consecutive workers fill one node before the next
+        if (placement == PlacementNuma) std::stable_sort(cpus.begin(), cpus.end(), [&](int a, int b) { return nodes[a] < nodes[b]; });
+
+        for (int i = 0;  i < numWorkers && !cpus.empty();  i++) {
+            workers[i]->cpu = cpus[i % cpus.size()];
+            if (placement == PlacementNuma) workers[i]->node = nodes[workers[i]->cpu];
+        }
+    }
+#else
+    (void) placement;
+#endif
+
+    // neighbours first, workers of the same node before remote ones
+    for (int i = 0;  i < numWorkers;  i++)
+    {
+        std::vector<int> &victims = workers[i]->victims;
+        for (int offset = 1;  offset < numWorkers;  offset++) victims.push_back((i + offset) % numWorkers);
+        std::stable_partition(victims.begin(), victims.end(), [&](int v) { return workers[v]->node == workers[i]->node; });
+    }
+}
@@ -0,0 +1,113 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Placement of worker threads on CPUs
+enum TaskPlacement
+{
+    PlacementNone = 0,    // the operating system decides
+    PlacementPinned,      // every worker is pinned to one CPU of the process's affinity mask
+    PlacementNuma         // pinned, workers of one NUMA node get neighbouring indices and steal from each other first
+};
+
+// Tasks spawned into a group are waited for together
+class TaskGroup
+{
+public:
+    TaskGroup();
+
+private:
+    friend class TaskScheduler;
+
+    std::atomic<int> pending;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+// Work-stealing scheduler for mixing parallelism between images and inside large images.
+//
+// Every worker has its own deque: tasks spawned by a worker are pushed to and taken from the back of its deque,
+// so a worker continues with the freshest (cache-hot) work, while idle workers steal the oldest tasks
+// from the front of other deques. Tasks spawned by other threads are queued in the order of spawning and taken
+// from the front by workers that have nothing else to do, so work started inside the pool is finished first.
+//
+// A worker waiting for a group doesn't block: it runs the tasks of this group that are not taken yet, so tasks
+// can spawn and wait for subtasks. Only tasks of the waited group are run, a large image is not delayed by
+// unrelated images then. Other threads block in wait().
+class TaskScheduler
+{
+public:
+    explicit TaskScheduler(int numThreads, TaskPlacement placement = PlacementNone);
+    ~TaskScheduler();    // finishes all spawned tasks
+
+    int numThreads() const;
+
+    void spawn(TaskGroup *group, std::function<void()> task);
+    void wait(TaskGroup *group);
+
+    // runs body on chunks of [0, count) as tasks and waits for them
+    void parallelFor(int count, int chunkSize, const std::function<void(int begin, int end)> &body);
+
+private:
+    struct Task
+    {
+        std::function<void()> function;
+        TaskGroup *group;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::vector<int> victims;    // other workers in the order of stealing
+        int cpu;
+        int node;
+        std::thread thread;
+    };
+
+    void run(int index);
+    bool takeTask(int index, TaskGroup *group, Task *task);
+    void execute(Task &task);
+    void placeWorkers(TaskPlacement placement);
+
+    std::vector<Worker *> workers;
+
+    // tasks spawned by other threads, first in first out
+    std::mutex injectedMutex;
+    std::deque<Task> injected;
+
+    std::atomic<int> numQueued;
+    bool stopping;
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+};
+
+#endif // TASKSCHEDULER_H
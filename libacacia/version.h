@@ -17,13 +17,10 @@
 */
 
 
-#ifndef FEATUREEXTRACTOR_H
-#define FEATUREEXTRACTOR_H
+#ifndef VERSION_H
+#define VERSION_H
 
-class FeatureExtractor
-{
-public:
-    static void calculateFeatures(const unsigned int *imageData, int imageWidth, int imageHeight, double *features);
-};
+// version shared by the library, the command line tool and the GUI
+#define ACACIA_VERSION "0.17"
 
-#endif // FEATUREEXTRACTOR_H
+#endif // VERSION_H
@@ -20,7 +20,7 @@
 #ifndef WEBPMODELS
 #define WEBPMODELS
 
-double webp_fsize_model [] = {
+constexpr double webp_fsize_model [] = {
     -2.04713983928356e+00, -5.45440799551727e-01,  5.05744163908677e-01,  1.63069215744283e-03,  1.30702989441928e+00, -4.09249993776041e-01, -7.57344091873330e-01,  3.25754154075878e-01, -1.26422225692647e+00, -5.16815281238070e-02, -5.05095678458313e-01, -4.42697121018071e-02, -6.40653111383764e-01,
     -7.56534343040735e+00, -2.53362002715246e-01, -9.93476605006069e-01,  1.02183540067896e+00, -3.25893169548189e-01,  1.77805349679571e+00, -1.17089379091080e+00,  7.55342804637842e-02, -5.52511775339097e-01,  9.43864007943818e-02,  1.54143194166064e-01,  4.42888527857960e-03,  3.39555951759638e+00,
     -3.31318256484187e+00,  1.49530828064954e+00, -3.51149927399011e-01, -3.87544744432531e-01, -1.38166200803430e+00,  4.41048208749033e-01,  4.07215749631131e-01,  1.07231997772484e+00, -3.37043941200022e-01, -4.60317697726531e-02, -1.81222261852347e-01,  5.34096328169222e-02,  2.32576259683703e+00,
@@ -74,7 +74,7 @@ double webp_fsize_model [] = {
      1.08150129597890e+01, -1.93638403454722e+00,  4.70602405346019e+00,  1.96739284117601e+00, -1.20110380173253e+00, -1.91756052807318e+00,  1.60743026907195e+00,  1.33908805301722e+00,  2.10419059687500e+00,  6.09022963036506e-01, -2.71473631798775e+00, -4.66934683766601e+00, -1.30387989331769e+00, -2.10274189240158e+00,  8.27562396656568e-01,  2.18014401374170e+00,  8.64944827423596e-01, -5.65807511665608e-01, -1.79012671306295e+00,  2.45193834065086e+00, -4.22198098160543e+00,  1.98606229895397e+00, -2.06393707765087e+00,  2.58481415881611e+00, -7.94055630785517e-01,  1.37353571955679e+00,  4.64294725236775e-01,  1.56842436809866e+00, -1.51666996640920e+00,  1.55018397731830e+00,  1.01636647517269e+00, -9.54454044034810e+00,  2.15747575774679e+00, -4.86374633109719e+00,  4.04952227678780e+00, -1.59297119347492e+00,  1.02723876430821e+00,  3.85274908583569e+00,  3.44643806749386e+00,  9.70939181445894e-01, -1.19726803768892e+00, -1.47967765136336e+00, -1.15191421910863e+00,  3.77361099327696e-01,  1.01720638615940e+00, -1.22715754310778e+00, -3.50018536793326e+00, -1.67633197559494e+00,  1.05408379772389e+00, -1.72721360419520e+00,  6.10781175977002e-01
 };
 
-double webp_ymssim_model [] = {
+constexpr double webp_ymssim_model [] = {
     -7.02753496352222e-01,  9.49736140071922e-02, -3.70276596682548e-01, -1.32545914471896e-02,  3.69311298104010e-01, -1.91011063381503e-01, -3.84840898138096e-02,  1.52565596830356e-01,  8.04510579532193e-02,  2.25935669219965e-02,  3.41951016453872e-02, -1.34961871859565e-02, -5.44420157010196e-01,
     -5.25039728226255e-01, -6.80777675797244e-01,  3.72168986555291e-01, -3.16341112406042e-01,  9.01514189751634e-02,  2.07513105969461e-01, -1.46395337458635e-01, -4.03658831499050e-01, -4.09160844521631e-01,  1.00204590000724e-02,  4.69796912412088e-01, -2.62379661920826e-02, -7.12396871460934e-02,
      3.31382539509274e-01, -7.22957019054500e-02,  2.02188621749887e-01, -4.54727010274220e-01,  1.86047561247871e-02, -4.56459700898825e-01,  1.86599159431438e-01, -5.33398644388234e-01, -5.44717664578655e-01, -3.20293426731712e-01, -1.23471687489094e-01,  1.33006137380836e-02, -3.43509782973895e-01,
@@ -128,7 +128,7 @@ double webp_ymssim_model [] = {
      8.15158143557461e-01, -6.64480639043781e-01, -7.64228678734215e-01,  4.60544133038538e-03, -7.76258044944368e-01, -1.91540663378940e-01,  8.81295925800003e-01,  2.44365606009307e-01,  5.64983775241103e-01,  3.29341758584719e-01,  1.21024709003517e-01,  3.12787116927511e-01,  1.90737386211393e-01,  3.81302311189530e-01, -1.85951464056969e-02, -3.25296471589272e-01, -6.72505643836029e-02, -1.45512940227661e-02,  7.04018406107694e-01,  7.98005225350684e-01,  8.42555784583705e-01,  1.58585510155874e-01,  5.72421610116563e-01, -1.07759775956102e+00,  8.65821528894578e-01,  7.06594809151961e-02,  3.61413230710947e-01, -8.37808885704707e-01,  3.51913975954352e-01, -9.61103377198731e-01, -1.22550474286959e+00, -3.57061158056045e-01, -8.50543859518161e-01,  4.89343557758717e-01, -4.87363586098628e-01,  2.29930416348290e-01,  9.61904494724427e-01, -3.76163601384827e-01,  4.90809864334931e-01,  1.06125885625625e+00, -1.67397383400337e-01, -5.25364473103005e-01,  1.51713794413293e-01,  1.35204251642117e-01, -4.80740205293147e-02, -3.07481088990485e-01, -4.33593243736961e-01, -1.99134475662308e+00, -4.11404264913935e-01,  2.16268705782346e-01,  3.67435015416943e-01
 };
 
-double webp_ypsnr_model [] = {
+constexpr double webp_ypsnr_model [] = {
     -2.75956899376632e-01, -1.71282482396322e+00,  1.64511764206121e+00, -1.95159311199035e-01,  1.78757423126006e+00, -1.02409378983779e+00,  8.53916324216074e-02,  1.97485805290161e+00, -4.65802524917662e-01, -1.99249586542797e-02, -4.18982836933938e-01, -8.45166845883671e-02,  9.40133642813647e-01,
     -6.92438223152627e-01, -3.81827546678738e+00, -6.90830751716472e+00,  7.22173427909916e+00,  7.01244917160756e-01,  1.51904705603552e+00, -1.69751285047287e+00,  3.20353894469850e+00,  1.35066499813149e+00,  1.78112558359803e-01, -9.80129728926432e-01, -1.81984057443529e-02,  5.95365308578001e-01,
      2.44213874138919e+00, -1.42097962826440e+00,  1.66240627716174e+00,  2.79016013504725e+00,  1.37044465209352e+00, -5.33566637257614e+00,  9.68356348787091e-01,  7.85916763948883e-01, -1.54592257195216e+00, -1.81111266520269e-01,  3.78979254123930e-01, -9.02480380082023e-02, -6.08314216874829e-01,
@@ -0,0 +1,107 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "yuvimage.h"
+
+#include <new>
+
+YuvBuffer::YuvBuffer()
+    : data(nullptr), capacity(0)
+{
+    clear();
+}
+
+YuvBuffer::~YuvBuffer()
+{
+    delete [] data;
+}
+
+bool YuvBuffer::resize(int width, int height)
+{
+    // 4:2:0 JPEG consists of MCUs of 16x16 luma and 8x8 samples of each chroma component
+    const int lumaWidth = (width + 15) / 16 * 16;
+    const int lumaHeight = (height + 15) / 16 * 16;
+    const unsigned long long int lumaSize = (unsigned long long int) lumaWidth * lumaHeight;
+    const unsigned long long int required = lumaSize + lumaSize / 2;
+
+    if (required > capacity)
+    {
+        delete [] data;
+        data = new (std::nothrow) unsigned char [required];
+        if (!data) {
+            capacity = 0;
+            clear();
+            return false;
+        }
+        capacity = required;
+    }
+
+    planes.y = data;
+    planes.u = data + lumaSize;
+    planes.v = data + lumaSize + lumaSize / 4;
+    planes.yStride = lumaWidth;
+    planes.uvStride = lumaWidth / 2;
+    planes.uvStep = 1;
+    planes.width = width;
+    planes.height = height;
+    planes.fullRange = true;
+    planes.padded = true;
+    return true;
+}
+
+// the memory is kept, only the image becomes empty
+void YuvBuffer::clear()
+{
+    planes.y = planes.u = planes.v = nullptr;
+    planes.yStride = planes.uvStride = 0;
+    planes.uvStep = 1;
+    planes.width = planes.height = 0;
+    planes.fullRange = true;
+    planes.padded = true;
+}
+
+const YuvImage &YuvBuffer::image() const
+{
+    return planes;
+}
+
+unsigned char *YuvBuffer::y() const
+{
+    return (unsigned char *) planes.y;
+}
+
+unsigned char *YuvBuffer::u() const
+{
+    return (unsigned char *) planes.u;
+}
+
+unsigned char *YuvBuffer::v() const
+{
+    return (unsigned char *) planes.v;
+}
+
+int YuvBuffer::paddedWidth() const
+{
+    return planes.yStride;
+}
+
+int YuvBuffer::paddedHeight() const
+{
+    return planes.width > 0 ? (planes.height + 15) / 16 * 16 : 0;
+}
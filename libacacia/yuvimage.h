@@ -0,0 +1,86 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#ifndef YUVIMAGE_H
+#define YUVIMAGE_H
+
+// Planar YUV 4:2:0 frame owned by the caller, e.g. from a video decoder or a camera, analyzed and encoded without
+// conversion to xRGB.
+//
+// The chroma planes have (width + 1) / 2 x (height + 1) / 2 samples; uvStep is the distance between two samples
+// of one chroma plane in bytes: 1 for I420 (separate U and V planes), 2 for NV12 (interleaved, v = u + 1)
+// and NV21 (u = v + 1). Strides are in bytes.
+//
+// Samples use the BT.601 matrix; fullRange is true for the 0..255 range of JPEG (JFIF, most cameras) and false
+// for the 16..235 video range (most video decoders). Features are calculated in the full range and WebP is encoded
+// in the video range, so a frame in the other range is scaled while it's read.
+//
+// padded is true if the planes extend to whole JPEG MCUs (width and height rounded up to 16 for luma, half of that
+// for chroma) with the edges filled as libjpeg fills them; the JPEG encoder then reads the rows in place.
+struct YuvImage
+{
+    const unsigned char *y;
+    const unsigned char *u;
+    const unsigned char *v;
+    int yStride;
+    int uvStride;
+    int uvStep;
+    int width;
+    int height;
+    bool fullRange;
+    bool padded;
+};
+
+// Owner of padded full range I420 planes, which FeatureExtractor fills with the colour conversion of libjpeg while
+// it analyzes an xRGB image (see featureextractor.h). The memory is kept between images and grows only when a larger
+// image arrives, so a buffer per thread is allocated once for a series of images of similar size.
+class YuvBuffer
+{
+public:
+    YuvBuffer();
+    ~YuvBuffer();
+
+    YuvBuffer(const YuvBuffer &) = delete;
+    YuvBuffer &operator=(const YuvBuffer &) = delete;
+
+    // returns false if the memory can't be allocated, the buffer is empty then
+    bool resize(int width, int height);
+    void clear();
+
+    // valid until the next resize() or clear()
+    const YuvImage &image() const;
+
+    // writable planes of image()
+    unsigned char *y() const;
+    unsigned char *u() const;
+    unsigned char *v() const;
+
+    // dimensions of the luma plane, its stride is paddedWidth()
+    int paddedWidth() const;
+    int paddedHeight() const;
+
+private:
+    unsigned char *data;
+    unsigned long long int capacity;
+    YuvImage planes;
+};
+
+#endif // YUVIMAGE_H
@@ -0,0 +1,710 @@
+/*
+    Copyright 2016 Oleksandr Murashko, John Thomson.
+    This file is part of ACACIA Image Processing Tool.
+
+    ACACIA is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ACACIA is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math.h"
+
+#include "featureextractor.h"
+#include "imagereader.h"
+#include "metrics.h"
+#include "groundtruth.h"
+#include "modelset.h"
+#include "taskscheduler.h"
+
+static const char *msgPref = "[train] ";
+
+static const int numInputs = 12;
+static const char objectives [3] = {'s', 'm', 'p'};
+static const char *formatNames [2] = {"jpeg", "webp"};
+static const char *objectiveNames [3] = {"fsize", "ymssim", "ypsnr"};
+
+static unsigned long long int nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool parseInt(const char *text, int *value)
+{
+    char *end = nullptr;
+    const long result = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || result < -2147483647L || result > 2147483647L) return false;
+    *value = (int) result;
+    return true;
+}
+
+static bool parseDouble(const char *text, double *value)
+{
+    char *end = nullptr;
+    *value = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+// ------------------------------------------------------------------------------------------------
+// Ground truth: every image compressed with the real encoders over a sweep of quality factors
+// ------------------------------------------------------------------------------------------------
+
+// one encode of one image: the optimizer's input vector (with the quality factor) and the measured values
+struct TrainingSample
+{
+    int image;
+    int format;    // 0 = JPEG, 1 = WebP
+    double input [numInputs];
+    double fileSize;
+    double yPSNR;
+    double yMSSIM;
+};
+
+struct Settings
+{
+    bool formats [2];
+    int qfStep;
+    int numHidden;
+    int epochs;
+    int batchSize;
+    double learningRate;
+    double validationShare;
+    bool builtInStandardization;    // the inputs are standardized like the built-in models instead of on the training set
+    bool silent;
+};
+
+// Decodes, analyzes and sweeps one image. Every encode is a task of the scheduler, so idle workers steal
+// the quality factors of the last images of the corpus and all cores stay busy until the end.
+static bool measureImage(const std::string &path, int imageIndex, const Settings &settings, TaskScheduler *scheduler, std::vector<TrainingSample> *samples)
+{
+    int w = 0, h = 0;
+    unsigned int *image = ImageReader::readFile(path.c_str(), &w, &h);
+    if (!image) return false;
+    if (w < 8 || h < 8) {
+        delete [] image;
+        return false;
+    }
+
+    double inputVector [numInputs];
+    FeatureExtractor::calculateFeatures(image, w, h, w, inputVector, scheduler);
+    inputVector[10] = log(w * (double) h / 1000000.0);
+
+    std::vector<unsigned char> referenceLuma ((size_t) w * h);
+    Metrics::extractLuma(image, w, h, referenceLuma.data());
+
+    // the same QF range as used by the optimizer, always including 100
+    std::vector<TrainingSample> sweep;
+    for (int format = 0;  format < 2;  format++)
+    {
+        if (!settings.formats[format]) continue;
+        TrainingSample sample;
+        sample.image = imageIndex;
+        sample.format = format;
+        for (int i = 0;  i < numInputs;  i++) sample.input[i] = inputVector[i];
+
+        for (int qualityFactor = (format == 0) ? 5 : 0;  qualityFactor < 100;  qualityFactor += settings.qfStep) {
+            sample.input[11] = qualityFactor;
+            sweep.push_back(sample);
+        }
+        sample.input[11] = 100;
+        sweep.push_back(sample);
+    }
+
+    std::atomic<bool> ok(true);
+    scheduler->parallelFor((int) sweep.size(), 1, [&](int begin, int end) {
+        for (int i = begin;  i < end;  i++)
+        {
+            TrainingSample &sample = sweep[i];
+            GroundTruthSample measured;
+            if (!GroundTruth::measure(sample.format == 0, image, referenceLuma.data(), w, h, (int) sample.input[11], &measured)) ok = false;
+            sample.fileSize = measured.fileSize;
+            sample.yPSNR = measured.yPSNR;
+            sample.yMSSIM = measured.yMSSIM;
+        }
+    });
+    delete [] image;
+
+    if (!ok) return false;
+    *samples = sweep;
+    return true;
+}
+
+static bool writeSamples(const char *path, const std::vector<TrainingSample> &samples)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    fprintf(f, "image,format,f1,f2,f3,f4,f5,f6,f7,f8,f9,f10,log_mp,qf,size,ypsnr,ymssim\n");
+    for (const TrainingSample &s : samples)
+    {
+        fprintf(f, "%d,%s", s.image, formatNames[s.format]);
+        for (int i = 0;  i < numInputs;  i++) fprintf(f, ",%.17g", s.input[i]);
+        fprintf(f, ",%.0f,%.17g,%.17g\n", s.fileSize, s.yPSNR, s.yMSSIM);
+    }
+
+    const bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+static bool readSamples(const char *path, std::vector<TrainingSample> *samples)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line [4096];
+    bool ok = fgets(line, sizeof(line), f) != nullptr && strncmp(line, "image,format,", 13) == 0;
+    while (ok && fgets(line, sizeof(line), f))
+    {
+        TrainingSample s;
+        char format [8];
+        double *in = s.input;
+        const int n = sscanf(line, "%d,%7[a-z],%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf", &s.image, format,
+                             &in[0], &in[1], &in[2], &in[3], &in[4], &in[5], &in[6], &in[7], &in[8], &in[9], &in[10], &in[11],
+                             &s.fileSize, &s.yPSNR, &s.yMSSIM);
+        ok = (n == 17 && (strcmp(format, "jpeg") == 0 || strcmp(format, "webp") == 0));
+        s.format = (strcmp(format, "jpeg") == 0) ? 0 : 1;
+        if (ok) samples->push_back(s);
+    }
+    fclose(f);
+    return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Training of the 12-n-1 perceptrons
+// ------------------------------------------------------------------------------------------------
+
+// value predicted by the model of an objective: the size models predict the logarithm of the file size
+static double targetValue(const TrainingSample &sample, int objective)
+{
+    switch (objectives[objective]) {
+    case 's':
+        return log(sample.fileSize);
+    case 'm':
+        return sample.yMSSIM;
+    default:
+        return sample.yPSNR;
+    }
+}
+
+// images, not samples, are held out, otherwise the validation set would contain neighbours of training samples
+static bool isValidationImage(int image, double validationShare)
+{
+    return ((unsigned int) image * 2654435761u) % 1000 < validationShare * 1000;
+}
+
+// A trained model in the layout of ModelView (see modelset.h); the standardization is that of the training samples
+// or that of the built-in models
+struct TrainedModel
+{
+    unsigned int layout [numInputs];
+    double mean [numInputs];
+    double sd [numInputs];
+    std::vector<double> weights;
+
+    double trainingError;
+    double validationError;
+    int numTrainingSamples;
+    int numValidationSamples;
+};
+
+static double sigmoid(double x)
+{
+    return 1 / (1 + exp(-x));
+}
+
+// network output for standardized inputs; hidden activations are stored if requested
+static double forward(const std::vector<double> &weights, int numHidden, const double *x, double *activations)
+{
+    const double *w = weights.data();
+    const double *outputWeights = w + (1 + numInputs) * numHidden;
+    double result = outputWeights[0];
+    for (int h = 0;  h < numHidden;  h++)
+    {
+        const double *neuron = w + h * (1 + numInputs);
+        double sum = neuron[0];
+        for (int k = 0;  k < numInputs;  k++) sum += neuron[1 + k] * x[k];
+        const double activation = sigmoid(sum);
+        if (activations) activations[h] = activation;
+        result += outputWeights[1 + h] * activation;
+    }
+    return result;
+}
+
+// root mean square error in the units of the target
+static double rootMeanSquareError(const std::vector<double> &weights, int numHidden, const std::vector<double> &x, const std::vector<double> &y, double targetSd)
+{
+    if (y.empty()) return 0;
+    double sum = 0;
+    for (size_t i = 0;  i < y.size();  i++)
+    {
+        const double error = forward(weights, numHidden, &x[i * numInputs], nullptr) - y[i];
+        sum += error * error;
+    }
+    return sqrt(sum / y.size()) * targetSd;
+}
+
+// Mini-batch gradient descent with Adam on the mean squared error of the standardized target. The target is
+// standardized as well and folded back into the output layer at the end, so the model has the usual format.
+// The weights with the smallest validation error are kept.
+static void trainModel(const std::vector<TrainingSample> &samples, int format, int objective, const Settings &settings, TrainedModel *model)
+{
+    // training and validation sets, standardized
+    std::vector<const TrainingSample *> training, validation;
+    for (const TrainingSample &s : samples)
+    {
+        if (s.format != format || !isfinite(targetValue(s, objective))) continue;
+        (isValidationImage(s.image, settings.validationShare) ? validation : training).push_back(&s);
+    }
+    model->numTrainingSamples = (int) training.size();
+    model->numValidationSamples = (int) validation.size();
+
+    double targetMean = 0, targetSd = 0;
+    const ModelView &builtIn = ModelSet::builtIn().model(format == 0, objectives[objective]);
+    for (int i = 0;  i < numInputs;  i++)
+    {
+        model->layout[i] = i;
+        if (settings.builtInStandardization) {
+            model->mean[i] = builtIn.mean[i];
+            model->sd[i] = builtIn.sd[i];
+            continue;
+        }
+
+        double sum = 0, sqrSum = 0;
+        for (const TrainingSample *s : training) {
+            sum += s->input[i];
+            sqrSum += s->input[i] * s->input[i];
+        }
+        model->mean[i] = sum / training.size();
+        const double variance = sqrSum / training.size() - model->mean[i] * model->mean[i];
+        model->sd[i] = variance > 1e-12 ? sqrt(variance) : 1.0;
+    }
+    {
+        double sum = 0, sqrSum = 0;
+        for (const TrainingSample *s : training) {
+            sum += targetValue(*s, objective);
+            sqrSum += targetValue(*s, objective) * targetValue(*s, objective);
+        }
+        targetMean = sum / training.size();
+        const double variance = sqrSum / training.size() - targetMean * targetMean;
+        targetSd = variance > 1e-12 ? sqrt(variance) : 1.0;
+    }
+
+    std::vector<double> trainingX, trainingY, validationX, validationY;
+    const std::vector<const TrainingSample *> *sets [2] = {&training, &validation};
+    std::vector<double> *xs [2] = {&trainingX, &validationX};
+    std::vector<double> *ys [2] = {&trainingY, &validationY};
+    for (int set = 0;  set < 2;  set++)
+    {
+        for (const TrainingSample *s : *sets[set])
+        {
+            for (int i = 0;  i < numInputs;  i++) xs[set]->push_back((s->input[i] - model->mean[i]) / model->sd[i]);
+            ys[set]->push_back((targetValue(*s, objective) - targetMean) / targetSd);
+        }
+    }
+
+    // Xavier initialization, seeded by the model, so a training run is reproducible
+    const int numHidden = settings.numHidden;
+    const size_t numWeights = (1 + numInputs) * numHidden + 1 + numHidden;
+    std::mt19937 random (1000 + format * 3 + objective);
+    std::vector<double> weights (numWeights, 0.0);
+    {
+        std::uniform_real_distribution<double> hiddenInit (-sqrt(6.0 / (numInputs + 1)), sqrt(6.0 / (numInputs + 1)));
+        std::uniform_real_distribution<double> outputInit (-sqrt(6.0 / (numHidden + 1)), sqrt(6.0 / (numHidden + 1)));
+        for (int h = 0;  h < numHidden;  h++)
+            for (int k = 1;  k <= numInputs;  k++) weights[h * (1 + numInputs) + k] = hiddenInit(random);
+        for (int h = 1;  h <= numHidden;  h++) weights[(1 + numInputs) * numHidden + h] = outputInit(random);
+    }
+
+    std::vector<double> gradient (numWeights), firstMoment (numWeights, 0.0), secondMoment (numWeights, 0.0);
+    std::vector<double> activations (numHidden);
+    std::vector<int> order (trainingY.size());
+    for (size_t i = 0;  i < order.size();  i++) order[i] = (int) i;
+
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    unsigned long long int step = 0;
+
+    std::vector<double> bestWeights = weights;
+    double bestError = INFINITY;
+
+    for (int epoch = 0;  epoch < settings.epochs;  epoch++)
+    {
+        // linear decay to a tenth of the initial rate
+        const double learningRate = settings.learningRate * (1.0 - 0.9 * epoch / settings.epochs);
+        std::shuffle(order.begin(), order.end(), random);
+
+        for (size_t first = 0;  first < order.size();  first += settings.batchSize)
+        {
+            const size_t last = std::min(order.size(), first + (size_t) settings.batchSize);
+            std::fill(gradient.begin(), gradient.end(), 0.0);
+
+            for (size_t b = first;  b < last;  b++)
+            {
+                const double *x = &trainingX[(size_t) order[b] * numInputs];
+                const double error = forward(weights, numHidden, x, activations.data()) - trainingY[order[b]];
+
+                double *outputGradient = &gradient[(1 + numInputs) * numHidden];
+                const double *outputWeights = &weights[(1 + numInputs) * numHidden];
+                outputGradient[0] += error;
+                for (int h = 0;  h < numHidden;  h++)
+                {
+                    outputGradient[1 + h] += error * activations[h];
+                    const double delta = error * outputWeights[1 + h] * activations[h] * (1 - activations[h]);
+                    double *neuronGradient = &gradient[h * (1 + numInputs)];
+                    neuronGradient[0] += delta;
+                    for (int k = 0;  k < numInputs;  k++) neuronGradient[1 + k] += delta * x[k];
+                }
+            }
+
+            step++;
+            const double scale = 1.0 / (last - first);
+            const double correction1 = 1 - pow(beta1, (double) step);
+            const double correction2 = 1 - pow(beta2, (double) step);
+            for (size_t i = 0;  i < numWeights;  i++)
+            {
+                const double g = gradient[i] * scale;
+                firstMoment[i] = beta1 * firstMoment[i] + (1 - beta1) * g;
+                secondMoment[i] = beta2 * secondMoment[i] + (1 - beta2) * g * g;
+                weights[i] -= learningRate * (firstMoment[i] / correction1) / (sqrt(secondMoment[i] / correction2) + epsilon);
+            }
+        }
+
+        // without validation images the last weights are kept
+        const bool lastEpoch = (epoch + 1 == settings.epochs);
+        if (!validationY.empty() && (epoch % 5 == 4 || lastEpoch))
+        {
+            const double error = rootMeanSquareError(weights, numHidden, validationX, validationY, 1.0);
+            if (error < bestError) {
+                bestError = error;
+                bestWeights = weights;
+            }
+        }
+    }
+    if (!validationY.empty()) weights = bestWeights;
+
+    model->trainingError = rootMeanSquareError(weights, numHidden, trainingX, trainingY, targetSd);
+    model->validationError = rootMeanSquareError(weights, numHidden, validationX, validationY, targetSd);
+
+    // output = targetSd * output' + targetMean
+    double *outputWeights = &weights[(1 + numInputs) * numHidden];
+    outputWeights[0] = outputWeights[0] * targetSd + targetMean;
+    for (int h = 1;  h <= numHidden;  h++) outputWeights[h] *= targetSd;
+    model->weights = weights;
+}
+
+static const char *licenseHeader =
+    "/*\n"
+    "    Copyright 2016 Oleksandr Murashko, John Thomson.\n"
+    "    This file is part of ACACIA Image Processing Tool.\n"
+    "\n"
+    "    ACACIA is free software: you can redistribute it and/or modify\n"
+    "    it under the terms of the GNU General Public License as published by\n"
+    "    the Free Software Foundation, either version 3 of the License, or\n"
+    "    (at your option) any later version.\n"
+    "\n"
+    "    ACACIA is distributed in the hope that it will be useful,\n"
+    "    but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
+    "    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the\n"
+    "    GNU General Public License for more details.\n"
+    "\n"
+    "    You should have received a copy of the GNU General Public License\n"
+    "    along with ACACIA. If not, see <http://www.gnu.org/licenses/>.\n"
+    "*/\n";
+
+// Replacement of libacacia/jpegmodels.h or webpmodels.h. The built-in models have no standardization of their own,
+// all of them share that of modelset.cpp, so the models are trained with it (see main()).
+static bool writeHeader(const std::string &directory, int format, const TrainedModel (&models)[2][3], const Settings &settings)
+{
+    const std::string path = directory + "/" + formatNames[format] + "models.h";
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    const char *guard = (format == 0) ? "JPEGMODELS" : "WEBPMODELS";
+    fprintf(f, "%s\n\n#ifndef %s\n#define %s\n\n", licenseHeader, guard, guard);
+    fprintf(f, "// Generated by train (%d epochs) for the standardization of the built-in models in modelset.cpp.\n", settings.epochs);
+    fprintf(f, "// Networks with %d inputs, a single hidden layer of %d neurons with a sigmoid activation function and one output\n"
+               "// neuron without activation function. Each line is a set of neuron weights starting from bias; the last line\n"
+               "// is the output neuron.\n", numInputs, settings.numHidden);
+    for (int objective = 0;  objective < 3;  objective++)
+    {
+        const TrainedModel &model = models[format][objective];
+        fprintf(f, "constexpr double %s_%s_model [] = {\n", formatNames[format], objectiveNames[objective]);
+        for (int h = 0;  h <= settings.numHidden;  h++)
+        {
+            const bool output = (h == settings.numHidden);
+            const int count = output ? 1 + settings.numHidden : 1 + numInputs;
+            const double *values = model.weights.data() + h * (1 + numInputs);
+            fprintf(f, "   ");
+            for (int i = 0;  i < count;  i++) fprintf(f, " %21.14e%s", values[i], (output && i + 1 == count) ? "" : ",");
+            fprintf(f, "\n");
+        }
+        fprintf(f, "};\n\n");
+    }
+    fprintf(f, "#endif // %s\n", guard);
+
+    const bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static void printUsage()
+{
+    printf("ACACIA model training: measures the real encoders on a corpus and trains the regression models.\n"
+           "Usage: train -list <path> -o <model file> [options]\n"
+           "Options:\n"
+           "  -list <path>         text file with one image path per line;\n"
+           "  -from-samples <path> train on samples written by -samples instead of measuring a corpus;\n"
+           "  -o <path>            model file to write (see libacacia/modelset.h), built-in models are used\n"
+           "                       for a format which is not trained;\n"
+           "  -header <directory>  also write jpegmodels.h and webpmodels.h of the trained formats, which replace the\n"
+           "                       built-in models of libacacia; the models are trained with the built-in standardization\n"
+           "                       then and the number of hidden neurons must be that of the built-in models;\n"
+           "  -samples <path>      write the measured samples to a CSV file;\n"
+           "  -jpeg, -webp         train only one format (both by default);\n"
+           "  -qf-step <n>         step of the quality factor sweep (default 1, every quality factor);\n"
+           "  -threads <n>         number of worker threads (default: all cores);\n"
+           "  -hidden <n>          number of hidden neurons (default 50);\n"
+           "  -epochs <n>          training epochs (default 300);\n"
+           "  -batch-size <n>      mini-batch size (default 32);\n"
+           "  -learning-rate <x>   initial learning rate of Adam (default 0.003);\n"
+           "  -validation <x>      share of images held out to select the best epoch and report the error (default 0.1);\n"
+           "  -silent              don't print progress.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *listPath = nullptr;
+    const char *samplesInPath = nullptr;
+    const char *modelPath = nullptr;
+    const char *headerPath = nullptr;
+    const char *samplesOutPath = nullptr;
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    Settings settings;
+    settings.formats[0] = true;
+    settings.formats[1] = true;
+    settings.qfStep = 1;
+    settings.numHidden = 50;
+    settings.epochs = 300;
+    settings.batchSize = 32;
+    settings.learningRate = 0.003;
+    settings.validationShare = 0.1;
+    settings.builtInStandardization = false;
+    settings.silent = false;
+
+    if (argc == 1) {
+        printUsage();
+        return 0;
+    }
+
+    for (int i = 1;  i < argc;  i++)
+    {
+        const char *argument = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool valid = true;
+
+        if (strcmp(argument, "-h") == 0 || strcmp(argument, "--help") == 0) {
+            printUsage();
+            return 0;
+        } else if (strcmp(argument, "-jpeg") == 0) {
+            settings.formats[0] = true;
+            settings.formats[1] = false;
+        } else if (strcmp(argument, "-webp") == 0) {
+            settings.formats[0] = false;
+            settings.formats[1] = true;
+        } else if (strcmp(argument, "-silent") == 0) {
+            settings.silent = true;
+        } else if (!value) {
+            valid = false;
+        } else {
+            i++;
+            if (strcmp(argument, "-list") == 0) listPath = value;
+            else if (strcmp(argument, "-from-samples") == 0) samplesInPath = value;
+            else if (strcmp(argument, "-o") == 0) modelPath = value;
+            else if (strcmp(argument, "-header") == 0) headerPath = value;
+            else if (strcmp(argument, "-samples") == 0) samplesOutPath = value;
+            else if (strcmp(argument, "-qf-step") == 0) valid = parseInt(value, &settings.qfStep) && settings.qfStep >= 1;
+            else if (strcmp(argument, "-threads") == 0) valid = parseInt(value, &numThreads) && numThreads >= 1;
+            else if (strcmp(argument, "-hidden") == 0) valid = parseInt(value, &settings.numHidden) && settings.numHidden >= 1;
+            else if (strcmp(argument, "-epochs") == 0) valid = parseInt(value, &settings.epochs) && settings.epochs >= 1;
+            else if (strcmp(argument, "-batch-size") == 0) valid = parseInt(value, &settings.batchSize) && settings.batchSize >= 1;
+            else if (strcmp(argument, "-learning-rate") == 0) valid = parseDouble(value, &settings.learningRate) && settings.learningRate > 0;
+            else if (strcmp(argument, "-validation") == 0) valid = parseDouble(value, &settings.validationShare) && settings.validationShare >= 0 && settings.validationShare < 1;
+            else valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "%serror: unknown, incomplete or invalid option \"%s\"\n", msgPref, argument);
+            return -1;
+        }
+    }
+
+    if (!listPath == !samplesInPath) {
+        fprintf(stderr, "%serror: either -list or -from-samples is required\n", msgPref);
+        return -1;
+    }
+    if (!modelPath && !headerPath && !samplesOutPath) {
+        fprintf(stderr, "%serror: missing output (-o, -header or -samples)\n", msgPref);
+        return -1;
+    }
+
+    // the fast and quantized inference is compiled from the built-in models with their topology and standardization
+    if (headerPath)
+    {
+        const int builtInHidden = ModelSet::builtIn().model(true, 's').numHidden;
+        if (settings.numHidden != builtInHidden) {
+            fprintf(stderr, "%serror: -header requires %d hidden neurons like the built-in models\n", msgPref, builtInHidden);
+            return -1;
+        }
+        settings.builtInStandardization = true;
+    }
+
+    TaskScheduler scheduler (numThreads);
+    std::vector<TrainingSample> samples;
+
+    if (samplesInPath)
+    {
+        if (!readSamples(samplesInPath, &samples)) {
+            fprintf(stderr, "%serror: can't read samples from \"%s\"\n", msgPref, samplesInPath);
+            return -1;
+        }
+    }
+    else
+    {
+        std::vector<std::string> images;
+        FILE *list = fopen(listPath, "r");
+        if (!list) {
+            fprintf(stderr, "%serror: can't read image list \"%s\"\n", msgPref, listPath);
+            return -1;
+        }
+        char line [4096];
+        while (fgets(line, sizeof(line), list))
+        {
+            size_t length = strlen(line);
+            while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+            if (length > 0) images.push_back(line);
+        }
+        fclose(list);
+
+        // every image is a task, its encodes are subtasks
+        const unsigned long long int startTime = nowNs();
+        std::vector<std::vector<TrainingSample>> imageSamples (images.size());
+        std::vector<char> imageOk (images.size(), 0);
+        std::atomic<int> numDone(0);
+        TaskGroup group;
+        for (size_t i = 0;  i < images.size();  i++)
+        {
+            scheduler.spawn(&group, [&, i]() {
+                imageOk[i] = measureImage(images[i], (int) i, settings, &scheduler, &imageSamples[i]);
+                const int done = ++numDone;
+                if (!imageOk[i]) fprintf(stderr, "%swarning: can't process \"%s\"\n", msgPref, images[i].c_str());
+                else if (!settings.silent) printf("%s%d/%d %s\n", msgPref, done, (int) images.size(), images[i].c_str());
+            });
+        }
+        scheduler.wait(&group);
+
+        int numFailed = 0;
+        for (size_t i = 0;  i < images.size();  i++) {
+            if (!imageOk[i]) numFailed++;
+            samples.insert(samples.end(), imageSamples[i].begin(), imageSamples[i].end());
+        }
+        if (!settings.silent) {
+            const double seconds = (nowNs() - startTime) / 1000000000.0;
+            printf("%s%d images measured, %d failed, %zu encodes in %.1f s (%.1f encodes/s, %d threads)\n", msgPref,
+                   (int) images.size() - numFailed, numFailed, samples.size(), seconds, samples.size() / seconds, numThreads);
+        }
+    }
+
+    if (samplesOutPath && !writeSamples(samplesOutPath, samples)) {
+        fprintf(stderr, "%serror: can't write samples to \"%s\"\n", msgPref, samplesOutPath);
+        return -1;
+    }
+    if (!modelPath && !headerPath) return 0;
+
+    // a format is trained only if it has samples
+    for (int format = 0;  format < 2;  format++)
+    {
+        if (!settings.formats[format]) continue;
+        int count = 0;
+        for (const TrainingSample &s : samples) {
+            if (s.format == format && !isValidationImage(s.image, settings.validationShare)) count++;
+        }
+        if (count < 2) {
+            fprintf(stderr, "%serror: not enough %s training samples\n", msgPref, formatNames[format]);
+            return -1;
+        }
+    }
+
+    // the six models are independent tasks
+    const unsigned long long int trainingStartTime = nowNs();
+    TrainedModel models [2][3];
+    scheduler.parallelFor(6, 1, [&](int begin, int end) {
+        for (int m = begin;  m < end;  m++) {
+            if (settings.formats[m / 3]) trainModel(samples, m / 3, m % 3, settings, &models[m / 3][m % 3]);
+        }
+    });
+
+    if (!settings.silent)
+    {
+        printf("%straining: %.1f s\n", msgPref, (nowNs() - trainingStartTime) / 1000000000.0);
+        printf("%-6s %-8s %10s %10s %14s %14s\n", "format", "model", "samples", "held out", "training RMSE", "held out RMSE");
+        for (int format = 0;  format < 2;  format++)
+        {
+            if (!settings.formats[format]) continue;
+            for (int objective = 0;  objective < 3;  objective++)
+            {
+                const TrainedModel &model = models[format][objective];
+                printf("%-6s %-8s %10d %10d %14.5f %14.5f\n", formatNames[format], objectiveNames[objective], model.numTrainingSamples,
+                       model.numValidationSamples, model.trainingError, model.validationError);
+            }
+        }
+        printf("(the size models predict the logarithm of the file size, their RMSE is about the relative error)\n");
+    }
+
+    for (int format = 0;  format < 2 && headerPath;  format++)
+    {
+        if (settings.formats[format] && !writeHeader(headerPath, format, models, settings)) {
+            fprintf(stderr, "%serror: can't write %smodels.h to \"%s\"\n", msgPref, formatNames[format], headerPath);
+            return -1;
+        }
+    }
+
+    if (modelPath)
+    {
+        ModelView views [2][3];
+        for (int format = 0;  format < 2;  format++)
+            for (int objective = 0;  objective < 3;  objective++)
+            {
+                const TrainedModel &model = models[format][objective];
+                views[format][objective] = settings.formats[format] ?
+                            ModelView {numInputs, settings.numHidden, model.layout, model.mean, model.sd, model.weights.data()} :
+                            ModelSet::builtIn().model(format == 0, objectives[objective]);
+            }
+        if (!ModelSet::save(modelPath, views)) return -1;    // the reason is already printed
+
+        // the library checks the file when it loads it
+        if (!ModelSet::load(modelPath)) return -1;
+    }
+
+    return 0;
+}
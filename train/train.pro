@@ -0,0 +1,25 @@
+# -------------------------------------------------------------------------------------------------
+#
+# Training of the regression models: compresses a corpus with the real encoders over a sweep of
+# quality factors, trains the perceptrons on the measured file sizes, Y-PSNR and Y-MSSIM and writes
+# a model file (see libacacia/modelset.h) and C++ arrays in the format of the built-in models.
+#
+# This target does not depend on Qt. Build it in release mode, the training is compute bound:
+#   qmake CONFIG+=release acacia.pro
+#   make
+#   train/train -list images.txt -o models.bin -header models.h
+#
+# -------------------------------------------------------------------------------------------------
+
+
+CONFIG  += console
+CONFIG  -= qt app_bundle
+
+TARGET   = train
+
+TEMPLATE = app
+
+include(../libacacia/libacacia.pri)
+
+SOURCES += \
+    train.cpp